@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cctype>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace kvdb {
+
+/**
+ * @brief Minimal blocking HTTP/1.1 client over one keep-alive
+ *        connection, for the load generator.
+ *
+ * One request at a time; responses must carry a Content-Length (every
+ * route the benchmark uses does). Any socket or framing error throws
+ * std::runtime_error and leaves the client closed; connect() again.
+ *
+ * Not thread-safe: one client per thread.
+ */
+class HttpClient {
+public:
+  struct Response {
+    int status = 0;
+    std::string body;
+  };
+
+  HttpClient(std::string host, std::string port)
+      : host_(std::move(host)), port_(std::move(port)) {}
+
+  ~HttpClient() { close(); }
+
+  // Non-copyable
+  HttpClient(const HttpClient &) = delete;
+  HttpClient &operator=(const HttpClient &) = delete;
+
+  [[nodiscard]] bool connected() const { return fd_ >= 0; }
+
+  /**
+   * @throws std::runtime_error If the host cannot be reached
+   */
+  void connect() {
+    close();
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *found = nullptr;
+    if (::getaddrinfo(host_.c_str(), port_.c_str(), &hints, &found) != 0) {
+      throw std::runtime_error("Cannot resolve " + host_);
+    }
+    for (addrinfo *a = found; a != nullptr && fd_ < 0; a = a->ai_next) {
+      fd_ = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC,
+                     a->ai_protocol);
+      if (fd_ >= 0 && ::connect(fd_, a->ai_addr, a->ai_addrlen) != 0) {
+        ::close(fd_);
+        fd_ = -1;
+      }
+    }
+    ::freeaddrinfo(found);
+    if (fd_ < 0) {
+      throw std::runtime_error("Cannot connect to " + host_ + ":" + port_);
+    }
+    int one = 1;
+    ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    input_.clear();
+  }
+
+  void close() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  /// GET `target` (path and query).
+  Response get(const std::string &target) {
+    return round_trip("GET " + target + " HTTP/1.1\r\nHost: " + host_ +
+                      "\r\n\r\n");
+  }
+
+  /// POST a MsgPack `body` to `path`.
+  Response post_msgpack(const std::string &path, const std::string &body) {
+    return round_trip("POST " + path + " HTTP/1.1\r\nHost: " + host_ +
+                      "\r\nContent-Type: application/msgpack\r\n"
+                      "Content-Length: " +
+                      std::to_string(body.size()) + "\r\n\r\n" + body);
+  }
+
+private:
+  std::string host_;
+  std::string port_;
+  int fd_ = -1;
+  std::string input_; ///< Received, not yet consumed
+
+  Response round_trip(const std::string &request) {
+    if (fd_ < 0) {
+      connect();
+    }
+    try {
+      send_all(request);
+      return read_response();
+    } catch (...) {
+      close();
+      throw;
+    }
+  }
+
+  void send_all(std::string_view data) {
+    while (!data.empty()) {
+      ssize_t n = ::send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        throw std::runtime_error(std::string("send failed: ") +
+                                 std::strerror(errno));
+      }
+      data.remove_prefix(static_cast<size_t>(n));
+    }
+  }
+
+  /// Receive more bytes into input_.
+  void receive() {
+    char buffer[16 * 1024];
+    while (true) {
+      ssize_t n = ::recv(fd_, buffer, sizeof(buffer), 0);
+      if (n > 0) {
+        input_.append(buffer, static_cast<size_t>(n));
+        return;
+      }
+      if (n < 0 && errno == EINTR)
+        continue;
+      throw std::runtime_error(n == 0 ? std::string("Connection closed")
+                                      : std::string("recv failed: ") +
+                                            std::strerror(errno));
+    }
+  }
+
+  Response read_response() {
+    size_t header_end;
+    while ((header_end = input_.find("\r\n\r\n")) == std::string::npos) {
+      receive();
+    }
+    const std::string_view head(input_.data(), header_end);
+    Response response;
+    if (head.size() < 12 || head.compare(0, 5, "HTTP/") != 0) {
+      throw std::runtime_error("Malformed HTTP response");
+    }
+    response.status = std::stoi(std::string(head.substr(9, 3)));
+    const std::string headers = lower(head);
+    const size_t length = content_length(headers);
+    const size_t total = header_end + 4 + length;
+    while (input_.size() < total) {
+      receive();
+    }
+    response.body = input_.substr(header_end + 4, length);
+    const bool closing =
+        headers.find("\r\nconnection: close") != std::string::npos;
+    input_.erase(0, total);
+    if (closing) {
+      close();
+    }
+    return response;
+  }
+
+  static std::string lower(std::string_view text) {
+    std::string out(text);
+    for (char &c : out) {
+      c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return out;
+  }
+
+  /// The Content-Length in a lower-cased header block.
+  static size_t content_length(const std::string &headers) {
+    const size_t at = headers.find("\r\ncontent-length:");
+    if (at == std::string::npos) {
+      throw std::runtime_error("HTTP response without Content-Length");
+    }
+    return std::stoul(headers.substr(at + 17));
+  }
+};
+
+} // namespace kvdb
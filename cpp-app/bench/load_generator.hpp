@@ -0,0 +1,463 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <msgpack.hpp>
+
+#include "commands/kv_command.hpp"
+#include "http_client.hpp"
+#include "metrics/metrics.hpp"
+#include "workload.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief How the load generator paces requests.
+ */
+enum class LoadMode {
+  CLOSED, ///< Each connection sends its next request once answered
+  OPEN    ///< Requests are due at a fixed rate, answered or not
+};
+
+/**
+ * @brief Parse a --mode value ("closed", "open").
+ * @throws std::invalid_argument On an unknown name
+ */
+inline LoadMode parse_load_mode(const std::string &name) {
+  if (name == "closed")
+    return LoadMode::CLOSED;
+  if (name == "open")
+    return LoadMode::OPEN;
+  throw std::invalid_argument("Unknown load mode: " + name);
+}
+
+/**
+ * @brief What `kvdb_bench load` runs, from `--name=value` flags.
+ */
+struct LoadOptions {
+  std::string host = "127.0.0.1";
+  std::string port = "8080";
+  LoadMode mode = LoadMode::CLOSED;
+  /// Open loop: requests per second, over all connections.
+  double rate = 1000;
+  size_t connections = 16;
+  std::chrono::seconds duration{30};
+  /// Run this long before measuring.
+  std::chrono::seconds warmup{5};
+  /// Fraction of requests that are GET /get-val; the rest are SETs.
+  double read_ratio = 0.9;
+  uint64_t keys = 100000;
+  KeyDistribution distribution = KeyDistribution::ZIPFIAN;
+  double zipf_theta = 0.99;
+  size_t value_bytes = 128;
+  /// Write every key once (with POST /mset) before the run.
+  bool preload = true;
+  /// ?consistency= of reads; empty for the node's default (stale).
+  std::string consistency;
+  uint64_t seed = 1;
+  /// File the JSON report goes to; empty for stdout.
+  std::string output;
+
+  /**
+   * @brief Parse argv[first..argc) as `--name=value` flags.
+   * @throws std::invalid_argument On an unknown or malformed flag
+   */
+  static LoadOptions from_args(int argc, char *argv[], int first) {
+    LoadOptions options;
+    for (int i = first; i < argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg.rfind("--", 0) != 0) {
+        throw std::invalid_argument("Unexpected argument: " + arg);
+      }
+      options.apply_flag(arg.substr(2));
+    }
+    if (options.connections == 0) {
+      throw std::invalid_argument("--connections must be at least 1");
+    }
+    if (options.mode == LoadMode::OPEN && !(options.rate > 0)) {
+      throw std::invalid_argument("--rate must be positive in open loop");
+    }
+    if (options.read_ratio < 0 || options.read_ratio > 1) {
+      throw std::invalid_argument("--reads must be in [0, 1]");
+    }
+    return options;
+  }
+
+private:
+  void apply_flag(const std::string &flag) {
+    const size_t eq_pos = flag.find('=');
+    if (eq_pos == std::string::npos) {
+      throw std::invalid_argument("Flag needs a value: --" + flag);
+    }
+    const std::string name = flag.substr(0, eq_pos);
+    const std::string value = flag.substr(eq_pos + 1);
+
+    if (name == "target") {
+      const size_t colon = value.rfind(':');
+      if (colon == std::string::npos) {
+        throw std::invalid_argument("--target needs host:port");
+      }
+      host = value.substr(0, colon);
+      port = value.substr(colon + 1);
+    } else if (name == "mode") {
+      mode = parse_load_mode(value);
+    } else if (name == "rate") {
+      rate = std::stod(value);
+    } else if (name == "connections") {
+      connections = std::stoul(value);
+    } else if (name == "duration-s") {
+      duration = std::chrono::seconds(std::stoul(value));
+    } else if (name == "warmup-s") {
+      warmup = std::chrono::seconds(std::stoul(value));
+    } else if (name == "reads") {
+      read_ratio = std::stod(value);
+    } else if (name == "keys") {
+      keys = std::stoull(value);
+    } else if (name == "distribution") {
+      distribution = parse_key_distribution(value);
+    } else if (name == "zipf-theta") {
+      zipf_theta = std::stod(value);
+    } else if (name == "value-bytes") {
+      value_bytes = std::stoul(value);
+    } else if (name == "preload") {
+      preload = value == "true" || value == "1";
+    } else if (name == "consistency") {
+      consistency = value;
+    } else if (name == "seed") {
+      seed = std::stoull(value);
+    } else if (name == "output") {
+      output = value;
+    } else {
+      throw std::invalid_argument("Unknown flag: --" + name);
+    }
+  }
+};
+
+/**
+ * @brief Latencies and errors of one kind of request.
+ */
+struct OperationStats {
+  LatencyHistogram latency;
+  std::atomic<uint64_t> max_ns{0};
+  std::atomic<uint64_t> errors{0};
+
+  void record(uint64_t ns) {
+    latency.record(ns);
+    uint64_t max = max_ns.load(std::memory_order_relaxed);
+    while (ns > max &&
+           !max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+  }
+};
+
+/**
+ * @brief HTTP load generator for a running node (`kvdb_bench load`).
+ *
+ * Each connection has its own thread and sends one request at a time:
+ * GET /get-val or POST /insert-val of a SET, picked by the read ratio,
+ * on a key drawn from the configured distribution.
+ *
+ * In a closed loop a connection sends its next request as soon as the
+ * last one is answered, so latency is measured from sending. In an open
+ * loop requests fall due at the configured rate (spread evenly over the
+ * connections) whether or not the earlier ones have been answered, and
+ * latency is measured from when each was due: a stalled server is
+ * charged for every request it held up, not just the one it stalled on
+ * (no coordinated omission). Requests still unsent when the run ends
+ * are reported as missed; any at all mean the server could not keep up
+ * with the rate.
+ *
+ * Throughput is answered requests over the measured time, which runs
+ * until the last request in flight is answered.
+ */
+class LoadGenerator {
+public:
+  /**
+   * @throws std::invalid_argument If the key distribution is invalid
+   */
+  explicit LoadGenerator(LoadOptions options)
+      : options_(std::move(options)),
+        chooser_(options_.distribution, options_.keys, options_.zipf_theta) {}
+
+  // Non-copyable
+  LoadGenerator(const LoadGenerator &) = delete;
+  LoadGenerator &operator=(const LoadGenerator &) = delete;
+
+  /**
+   * @brief Write every key once, kPreloadBatch keys per POST /mset.
+   * @throws std::runtime_error If any batch fails
+   */
+  void preload() {
+    const auto start = MetricsClock::now();
+    std::atomic<uint64_t> failed{0};
+    run_threads([&](size_t index) {
+      std::mt19937_64 engine(options_.seed ^ (index + 1));
+      HttpClient client(options_.host, options_.port);
+      const size_t stride = options_.connections * kPreloadBatch;
+      for (uint64_t first = index * kPreloadBatch; first < options_.keys;
+           first += stride) {
+        const uint64_t last = std::min<uint64_t>(first + kPreloadBatch,
+                                                 options_.keys);
+        try {
+          if (client.post_msgpack("/mset", mset_body(first, last, engine))
+                  .status != 200) {
+            failed.fetch_add(1, std::memory_order_relaxed);
+          }
+        } catch (const std::exception &) {
+          failed.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    });
+    if (failed.load() != 0) {
+      throw std::runtime_error("Preload failed: " +
+                               std::to_string(failed.load()) +
+                               " batches were not written");
+    }
+    preload_time_ = MetricsClock::now() - start;
+  }
+
+  /**
+   * @brief Run the workload for warmup + duration.
+   * @return The JSON report
+   */
+  std::string run() {
+    const auto start = MetricsClock::now();
+    const auto measure_from = start + options_.warmup;
+    const auto end = measure_from + options_.duration;
+    run_threads([&](size_t index) { drive(index, start, measure_from, end); });
+    measured_ = MetricsClock::now() - measure_from;
+    return report();
+  }
+
+private:
+  /// Keys per POST /mset while preloading.
+  static constexpr uint64_t kPreloadBatch = 100;
+  /// Distinct random values each connection cycles through.
+  static constexpr size_t kValuesPerConnection = 16;
+  /// Pause before reconnecting after a failed request.
+  static constexpr std::chrono::milliseconds kReconnectDelay{10};
+
+  LoadOptions options_;
+  KeyChooser chooser_;
+  OperationStats reads_;
+  OperationStats writes_;
+  std::atomic<uint64_t> missed_{0};
+  MetricsClock::duration preload_time_{0};
+  MetricsClock::duration measured_{0}; ///< From the warmup to the end
+
+  /// Run `body(i)` on one thread per connection and wait for them all.
+  template <typename Body> void run_threads(Body &&body) {
+    std::vector<std::thread> threads;
+    threads.reserve(options_.connections);
+    for (size_t i = 0; i < options_.connections; ++i) {
+      threads.emplace_back([&body, i] { body(i); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+
+  /// Body of connection `index`'s thread.
+  void drive(size_t index, MetricsClock::time_point start,
+             MetricsClock::time_point measure_from,
+             MetricsClock::time_point end) {
+    std::mt19937_64 engine(options_.seed * 0x9e3779b97f4a7c15ULL + index);
+    std::vector<std::string> values;
+    for (size_t i = 0; i < kValuesPerConnection; ++i) {
+      values.push_back(random_value(options_.value_bytes, engine));
+    }
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    HttpClient client(options_.host, options_.port);
+
+    const bool open = options_.mode == LoadMode::OPEN;
+    const auto interval =
+        open ? std::chrono::duration_cast<MetricsClock::duration>(
+                   std::chrono::duration<double>(
+                       static_cast<double>(options_.connections) /
+                       options_.rate))
+             : MetricsClock::duration::zero();
+    // Stagger the connections over one interval
+    MetricsClock::time_point due =
+        start + interval * static_cast<int64_t>(index) /
+                    static_cast<int64_t>(options_.connections);
+
+    for (uint64_t sent = 0;; ++sent) {
+      MetricsClock::time_point intended;
+      if (open) {
+        if (due >= end)
+          break;
+        if (MetricsClock::now() >= end) {
+          // Due but never sent: the server fell behind the rate
+          const auto from = std::max(due, measure_from);
+          missed_.fetch_add(static_cast<uint64_t>((end - from) / interval),
+                            std::memory_order_relaxed);
+          break;
+        }
+        std::this_thread::sleep_until(due);
+        intended = due;
+        due += interval;
+      } else {
+        intended = MetricsClock::now();
+        if (intended >= end)
+          break;
+      }
+
+      const bool read = coin(engine) < options_.read_ratio;
+      const std::string key = bench_key(chooser_.next(engine));
+      bool ok = false;
+      try {
+        const HttpClient::Response response =
+            read ? client.get(read_target(key))
+                 : client.post_msgpack(
+                       "/insert-val",
+                       set_command(key, values[sent % values.size()]));
+        ok = response.status == 200;
+      } catch (const std::exception &) {
+        std::this_thread::sleep_for(kReconnectDelay);
+      }
+      if (intended < measure_from)
+        continue;
+      OperationStats &stats = read ? reads_ : writes_;
+      if (ok) {
+        stats.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                MetricsClock::now() - intended)
+                .count()));
+      } else {
+        stats.errors.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  std::string read_target(const std::string &key) const {
+    std::string target = "/get-val?key=" + key;
+    if (!options_.consistency.empty()) {
+      target += "&consistency=" + options_.consistency;
+    }
+    return target;
+  }
+
+  static std::string set_command(const std::string &key,
+                                 const std::string &value) {
+    KVCommand command;
+    command.op = Operation::SET;
+    command.key = key;
+    command.value = value;
+    return command.to_msgpack();
+  }
+
+  template <typename Engine>
+  std::string mset_body(uint64_t first, uint64_t last, Engine &engine) const {
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    packer.pack_array(static_cast<uint32_t>(last - first));
+    for (uint64_t i = first; i < last; ++i) {
+      KVCommand command;
+      command.op = Operation::SET;
+      command.key = bench_key(i);
+      command.value = random_value(options_.value_bytes, engine);
+      command.pack(packer);
+    }
+    return std::string(buffer.data(), buffer.size());
+  }
+
+  static std::string number(double value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.3f", value);
+    return text;
+  }
+
+  /// `{"count": ..., "mean": ..., "p50": ..., ...}` in microseconds.
+  static std::string latency_json(const LatencyHistogram::Snapshot &totals,
+                                  uint64_t max_ns) {
+    static constexpr std::pair<const char *, double> kPercentiles[] = {
+        {"p50", 0.50},  {"p90", 0.90},    {"p99", 0.99},
+        {"p999", 0.999}, {"p9999", 0.9999}};
+    const double mean =
+        totals.count == 0 ? 0.0
+                          : static_cast<double>(totals.sum_ns) /
+                                static_cast<double>(totals.count);
+    std::string out = "{\"count\": " + std::to_string(totals.count) +
+                      ", \"mean\": " + number(mean / 1e3);
+    for (const auto &[name, q] : kPercentiles) {
+      const double value = static_cast<double>(
+          std::min(totals.percentile(q), max_ns));
+      out += std::string(", \"") + name + "\": " + number(value / 1e3);
+    }
+    out += ", \"max\": " + number(static_cast<double>(max_ns) / 1e3) + "}";
+    return out;
+  }
+
+  std::string report() const {
+    const LatencyHistogram::Snapshot reads = reads_.latency.snapshot();
+    const LatencyHistogram::Snapshot writes = writes_.latency.snapshot();
+    LatencyHistogram::Snapshot all = reads;
+    for (size_t i = 0; i < all.counts.size(); ++i) {
+      all.counts[i] += writes.counts[i];
+    }
+    all.count += writes.count;
+    all.sum_ns += writes.sum_ns;
+    const uint64_t errors = reads_.errors.load() + writes_.errors.load();
+    const double seconds = std::chrono::duration<double>(measured_).count();
+
+    std::string out = "{\n";
+    out += "  \"mode\": \"" +
+           std::string(options_.mode == LoadMode::OPEN ? "open" : "closed") +
+           "\",\n";
+    out += "  \"target\": \"" + options_.host + ":" + options_.port + "\",\n";
+    out += "  \"connections\": " + std::to_string(options_.connections) +
+           ",\n";
+    if (options_.mode == LoadMode::OPEN) {
+      out += "  \"rate\": " + number(options_.rate) + ",\n";
+    }
+    out += "  \"duration_s\": " + std::to_string(options_.duration.count()) +
+           ",\n";
+    out += "  \"warmup_s\": " + std::to_string(options_.warmup.count()) +
+           ",\n";
+    out += "  \"keys\": " + std::to_string(options_.keys) + ",\n";
+    out += "  \"distribution\": \"" +
+           std::string(key_distribution_name(options_.distribution)) +
+           "\",\n";
+    if (options_.distribution == KeyDistribution::ZIPFIAN) {
+      out += "  \"zipf_theta\": " + number(options_.zipf_theta) + ",\n";
+    }
+    out += "  \"read_ratio\": " + number(options_.read_ratio) + ",\n";
+    out += "  \"value_bytes\": " + std::to_string(options_.value_bytes) +
+           ",\n";
+    out += "  \"preload_s\": " +
+           number(std::chrono::duration<double>(preload_time_).count()) +
+           ",\n";
+    out += "  \"requests\": " + std::to_string(all.count + errors) + ",\n";
+    out += "  \"errors\": " + std::to_string(errors) + ",\n";
+    if (options_.mode == LoadMode::OPEN) {
+      out += "  \"missed\": " + std::to_string(missed_.load()) + ",\n";
+    }
+    out += "  \"throughput\": " +
+           number(seconds > 0 ? static_cast<double>(all.count) / seconds : 0) +
+           ",\n";
+    out += "  \"latency_us\": {\n";
+    out += "    \"read\": " +
+           latency_json(reads, reads_.max_ns.load()) + ",\n";
+    out += "    \"write\": " +
+           latency_json(writes, writes_.max_ns.load()) + ",\n";
+    out += "    \"all\": " +
+           latency_json(all, std::max(reads_.max_ns.load(),
+                                      writes_.max_ns.load())) +
+           "\n";
+    out += "  }\n}\n";
+    return out;
+  }
+};
+
+} // namespace kvdb
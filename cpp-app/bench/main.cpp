@@ -0,0 +1,93 @@
+/**
+ * @file main.cpp
+ * @brief Entry point for kvdb_bench.
+ *
+ *   kvdb_bench micro [--benchmark_...]
+ *       Microbenchmarks of the storage engines, the HTTP parser and
+ *       command decoding (Google Benchmark flags apply).
+ *   kvdb_bench load [--name=value ...]
+ *       Drive a running node over HTTP and print percentile latencies
+ *       as JSON (see LoadOptions for the flags).
+ */
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "load_generator.hpp"
+
+namespace kvdb {
+void register_micro_benchmarks();
+} // namespace kvdb
+
+using namespace kvdb;
+
+static int usage() {
+  std::cerr << "Usage: kvdb_bench micro [--benchmark_...]\n"
+               "       kvdb_bench load [--target=host:port]"
+               " [--mode=closed|open] [--rate=<req/s>]\n"
+               "                       [--connections=<n>] [--duration-s=<s>]"
+               " [--warmup-s=<s>]\n"
+               "                       [--reads=<fraction>] [--keys=<n>]"
+               " [--distribution=uniform|zipfian]\n"
+               "                       [--zipf-theta=<t>] [--value-bytes=<n>]"
+               " [--preload=true|false]\n"
+               "                       [--consistency=<level>] [--seed=<n>]"
+               " [--output=<file>]"
+            << std::endl;
+  return 2;
+}
+
+static int run_micro(int argc, char *argv[]) {
+  // Google Benchmark sees the arguments after "micro"
+  argv[1] = argv[0];
+  int args = argc - 1;
+  benchmark::Initialize(&args, argv + 1);
+  if (benchmark::ReportUnrecognizedArguments(args, argv + 1))
+    return 2;
+  register_micro_benchmarks();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
+
+static int run_load(int argc, char *argv[]) {
+  const LoadOptions options = LoadOptions::from_args(argc, argv, 2);
+  LoadGenerator generator(options);
+  if (options.preload) {
+    std::cerr << "Preloading " << options.keys << " keys..." << std::endl;
+    generator.preload();
+  }
+  std::cerr << "Running for " << options.warmup.count() << " s of warmup and "
+            << options.duration.count() << " s..." << std::endl;
+  const std::string report = generator.run();
+  if (options.output.empty()) {
+    std::cout << report;
+    return 0;
+  }
+  std::ofstream out(options.output);
+  out << report;
+  if (!out) {
+    std::cerr << "Cannot write " << options.output << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2)
+    return usage();
+  const std::string command = argv[1];
+  try {
+    if (command == "micro")
+      return run_micro(argc, argv);
+    if (command == "load")
+      return run_load(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  return usage();
+}
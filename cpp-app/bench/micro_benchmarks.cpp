@@ -0,0 +1,269 @@
+/**
+ * @file micro_benchmarks.cpp
+ * @brief Google Benchmark microbenchmarks (`kvdb_bench micro`).
+ *
+ * Storage engines run with --wal-sync=none semantics, so they measure
+ * the CPU cost of each operation rather than the disk's fdatasync.
+ */
+
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <msgpack.hpp>
+
+#include "commands/kv_command.hpp"
+#include "network/http_request.hpp"
+#include "storage/arena_kv_store.hpp"
+#include "storage/kv_store.hpp"
+#include "storage/lsm_kv_store.hpp"
+#include "storage/sharded_kv_store.hpp"
+#include "workload.hpp"
+
+namespace kvdb {
+namespace {
+
+/// Keys loaded before a read benchmark, and cycled through by writes.
+constexpr uint64_t kBenchKeys = 100000;
+constexpr size_t kValueBytes = 128;
+constexpr size_t kBatchWrites = 64;
+constexpr size_t kScanLength = 100;
+
+/// A fresh directory under $TMPDIR, removed with everything in it.
+class ScratchDir {
+public:
+  ScratchDir() {
+    const char *tmp = std::getenv("TMPDIR");
+    std::string pattern =
+        std::string(tmp != nullptr ? tmp : "/tmp") + "/kvdb_bench.XXXXXX";
+    if (::mkdtemp(pattern.data()) == nullptr) {
+      throw std::runtime_error("Cannot create a scratch directory");
+    }
+    path_ = pattern;
+  }
+
+  ~ScratchDir() {
+    std::error_code ignored;
+    std::filesystem::remove_all(path_, ignored);
+  }
+
+  // Non-copyable
+  ScratchDir(const ScratchDir &) = delete;
+  ScratchDir &operator=(const ScratchDir &) = delete;
+
+  [[nodiscard]] std::string file(const std::string &name) const {
+    return path_ + "/" + name;
+  }
+
+private:
+  std::string path_;
+};
+
+/// The engines, as the node's --engine names them.
+constexpr const char *kEngines[] = {"hash", "sharded", "arena", "lsm"};
+
+std::unique_ptr<IKVStore> make_engine(const std::string &engine,
+                                      const std::string &path) {
+  PersistenceOptions options;
+  options.sync_policy = SyncPolicy::NONE;
+  if (engine == "hash")
+    return std::make_unique<PersistentKVStore>(path, options);
+  if (engine == "sharded")
+    return std::make_unique<ShardedKVStore>(path, 16, options);
+  if (engine == "arena")
+    return std::make_unique<ArenaKVStore>(path, options);
+  return std::make_unique<LsmKVStore>(path, options);
+}
+
+std::vector<std::string> bench_keys() {
+  std::vector<std::string> keys;
+  keys.reserve(kBenchKeys);
+  for (uint64_t i = 0; i < kBenchKeys; ++i) {
+    keys.push_back(bench_key(i));
+  }
+  return keys;
+}
+
+/// Write every bench key once.
+void load(IKVStore &store, const std::vector<std::string> &keys,
+          const std::string &value) {
+  std::vector<BatchWrite> writes;
+  for (const auto &key : keys) {
+    writes.push_back(BatchWrite{key, value, 0, false});
+    if (writes.size() == 1000) {
+      store.write_batch(std::move(writes));
+      writes.clear();
+    }
+  }
+  store.write_batch(std::move(writes));
+}
+
+void store_set(benchmark::State &state, const std::string &engine) {
+  ScratchDir dir;
+  auto store = make_engine(engine, dir.file("db"));
+  std::mt19937_64 random(1);
+  const std::string value = random_value(kValueBytes, random);
+  const auto keys = bench_keys();
+  size_t next = 0;
+  for (auto _ : state) {
+    store->set(keys[next], value);
+    next = (next + 1) % keys.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void store_get(benchmark::State &state, const std::string &engine) {
+  ScratchDir dir;
+  auto store = make_engine(engine, dir.file("db"));
+  std::mt19937_64 random(1);
+  const auto keys = bench_keys();
+  load(*store, keys, random_value(kValueBytes, random));
+  const KeyChooser chooser(KeyDistribution::UNIFORM, keys.size());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(store->get(keys[chooser.next(random)]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void store_write_batch(benchmark::State &state, const std::string &engine) {
+  ScratchDir dir;
+  auto store = make_engine(engine, dir.file("db"));
+  std::mt19937_64 random(1);
+  const std::string value = random_value(kValueBytes, random);
+  const auto keys = bench_keys();
+  size_t next = 0;
+  for (auto _ : state) {
+    std::vector<BatchWrite> writes;
+    writes.reserve(kBatchWrites);
+    for (size_t i = 0; i < kBatchWrites; ++i) {
+      writes.push_back(BatchWrite{keys[next], value, 0, false});
+      next = (next + 1) % keys.size();
+    }
+    store->write_batch(std::move(writes));
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchWrites);
+}
+
+void store_scan(benchmark::State &state, const std::string &engine) {
+  ScratchDir dir;
+  auto store = make_engine(engine, dir.file("db"));
+  std::mt19937_64 random(1);
+  const auto keys = bench_keys();
+  load(*store, keys, random_value(kValueBytes, random));
+  const KeyChooser chooser(KeyDistribution::UNIFORM, keys.size());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        store->scan(keys[chooser.next(random)], "", kScanLength));
+  }
+  state.SetItemsProcessed(state.iterations() * kScanLength);
+}
+
+void parse_request(benchmark::State &state, const std::string &raw) {
+  HttpRequestParser parser(64 * 1024, 64 * 1024 * 1024);
+  HttpRequest request;
+  for (auto _ : state) {
+    parser.reset();
+    benchmark::DoNotOptimize(parser.parse(raw, request));
+    benchmark::DoNotOptimize(request);
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(raw.size()));
+}
+
+std::string get_request() {
+  return "GET /get-val?key=" + bench_key(42) +
+         "&consistency=lease HTTP/1.1\r\n"
+         "Host: localhost:8080\r\n"
+         "User-Agent: kvdb_bench\r\n"
+         "Accept: */*\r\n\r\n";
+}
+
+std::string set_command(size_t value_bytes) {
+  std::mt19937_64 random(1);
+  KVCommand command;
+  command.op = Operation::SET;
+  command.key = bench_key(42);
+  command.value = random_value(value_bytes, random);
+  return command.to_msgpack();
+}
+
+std::string post_request() {
+  const std::string body = set_command(kValueBytes);
+  return "POST /insert-val HTTP/1.1\r\n"
+         "Host: localhost:8080\r\n"
+         "User-Agent: kvdb_bench\r\n"
+         "Content-Type: application/msgpack\r\n"
+         "Content-Length: " +
+         std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+std::string batch_command() {
+  std::mt19937_64 random(1);
+  KVCommand batch;
+  batch.op = Operation::BATCH;
+  for (size_t i = 0; i < kBatchWrites; ++i) {
+    KVCommand command;
+    command.op = Operation::SET;
+    command.key = bench_key(i);
+    command.value = random_value(kValueBytes, random);
+    batch.commands.push_back(std::move(command));
+  }
+  return batch.to_msgpack();
+}
+
+void decode_command(benchmark::State &state, const std::string &encoded) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        KVCommand::from_msgpack(encoded.data(), encoded.size()));
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(encoded.size()));
+}
+
+void decode_command_view(benchmark::State &state,
+                         const std::string &encoded) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(KVCommandView::parse(encoded));
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(encoded.size()));
+}
+
+} // namespace
+
+/**
+ * @brief Register every microbenchmark with Google Benchmark.
+ */
+void register_micro_benchmarks() {
+  for (const char *engine : kEngines) {
+    const std::string name = engine;
+    benchmark::RegisterBenchmark(("Store/Set/" + name).c_str(), store_set,
+                                 name);
+    benchmark::RegisterBenchmark(("Store/Get/" + name).c_str(), store_get,
+                                 name);
+    benchmark::RegisterBenchmark(("Store/WriteBatch/" + name).c_str(),
+                                 store_write_batch, name);
+    benchmark::RegisterBenchmark(("Store/Scan/" + name).c_str(), store_scan,
+                                 name);
+  }
+  benchmark::RegisterBenchmark("HttpRequestParser/Get", parse_request,
+                               get_request());
+  benchmark::RegisterBenchmark("HttpRequestParser/PostMsgPack",
+                               parse_request, post_request());
+  benchmark::RegisterBenchmark("KVCommand/FromMsgPack/Set", decode_command,
+                               set_command(kValueBytes));
+  benchmark::RegisterBenchmark("KVCommand/FromMsgPack/Batch",
+                               decode_command, batch_command());
+  benchmark::RegisterBenchmark("KVCommandView/Parse/Set",
+                               decode_command_view, set_command(kValueBytes));
+  benchmark::RegisterBenchmark("KVCommandView/Parse/Batch",
+                               decode_command_view, batch_command());
+}
+
+} // namespace kvdb
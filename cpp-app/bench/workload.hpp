@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace kvdb {
+
+/**
+ * @brief How benchmark keys are picked.
+ */
+enum class KeyDistribution {
+  UNIFORM, ///< Every key equally likely
+  ZIPFIAN  ///< A few hot keys, scattered over the key space (as YCSB)
+};
+
+/**
+ * @brief Parse a --distribution value ("uniform", "zipfian").
+ * @throws std::invalid_argument On an unknown name
+ */
+inline KeyDistribution parse_key_distribution(const std::string &name) {
+  if (name == "uniform")
+    return KeyDistribution::UNIFORM;
+  if (name == "zipfian")
+    return KeyDistribution::ZIPFIAN;
+  throw std::invalid_argument("Unknown key distribution: " + name);
+}
+
+inline const char *key_distribution_name(KeyDistribution distribution) {
+  return distribution == KeyDistribution::UNIFORM ? "uniform" : "zipfian";
+}
+
+/**
+ * @brief Zipfian ranks in [0, items), rank 0 the most popular.
+ *
+ * The generator of Gray et al., "Quickly Generating Billion-Record
+ * Synthetic Databases" (as in YCSB): constant time per draw after an
+ * O(items) setup.
+ *
+ * Immutable once built, so threads may share one, each with its own
+ * random engine.
+ */
+class ZipfianGenerator {
+public:
+  /**
+   * @param items Number of ranks (must be > 0)
+   * @param theta Skew, in (0, 1); YCSB uses 0.99
+   * @throws std::invalid_argument If either is out of range
+   */
+  explicit ZipfianGenerator(uint64_t items, double theta = 0.99)
+      : items_(items), theta_(theta) {
+    if (items == 0) {
+      throw std::invalid_argument("Zipfian distribution needs items");
+    }
+    if (!(theta > 0.0 && theta < 1.0)) {
+      throw std::invalid_argument("Zipfian theta must be in (0, 1)");
+    }
+    for (uint64_t i = 1; i <= items_; ++i) {
+      zeta_n_ += 1.0 / std::pow(static_cast<double>(i), theta_);
+    }
+    zeta_2_ = 1.0 + std::pow(0.5, theta_);
+    alpha_ = 1.0 / (1.0 - theta_);
+    eta_ = (1.0 - std::pow(2.0 / static_cast<double>(items_), 1.0 - theta_)) /
+           (1.0 - zeta_2_ / zeta_n_);
+  }
+
+  template <typename Engine> uint64_t next(Engine &engine) const {
+    const double u = std::uniform_real_distribution<double>(0.0, 1.0)(engine);
+    const double uz = u * zeta_n_;
+    if (uz < 1.0)
+      return 0;
+    if (uz < zeta_2_)
+      return std::min<uint64_t>(1, items_ - 1);
+    const auto rank = static_cast<uint64_t>(
+        static_cast<double>(items_) * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+    return std::min(rank, items_ - 1);
+  }
+
+private:
+  uint64_t items_;
+  double theta_;
+  double zeta_n_ = 0.0; ///< Sum of 1 / i^theta over every rank
+  double zeta_2_ = 0.0; ///< The same over the first two
+  double alpha_ = 0.0;
+  double eta_ = 0.0;
+};
+
+/**
+ * @brief Picks key numbers in [0, keys) from a KeyDistribution.
+ *
+ * Zipfian ranks are hashed onto the key space, so the hot keys are not
+ * neighbours (which would put them all in one range of an ordered
+ * engine).
+ *
+ * Immutable once built; threads share one.
+ */
+class KeyChooser {
+public:
+  /**
+   * @throws std::invalid_argument If `keys` is 0 or `theta` out of range
+   */
+  KeyChooser(KeyDistribution distribution, uint64_t keys,
+             double theta = 0.99)
+      : distribution_(distribution), keys_(keys),
+        zipfian_(distribution == KeyDistribution::ZIPFIAN ? keys : 1, theta) {
+    if (keys == 0) {
+      throw std::invalid_argument("Workload needs at least one key");
+    }
+  }
+
+  template <typename Engine> uint64_t next(Engine &engine) const {
+    if (distribution_ == KeyDistribution::UNIFORM) {
+      return std::uniform_int_distribution<uint64_t>(0, keys_ - 1)(engine);
+    }
+    return fnv1a(zipfian_.next(engine)) % keys_;
+  }
+
+private:
+  KeyDistribution distribution_;
+  uint64_t keys_;
+  ZipfianGenerator zipfian_;
+
+  static uint64_t fnv1a(uint64_t value) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < 8; ++i) {
+      hash ^= (value >> (8 * i)) & 0xff;
+      hash *= 0x100000001b3ULL;
+    }
+    return hash;
+  }
+};
+
+/**
+ * @brief The key numbered `index`: "key" and 12 digits, so keys sort
+ *        by number and are all the same length.
+ */
+inline std::string bench_key(uint64_t index) {
+  char key[32];
+  std::snprintf(key, sizeof(key), "key%012llu",
+                static_cast<unsigned long long>(index));
+  return key;
+}
+
+/**
+ * @brief `bytes` random letters and digits: incompressible enough that
+ *        value compression does not flatter the results.
+ */
+template <typename Engine>
+std::string random_value(size_t bytes, Engine &engine) {
+  static constexpr char kAlphabet[] =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  std::uniform_int_distribution<size_t> pick(0, sizeof(kAlphabet) - 2);
+  std::string value(bytes, '\0');
+  for (char &c : value) {
+    c = kAlphabet[pick(engine)];
+  }
+  return value;
+}
+
+} // namespace kvdb
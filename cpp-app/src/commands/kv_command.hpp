@@ -1,52 +1,371 @@
 #pragma once
 
 #include <msgpack.hpp>
+
+#include <cstdint>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "msgpack_reader.hpp"
 
 namespace kvdb {
 
 /**
  * @brief Operation types supported by the KV store.
+ *
+ * The values are the opcodes written for 'op' on the wire; they must
+ * never change.
  */
-enum class Operation { SET, DELETE, UNKNOWN };
+enum class Operation : uint8_t {
+  UNKNOWN = 0,
+  SET = 1,
+  DELETE = 2,
+  EXPIRE = 3,
+  BATCH = 4
+};
 
 /**
  * @brief Parse operation string to enum.
  */
-inline Operation parse_operation(const std::string &op) {
+inline Operation parse_operation(std::string_view op) {
   if (op == "SET")
     return Operation::SET;
   if (op == "DELETE")
     return Operation::DELETE;
+  if (op == "EXPIRE")
+    return Operation::EXPIRE;
+  if (op == "BATCH")
+    return Operation::BATCH;
+  return Operation::UNKNOWN;
+}
+
+/**
+ * @brief Map a wire opcode to its operation.
+ */
+inline Operation operation_from_code(uint64_t code) {
+  if (code >= static_cast<uint64_t>(Operation::SET) &&
+      code <= static_cast<uint64_t>(Operation::BATCH))
+    return static_cast<Operation>(code);
   return Operation::UNKNOWN;
 }
 
+/**
+ * @brief The name of an operation, as clients spell it.
+ */
+inline const char *operation_name(Operation op) {
+  switch (op) {
+  case Operation::SET:
+    return "SET";
+  case Operation::DELETE:
+    return "DELETE";
+  case Operation::EXPIRE:
+    return "EXPIRE";
+  case Operation::BATCH:
+    return "BATCH";
+  default:
+    return "UNKNOWN";
+  }
+}
+
+/**
+ * @brief A MsgPack-encoded command, decoded in place.
+ *
+ * Strings are views into the encoded bytes, which must outlive the
+ * view; 'expired_keys' and 'commands' stay encoded and are decoded on
+ * the fly by for_each_expired_key() and for_each_command(). parse()
+ * checks the whole command, nested ones included, so those never throw.
+ *
+ * This is what the state machine applies: decoding a command allocates
+ * nothing, and its key and value are copied once, into the store.
+ * Fields are as for KVCommand; 'op' may be a name or an opcode.
+ */
+struct KVCommandView {
+  Operation op = Operation::UNKNOWN;
+  std::string_view key;
+  std::string_view value;
+  uint64_t ttl_ms = 0;
+  uint64_t expires_at_ms = 0; ///< 0 = never
+  uint32_t expired_key_count = 0;
+  uint32_t command_count = 0;    ///< BATCH only
+  std::string_view expired_keys; ///< The encoded [key, deadline] pairs
+  std::string_view commands;     ///< The encoded commands
+  std::string_view encoded;      ///< The whole command
+
+  /**
+   * @brief Decode the command at the start of `data`.
+   * @throws std::runtime_error If it is malformed
+   */
+  static KVCommandView parse(std::string_view data) {
+    MsgPackReader reader(data);
+    return read(reader);
+  }
+
+  /**
+   * @brief Decode the next command from `reader`.
+   * @throws std::runtime_error If it is malformed
+   */
+  static KVCommandView read(MsgPackReader &reader) { return read(reader, 0); }
+
+  /**
+   * @brief Call `visit(key, expires_at_ms)` for each of an EXPIRE's keys.
+   */
+  template <typename Visitor>
+  void for_each_expired_key(Visitor &&visit) const {
+    MsgPackReader reader(expired_keys);
+    for (uint32_t i = 0; i < expired_key_count; ++i) {
+      reader.read_array();
+      const std::string_view expired = reader.read_string();
+      visit(expired, reader.read_uint());
+    }
+  }
+
+  /**
+   * @brief Call `visit(command)` for each of a BATCH's commands.
+   */
+  template <typename Visitor> void for_each_command(Visitor &&visit) const {
+    MsgPackReader reader(commands);
+    for (uint32_t i = 0; i < command_count; ++i) {
+      visit(read(reader));
+    }
+  }
+
+  /**
+   * @brief Check if this is a valid command (as KVCommand::is_valid()).
+   */
+  [[nodiscard]] bool is_valid() const {
+    switch (op) {
+    case Operation::EXPIRE:
+      return expired_key_count != 0;
+    case Operation::BATCH: {
+      if (command_count == 0)
+        return false;
+      bool valid = true;
+      for_each_command([&valid](const KVCommandView &command) {
+        valid = valid &&
+                (command.op == Operation::SET ||
+                 command.op == Operation::DELETE) &&
+                command.is_valid();
+      });
+      return valid;
+    }
+    case Operation::UNKNOWN:
+      return false;
+    default:
+      return !key.empty();
+    }
+  }
+
+private:
+  /// Deepest nesting of BATCHes parse() accepts.
+  static constexpr int kMaxDepth = 4;
+
+  static KVCommandView read(MsgPackReader &reader, int depth) {
+    if (depth > kMaxDepth) {
+      throw std::runtime_error("Malformed MsgPack: commands nested too deep");
+    }
+    KVCommandView view;
+    const size_t begin = reader.offset();
+    const std::string_view data = reader.remaining();
+    const uint32_t fields = reader.read_map();
+    for (uint32_t i = 0; i < fields; ++i) {
+      if (reader.peek() != MsgPackReader::Type::STR) {
+        reader.skip();
+        reader.skip();
+        continue;
+      }
+      const std::string_view field = reader.read_string();
+      if (field == "op") {
+        view.op = reader.peek() == MsgPackReader::Type::INT
+                      ? operation_from_code(reader.read_uint())
+                      : parse_operation(reader.read_string());
+      } else if (field == "key") {
+        view.key = reader.read_string();
+      } else if (field == "value") {
+        view.value = reader.read_string();
+      } else if (field == "ttl_ms") {
+        view.ttl_ms = reader.read_uint();
+      } else if (field == "expires_at_ms") {
+        view.expires_at_ms = reader.read_uint();
+      } else if (field == "expired_keys") {
+        view.expired_key_count = reader.read_array();
+        const size_t start = reader.offset();
+        for (uint32_t k = 0; k < view.expired_key_count; ++k) {
+          if (reader.read_array() != 2) {
+            throw std::runtime_error("Malformed MsgPack: expected a pair");
+          }
+          reader.read_string();
+          reader.read_uint();
+        }
+        view.expired_keys =
+            data.substr(start - begin, reader.offset() - start);
+      } else if (field == "commands") {
+        view.command_count = reader.read_array();
+        const size_t start = reader.offset();
+        for (uint32_t c = 0; c < view.command_count; ++c) {
+          read(reader, depth + 1);
+        }
+        view.commands = data.substr(start - begin, reader.offset() - start);
+      } else {
+        reader.skip();
+      }
+    }
+    view.encoded = data.substr(0, reader.offset() - begin);
+    return view;
+  }
+};
+
 /**
  * @brief Command structure for KV operations.
  *
  * This structure is serialized/deserialized using MsgPack
  * for efficient binary transmission over Raft consensus.
  *
- * Maps to the format: {'op': '...', 'key': '...', 'value': '...'}
+ * Maps to the format: {'op': ..., 'key': '...', 'value': '...'}, where
+ * 'op' is an Operation opcode (or, as clients and older nodes write
+ * it, its name). to_msgpack() leaves out fields with default values.
+ *
+ * A SET may also carry 'ttl_ms' (relative; turned into 'expires_at_ms'
+ * by the node that proposes it, see resolve_ttl) or 'expires_at_ms'
+ * (Unix time in ms). Missing fields keep their defaults.
+ *
+ * EXPIRE is proposed by the leader's KeyExpirer, never by clients: it
+ * deletes each key in 'expired_keys' whose deadline is still the one
+ * listed, so a key re-set in the meantime survives.
+ *
+ * BATCH carries SETs and DELETEs in 'commands' (see POST /mset): one
+ * Raft entry, applied in order as one IKVStore::write_batch.
  */
 struct KVCommand {
-  std::string op;
+  Operation op = Operation::UNKNOWN;
   std::string key;
   std::string value;
-
-  // MsgPack serialization macro
-  MSGPACK_DEFINE_MAP(op, key, value);
+  uint64_t ttl_ms = 0;
+  uint64_t expires_at_ms = 0; ///< 0 = never
+  std::vector<std::pair<std::string, uint64_t>> expired_keys;
+  std::vector<KVCommand> commands; ///< BATCH only
 
   /**
    * @brief Get the operation type as an enum.
    */
-  [[nodiscard]] Operation operation_type() const { return parse_operation(op); }
+  [[nodiscard]] Operation operation_type() const { return op; }
 
   /**
    * @brief Check if this is a valid command.
    */
   [[nodiscard]] bool is_valid() const {
-    return operation_type() != Operation::UNKNOWN && !key.empty();
+    switch (operation_type()) {
+    case Operation::EXPIRE:
+      return !expired_keys.empty();
+    case Operation::BATCH:
+      if (commands.empty())
+        return false;
+      for (const auto &command : commands) {
+        const Operation type = command.operation_type();
+        if ((type != Operation::SET && type != Operation::DELETE) ||
+            !command.is_valid())
+          return false;
+      }
+      return true;
+    case Operation::UNKNOWN:
+      return false;
+    default:
+      return !key.empty();
+    }
+  }
+
+  /**
+   * @brief Replace a relative ttl_ms with an absolute deadline.
+   *
+   * Must happen once, before proposing, so every replica applies the
+   * same deadline.
+   *
+   * @param now_ms Current Unix time in milliseconds
+   * @return true if the command changed
+   */
+  bool resolve_ttl(uint64_t now_ms) {
+    bool changed = false;
+    for (auto &command : commands) {
+      changed |= command.resolve_ttl(now_ms);
+    }
+    if (ttl_ms == 0)
+      return changed;
+    expires_at_ms = now_ms + ttl_ms;
+    ttl_ms = 0;
+    return true;
+  }
+
+  /**
+   * @brief Serialize to MsgPack.
+   */
+  [[nodiscard]] std::string to_msgpack() const {
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    pack(packer);
+    return std::string(buffer.data(), buffer.size());
+  }
+
+  /**
+   * @brief Write as a MsgPack map, without the fields left at their
+   *        defaults.
+   */
+  template <typename Stream> void pack(msgpack::packer<Stream> &packer) const {
+    const uint32_t size = 1 + !key.empty() + !value.empty() + (ttl_ms != 0) +
+                          (expires_at_ms != 0) + !expired_keys.empty() +
+                          !commands.empty();
+    packer.pack_map(size);
+    packer.pack(std::string("op"));
+    packer.pack(static_cast<uint8_t>(op));
+    if (!key.empty()) {
+      packer.pack(std::string("key"));
+      packer.pack(key);
+    }
+    if (!value.empty()) {
+      packer.pack(std::string("value"));
+      packer.pack(value);
+    }
+    if (ttl_ms != 0) {
+      packer.pack(std::string("ttl_ms"));
+      packer.pack(ttl_ms);
+    }
+    if (expires_at_ms != 0) {
+      packer.pack(std::string("expires_at_ms"));
+      packer.pack(expires_at_ms);
+    }
+    if (!expired_keys.empty()) {
+      packer.pack(std::string("expired_keys"));
+      packer.pack(expired_keys);
+    }
+    if (!commands.empty()) {
+      packer.pack(std::string("commands"));
+      packer.pack_array(static_cast<uint32_t>(commands.size()));
+      for (const auto &command : commands) {
+        command.pack(packer);
+      }
+    }
+  }
+
+  /**
+   * @brief Copy a decoded command.
+   */
+  static KVCommand from_view(const KVCommandView &view) {
+    KVCommand cmd;
+    cmd.op = view.op;
+    cmd.key = std::string(view.key);
+    cmd.value = std::string(view.value);
+    cmd.ttl_ms = view.ttl_ms;
+    cmd.expires_at_ms = view.expires_at_ms;
+    cmd.expired_keys.reserve(view.expired_key_count);
+    view.for_each_expired_key([&cmd](std::string_view key, uint64_t at_ms) {
+      cmd.expired_keys.emplace_back(std::string(key), at_ms);
+    });
+    cmd.commands.reserve(view.command_count);
+    view.for_each_command([&cmd](const KVCommandView &command) {
+      cmd.commands.push_back(from_view(command));
+    });
+    return cmd;
   }
 
   /**
@@ -58,11 +377,7 @@ struct KVCommand {
    * @throws std::runtime_error If deserialization fails
    */
   static KVCommand from_msgpack(const char *data, size_t size) {
-    KVCommand cmd;
-    msgpack::object_handle oh = msgpack::unpack(data, size);
-    msgpack::object obj = oh.get();
-    obj.convert(cmd);
-    return cmd;
+    return from_view(KVCommandView::parse(std::string_view(data, size)));
   }
 };
 
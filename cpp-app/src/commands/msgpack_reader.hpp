@@ -0,0 +1,280 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace kvdb {
+
+/**
+ * @brief Forward-only MsgPack decoder over a byte buffer.
+ *
+ * Unlike msgpack::unpack, which builds an object tree in a zone, it
+ * reads one value at a time straight from the buffer: strings come back
+ * as views into it, so decoding allocates nothing. The buffer must
+ * outlive the views.
+ *
+ * Every read throws std::runtime_error if the next value is truncated
+ * or of another type.
+ */
+class MsgPackReader {
+public:
+  /// Kinds of MsgPack values, as far as readers care.
+  enum class Type { NIL, BOOL, INT, FLOAT, STR, BIN, ARRAY, MAP, EXT };
+
+  explicit MsgPackReader(std::string_view data) : data_(data) {}
+
+  [[nodiscard]] bool at_end() const { return pos_ == data_.size(); }
+
+  /// Bytes read so far.
+  [[nodiscard]] size_t offset() const { return pos_; }
+
+  /// The bytes not read yet.
+  [[nodiscard]] std::string_view remaining() const {
+    return data_.substr(pos_);
+  }
+
+  /// The type of the next value.
+  [[nodiscard]] Type peek() const {
+    if (at_end())
+      malformed("unexpected end of data");
+    const uint8_t b = static_cast<uint8_t>(data_[pos_]);
+    if (b <= 0x7f || b >= 0xe0)
+      return Type::INT;
+    if (b <= 0x8f)
+      return Type::MAP;
+    if (b <= 0x9f)
+      return Type::ARRAY;
+    if (b <= 0xbf)
+      return Type::STR;
+    switch (b) {
+    case 0xc0:
+      return Type::NIL;
+    case 0xc2:
+    case 0xc3:
+      return Type::BOOL;
+    case 0xc4:
+    case 0xc5:
+    case 0xc6:
+      return Type::BIN;
+    case 0xca:
+    case 0xcb:
+      return Type::FLOAT;
+    case 0xcc:
+    case 0xcd:
+    case 0xce:
+    case 0xcf:
+    case 0xd0:
+    case 0xd1:
+    case 0xd2:
+    case 0xd3:
+      return Type::INT;
+    case 0xd9:
+    case 0xda:
+    case 0xdb:
+      return Type::STR;
+    case 0xdc:
+    case 0xdd:
+      return Type::ARRAY;
+    case 0xde:
+    case 0xdf:
+      return Type::MAP;
+    case 0xc1:
+      malformed("reserved type byte");
+    default:
+      return Type::EXT;
+    }
+  }
+
+  /// Read a map header: the number of key/value pairs that follow.
+  uint32_t read_map() {
+    const uint8_t b = byte();
+    if (b >= 0x80 && b <= 0x8f)
+      return b & 0x0f;
+    if (b == 0xde)
+      return static_cast<uint32_t>(big_endian(2));
+    if (b == 0xdf)
+      return static_cast<uint32_t>(big_endian(4));
+    malformed("expected a map");
+  }
+
+  /// Read an array header: the number of elements that follow.
+  uint32_t read_array() {
+    const uint8_t b = byte();
+    if (b >= 0x90 && b <= 0x9f)
+      return b & 0x0f;
+    if (b == 0xdc)
+      return static_cast<uint32_t>(big_endian(2));
+    if (b == 0xdd)
+      return static_cast<uint32_t>(big_endian(4));
+    malformed("expected an array");
+  }
+
+  /// Read a str or bin value.
+  std::string_view read_string() {
+    const uint8_t b = byte();
+    if (b >= 0xa0 && b <= 0xbf)
+      return take(b & 0x1f);
+    switch (b) {
+    case 0xc4:
+    case 0xd9:
+      return take(big_endian(1));
+    case 0xc5:
+    case 0xda:
+      return take(big_endian(2));
+    case 0xc6:
+    case 0xdb:
+      return take(big_endian(4));
+    default:
+      malformed("expected a string");
+    }
+  }
+
+  /// Read a non-negative integer (of any width or signedness).
+  uint64_t read_uint() {
+    const uint8_t b = byte();
+    if (b <= 0x7f)
+      return b;
+    switch (b) {
+    case 0xcc:
+      return big_endian(1);
+    case 0xcd:
+      return big_endian(2);
+    case 0xce:
+      return big_endian(4);
+    case 0xcf:
+      return big_endian(8);
+    case 0xd0:
+      return non_negative(static_cast<int8_t>(big_endian(1)));
+    case 0xd1:
+      return non_negative(static_cast<int16_t>(big_endian(2)));
+    case 0xd2:
+      return non_negative(static_cast<int32_t>(big_endian(4)));
+    case 0xd3:
+      return non_negative(static_cast<int64_t>(big_endian(8)));
+    default:
+      malformed("expected a non-negative integer");
+    }
+  }
+
+  /// Skip the next value, with everything nested in it.
+  void skip() {
+    uint64_t pending = 1;
+    while (pending > 0) {
+      --pending;
+      switch (peek()) {
+      case Type::ARRAY:
+        pending += read_array();
+        break;
+      case Type::MAP:
+        pending += uint64_t{2} * read_map();
+        break;
+      case Type::STR:
+      case Type::BIN:
+        read_string();
+        break;
+      default:
+        skip_scalar();
+        break;
+      }
+    }
+  }
+
+private:
+  std::string_view data_;
+  size_t pos_ = 0;
+
+  [[noreturn]] static void malformed(const char *what) {
+    throw std::runtime_error(std::string("Malformed MsgPack: ") + what);
+  }
+
+  uint8_t byte() {
+    if (at_end())
+      malformed("unexpected end of data");
+    return static_cast<uint8_t>(data_[pos_++]);
+  }
+
+  std::string_view take(uint64_t size) {
+    if (size > data_.size() - pos_)
+      malformed("unexpected end of data");
+    std::string_view bytes = data_.substr(pos_, size);
+    pos_ += size;
+    return bytes;
+  }
+
+  uint64_t big_endian(size_t width) {
+    const std::string_view bytes = take(width);
+    uint64_t value = 0;
+    for (unsigned char c : bytes) {
+      value = value << 8 | c;
+    }
+    return value;
+  }
+
+  static uint64_t non_negative(int64_t value) {
+    if (value < 0)
+      malformed("expected a non-negative integer");
+    return static_cast<uint64_t>(value);
+  }
+
+  /// Skip a nil, bool, number or ext value.
+  void skip_scalar() {
+    const uint8_t b = byte();
+    if (b <= 0x7f || b >= 0xe0)
+      return;
+    switch (b) {
+    case 0xc0:
+    case 0xc2:
+    case 0xc3:
+      return;
+    case 0xcc:
+    case 0xd0:
+      take(1);
+      return;
+    case 0xcd:
+    case 0xd1:
+      take(2);
+      return;
+    case 0xca:
+    case 0xce:
+    case 0xd2:
+      take(4);
+      return;
+    case 0xcb:
+    case 0xcf:
+    case 0xd3:
+      take(8);
+      return;
+    case 0xd4: // fixext 1, 2, 4, 8, 16: type byte and data
+      take(1 + 1);
+      return;
+    case 0xd5:
+      take(1 + 2);
+      return;
+    case 0xd6:
+      take(1 + 4);
+      return;
+    case 0xd7:
+      take(1 + 8);
+      return;
+    case 0xd8:
+      take(1 + 16);
+      return;
+    case 0xc7: // ext 8, 16, 32: size, type byte and data
+      take(1 + big_endian(1));
+      return;
+    case 0xc8:
+      take(1 + big_endian(2));
+      return;
+    case 0xc9:
+      take(1 + big_endian(4));
+      return;
+    default:
+      malformed("unexpected type byte");
+    }
+  }
+};
+
+} // namespace kvdb
@@ -1,7 +1,19 @@
 #pragma once
 
+#include <chrono>
+#include <stdexcept>
 #include <string>
 
+#include "../logging/logger.hpp"
+#include "../network/http_server.hpp"
+#include "../raft/admission_controller.hpp"
+#include "../raft/apply_ring.hpp"
+#include "../raft/proposal_batcher.hpp"
+#include "../raft/state_machine_server.hpp"
+#include "../storage/expiring_kv_store.hpp"
+#include "../storage/persistence.hpp"
+#include "../storage/value_codec.hpp"
+
 namespace kvdb {
 
 /**
@@ -15,7 +27,45 @@ struct Config {
   std::string db_file;
   std::string grpc_port;
   std::string sidecar_port;
+  std::string grpc_socket;    ///< Unix socket path; empty = TCP grpc_port
+  std::string sidecar_socket; ///< Same, for the sidecar
+  std::string apply_ring;     ///< Shared-memory ring path; empty = none
+  size_t apply_ring_mb;
   int http_port;
+  std::string engine;
+  size_t shard_count;
+  std::string wal_sync;
+  size_t group_commit_max_batch;
+  int group_commit_max_delay_us;
+  bool lazy_values;
+  size_t lsm_memtable_mb;
+  std::string compression;
+  size_t compression_min_bytes;
+  int compression_level;
+  std::string compression_dict;
+  int expiry_tick_ms;
+  size_t http_threads;
+  int http_backlog;
+  size_t http_blocking_threads;
+  size_t http_workers;
+  int http_idle_timeout_ms;
+  size_t http_max_requests_per_connection;
+  std::string http_backend; ///< "epoll" or "io_uring"
+  int read_lease_ms;
+  size_t admission_max_in_flight; ///< 0 = no admission control
+  int admission_fail_fast_ms;
+  size_t raft_channels; ///< gRPC connections to the sidecar
+  size_t propose_batch_max; ///< 0 = no proposal batching
+  size_t propose_batch_max_bytes;
+  int propose_batch_delay_us;
+  size_t propose_batch_inflight;
+  std::string log_level; ///< "debug", "info", "warn" or "error"
+  size_t grpc_completion_queues;
+  size_t grpc_pollers_per_queue;
+  bool grpc_pin_pollers;
+  size_t grpc_max_message_mb;
+  size_t grpc_max_threads;     ///< 0 = gRPC's default
+  size_t grpc_memory_quota_mb; ///< 0 = unlimited
 
   /**
    * @brief Create config with default values.
@@ -24,44 +74,353 @@ struct Config {
     return Config{.db_file = "kv.db",
                   .grpc_port = "50051",
                   .sidecar_port = "50052",
-                  .http_port = 8080};
+                  .grpc_socket = "",
+                  .sidecar_socket = "",
+                  .apply_ring = "",
+                  .apply_ring_mb = 16,
+                  .http_port = 8080,
+                  .engine = "hash",
+                  .shard_count = 16,
+                  .wal_sync = "batch",
+                  .group_commit_max_batch = 128,
+                  .group_commit_max_delay_us = 0,
+                  .lazy_values = false,
+                  .lsm_memtable_mb = 4,
+                  .compression = "none",
+                  .compression_min_bytes = 1024,
+                  .compression_level = 3,
+                  .compression_dict = "",
+                  .expiry_tick_ms = 100,
+                  .http_threads = 0,
+                  .http_backlog = 1024,
+                  .http_blocking_threads = 32,
+                  .http_workers = 0,
+                  .http_idle_timeout_ms = 60000,
+                  .http_max_requests_per_connection = 1000,
+                  .http_backend = "epoll",
+                  .read_lease_ms = 500,
+                  .admission_max_in_flight = 256,
+                  .admission_fail_fast_ms = 1000,
+                  .raft_channels = 1,
+                  .propose_batch_max = 128,
+                  .propose_batch_max_bytes = 1024 * 1024,
+                  .propose_batch_delay_us = 0,
+                  .propose_batch_inflight = 4,
+                  .log_level = "info",
+                  .grpc_completion_queues = 1,
+                  .grpc_pollers_per_queue = 1,
+                  .grpc_pin_pollers = false,
+                  .grpc_max_message_mb = 64,
+                  .grpc_max_threads = 0,
+                  .grpc_memory_quota_mb = 0};
   }
 
   /**
    * @brief Parse configuration from command line arguments.
    *
+   * The first four arguments are positional
+   * (`<http_port> <grpc_port> <sidecar_port> <db_file>`); tunables are
+   * passed as `--name=value` flags anywhere on the command line.
+   *
    * @param argc Argument count from main
    * @param argv Argument values from main
    * @return Config Parsed configuration with CLI overrides
+   * @throws std::invalid_argument On an unknown or malformed flag
    */
   static Config from_args(int argc, char *argv[]) {
     Config cfg = defaults();
 
-    if (argc > 1)
-      cfg.http_port = std::stoi(argv[1]);
-    if (argc > 2)
-      cfg.grpc_port = argv[2];
-    if (argc > 3)
-      cfg.sidecar_port = argv[3];
-    if (argc > 4)
-      cfg.db_file = argv[4];
+    int position = 0;
+    for (int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+      if (arg.rfind("--", 0) == 0) {
+        cfg.apply_flag(arg.substr(2));
+        continue;
+      }
+
+      switch (++position) {
+      case 1:
+        cfg.http_port = std::stoi(arg);
+        break;
+      case 2:
+        cfg.grpc_port = arg;
+        break;
+      case 3:
+        cfg.sidecar_port = arg;
+        break;
+      case 4:
+        cfg.db_file = arg;
+        break;
+      default:
+        throw std::invalid_argument("Unexpected argument: " + arg);
+      }
+    }
 
     return cfg;
   }
 
   /**
-   * @brief Get the full gRPC server address.
+   * @brief Build storage persistence options from this config.
+   */
+  [[nodiscard]] PersistenceOptions persistence_options() const {
+    PersistenceOptions options;
+    options.sync_policy = parse_sync_policy(wal_sync);
+    options.group_commit_max_batch = group_commit_max_batch;
+    options.group_commit_max_delay =
+        std::chrono::microseconds(group_commit_max_delay_us);
+    options.lazy_values = lazy_values;
+    return options;
+  }
+
+  /**
+   * @brief Build value compression options from this config.
+   */
+  [[nodiscard]] CompressionOptions compression_options() const {
+    CompressionOptions options;
+    options.codec = parse_compression(compression);
+    options.min_bytes = compression_min_bytes;
+    options.level = compression_level;
+    options.dictionary_path = compression_dict;
+    return options;
+  }
+
+  /**
+   * @brief Build key expiry options from this config.
+   */
+  [[nodiscard]] ExpiryOptions expiry_options() const {
+    ExpiryOptions options;
+    options.tick = std::chrono::milliseconds(expiry_tick_ms);
+    return options;
+  }
+
+  /**
+   * @brief Build HTTP server options from this config.
+   */
+  [[nodiscard]] HttpServerOptions http_options() const {
+    HttpServerOptions options;
+    options.threads = http_threads;
+    options.backlog = http_backlog;
+    options.blocking_threads = http_blocking_threads;
+    options.workers = http_workers;
+    options.idle_timeout = std::chrono::milliseconds(http_idle_timeout_ms);
+    options.limits.max_requests = http_max_requests_per_connection;
+    options.backend = parse_http_backend(http_backend);
+    return options;
+  }
+
+  /**
+   * @brief Build proposal batching options from this config.
+   */
+  [[nodiscard]] BatchingOptions batching_options() const {
+    BatchingOptions options;
+    options.max_commands = propose_batch_max;
+    options.max_bytes = propose_batch_max_bytes;
+    options.max_delay = std::chrono::microseconds(propose_batch_delay_us);
+    options.max_in_flight = propose_batch_inflight;
+    return options;
+  }
+
+  /**
+   * @brief Build StateMachine gRPC server options from this config.
+   */
+  [[nodiscard]] GrpcServerOptions grpc_options() const {
+    GrpcServerOptions options;
+    options.completion_queues = grpc_completion_queues;
+    options.pollers_per_queue = grpc_pollers_per_queue;
+    options.pin_pollers = grpc_pin_pollers;
+    options.max_message_bytes =
+        static_cast<int>(grpc_max_message_mb * 1024 * 1024);
+    options.max_threads = grpc_max_threads;
+    options.memory_quota_bytes = grpc_memory_quota_mb * 1024 * 1024;
+    return options;
+  }
+
+  /**
+   * @brief Build shared-memory apply ring options from this config.
+   */
+  [[nodiscard]] ApplyRingOptions apply_ring_options() const {
+    ApplyRingOptions options;
+    options.request_bytes = apply_ring_mb * 1024 * 1024;
+    return options;
+  }
+
+  /**
+   * @brief Build proposal admission options from this config.
+   */
+  [[nodiscard]] AdmissionOptions admission_options() const {
+    AdmissionOptions options;
+    options.max_in_flight = admission_max_in_flight;
+    options.fail_fast = std::chrono::milliseconds(admission_fail_fast_ms);
+    return options;
+  }
+
+  /**
+   * @brief Get the full gRPC server address: the Unix socket given by
+   *        --grpc-socket, or else the TCP port.
    */
   [[nodiscard]] std::string grpc_address() const {
+    if (!grpc_socket.empty()) {
+      return "unix:" + grpc_socket;
+    }
     return "0.0.0.0:" + grpc_port;
   }
 
   /**
-   * @brief Get the sidecar channel address.
+   * @brief Get the sidecar channel address: the Unix socket given by
+   *        --sidecar-socket, or else the TCP port.
    */
   [[nodiscard]] std::string sidecar_address() const {
+    if (!sidecar_socket.empty()) {
+      return "unix:" + sidecar_socket;
+    }
     return "localhost:" + sidecar_port;
   }
+
+private:
+  /**
+   * @brief Apply one `name=value` flag (leading dashes already stripped).
+   */
+  void apply_flag(const std::string &flag) {
+    size_t eq_pos = flag.find('=');
+    if (eq_pos == std::string::npos) {
+      throw std::invalid_argument("Flag needs a value: --" + flag);
+    }
+    std::string name = flag.substr(0, eq_pos);
+    std::string value = flag.substr(eq_pos + 1);
+
+    if (name == "engine") {
+      engine = value;
+    } else if (name == "shards") {
+      shard_count = std::stoul(value);
+    } else if (name == "wal-sync") {
+      parse_sync_policy(value); // validate early
+      wal_sync = value;
+    } else if (name == "group-commit-max-batch") {
+      group_commit_max_batch = std::stoul(value);
+    } else if (name == "group-commit-max-delay-us") {
+      group_commit_max_delay_us = std::stoi(value);
+    } else if (name == "lazy-values") {
+      lazy_values = parse_bool(name, value);
+    } else if (name == "lsm-memtable-mb") {
+      lsm_memtable_mb = std::stoul(value);
+      if (lsm_memtable_mb == 0) {
+        throw std::invalid_argument("--lsm-memtable-mb must be positive");
+      }
+    } else if (name == "compression") {
+      parse_compression(value); // validate early
+      compression = value;
+    } else if (name == "compression-min-bytes") {
+      compression_min_bytes = std::stoul(value);
+    } else if (name == "compression-level") {
+      compression_level = std::stoi(value);
+    } else if (name == "compression-dict") {
+      compression_dict = value;
+    } else if (name == "http-threads") {
+      http_threads = std::stoul(value);
+    } else if (name == "http-backlog") {
+      http_backlog = std::stoi(value);
+    } else if (name == "http-blocking-threads") {
+      http_blocking_threads = std::stoul(value);
+    } else if (name == "http-workers") {
+      http_workers = std::stoul(value);
+    } else if (name == "http-idle-timeout-ms") {
+      http_idle_timeout_ms = std::stoi(value);
+      if (http_idle_timeout_ms <= 0) {
+        throw std::invalid_argument("--http-idle-timeout-ms must be positive");
+      }
+    } else if (name == "http-max-requests-per-connection") {
+      http_max_requests_per_connection = std::stoul(value);
+    } else if (name == "http-backend") {
+      parse_http_backend(value); // validate early
+      http_backend = value;
+    } else if (name == "read-lease-ms") {
+      read_lease_ms = std::stoi(value);
+      if (read_lease_ms < 0) {
+        throw std::invalid_argument("--read-lease-ms must not be negative");
+      }
+    } else if (name == "admission-max-inflight") {
+      admission_max_in_flight = std::stoul(value);
+    } else if (name == "admission-fail-fast-ms") {
+      admission_fail_fast_ms = std::stoi(value);
+      if (admission_fail_fast_ms < 0) {
+        throw std::invalid_argument(
+            "--admission-fail-fast-ms must not be negative");
+      }
+    } else if (name == "raft-channels") {
+      raft_channels = std::stoul(value);
+      if (raft_channels == 0) {
+        throw std::invalid_argument("--raft-channels must be positive");
+      }
+    } else if (name == "propose-batch-max") {
+      propose_batch_max = std::stoul(value);
+    } else if (name == "propose-batch-max-bytes") {
+      propose_batch_max_bytes = std::stoul(value);
+    } else if (name == "propose-batch-delay-us") {
+      propose_batch_delay_us = std::stoi(value);
+      if (propose_batch_delay_us < 0) {
+        throw std::invalid_argument(
+            "--propose-batch-delay-us must not be negative");
+      }
+    } else if (name == "propose-batch-inflight") {
+      propose_batch_inflight = std::stoul(value);
+      if (propose_batch_inflight == 0) {
+        throw std::invalid_argument(
+            "--propose-batch-inflight must be positive");
+      }
+    } else if (name == "log-level") {
+      parse_log_level(value); // validate early
+      log_level = value;
+    } else if (name == "grpc-cqs") {
+      grpc_completion_queues = std::stoul(value);
+      if (grpc_completion_queues == 0) {
+        throw std::invalid_argument("--grpc-cqs must be positive");
+      }
+    } else if (name == "grpc-pollers-per-cq") {
+      grpc_pollers_per_queue = std::stoul(value);
+      if (grpc_pollers_per_queue == 0) {
+        throw std::invalid_argument("--grpc-pollers-per-cq must be positive");
+      }
+    } else if (name == "grpc-pin-pollers") {
+      grpc_pin_pollers = parse_bool(name, value);
+    } else if (name == "grpc-max-message-mb") {
+      grpc_max_message_mb = std::stoul(value);
+      if (grpc_max_message_mb == 0 || grpc_max_message_mb > 2047) {
+        throw std::invalid_argument(
+            "--grpc-max-message-mb must be between 1 and 2047");
+      }
+    } else if (name == "grpc-max-threads") {
+      grpc_max_threads = std::stoul(value);
+    } else if (name == "grpc-memory-quota-mb") {
+      grpc_memory_quota_mb = std::stoul(value);
+    } else if (name == "grpc-socket") {
+      grpc_socket = value;
+    } else if (name == "sidecar-socket") {
+      sidecar_socket = value;
+    } else if (name == "apply-ring") {
+      apply_ring = value;
+    } else if (name == "apply-ring-mb") {
+      apply_ring_mb = std::stoul(value);
+      if (apply_ring_mb == 0 || apply_ring_mb > 1024) {
+        throw std::invalid_argument(
+            "--apply-ring-mb must be between 1 and 1024");
+      }
+    } else if (name == "expiry-tick-ms") {
+      expiry_tick_ms = std::stoi(value);
+      if (expiry_tick_ms <= 0) {
+        throw std::invalid_argument("--expiry-tick-ms must be positive");
+      }
+    } else {
+      throw std::invalid_argument("Unknown flag: --" + name);
+    }
+  }
+
+  static bool parse_bool(const std::string &name, const std::string &value) {
+    if (value == "true" || value == "1")
+      return true;
+    if (value == "false" || value == "0")
+      return false;
+    throw std::invalid_argument("Flag --" + name + " expects true or false");
+  }
 };
 
 } // namespace kvdb
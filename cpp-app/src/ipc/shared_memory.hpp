@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace kvdb {
+
+/**
+ * @brief A file mapped shared into memory, for another process on the
+ *        same host to map too (normally under /dev/shm, so it is never
+ *        written back to disk).
+ *
+ * The creator owns the file: it is created zero-filled, replacing any
+ * file left at the path by an earlier run, and removed again by the
+ * destructor. A process still mapping the replaced file keeps the old
+ * one until it unmaps it.
+ */
+class SharedMemoryFile {
+public:
+  /**
+   * @brief Create the file and map it.
+   * @param path Where to create it
+   * @param bytes Its size
+   * @throws std::runtime_error If it cannot be created or mapped
+   */
+  SharedMemoryFile(std::string path, size_t bytes)
+      : path_(std::move(path)), size_(bytes) {
+    ::unlink(path_.c_str());
+    const int fd =
+        ::open(path_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) {
+      throw error("Cannot create");
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+      const std::runtime_error failed = error("Cannot size");
+      ::close(fd);
+      ::unlink(path_.c_str());
+      throw failed;
+    }
+    void *data =
+        ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      const std::runtime_error failed = error("Cannot map");
+      ::unlink(path_.c_str());
+      throw failed;
+    }
+    data_ = static_cast<char *>(data);
+  }
+
+  ~SharedMemoryFile() {
+    ::munmap(data_, size_);
+    ::unlink(path_.c_str());
+  }
+
+  // Non-copyable
+  SharedMemoryFile(const SharedMemoryFile &) = delete;
+  SharedMemoryFile &operator=(const SharedMemoryFile &) = delete;
+
+  [[nodiscard]] char *data() const { return data_; }
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] const std::string &path() const { return path_; }
+
+private:
+  std::string path_;
+  size_t size_;
+  char *data_ = nullptr;
+
+  std::runtime_error error(const char *what) const {
+    return std::runtime_error(std::string(what) + " " + path_ + ": " +
+                              std::strerror(errno));
+  }
+};
+
+} // namespace kvdb
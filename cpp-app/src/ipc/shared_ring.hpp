@@ -0,0 +1,262 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace kvdb {
+
+/**
+ * @brief Control block of a SharedRing, in the shared memory with its
+ *        data. The producer writes `head`, the consumer `tail`; each on
+ *        its own cache line.
+ *
+ * The layout is shared with the Go sidecar (internal/shmring): fields
+ * are at fixed offsets, in native byte order.
+ */
+struct SharedRingControl {
+  alignas(64) std::atomic<uint64_t> head; ///< Bytes ever published
+  alignas(64) std::atomic<uint64_t> tail; ///< Bytes ever released
+  /// Bumped by every publish; the futex a waiting consumer sleeps on.
+  alignas(64) std::atomic<uint32_t> signal;
+  std::atomic<uint32_t> waiters; ///< Consumers asleep, or about to be
+  alignas(64) uint64_t capacity; ///< Data bytes (a multiple of 8)
+  uint64_t data_offset;          ///< Of the data, from the control block
+};
+
+static_assert(sizeof(SharedRingControl) == 256);
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+              "SharedRing needs lock-free atomics in shared memory");
+
+/**
+ * @brief Single-producer single-consumer ring of variable-size records
+ *        in memory shared between two processes.
+ *
+ * A record is a {u32 length, u32 kind} header and `length` payload
+ * bytes, padded to 8. Records are contiguous: one that does not fit
+ * before the end of the ring is preceded by a wrap record (kind 0)
+ * filling the rest, and starts over at offset 0. So a payload can be
+ * read and written in place, and the largest is half the ring
+ * (max_payload()), which always fits once the ring is empty.
+ *
+ * head and tail count bytes and never wrap. The producer fills a
+ * record in place (try_reserve()) and publishes it by advancing head;
+ * the consumer reads it in place (peek()) and frees it by advancing
+ * tail (release()). A consumer with nothing to read polls for up to
+ * 50 us (given more than one core), then sleeps on a futex in `signal`
+ * (which works across processes), which the producer wakes only while
+ * `waiters` says someone sleeps: publishing costs no system call while
+ * the consumer keeps up.
+ *
+ * Either side's process can be on either end; each process holds its
+ * own SharedRing over the same control block. Not thread-safe beyond
+ * one producer and one consumer.
+ */
+class SharedRing {
+public:
+  struct Record {
+    uint32_t kind;
+    std::string_view payload; ///< In the ring, until release()
+  };
+
+  static constexpr uint32_t kWrap = 0;
+  static constexpr size_t kHeaderBytes = 8;
+
+  /**
+   * @brief Initialize a control block in zeroed shared memory, for a
+   *        ring whose data follows it at `data_offset`.
+   * @throws std::invalid_argument If the capacity is not a positive
+   *         multiple of 8
+   */
+  static SharedRingControl &create(void *at, uint64_t capacity,
+                                   uint64_t data_offset) {
+    if (capacity == 0 || capacity % 8 != 0) {
+      throw std::invalid_argument("Ring capacity must be a multiple of 8");
+    }
+    auto *control = new (at) SharedRingControl{};
+    control->capacity = capacity;
+    control->data_offset = data_offset;
+    return *control;
+  }
+
+  explicit SharedRing(SharedRingControl &control)
+      : control_(control), capacity_(control.capacity),
+        data_(reinterpret_cast<char *>(&control) + control.data_offset) {}
+
+  /// Largest payload a record can carry.
+  [[nodiscard]] size_t max_payload() const {
+    return capacity_ / 2 - kHeaderBytes;
+  }
+
+  // --- Producer ---
+
+  /**
+   * @brief Room for the payload of the next record, or nullptr if the
+   *        ring has none until the consumer releases more.
+   *
+   * Nothing is visible to the consumer before publish(); reserving
+   * again replaces the reservation.
+   *
+   * @throws std::invalid_argument If `bytes` exceeds max_payload()
+   */
+  char *try_reserve(uint32_t kind, size_t bytes) {
+    if (bytes > max_payload()) {
+      throw std::invalid_argument("Record too large for the ring");
+    }
+    const uint64_t size = record_size(bytes);
+    const uint64_t head = control_.head.load(std::memory_order_relaxed);
+    const uint64_t tail = control_.tail.load(std::memory_order_acquire);
+    const uint64_t offset = head % capacity_;
+    const uint64_t skip = offset + size > capacity_ ? capacity_ - offset : 0;
+    if (head + skip + size - tail > capacity_)
+      return nullptr;
+    if (skip > 0) {
+      write_header(offset, 0, kWrap);
+    }
+    const uint64_t start = (head + skip) % capacity_;
+    write_header(start, static_cast<uint32_t>(bytes), kind);
+    reserved_ = head + skip + size;
+    return data_ + start + kHeaderBytes;
+  }
+
+  /**
+   * @brief Make the reserved record visible, waking the consumer if it
+   *        sleeps.
+   */
+  void publish() {
+    control_.head.store(reserved_, std::memory_order_seq_cst);
+    control_.signal.fetch_add(1, std::memory_order_seq_cst);
+    if (control_.waiters.load(std::memory_order_seq_cst) != 0) {
+      wake();
+    }
+  }
+
+  // --- Consumer ---
+
+  /**
+   * @brief The next record, if one is published; wrap records are
+   *        skipped.
+   * @throws std::runtime_error If the ring holds something that is not
+   *         a record (a misbehaving producer)
+   */
+  std::optional<Record> peek() {
+    uint64_t tail = control_.tail.load(std::memory_order_relaxed);
+    const uint64_t head = control_.head.load(std::memory_order_acquire);
+    if (head - tail > capacity_ || (head - tail) % 8 != 0) {
+      throw std::runtime_error("Corrupt ring positions");
+    }
+    while (tail != head) {
+      const uint64_t offset = tail % capacity_;
+      uint32_t length;
+      uint32_t kind;
+      std::memcpy(&length, data_ + offset, sizeof(length));
+      std::memcpy(&kind, data_ + offset + 4, sizeof(kind));
+      if (kind == kWrap) {
+        tail += capacity_ - offset;
+        control_.tail.store(tail, std::memory_order_release);
+        continue;
+      }
+      const uint64_t size = record_size(length);
+      if (size > capacity_ - offset || size > head - tail) {
+        throw std::runtime_error("Corrupt ring record");
+      }
+      next_ = tail + size;
+      return Record{kind,
+                    std::string_view(data_ + offset + kHeaderBytes, length)};
+    }
+    return std::nullopt;
+  }
+
+  /// Free the record last returned by peek().
+  void release() { control_.tail.store(next_, std::memory_order_release); }
+
+  /**
+   * @brief Wait up to `timeout` for a record to be published.
+   * @return Whether one is there to peek()
+   */
+  bool wait(std::chrono::milliseconds timeout) {
+    if (readable())
+      return true;
+    if (spins()) {
+      const auto spin_until = std::chrono::steady_clock::now() + kSpin;
+      do {
+        if (readable())
+          return true;
+        std::this_thread::yield();
+      } while (std::chrono::steady_clock::now() < spin_until);
+    }
+    const uint32_t seen = control_.signal.load(std::memory_order_seq_cst);
+    control_.waiters.fetch_add(1, std::memory_order_seq_cst);
+    bool ready = readable();
+    if (!ready) {
+      timespec relative{};
+      relative.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+      relative.tv_nsec = static_cast<long>(timeout.count() % 1000) * 1000000;
+      // Returns at once if a publish has bumped the signal since `seen`
+      ::syscall(SYS_futex, futex_word(), FUTEX_WAIT, seen, &relative,
+                nullptr, 0);
+      ready = readable();
+    }
+    control_.waiters.fetch_sub(1, std::memory_order_seq_cst);
+    return ready;
+  }
+
+  /// Wake every consumer asleep in wait() (e.g. to shut down).
+  void wake() {
+    ::syscall(SYS_futex, futex_word(), FUTEX_WAKE, INT_MAX, nullptr,
+              nullptr, 0);
+  }
+
+private:
+  /// How long wait() polls before sleeping on the futex: waking a
+  /// sleeper costs both sides a system call and tens of microseconds,
+  /// more than most batches take to apply.
+  static constexpr std::chrono::microseconds kSpin{50};
+
+  /// Polling only pays with a core for each side; on a single one it
+  /// keeps the other side from running.
+  static bool spins() {
+    static const bool multicore = std::thread::hardware_concurrency() > 1;
+    return multicore;
+  }
+
+  SharedRingControl &control_;
+  uint64_t capacity_;
+  char *data_;
+  uint64_t reserved_ = 0; ///< Producer: head once the record is published
+  uint64_t next_ = 0;     ///< Consumer: tail once the record is released
+
+  static uint64_t record_size(size_t payload) {
+    return (kHeaderBytes + payload + 7) & ~uint64_t{7};
+  }
+
+  void write_header(uint64_t offset, uint32_t length, uint32_t kind) {
+    std::memcpy(data_ + offset, &length, sizeof(length));
+    std::memcpy(data_ + offset + 4, &kind, sizeof(kind));
+  }
+
+  [[nodiscard]] bool readable() const {
+    return control_.tail.load(std::memory_order_relaxed) !=
+           control_.head.load(std::memory_order_seq_cst);
+  }
+
+  uint32_t *futex_word() {
+    return reinterpret_cast<uint32_t *>(&control_.signal);
+  }
+};
+
+} // namespace kvdb
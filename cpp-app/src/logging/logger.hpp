@@ -0,0 +1,334 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Numeric log levels, for KVDB_MIN_LOG_LEVEL
+#define KVDB_LOG_LEVEL_DEBUG 0
+#define KVDB_LOG_LEVEL_INFO 1
+#define KVDB_LOG_LEVEL_WARN 2
+#define KVDB_LOG_LEVEL_ERROR 3
+
+/// Statements below this level are compiled out (see KVDB_LOG).
+#ifndef KVDB_MIN_LOG_LEVEL
+#define KVDB_MIN_LOG_LEVEL KVDB_LOG_LEVEL_INFO
+#endif
+
+namespace kvdb {
+
+/**
+ * @brief Severity of a log record.
+ */
+enum class LogLevel {
+  DEBUG = KVDB_LOG_LEVEL_DEBUG, ///< Per-entry tracing
+  INFO = KVDB_LOG_LEVEL_INFO,   ///< Lifecycle events
+  WARN = KVDB_LOG_LEVEL_WARN,   ///< Recoverable failures
+  ERROR = KVDB_LOG_LEVEL_ERROR  ///< Failed requests and background work
+};
+
+/**
+ * @brief Whether statements at this level are compiled in.
+ */
+constexpr bool log_level_compiled(LogLevel level) {
+  return static_cast<int>(level) >= KVDB_MIN_LOG_LEVEL;
+}
+
+/**
+ * @brief Parse a log level name ("debug", "info", "warn", "error").
+ * @throws std::invalid_argument On an unknown name
+ */
+inline LogLevel parse_log_level(const std::string &name) {
+  if (name == "debug")
+    return LogLevel::DEBUG;
+  if (name == "info")
+    return LogLevel::INFO;
+  if (name == "warn")
+    return LogLevel::WARN;
+  if (name == "error")
+    return LogLevel::ERROR;
+  throw std::invalid_argument("Unknown log level: " + name);
+}
+
+/**
+ * @brief Process-wide asynchronous logger.
+ *
+ * write() never blocks on I/O or on other logging threads: each thread
+ * appends to its own single-producer ring of kRingCapacity records,
+ * and a background thread drains every ring each kDrainInterval (or as
+ * soon as a WARN or ERROR arrives), writing the records in time order
+ * with one fwrite and one flush per round. INFO and DEBUG records go to
+ * stdout, WARN and ERROR to stderr, as "[Component] message".
+ *
+ * A thread whose ring is full drops INFO and DEBUG records rather than
+ * wait (the number dropped is reported in the output), and writes WARN
+ * and ERROR records out itself. Use it through KVDB_LOG and
+ * KVDB_LOG_EVERY_N.
+ *
+ * Thread-safe.
+ */
+class Logger {
+public:
+  static constexpr size_t kRingCapacity = 1024;
+  static constexpr std::chrono::milliseconds kDrainInterval{50};
+
+  static Logger &instance() {
+    static Logger logger;
+    return logger;
+  }
+
+  /// Writes out what is still buffered.
+  ~Logger() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    drainer_.join();
+  }
+
+  // Non-copyable
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
+  /// Whether a compiled-in statement at this level is logged.
+  [[nodiscard]] bool enabled(LogLevel level) const {
+    return static_cast<int>(level) >=
+           min_level_.load(std::memory_order_relaxed);
+  }
+
+  void set_level(LogLevel level) {
+    min_level_.store(static_cast<int>(level), std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Queue one record for the background thread.
+   * @param component Tag printed in brackets; must outlive the logger
+   *                  (a string literal)
+   */
+  void write(LogLevel level, const char *component, std::string message) {
+    Record record{Clock::now(), level, component, std::move(message)};
+    if (!local_ring().push(std::move(record))) {
+      if (level >= LogLevel::WARN) {
+        // Rare enough to write out directly rather than lose
+        const std::string line = format(record);
+        std::fwrite(line.data(), 1, line.size(), stderr);
+      } else {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+      }
+      return;
+    }
+    if (level >= LogLevel::WARN) {
+      urgent_.store(true, std::memory_order_relaxed);
+      wake_.notify_one();
+    }
+  }
+
+  /**
+   * @brief Wait until every record queued so far has been written.
+   */
+  void flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const uint64_t request = ++flush_requests_;
+    wake_.notify_one();
+    flushed_cv_.wait(
+        lock, [this, request] { return flushed_ >= request || stopping_; });
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Record {
+    Clock::time_point at;
+    LogLevel level = LogLevel::INFO;
+    const char *component = "";
+    std::string message;
+  };
+
+  /// Single-producer, single-consumer ring owned by one logging thread.
+  struct Ring {
+    std::array<Record, kRingCapacity> slots;
+    alignas(64) std::atomic<size_t> head{0}; ///< Next slot written
+    alignas(64) std::atomic<size_t> tail{0}; ///< Next slot read
+    /// Set once the owning thread has exited.
+    std::atomic<bool> detached{false};
+
+    bool push(Record &&record) {
+      const size_t h = head.load(std::memory_order_relaxed);
+      if (h - tail.load(std::memory_order_acquire) == kRingCapacity)
+        return false;
+      slots[h % kRingCapacity] = std::move(record);
+      head.store(h + 1, std::memory_order_release);
+      return true;
+    }
+
+    void pop_all(std::vector<Record> &out) {
+      size_t t = tail.load(std::memory_order_relaxed);
+      const size_t h = head.load(std::memory_order_acquire);
+      for (; t != h; ++t) {
+        out.push_back(std::move(slots[t % kRingCapacity]));
+      }
+      tail.store(t, std::memory_order_release);
+    }
+  };
+
+  /// A thread's handle on its ring; detaches the ring when it exits.
+  struct LocalRing {
+    std::shared_ptr<Ring> ring;
+    ~LocalRing() {
+      if (ring) {
+        ring->detached.store(true, std::memory_order_release);
+      }
+    }
+  };
+
+  std::atomic<int> min_level_{KVDB_LOG_LEVEL_INFO};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<bool> urgent_{false};
+
+  std::mutex mutex_;
+  std::condition_variable wake_;       ///< Wakes the drainer
+  std::condition_variable flushed_cv_; ///< Wakes flush() callers
+  std::vector<std::shared_ptr<Ring>> rings_;
+  uint64_t flush_requests_ = 0;
+  uint64_t flushed_ = 0;
+  bool stopping_ = false;
+  std::thread drainer_;
+
+  Logger() : drainer_([this] { drain_loop(); }) {}
+
+  /// The calling thread's ring, registered on first use.
+  Ring &local_ring() {
+    thread_local LocalRing local;
+    if (!local.ring) {
+      local.ring = std::make_shared<Ring>();
+      std::lock_guard<std::mutex> lock(mutex_);
+      rings_.push_back(local.ring);
+    }
+    return *local.ring;
+  }
+
+  /// Body of drainer_: write out the rings until stopped.
+  void drain_loop() {
+    std::vector<Record> records;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      wake_.wait_for(lock, kDrainInterval, [this] {
+        return stopping_ || flush_requests_ > flushed_ ||
+               urgent_.load(std::memory_order_relaxed);
+      });
+      urgent_.store(false, std::memory_order_relaxed);
+      const bool stopping = stopping_;
+      const uint64_t requests = flush_requests_;
+      collect(records);
+      lock.unlock();
+      emit(records);
+      records.clear();
+      lock.lock();
+      flushed_ = requests;
+      flushed_cv_.notify_all();
+      if (stopping)
+        return;
+    }
+  }
+
+  /// Pop every ring (mutex_ held), forgetting those of exited threads.
+  void collect(std::vector<Record> &records) {
+    for (auto it = rings_.begin(); it != rings_.end();) {
+      // Read before popping: a detached ring gets no more records
+      const bool detached = (*it)->detached.load(std::memory_order_acquire);
+      (*it)->pop_all(records);
+      it = detached ? rings_.erase(it) : it + 1;
+    }
+  }
+
+  /// "[Component] message\n"
+  static std::string format(const Record &record) {
+    std::string line;
+    line.reserve(record.message.size() + 32);
+    line += '[';
+    line += record.component;
+    line += "] ";
+    line += record.message;
+    line += '\n';
+    return line;
+  }
+
+  void emit(std::vector<Record> &records) {
+    const uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+    if (records.empty() && dropped == 0)
+      return;
+    // Rings are each in order; merge them by time
+    std::stable_sort(
+        records.begin(), records.end(),
+        [](const Record &a, const Record &b) { return a.at < b.at; });
+    std::string out;
+    std::string err;
+    for (const auto &record : records) {
+      (record.level >= LogLevel::WARN ? err : out) += format(record);
+    }
+    if (dropped != 0) {
+      err += "[Log] Dropped " + std::to_string(dropped) +
+             " records (logging faster than they are written)\n";
+    }
+    if (!out.empty()) {
+      std::fwrite(out.data(), 1, out.size(), stdout);
+      std::fflush(stdout);
+    }
+    if (!err.empty()) {
+      std::fwrite(err.data(), 1, err.size(), stderr);
+      std::fflush(stderr);
+    }
+  }
+};
+
+} // namespace kvdb
+
+/**
+ * @brief Log `message`, a `<<` chain such as `"Applied: " << key`.
+ *
+ * Below KVDB_MIN_LOG_LEVEL the statement compiles to nothing; below the
+ * runtime level (Logger::set_level) it costs one relaxed load, and the
+ * message is not formatted.
+ */
+#define KVDB_LOG(level, component, message)                                   \
+  do {                                                                        \
+    if constexpr (::kvdb::log_level_compiled(level)) {                        \
+      if (::kvdb::Logger::instance().enabled(level)) {                        \
+        std::ostringstream kvdb_log_stream;                                   \
+        kvdb_log_stream << message;                                           \
+        ::kvdb::Logger::instance().write(level, component,                    \
+                                         kvdb_log_stream.str());              \
+      }                                                                       \
+    }                                                                         \
+  } while (0)
+
+/**
+ * @brief Like KVDB_LOG, but logs only the 1st, (n+1)th, (2n+1)th, ...
+ *        time this statement runs, for per-entry messages.
+ */
+#define KVDB_LOG_EVERY_N(level, n, component, message)                        \
+  do {                                                                        \
+    if constexpr (::kvdb::log_level_compiled(level)) {                        \
+      static std::atomic<uint64_t> kvdb_log_occurrences{0};                   \
+      if (::kvdb::Logger::instance().enabled(level) &&                        \
+          kvdb_log_occurrences.fetch_add(1, std::memory_order_relaxed) %      \
+                  (n) ==                                                      \
+              0) {                                                            \
+        KVDB_LOG(level, component, message);                                  \
+      }                                                                       \
+    }                                                                         \
+  } while (0)
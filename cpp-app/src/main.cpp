@@ -9,49 +9,155 @@
  * - raft/       : Raft consensus client and state machine
  * - network/    : HTTP server and request handling
  * - commands/   : Command structures for operations
+ * - logging/    : Asynchronous logging
+ * - metrics/    : Latency histograms and counters (GET /metrics)
+ * - ipc/        : Shared-memory rings (the apply ring to the sidecar)
  */
 
 #include <iostream>
 #include <memory>
-#include <thread>
 
 #include "config/config.hpp"
+#include "logging/logger.hpp"
 #include "network/http_server.hpp"
+#include "raft/admission_controller.hpp"
+#include "raft/apply_ring.hpp"
+#include "raft/key_expirer.hpp"
+#include "raft/proposal_batcher.hpp"
 #include "raft/raft_client.hpp"
-#include "raft/state_machine.hpp"
+#include "raft/read_barrier.hpp"
+#include "raft/state_machine_server.hpp"
+#include "storage/applied_index_kv_store.hpp"
+#include "storage/arena_kv_store.hpp"
+#include "storage/compressed_kv_store.hpp"
+#include "storage/expiring_kv_store.hpp"
 #include "storage/kv_store.hpp"
+#include "storage/lsm_kv_store.hpp"
+#include "storage/sharded_kv_store.hpp"
 
 using namespace kvdb;
 
+/**
+ * @brief Instantiate the storage engine selected by --engine.
+ */
+static std::unique_ptr<IKVStore> create_engine(const Config &config) {
+  if (config.engine == "hash") {
+    return std::make_unique<PersistentKVStore>(config.db_file,
+                                               config.persistence_options());
+  }
+  if (config.engine == "sharded") {
+    return std::make_unique<ShardedKVStore>(
+        config.db_file, config.shard_count, config.persistence_options());
+  }
+  if (config.engine == "arena") {
+    return std::make_unique<ArenaKVStore>(config.db_file,
+                                          config.persistence_options());
+  }
+  if (config.engine == "lsm") {
+    LsmOptions options;
+    options.memtable_bytes = config.lsm_memtable_mb * 1024 * 1024;
+    return std::make_unique<LsmKVStore>(config.db_file,
+                                        config.persistence_options(), options);
+  }
+  throw std::invalid_argument("Unknown storage engine: " + config.engine);
+}
+
+/**
+ * @brief Wrap the engine in the key expiry, value compression and
+ *        applied index layers.
+ *
+ * Compression is applied even with --compression=none, so values
+ * compressed by a peer (and received in a Raft snapshot) still read
+ * back correctly. It sits above expiry, so deadlines are stored
+ * uncompressed in front of the (compressed) value. The applied index
+ * goes on top, so every write reaches the engine with the position it
+ * is recorded with.
+ *
+ * @param expiry Receives the expiry layer, for the KeyExpirer
+ * @param compression Receives the compression layer, for its stats
+ */
+static std::unique_ptr<AppliedIndexKVStore>
+create_store(const Config &config, ExpiringKVStore **expiry,
+             CompressedKVStore **compression) {
+  auto expiring = std::make_unique<ExpiringKVStore>(create_engine(config),
+                                                    config.expiry_options());
+  *expiry = expiring.get();
+  auto compressed = std::make_unique<CompressedKVStore>(
+      std::move(expiring), config.compression_options());
+  *compression = compressed.get();
+  return std::make_unique<AppliedIndexKVStore>(std::move(compressed));
+}
+
 int main(int argc, char *argv[]) {
   try {
     // 1. Parse configuration
     Config config = Config::from_args(argc, argv);
+    Logger::instance().set_level(parse_log_level(config.log_level));
 
     std::cout << "=== KVDB Raft Node ===" << std::endl;
     std::cout << "HTTP Port:    " << config.http_port << std::endl;
-    std::cout << "gRPC Port:    " << config.grpc_port << std::endl;
-    std::cout << "Sidecar Port: " << config.sidecar_port << std::endl;
+    std::cout << "gRPC Address: " << config.grpc_address() << std::endl;
+    std::cout << "Sidecar:      " << config.sidecar_address() << std::endl;
     std::cout << "DB File:      " << config.db_file << std::endl;
+    std::cout << "Engine:       " << config.engine << std::endl;
+    std::cout << "WAL Sync:     " << config.wal_sync << std::endl;
+    std::cout << "Compression:  " << config.compression << std::endl;
     std::cout << "======================" << std::endl;
 
     // 2. Initialize the persistent key-value store
-    PersistentKVStore store(config.db_file);
+    ExpiringKVStore *expiry = nullptr;
+    CompressedKVStore *compression = nullptr;
+    std::unique_ptr<AppliedIndexKVStore> store =
+        create_store(config, &expiry, &compression);
+    const LogPosition applied = store->applied();
+    std::cout << "Applied up to: " << applied.index << " (term "
+              << applied.term << ")" << std::endl;
 
-    // 3. Start the gRPC StateMachine server in a background thread
-    StateMachineServer grpc_server(config.grpc_address(), store);
-    std::thread grpc_thread([&grpc_server]() {
-      grpc_server.start();
-      grpc_server.wait();
-    });
-    grpc_thread.detach();
+    // 3. Start the gRPC StateMachine server (on its own poller threads)
+    StateMachineServer grpc_server(config.grpc_address(), *store,
+                                   config.db_file + ".restore",
+                                   config.grpc_options());
+    // Batches of entries may come over shared memory instead
+    std::unique_ptr<ApplyRingServer> apply_ring;
+    if (!config.apply_ring.empty()) {
+      apply_ring = std::make_unique<ApplyRingServer>(
+          config.apply_ring, grpc_server.state_machine(),
+          config.apply_ring_options());
+      apply_ring->start();
+    }
+    grpc_server.start();
 
     // 4. Create the Raft client for proposing commands
-    auto raft_client = GrpcRaftClient::connect(config.sidecar_address());
+    auto raft_client =
+        GrpcRaftClient::connect(config.sidecar_address(), config.raft_channels);
+
+    // 5. Delete expired keys through Raft (effective on the leader)
+    KeyExpirer expirer(*expiry, *raft_client, config.expiry_options());
 
-    // 5. Create and run the HTTP server
-    KVHttpHandler handler(*raft_client, store);
-    HttpServer http_server(config.http_port, std::move(handler));
+    // 6. Create and run the HTTP server; strong reads share ReadIndex
+    //    round trips through the barrier
+    ReadBarrier read_barrier(*raft_client,
+                             std::chrono::milliseconds(config.read_lease_ms));
+    KVHttpHandler handler(*raft_client, *store, compression);
+    handler.set_read_barrier(&read_barrier);
+    // Coalesce concurrent writes into shared Raft entries
+    std::unique_ptr<ProposalBatcher> batcher;
+    if (config.propose_batch_max > 1) {
+      batcher = std::make_unique<ProposalBatcher>(*raft_client,
+                                                  config.batching_options());
+      handler.set_batcher(batcher.get());
+    }
+    handler.set_export_store(store.get());
+    // Refuse proposals early instead of letting them pile up behind a
+    // slow or leaderless sidecar
+    std::unique_ptr<AdmissionController> admission;
+    if (config.admission_max_in_flight > 0) {
+      admission =
+          std::make_unique<AdmissionController>(config.admission_options());
+      handler.set_admission(admission.get());
+    }
+    HttpServer http_server(config.http_port, std::move(handler),
+                           config.http_options());
     http_server.run();
 
     return 0;
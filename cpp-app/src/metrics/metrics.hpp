@@ -0,0 +1,426 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace kvdb {
+
+/// Clock of every latency sample.
+using MetricsClock = std::chrono::steady_clock;
+
+namespace detail {
+
+/// Shards per metric (see metric_shard()).
+inline constexpr size_t kMetricShards = 32;
+
+/**
+ * @brief The calling thread's shard, assigned on its first sample.
+ *
+ * The first kMetricShards - 1 threads to record anything each own a
+ * shard of every metric; later ones share the last.
+ */
+inline size_t metric_shard() {
+  static std::atomic<size_t> next{0};
+  thread_local const size_t shard = std::min(
+      next.fetch_add(1, std::memory_order_relaxed), kMetricShards - 1);
+  return shard;
+}
+
+/**
+ * @brief Add `n` to a cell of shard `shard`.
+ *
+ * An owned shard has a single writer, so a plain load and store do
+ * (readers still see whole values); the shared one needs an atomic add.
+ */
+inline void metric_add(std::atomic<uint64_t> &cell, uint64_t n, size_t shard) {
+  if (shard < kMetricShards - 1) {
+    cell.store(cell.load(std::memory_order_relaxed) + n,
+               std::memory_order_relaxed);
+  } else {
+    cell.fetch_add(n, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief The shards of one metric, each allocated by its owner's first
+ *        sample (the shared one up front), so idle threads cost nothing.
+ */
+template <typename Shard> class ShardSet {
+public:
+  ShardSet() {
+    for (auto &shard : shards_) {
+      shard.store(nullptr, std::memory_order_relaxed);
+    }
+    shards_.back().store(new Shard(), std::memory_order_relaxed);
+  }
+
+  ~ShardSet() {
+    for (auto &shard : shards_) {
+      delete shard.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Non-copyable
+  ShardSet(const ShardSet &) = delete;
+  ShardSet &operator=(const ShardSet &) = delete;
+
+  /// Shard `shard`; only its owning thread may call this.
+  Shard &local(size_t shard) {
+    Shard *local = shards_[shard].load(std::memory_order_relaxed);
+    if (local == nullptr) {
+      local = new Shard();
+      shards_[shard].store(local, std::memory_order_release);
+    }
+    return *local;
+  }
+
+  template <typename Visitor> void for_each(Visitor &&visit) const {
+    for (const auto &shard : shards_) {
+      if (const Shard *s = shard.load(std::memory_order_acquire)) {
+        visit(*s);
+      }
+    }
+  }
+
+private:
+  std::array<std::atomic<Shard *>, kMetricShards> shards_;
+};
+
+} // namespace detail
+
+/**
+ * @brief A monotonically increasing count, summed over per-thread
+ *        shards when read.
+ *
+ * Thread-safe.
+ */
+class Counter {
+public:
+  Counter() = default;
+
+  // Non-copyable
+  Counter(const Counter &) = delete;
+  Counter &operator=(const Counter &) = delete;
+
+  void add(uint64_t n = 1) {
+    const size_t shard = detail::metric_shard();
+    detail::metric_add(shards_.local(shard).value, n, shard);
+  }
+
+  [[nodiscard]] uint64_t value() const {
+    uint64_t total = 0;
+    shards_.for_each([&total](const Shard &shard) {
+      total += shard.value.load(std::memory_order_relaxed);
+    });
+    return total;
+  }
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> value{0};
+  };
+
+  detail::ShardSet<Shard> shards_;
+};
+
+/**
+ * @brief HDR-style histogram of latencies in nanoseconds.
+ *
+ * Each power of two is split into kSubBuckets linear buckets, so a
+ * sample is placed within 12.5% of its value from 8 ns up to 2^37 ns
+ * (~137 s; longer ones fall in the last bucket). Recording is a bucket
+ * computation and two adds to the calling thread's shard, with no
+ * locks or shared cache lines.
+ *
+ * Thread-safe.
+ */
+class LatencyHistogram {
+public:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr size_t kSubBuckets = size_t{1} << kSubBucketBits;
+  /// Exponent of the largest power of two with its own buckets.
+  static constexpr int kMaxExponent = 36;
+  static constexpr size_t kBuckets =
+      (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+  /// Totals as of one read.
+  struct Snapshot {
+    std::array<uint64_t, kBuckets> counts{};
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+
+    /**
+     * @brief The latency at or below which a fraction `q` (in [0, 1])
+     *        of the samples fall: the top of its bucket, so within the
+     *        histogram's precision above the exact value (0 if empty).
+     */
+    [[nodiscard]] uint64_t percentile(double q) const {
+      if (count == 0)
+        return 0;
+      const auto rank = static_cast<uint64_t>(
+          std::max(1.0, std::ceil(q * static_cast<double>(count))));
+      uint64_t seen = 0;
+      for (size_t i = 0; i < kBuckets; ++i) {
+        seen += counts[i];
+        if (seen >= rank)
+          return bucket_end(i) - 1;
+      }
+      return bucket_end(kBuckets - 1) - 1;
+    }
+  };
+
+  LatencyHistogram() = default;
+
+  // Non-copyable
+  LatencyHistogram(const LatencyHistogram &) = delete;
+  LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+  void record(uint64_t ns) {
+    const size_t shard = detail::metric_shard();
+    Shard &local = shards_.local(shard);
+    detail::metric_add(local.counts[bucket_of(ns)], 1, shard);
+    detail::metric_add(local.sum_ns, ns, shard);
+  }
+
+  void record(std::chrono::nanoseconds elapsed) {
+    record(static_cast<uint64_t>(std::max<int64_t>(0, elapsed.count())));
+  }
+
+  /// Record the time elapsed since `start`.
+  void record_since(MetricsClock::time_point start) {
+    record(MetricsClock::now() - start);
+  }
+
+  [[nodiscard]] Snapshot snapshot() const {
+    Snapshot totals;
+    shards_.for_each([&totals](const Shard &shard) {
+      for (size_t i = 0; i < kBuckets; ++i) {
+        totals.counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+      }
+      totals.sum_ns += shard.sum_ns.load(std::memory_order_relaxed);
+    });
+    for (uint64_t count : totals.counts) {
+      totals.count += count;
+    }
+    return totals;
+  }
+
+  /// The bucket holding `ns`.
+  static size_t bucket_of(uint64_t ns) {
+    if (ns < kSubBuckets)
+      return static_cast<size_t>(ns);
+    const int exponent = 63 - __builtin_clzll(ns);
+    if (exponent > kMaxExponent)
+      return kBuckets - 1;
+    const int shift = exponent - kSubBucketBits;
+    return static_cast<size_t>(shift + 1) * kSubBuckets +
+           static_cast<size_t>((ns >> shift) & (kSubBuckets - 1));
+  }
+
+  /// One past the largest value bucket `bucket` holds.
+  static uint64_t bucket_end(size_t bucket) {
+    if (bucket < kSubBuckets)
+      return bucket + 1;
+    const size_t shift = bucket / kSubBuckets - 1;
+    return (kSubBuckets + bucket % kSubBuckets + 1) << shift;
+  }
+
+private:
+  struct alignas(64) Shard {
+    std::array<std::atomic<uint64_t>, kBuckets> counts{};
+    std::atomic<uint64_t> sum_ns{0};
+  };
+
+  detail::ShardSet<Shard> shards_;
+};
+
+/**
+ * @brief Records the lifetime of a scope into a histogram.
+ */
+class ScopedLatency {
+public:
+  explicit ScopedLatency(LatencyHistogram &histogram)
+      : histogram_(histogram), start_(MetricsClock::now()) {}
+
+  ~ScopedLatency() { histogram_.record_since(start_); }
+
+  // Non-copyable
+  ScopedLatency(const ScopedLatency &) = delete;
+  ScopedLatency &operator=(const ScopedLatency &) = delete;
+
+private:
+  LatencyHistogram &histogram_;
+  MetricsClock::time_point start_;
+};
+
+/**
+ * @brief Process-wide registry of named metrics, rendered for
+ *        Prometheus (GET /metrics).
+ *
+ * A metric is named by its family and a label set, pre-rendered as
+ * `key="value"` pairs (e.g. `rpc="propose"`); asking for the same one
+ * twice returns the same object. Components look theirs up once, when
+ * constructed, and keep the reference: metrics live as long as the
+ * process.
+ *
+ * Thread-safe.
+ */
+class MetricsRegistry {
+public:
+  static MetricsRegistry &instance() {
+    static MetricsRegistry registry;
+    return registry;
+  }
+
+  // Non-copyable
+  MetricsRegistry(const MetricsRegistry &) = delete;
+  MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+
+  /**
+   * @throws std::invalid_argument If `name` is registered as a histogram
+   */
+  Counter &counter(const std::string &name, const std::string &help,
+                   const std::string &labels = "") {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series &found = series(name, help, Kind::COUNTER, labels);
+    if (!found.counter) {
+      found.counter = std::make_unique<Counter>();
+    }
+    return *found.counter;
+  }
+
+  /**
+   * @throws std::invalid_argument If `name` is registered as a counter
+   */
+  LatencyHistogram &histogram(const std::string &name,
+                              const std::string &help,
+                              const std::string &labels = "") {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series &found = series(name, help, Kind::HISTOGRAM, labels);
+    if (!found.histogram) {
+      found.histogram = std::make_unique<LatencyHistogram>();
+    }
+    return *found.histogram;
+  }
+
+  /**
+   * @brief Every metric in the Prometheus text format (version 0.0.4),
+   *        in registration order.
+   *
+   * Histograms are in seconds, with a bucket per power of two from
+   * 2^10 ns (~1 us) to 2^36 ns (~69 s); each counts the samples below
+   * its bound, to within the histogram's precision.
+   */
+  [[nodiscard]] std::string render() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out;
+    for (const auto &family : families_) {
+      out += "# HELP " + family.name + " " + family.help + "\n";
+      out += "# TYPE " + family.name +
+             (family.kind == Kind::COUNTER ? " counter\n" : " histogram\n");
+      for (const auto &series : family.series) {
+        if (family.kind == Kind::COUNTER) {
+          out += family.name + braced(series.labels) + " " +
+                 std::to_string(series.counter->value()) + "\n";
+        } else {
+          render_histogram(out, family.name, series.labels,
+                           series.histogram->snapshot());
+        }
+      }
+    }
+    return out;
+  }
+
+private:
+  enum class Kind { COUNTER, HISTOGRAM };
+
+  /// Smallest and largest exponent of a rendered bucket bound.
+  static constexpr int kFirstBoundExponent = 10;
+  static constexpr int kLastBoundExponent = LatencyHistogram::kMaxExponent;
+
+  struct Series {
+    std::string labels;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<LatencyHistogram> histogram;
+  };
+
+  struct Family {
+    std::string name;
+    std::string help;
+    Kind kind = Kind::COUNTER;
+    std::vector<Series> series;
+  };
+
+  mutable std::mutex mutex_;
+  std::vector<Family> families_;
+
+  MetricsRegistry() = default;
+
+  /// Find or add a series (mutex_ held).
+  Series &series(const std::string &name, const std::string &help, Kind kind,
+                 const std::string &labels) {
+    auto family = std::find_if(
+        families_.begin(), families_.end(),
+        [&name](const Family &f) { return f.name == name; });
+    if (family == families_.end()) {
+      families_.push_back(Family{name, help, kind, {}});
+      family = families_.end() - 1;
+    } else if (family->kind != kind) {
+      throw std::invalid_argument("Metric " + name +
+                                  " is registered with another type");
+    }
+    for (auto &existing : family->series) {
+      if (existing.labels == labels)
+        return existing;
+    }
+    family->series.push_back(Series{labels, nullptr, nullptr});
+    return family->series.back();
+  }
+
+  static std::string braced(const std::string &labels) {
+    return labels.empty() ? std::string() : "{" + labels + "}";
+  }
+
+  static std::string seconds(uint64_t ns) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.9g", static_cast<double>(ns) / 1e9);
+    return text;
+  }
+
+  static void render_histogram(std::string &out, const std::string &name,
+                               const std::string &labels,
+                               const LatencyHistogram::Snapshot &totals) {
+    const std::string prefix =
+        name + "_bucket{" + labels + (labels.empty() ? "" : ",") + "le=\"";
+    uint64_t below = 0;
+    size_t bucket = 0;
+    for (int exponent = kFirstBoundExponent; exponent <= kLastBoundExponent;
+         ++exponent) {
+      const uint64_t bound = uint64_t{1} << exponent;
+      for (; bucket < LatencyHistogram::kBuckets &&
+             LatencyHistogram::bucket_end(bucket) <= bound;
+           ++bucket) {
+        below += totals.counts[bucket];
+      }
+      out += prefix + seconds(bound) + "\"} " + std::to_string(below) + "\n";
+    }
+    out += prefix + "+Inf\"} " + std::to_string(totals.count) + "\n";
+    out += name + "_sum" + braced(labels) + " " + seconds(totals.sum_ns) +
+           "\n";
+    out += name + "_count" + braced(labels) + " " +
+           std::to_string(totals.count) + "\n";
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "../logging/logger.hpp"
+#include "event_loop.hpp"
+#include "http_reactor.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Reactor thread over an edge-triggered epoll EventLoop.
+ *
+ * Sockets are non-blocking; each readiness edge is drained with
+ * recv(), and output goes out with sendmsg(), and file bodies with
+ * sendfile(), until the socket is full, resuming on the next EPOLLOUT.
+ */
+class EpollReactor : public HttpReactor {
+public:
+  EpollReactor(int listen_fd, bool shared_listener, size_t index,
+               const KVHttpHandler &handler, WorkStealingPool &workers,
+               ThreadPool &blocking, const HttpServerOptions &options)
+      : HttpReactor(index, handler, workers, blocking, options),
+        listen_fd_(listen_fd) {
+    // EPOLLEXCLUSIVE wakes one reactor per connection on a shared socket
+    loop_.watch(listen_fd_,
+                EPOLLIN | (shared_listener ? EPOLLEXCLUSIVE : EPOLLET),
+                kListenToken);
+  }
+
+  ~EpollReactor() override {
+    await_unanswered();
+    for (auto &[token, connection] : connections_) {
+      close(connection->fd);
+    }
+  }
+
+  void run() override {
+    loop_.run(
+        [this](uint64_t token, uint32_t events) { on_event(token, events); },
+        static_cast<int>(kIdleTickMs), [this] { close_idle(); });
+  }
+
+  void stop() override { loop_.stop(); }
+
+private:
+  struct Connection : HttpReactor::Connection {
+    using HttpReactor::Connection::Connection;
+
+    /// Reading stopped because HttpConnection::wants_input() was false
+    bool read_paused = false;
+  };
+
+  static constexpr uint64_t kListenToken = 1;
+  static constexpr size_t kReadChunk = 16 * 1024;
+  static constexpr size_t kMaxIov = 64;
+  /// Bytes per sendfile(2) call
+  static constexpr uint64_t kMaxSendfile = 1 << 20;
+
+  EventLoop loop_;
+  int listen_fd_;
+  std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections_;
+  uint64_t next_token_ = kListenToken + 1;
+
+  void post(std::function<void()> task) override {
+    loop_.post(std::move(task));
+  }
+
+  void on_event(uint64_t token, uint32_t events) {
+    if (token == kListenToken) {
+      accept_all();
+      return;
+    }
+    auto it = connections_.find(token);
+    if (it == connections_.end())
+      return; // Closed earlier in this batch
+
+    Connection &connection = *it->second;
+    connection.last_active = now_tick();
+    if (events & EPOLLERR) {
+      close_connection(token);
+      return;
+    }
+    if ((events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) &&
+        !read_all(connection)) {
+      close_connection(token);
+      return;
+    }
+    progress(token, connection);
+  }
+
+  void accept_all() {
+    while (true) {
+      int fd = accept4(listen_fd_, nullptr, nullptr,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED)
+          continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          KVDB_LOG(LogLevel::ERROR, "HTTP", "accept failed: " << errno);
+        }
+        return;
+      }
+
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+      const uint64_t token = next_token_++;
+      auto connection = std::make_unique<Connection>(token, fd, limits_);
+      track_idle(*connection);
+      connections_.emplace(token, std::move(connection));
+      loop_.watch(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, token);
+    }
+  }
+
+  /**
+   * @brief Drain the socket into the connection's buffer, or as much
+   *        of it as the connection wants.
+   * @return false on a socket error
+   */
+  bool read_all(Connection &connection) {
+    char buffer[kReadChunk];
+    connection.read_paused = false;
+    while (true) {
+      if (!connection.http.wants_input()) {
+        // Edge-triggered: nothing re-announces what is left unread,
+        // so progress() resumes reading once we catch up
+        connection.read_paused = true;
+        return true;
+      }
+      ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+      if (n > 0) {
+        connection.http.on_read(buffer, static_cast<size_t>(n));
+        continue;
+      }
+      if (n == 0) {
+        connection.peer_closed = true;
+        return true;
+      }
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+  }
+
+  /**
+   * @brief Handle the complete requests buffered (in order, stopping
+   *        at one that waits for Raft), write what is pending, and
+   *        close the connection when it is done.
+   */
+  void progress(uint64_t token, Connection &connection) {
+    bool progressed = true;
+    while (progressed) {
+      progressed = false;
+      while (auto request = take_request(connection)) {
+        dispatch(token, std::move(*request));
+        progressed = true;
+      }
+      const bool had_output = connection.http.has_pending_output();
+      if (!flush(connection)) {
+        close_connection(token);
+        return;
+      }
+      if (connection.http.has_pending_output())
+        break; // Socket full; EPOLLOUT brings us back
+      // Draining the output may unblock requests held back by
+      // max_pending_output
+      progressed |= had_output;
+      if (connection.read_paused && connection.http.wants_input()) {
+        if (!read_all(connection)) {
+          close_connection(token);
+          return;
+        }
+        progressed = true;
+      }
+    }
+
+    pull_stream(connection);
+    if (connection.http.handling())
+      return; // Response comes later; keep the socket even if half-closed
+    if (!connection.http.has_pending_output() &&
+        (connection.http.closing() || connection.peer_closed)) {
+      close_connection(token);
+    }
+  }
+
+  void complete(uint64_t token, HttpResponse response) override {
+    auto it = connections_.find(token);
+    if (it == connections_.end())
+      return; // The client went away meanwhile
+    it->second->http.respond(std::move(response));
+    progress(token, *it->second);
+  }
+
+  void complete_chunk(uint64_t token, std::string chunk,
+                      bool failed) override {
+    auto it = connections_.find(token);
+    if (it == connections_.end())
+      return;
+    it->second->http.on_chunk(std::move(chunk), failed);
+    progress(token, *it->second);
+  }
+
+  /**
+   * @brief Write pending output until done or the socket is full (a
+   *        later EPOLLOUT edge resumes it).
+   * @return false on a socket error
+   */
+  static bool flush(Connection &connection) {
+    while (connection.http.has_pending_output()) {
+      ssize_t n;
+      if (auto file = connection.http.pending_file()) {
+        auto offset = static_cast<off_t>(file->offset);
+        n = sendfile(connection.fd, file->fd, &offset,
+                     static_cast<size_t>(
+                         std::min<uint64_t>(file->length, kMaxSendfile)));
+        if (n == 0)
+          return false; // The file shrank under us
+      } else {
+        iovec iov[kMaxIov];
+        msghdr message{};
+        message.msg_iov = iov;
+        message.msg_iovlen =
+            connection.http.gather_output(iov, kMaxIov, true);
+        n = sendmsg(connection.fd, &message, MSG_NOSIGNAL);
+      }
+      if (n >= 0) {
+        // Short writes just leave the rest for the next round
+        connection.http.consume_output(static_cast<size_t>(n));
+        continue;
+      }
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    return true;
+  }
+
+  void close_connection(uint64_t token) override {
+    auto it = connections_.find(token);
+    if (it == connections_.end())
+      return;
+    forget_idle(*it->second);
+    loop_.unwatch(it->second->fd);
+    close(it->second->fd);
+    connections_.erase(it);
+  }
+};
+
+} // namespace kvdb
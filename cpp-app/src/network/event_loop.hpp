@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace kvdb {
+
+/**
+ * @brief One epoll instance plus a queue of tasks posted from other
+ *        threads.
+ *
+ * Watched descriptors are identified by a caller-chosen non-zero token
+ * (0 is the loop's own wake-up eventfd), so a stale event for a closed
+ * and reused descriptor can be told apart from a live one.
+ *
+ * run() and every method except post() and stop() must be called from
+ * the loop's thread.
+ */
+class EventLoop {
+public:
+  using EventHandler = std::function<void(uint64_t token, uint32_t events)>;
+  using Task = std::function<void()>;
+
+  EventLoop() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+      throw std::runtime_error("epoll_create1 failed");
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+      close(epoll_fd_);
+      throw std::runtime_error("eventfd failed");
+    }
+    watch(wake_fd_, EPOLLIN | EPOLLET, 0);
+  }
+
+  ~EventLoop() {
+    close(wake_fd_);
+    close(epoll_fd_);
+  }
+
+  // Non-copyable
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator=(const EventLoop &) = delete;
+
+  void watch(int fd, uint32_t events, uint64_t token) {
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = token;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+      throw std::runtime_error("epoll_ctl(ADD) failed: " +
+                               std::to_string(errno));
+    }
+  }
+
+  void modify(int fd, uint32_t events, uint64_t token) {
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = token;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+  }
+
+  void unwatch(int fd) { epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr); }
+
+  /**
+   * @brief Run `task` on the loop's thread. Thread-safe.
+   */
+  void post(Task task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    wake();
+  }
+
+  /**
+   * @brief Make run() return after the current iteration. Thread-safe.
+   */
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake();
+  }
+
+  /**
+   * @brief Dispatch events and posted tasks until stop().
+   *
+   * @param on_event Called for every event on a watched descriptor
+   * @param timeout_ms epoll_wait timeout; `on_idle` runs after each wait
+   * @param on_idle Periodic housekeeping (may be empty)
+   */
+  void run(const EventHandler &on_event, int timeout_ms = -1,
+           const Task &on_idle = {}) {
+    std::vector<epoll_event> events(kMaxEvents);
+    std::vector<Task> tasks;
+    while (true) {
+      int n = epoll_wait(epoll_fd_, events.data(),
+                         static_cast<int>(events.size()), timeout_ms);
+      if (n < 0 && errno != EINTR) {
+        throw std::runtime_error("epoll_wait failed: " +
+                                 std::to_string(errno));
+      }
+      for (int i = 0; i < n; ++i) {
+        if (events[i].data.u64 == 0) {
+          uint64_t counter;
+          while (read(wake_fd_, &counter, sizeof(counter)) > 0) {
+          }
+          continue;
+        }
+        on_event(events[i].data.u64, events[i].events);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_)
+          return;
+        tasks.swap(tasks_);
+      }
+      for (auto &task : tasks) {
+        task();
+      }
+      tasks.clear();
+      if (on_idle) {
+        on_idle();
+      }
+    }
+  }
+
+private:
+  static constexpr size_t kMaxEvents = 256;
+
+  int epoll_fd_ = -1;
+  int wake_fd_ = -1;
+  std::mutex mutex_;
+  std::vector<Task> tasks_;
+  bool stopping_ = false;
+
+  void wake() {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = write(wake_fd_, &one, sizeof(one));
+  }
+};
+
+} // namespace kvdb
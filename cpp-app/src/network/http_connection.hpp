@@ -0,0 +1,364 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <sys/uio.h>
+
+#include "http_request.hpp"
+#include "http_response.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Size and reuse limits for one connection.
+ */
+struct HttpLimits {
+  size_t max_header_bytes = 64 * 1024;
+  size_t max_body_bytes = 64 * 1024 * 1024;
+  /// Requests served before the connection is closed (0 = unlimited).
+  size_t max_requests = 1000;
+  /// Stop taking pipelined requests while this much output is unsent.
+  size_t max_pending_output = 1024 * 1024;
+};
+
+/**
+ * @brief Per-connection HTTP state machine, independent of the I/O
+ *        backend driving it.
+ *
+ * The backend appends whatever it receives with on_read(), takes
+ * complete requests with take_request(), hands their responses back
+ * with respond() (possibly later, from another thread's result) and
+ * writes the pending output until has_pending_output() is false.
+ *
+ * Output is a queue of segments written without flattening it: small
+ * responses are packed together, large bodies are queued as they are
+ * (moved, not copied) for gather_output() to hand to writev/sendmsg,
+ * and file bodies stay in their file (see pending_file()). Streamed
+ * bodies are framed as chunks, each fetched by the backend (see
+ * stream_to_pull()) once the output queue has drained below
+ * kStreamLowWater, so their memory use is bounded by the socket's pace.
+ *
+ * Requests are parsed in place by an incremental HttpRequestParser; a
+ * taken request's views into the input buffer stay valid until the
+ * next on_read() or take_request() (call HttpRequest::own_buffer() to
+ * keep it longer).
+ *
+ * Connections are persistent (HTTP/1.1 keep-alive) up to
+ * HttpLimits::max_requests. Pipelined requests are taken from the same
+ * buffer one at a time, so their responses go out in order; while the
+ * peer is not reading them, wants_input() tells the backend to stop
+ * reading too. Malformed or oversized requests get an error response
+ * and close the connection.
+ */
+class HttpConnection {
+public:
+  explicit HttpConnection(HttpLimits limits = {})
+      : limits_(limits),
+        parser_(limits.max_header_bytes, limits.max_body_bytes) {}
+
+  /// Buffer bytes received from the peer.
+  void on_read(const char *data, size_t size) {
+    if (!closing_) {
+      compact_input();
+      input_.append(data, size);
+    }
+  }
+
+  /**
+   * @brief Whether the backend should keep reading from the socket.
+   *
+   * False while the output backlog or the buffered input is already
+   * at its limit, and once the connection is closing.
+   */
+  [[nodiscard]] bool wants_input() const {
+    return !closing_ &&
+           pending_bytes_ < limits_.max_pending_output &&
+           input_.size() - consumed_ <
+               limits_.max_header_bytes + limits_.max_body_bytes;
+  }
+
+  /**
+   * @brief Extract the next complete request, if one has arrived.
+   *
+   * On a malformed or oversized request an error response is queued
+   * instead and the connection is marked closing.
+   */
+  [[nodiscard]] std::optional<HttpRequest> take_request() {
+    if (handling_ || closing_ || pending_bytes_ >= limits_.max_pending_output)
+      return std::nullopt;
+    compact_input();
+
+    HttpRequest request;
+    switch (parser_.parse(std::string_view(input_).substr(consumed_),
+                          request)) {
+    case HttpRequestParser::Status::INCOMPLETE:
+      return std::nullopt;
+    case HttpRequestParser::Status::BAD_REQUEST:
+      fail(HttpResponse::bad_request());
+      return std::nullopt;
+    case HttpRequestParser::Status::HEADERS_TOO_LARGE:
+      fail(HttpResponse{431, "Request Header Fields Too Large", {}, {}});
+      return std::nullopt;
+    case HttpRequestParser::Status::BODY_TOO_LARGE:
+      fail(HttpResponse{413, "Payload Too Large", {}, {}});
+      return std::nullopt;
+    case HttpRequestParser::Status::NOT_IMPLEMENTED:
+      fail(HttpResponse{501, "Not Implemented", {}, {}});
+      return std::nullopt;
+    case HttpRequestParser::Status::COMPLETE:
+      break;
+    }
+
+    // Compacted lazily, so the request's views stay valid for now
+    consumed_ += parser_.consumed();
+    parser_.reset();
+    handling_ = true;
+    keep_alive_ = request.keep_alive;
+    return request;
+  }
+
+  /**
+   * @brief A file body at the front of the output, for sendfile(2).
+   */
+  struct PendingFile {
+    int fd;
+    uint64_t offset; ///< Next byte of the file to send
+    uint64_t length; ///< Bytes left
+  };
+
+  /// Queue the response to the request last taken.
+  void respond(HttpResponse response) {
+    handling_ = false;
+    ++served_;
+    const bool keep_alive =
+        keep_alive_ &&
+        (limits_.max_requests == 0 || served_ < limits_.max_requests);
+    append_bytes(response.head(keep_alive));
+    if (response.stream) {
+      // Still handling the request until the last chunk is in
+      handling_ = true;
+      stream_ = std::move(response.stream);
+    } else if (response.file) {
+      if (!response.file->bytes.empty()) {
+        pending_bytes_ += response.file->bytes.size();
+        output_.push_back(Segment{{}, std::move(response.file)});
+      }
+    } else if (response.body.size() <= kPackBytes) {
+      append_bytes(response.body);
+    } else {
+      pending_bytes_ += response.body.size();
+      output_.push_back(Segment{std::move(response.body), nullptr});
+    }
+    if (!keep_alive) {
+      closing_ = true;
+    }
+  }
+
+  /**
+   * @brief The body stream to fetch the next chunk from, if one is due.
+   *
+   * Due when a streamed response is being sent, the output queue is
+   * below kStreamLowWater and no chunk is outstanding; the caller then
+   * calls IBodyStream::next() (off the reactor thread) and hands the
+   * result to on_chunk().
+   */
+  [[nodiscard]] std::shared_ptr<IBodyStream> stream_to_pull() {
+    if (!stream_ || stream_pulling_ || pending_bytes_ >= kStreamLowWater)
+      return nullptr;
+    stream_pulling_ = true;
+    return stream_;
+  }
+
+  /**
+   * @brief Queue a chunk returned by the body stream.
+   * @param chunk The chunk; empty for the end of the body
+   * @param failed Whether producing it failed: the body is cut short
+   *        and the connection will be closed
+   */
+  void on_chunk(std::string chunk, bool failed = false) {
+    stream_pulling_ = false;
+    if (!stream_)
+      return;
+    if (failed) {
+      stream_.reset();
+      handling_ = false;
+      closing_ = true;
+      return;
+    }
+    if (chunk.empty()) {
+      append_bytes("0\r\n\r\n");
+      stream_.reset();
+      handling_ = false;
+      return;
+    }
+    char size_line[24];
+    const int length = std::snprintf(size_line, sizeof(size_line), "%zx\r\n",
+                                     chunk.size());
+    append_bytes(std::string_view(size_line, static_cast<size_t>(length)));
+    if (chunk.size() <= kPackBytes) {
+      append_bytes(chunk);
+    } else {
+      pending_bytes_ += chunk.size();
+      output_.push_back(Segment{std::move(chunk), nullptr});
+    }
+    append_bytes("\r\n");
+  }
+
+  /// Whether a streamed response body is still being produced.
+  [[nodiscard]] bool streaming() const { return stream_ != nullptr; }
+
+  [[nodiscard]] bool has_pending_output() const { return pending_bytes_ > 0; }
+
+  /// Bytes queued but not yet written.
+  [[nodiscard]] size_t pending_bytes() const { return pending_bytes_; }
+
+  /**
+   * @brief Describe the output at the front of the queue as at most
+   *        `max_iov` buffers.
+   *
+   * File bodies are described by their mapping, or, with
+   * `stop_at_files`, left to sendfile(2) (see pending_file()).
+   * @return Buffers filled (0 if nothing is pending, or if the front is
+   *         a file body and `stop_at_files`)
+   */
+  size_t gather_output(iovec *iov, size_t max_iov,
+                       bool stop_at_files = false) const {
+    size_t count = 0;
+    size_t skip = written_;
+    for (const Segment &segment : output_) {
+      if (count == max_iov || (stop_at_files && segment.file))
+        break;
+      const std::string_view bytes = segment.bytes();
+      iov[count].iov_base = const_cast<char *>(bytes.data() + skip);
+      iov[count].iov_len = bytes.size() - skip;
+      ++count;
+      skip = 0;
+    }
+    return count;
+  }
+
+  /**
+   * @brief Keep the buffers last returned by gather_output() in place
+   *        until they are consumed.
+   *
+   * For backends whose writes complete later (io_uring): responses
+   * queued meanwhile go to a new segment instead of being packed into
+   * one the kernel may still be reading.
+   */
+  void seal_output() { sealed_ = true; }
+
+  /// The file body at the front of the queue, if that is what is next.
+  [[nodiscard]] std::optional<PendingFile> pending_file() const {
+    if (output_.empty() || !output_.front().file)
+      return std::nullopt;
+    const FileRegion &file = *output_.front().file;
+    return PendingFile{file.fd, file.offset + written_,
+                       file.bytes.size() - written_};
+  }
+
+  /// Mark `n` bytes of pending output as written.
+  void consume_output(size_t n) {
+    pending_bytes_ -= n;
+    while (n > 0) {
+      const size_t left = output_.front().bytes().size() - written_;
+      if (n < left) {
+        written_ += n;
+        return;
+      }
+      n -= left;
+      output_.pop_front();
+      written_ = 0;
+    }
+  }
+
+  /// Whether a taken request is still waiting for its response.
+  [[nodiscard]] bool handling() const { return handling_; }
+
+  /// Whether to close the connection once pending output is written.
+  [[nodiscard]] bool closing() const { return closing_; }
+
+  /// Whether part of a request has been received but not taken.
+  [[nodiscard]] bool has_partial_input() const {
+    return consumed_ < input_.size();
+  }
+
+private:
+  HttpLimits limits_;
+  HttpRequestParser parser_;
+  std::string input_;
+  size_t consumed_ = 0; ///< Prefix of input_ already taken
+  /// One run of output: `owned`, or a file body when `file` is set.
+  struct Segment {
+    std::string owned;
+    std::shared_ptr<const FileRegion> file;
+
+    [[nodiscard]] std::string_view bytes() const {
+      return file ? file->bytes : std::string_view(owned);
+    }
+  };
+
+  /// Bodies up to this size are copied next to their headers instead
+  /// of being queued as a segment of their own.
+  static constexpr size_t kPackBytes = 4096;
+  /// Packed segments stop growing at this size.
+  static constexpr size_t kMaxPackedSegment = 64 * 1024;
+  /// Fetch the next chunk of a streamed body once less than this is
+  /// left to write.
+  static constexpr size_t kStreamLowWater = 64 * 1024;
+
+  std::deque<Segment> output_; ///< Written in order
+  size_t written_ = 0; ///< Prefix of output_.front() already sent
+  size_t pending_bytes_ = 0;
+  size_t served_ = 0;
+  bool handling_ = false;
+  bool keep_alive_ = false;
+  bool closing_ = false;
+  bool sealed_ = false; ///< Don't pack into output_.back() (seal_output)
+  std::shared_ptr<IBodyStream> stream_; ///< Body still being streamed
+  bool stream_pulling_ = false;         ///< A chunk is being produced
+
+  void compact_input() {
+    // Only once the taken prefix dominates, keeping this amortised O(1)
+    // per byte however many requests are pipelined
+    if (consumed_ == input_.size()) {
+      input_.clear();
+      consumed_ = 0;
+    } else if (consumed_ > input_.size() / 2) {
+      input_.erase(0, consumed_);
+      consumed_ = 0;
+    }
+  }
+
+  /// Queue bytes, packing them into the last segment when it is small.
+  void append_bytes(std::string_view bytes) {
+    if (bytes.empty())
+      return;
+    pending_bytes_ += bytes.size();
+    if (!sealed_ && !output_.empty() && !output_.back().file &&
+        output_.back().owned.size() + bytes.size() <= kMaxPackedSegment) {
+      output_.back().owned += bytes;
+    } else {
+      output_.push_back(Segment{std::string(bytes), nullptr});
+      sealed_ = false;
+    }
+  }
+
+  void fail(HttpResponse response) {
+    keep_alive_ = false;
+    respond(std::move(response));
+    input_.clear();
+    consumed_ = 0;
+    parser_.reset();
+  }
+};
+
+} // namespace kvdb
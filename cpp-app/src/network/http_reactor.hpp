@@ -0,0 +1,315 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "../logging/logger.hpp"
+#include "../metrics/metrics.hpp"
+#include "../storage/timer_wheel.hpp"
+#include "http_connection.hpp"
+#include "http_request.hpp"
+#include "http_response.hpp"
+#include "kv_http_handler.hpp"
+#include "thread_pool.hpp"
+#include "work_stealing_pool.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Socket layer under HttpServer.
+ */
+enum class HttpBackend {
+  EPOLL,    ///< Edge-triggered epoll and non-blocking syscalls
+  IO_URING, ///< io_uring (KVDB_WITH_IO_URING builds, Linux 6.0+)
+};
+
+/**
+ * @brief Parse a --http-backend value ("epoll", "io_uring").
+ * @throws std::invalid_argument If unknown or not compiled in
+ */
+inline HttpBackend parse_http_backend(const std::string &name) {
+  if (name == "epoll")
+    return HttpBackend::EPOLL;
+  if (name == "io_uring") {
+#ifdef KVDB_HAVE_IO_URING
+    return HttpBackend::IO_URING;
+#else
+    throw std::invalid_argument(
+        "Built without io_uring (KVDB_WITH_IO_URING=OFF)");
+#endif
+  }
+  throw std::invalid_argument("Unknown HTTP backend: " + name);
+}
+
+/**
+ * @brief Tunables for HttpServer.
+ */
+struct HttpServerOptions {
+  /// Reactor threads, each with its own event loop; 0 = one per core.
+  size_t threads = 0;
+  /// listen() backlog of each listening socket.
+  int backlog = 1024;
+  /// Threads for requests that block on Raft (see
+  /// KVHttpHandler::waits_for_raft) and for blocking streamed bodies.
+  size_t blocking_threads = 32;
+  /// Work-stealing threads running the other requests; 0 = one per
+  /// reactor.
+  size_t workers = 0;
+  /// Socket layer; IO_URING falls back to EPOLL where unsupported.
+  HttpBackend backend = HttpBackend::EPOLL;
+  /// Close keep-alive connections idle this long.
+  std::chrono::milliseconds idle_timeout{60000};
+  HttpLimits limits;
+};
+
+/**
+ * @brief Backend-independent half of a reactor thread.
+ *
+ * Hands parsed requests to the executors and closes idle connections.
+ * A backend (EpollReactor, UringReactor) owns the sockets and drives
+ * each connection's HttpConnection, and implements post(), complete()
+ * and close_connection().
+ *
+ * Records how long requests take to parse (kvdb_http_parse_seconds),
+ * wait for an executor (kvdb_http_queue_seconds) and be answered from
+ * dispatch (kvdb_http_request_seconds).
+ */
+class HttpReactor {
+public:
+  virtual ~HttpReactor() = default;
+
+  // Non-copyable
+  HttpReactor(const HttpReactor &) = delete;
+  HttpReactor &operator=(const HttpReactor &) = delete;
+
+  /// Serve connections until stop().
+  virtual void run() = 0;
+
+  /// Make run() return. Thread-safe.
+  virtual void stop() = 0;
+
+protected:
+  /// Filed in idle_timers_ by its own idle-timeout timer.
+  struct Connection : TimerWheel::Timer {
+    Connection(uint64_t token, int fd, HttpLimits limits)
+        : token(token), fd(fd), http(limits) {}
+
+    uint64_t token;
+    int fd;
+    HttpConnection http;
+    bool peer_closed = false;
+    uint64_t last_active = 0; ///< Idle tick of the last socket activity
+  };
+
+  static constexpr uint64_t kIdleTickMs = 250;
+
+  /**
+   * @param index Reactor number; also picks its worker queue
+   */
+  HttpReactor(size_t index, const KVHttpHandler &handler,
+              WorkStealingPool &workers, ThreadPool &blocking,
+              const HttpServerOptions &options)
+      : index_(index), handler_(handler), workers_(workers),
+        blocking_(blocking), limits_(options.limits),
+        idle_ticks_(std::max<uint64_t>(
+            1, static_cast<uint64_t>(options.idle_timeout.count()) /
+                   kIdleTickMs)),
+        idle_timers_(now_tick()),
+        parse_latency_(MetricsRegistry::instance().histogram(
+            "kvdb_http_parse_seconds", "Time to parse an HTTP request.")),
+        queue_latency_(MetricsRegistry::instance().histogram(
+            "kvdb_http_queue_seconds",
+            "Time from dispatching an HTTP request to an executor "
+            "starting it.")),
+        request_latency_(MetricsRegistry::instance().histogram(
+            "kvdb_http_request_seconds",
+            "Time from dispatching an HTTP request to its response.")),
+        requests_(MetricsRegistry::instance().counter(
+            "kvdb_http_requests_total", "HTTP requests dispatched.")) {}
+
+  /// Run `task` on the reactor thread. Thread-safe.
+  virtual void post(std::function<void()> task) = 0;
+
+  /// Deliver a response computed off the reactor thread.
+  virtual void complete(uint64_t token, HttpResponse response) = 0;
+
+  /// Deliver a chunk of a streamed body (see pull_stream()).
+  virtual void complete_chunk(uint64_t token, std::string chunk,
+                              bool failed) = 0;
+
+  virtual void close_connection(uint64_t token) = 0;
+
+  /**
+   * @brief The connection's next complete request, if any (as
+   *        HttpConnection::take_request()), timing its parse.
+   */
+  std::optional<HttpRequest> take_request(Connection &connection) {
+    const auto start = MetricsClock::now();
+    auto request = connection.http.take_request();
+    if (request) {
+      parse_latency_.record_since(start);
+    }
+    return request;
+  }
+
+  /**
+   * @brief Handle a request off the reactor thread and complete() it.
+   *
+   * Requests go to the reactor's own queue in the WorkStealingPool, but
+   * those that block on Raft go to the blocking ThreadPool. Proposals,
+   * unless admission control refuses them first, are sent from a worker
+   * and answered from the Raft client's thread when they commit (see
+   * KVHttpHandler::handle_async()), so they hold up no thread meanwhile.
+   */
+  void dispatch(uint64_t token, HttpRequest request) {
+    const auto dispatched = MetricsClock::now();
+    requests_.add();
+    if (auto refused = handler_.admit(request)) {
+      post([this, token, response = std::move(*refused)]() mutable {
+        complete(token, std::move(response));
+      });
+      return;
+    }
+    const bool blocks = handler_.waits_for_raft(request);
+    // The connection's buffer keeps changing meanwhile
+    request.own_buffer();
+    {
+      std::lock_guard<std::mutex> lock(unanswered_mutex_);
+      ++unanswered_;
+    }
+    auto task = [this, token, dispatched, request = std::move(request)] {
+      queue_latency_.record_since(dispatched);
+      handler_.handle_async(
+          request, [this, token, dispatched](HttpResponse response) {
+            request_latency_.record_since(dispatched);
+            post([this, token, response = std::move(response)]() mutable {
+              complete(token, std::move(response));
+            });
+            std::lock_guard<std::mutex> lock(unanswered_mutex_);
+            if (--unanswered_ == 0) {
+              answered_.notify_all();
+            }
+          });
+    };
+    if (blocks) {
+      blocking_.submit(std::move(task));
+    } else {
+      workers_.submit(index_, std::move(task));
+    }
+  }
+
+  /**
+   * @brief Produce the next chunk of the connection's streamed response
+   *        off the reactor thread, if one is due, and complete_chunk()
+   *        it.
+   *
+   * Backends call this whenever output has drained; the chunk arriving
+   * brings them back here, so a stream advances at the socket's pace.
+   */
+  void pull_stream(Connection &connection) {
+    auto stream = connection.http.stream_to_pull();
+    if (!stream)
+      return;
+    const uint64_t token = connection.token;
+    const bool blocks = stream->blocking();
+    auto task = [this, token, stream = std::move(stream)] {
+      std::string chunk;
+      bool failed = false;
+      try {
+        chunk = stream->next();
+      } catch (const std::exception &e) {
+        KVDB_LOG(LogLevel::ERROR, "HTTP",
+                 "Streamed response failed: " << e.what());
+        failed = true;
+      }
+      post([this, token, chunk = std::move(chunk), failed]() mutable {
+        complete_chunk(token, std::move(chunk), failed);
+      });
+    };
+    if (blocks) {
+      blocking_.submit(std::move(task));
+    } else {
+      workers_.submit(index_, std::move(task));
+    }
+  }
+
+  /**
+   * @brief Wait until every dispatched request has been answered.
+   *
+   * Proposals are answered after the executors have drained, so a
+   * backend calls this first thing in its destructor, while post()
+   * still works.
+   */
+  void await_unanswered() {
+    std::unique_lock<std::mutex> lock(unanswered_mutex_);
+    answered_.wait(lock, [this] { return unanswered_ == 0; });
+  }
+
+  /// Start the idle timeout of a new connection.
+  void track_idle(Connection &connection) {
+    connection.last_active = now_tick();
+    idle_timers_.schedule(&connection, connection.last_active + idle_ticks_);
+  }
+
+  void forget_idle(Connection &connection) {
+    idle_timers_.cancel(&connection);
+  }
+
+  /**
+   * @brief Close connections with no socket activity for idle_ticks_.
+   *
+   * A timer firing re-arms itself from the connection's last activity
+   * instead of being moved on every read.
+   */
+  void close_idle() {
+    const uint64_t now = now_tick();
+    idle_timers_.advance(now, [&](TimerWheel::Timer *timer) {
+      auto *connection = static_cast<Connection *>(timer);
+      if (connection->http.handling() && !connection->http.streaming()) {
+        // Waiting for Raft is not idleness; a client not reading a
+        // streamed body is
+        idle_timers_.schedule(connection, now + idle_ticks_);
+      } else if (now - connection->last_active >= idle_ticks_) {
+        close_connection(connection->token);
+      } else {
+        idle_timers_.schedule(connection,
+                              connection->last_active + idle_ticks_);
+      }
+    });
+  }
+
+  static uint64_t now_tick() {
+    return static_cast<uint64_t>(
+               std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+                   .count()) /
+           kIdleTickMs;
+  }
+
+  size_t index_;
+  const KVHttpHandler &handler_;
+  WorkStealingPool &workers_;
+  ThreadPool &blocking_;
+  HttpLimits limits_;
+  uint64_t idle_ticks_;
+  TimerWheel idle_timers_;
+  LatencyHistogram &parse_latency_;
+  LatencyHistogram &queue_latency_;
+  LatencyHistogram &request_latency_;
+  Counter &requests_;
+
+  std::mutex unanswered_mutex_;
+  std::condition_variable answered_;
+  size_t unanswered_ = 0; ///< Dispatched requests not yet answered
+};
+
+} // namespace kvdb
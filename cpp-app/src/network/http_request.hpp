@@ -1,117 +1,432 @@
 #pragma once
 
 #include <algorithm>
-#include <map>
-#include <sstream>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace kvdb {
 
+/**
+ * @brief One header line, as views into the request's buffer.
+ */
+struct HttpHeader {
+  std::string_view name; ///< As sent; compare with HttpRequest::iequals
+  std::string_view value; ///< Trimmed
+};
+
 /**
  * @brief Parsed HTTP request structure.
  *
- * Immutable value object representing a parsed HTTP request.
+ * Every field is a view into the buffer the request was parsed from
+ * (see HttpRequestParser), valid as long as that buffer is unchanged.
+ * own_buffer() copies the bytes into the request itself for requests
+ * that outlive it.
  */
 struct HttpRequest {
-  std::string method;
-  std::string path;
-  std::string query_string;
-  std::map<std::string, std::string> headers;
-  std::string body;
+  /// Headers beyond this make the request fail with 431.
+  static constexpr size_t kMaxHeaders = 64;
+
+  std::string_view raw; ///< The whole request, header block and body
+  std::string_view method;
+  std::string_view path;
+  std::string_view query_string;
+  std::string_view version; ///< e.g. "HTTP/1.1"
+  std::array<HttpHeader, kMaxHeaders> headers{};
+  size_t header_count = 0;
+  std::string_view body;
   bool is_msgpack = false;
-  int content_length = 0;
+  size_t content_length = 0;
+  /// Whether the client wants the connection kept open (HTTP/1.1
+  /// unless "Connection: close"; HTTP/1.0 only with "keep-alive").
+  bool keep_alive = false;
 
   /**
-   * @brief Parse query parameters from the query string.
-   * @return Map of key-value pairs from the query string
+   * @brief Value of the first header named `name` (case-insensitive).
    */
-  [[nodiscard]] std::map<std::string, std::string> query_params() const {
-    std::map<std::string, std::string> params;
-    size_t start = 0;
+  [[nodiscard]] std::optional<std::string_view>
+  header(std::string_view name) const {
+    for (size_t i = 0; i < header_count; ++i) {
+      if (iequals(headers[i].name, name))
+        return headers[i].value;
+    }
+    return std::nullopt;
+  }
 
-    while (start < query_string.size()) {
-      size_t eq_pos = query_string.find('=', start);
-      if (eq_pos == std::string::npos)
-        break;
+  /**
+   * @brief Value of query parameter `name`, or nullopt if absent.
+   *
+   * Keys and values are percent-decoded ('+' becomes a space).
+   */
+  [[nodiscard]] std::optional<std::string>
+  query_param(std::string_view name) const {
+    std::string_view rest = query_string;
+    while (!rest.empty()) {
+      size_t amp = rest.find('&');
+      std::string_view pair = rest.substr(0, amp);
+      rest = amp == std::string_view::npos ? std::string_view()
+                                           : rest.substr(amp + 1);
+
+      size_t eq = pair.find('=');
+      if (eq == std::string_view::npos)
+        continue;
+      std::string_view key = pair.substr(0, eq);
+      // Keys are almost never escaped; only decode the ones that are
+      const bool match = key.find_first_of("%+") == std::string_view::npos
+                             ? key == name
+                             : url_decode(key) == name;
+      if (match)
+        return url_decode(pair.substr(eq + 1));
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Whether Accept-Encoding lists a content coding (or "*")
+   *        without q=0.
+   */
+  [[nodiscard]] bool accepts_encoding(std::string_view coding) const {
+    auto header_value = header("accept-encoding");
+    if (!header_value)
+      return false;
+
+    std::string_view list = *header_value;
+    while (!list.empty()) {
+      size_t comma = list.find(',');
+      std::string_view item = list.substr(0, comma);
+      list = comma == std::string_view::npos ? std::string_view()
+                                             : list.substr(comma + 1);
+
+      size_t semi = item.find(';');
+      std::string_view name = trim(item.substr(0, semi));
+      if (!iequals(name, coding) && name != "*")
+        continue;
+      if (semi == std::string_view::npos)
+        return true;
+      std::string_view param = trim(item.substr(semi + 1));
+      if (param.size() < 2 || (param[0] != 'q' && param[0] != 'Q') ||
+          param[1] != '=')
+        return true;
+      // q=0, q=0.0, q=0.00 ... mean "not acceptable"
+      param.remove_prefix(2);
+      return param.find_first_not_of("0.") != std::string_view::npos;
+    }
+    return false;
+  }
 
-      size_t amp_pos = query_string.find('&', eq_pos);
-      std::string key = query_string.substr(start, eq_pos - start);
-      std::string value = query_string.substr(
-          eq_pos + 1,
-          (amp_pos == std::string::npos ? query_string.size() : amp_pos) -
-              (eq_pos + 1));
+  /**
+   * @brief Copy the request's bytes into storage it owns and repoint
+   *        its views there, so it outlives the buffer it was parsed
+   *        from (e.g. when handed to another thread).
+   */
+  void own_buffer() {
+    const char *begin = raw.data();
+    auto storage = std::make_shared<std::string>(raw);
+    const char *base = storage->data();
+    auto rebase = [&](std::string_view &view) {
+      if (!view.empty()) {
+        view = std::string_view(base + (view.data() - begin), view.size());
+      }
+    };
+    rebase(raw);
+    rebase(method);
+    rebase(path);
+    rebase(query_string);
+    rebase(version);
+    for (size_t i = 0; i < header_count; ++i) {
+      rebase(headers[i].name);
+      rebase(headers[i].value);
+    }
+    rebase(body);
+    storage_ = std::move(storage);
+  }
+
+  static std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+      s.remove_prefix(1);
+    while (!s.empty() &&
+           (s.back() == ' ' || s.back() == '\t' || s.back() == '\r'))
+      s.remove_suffix(1);
+    return s;
+  }
+
+  static bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+             return std::tolower(static_cast<unsigned char>(x)) ==
+                    std::tolower(static_cast<unsigned char>(y));
+           });
+  }
+
+  /// Whether `list` (e.g. a Connection header) contains `token`,
+  /// case-insensitively.
+  static bool icontains(std::string_view list, std::string_view token) {
+    if (token.size() > list.size())
+      return false;
+    for (size_t i = 0; i + token.size() <= list.size(); ++i) {
+      if (iequals(list.substr(i, token.size()), token))
+        return true;
+    }
+    return false;
+  }
 
-      params[key] = value;
-      start = (amp_pos == std::string::npos) ? std::string::npos : amp_pos + 1;
+  /**
+   * @brief Decode %XX escapes and '+' in a query component.
+   */
+  static std::string url_decode(std::string_view in) {
+    std::string out;
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+      if (in[i] == '+') {
+        out += ' ';
+      } else if (in[i] == '%' && i + 2 < in.size() &&
+                 std::isxdigit(static_cast<unsigned char>(in[i + 1])) &&
+                 std::isxdigit(static_cast<unsigned char>(in[i + 2]))) {
+        out += static_cast<char>(hex_value(in[i + 1]) * 16 +
+                                 hex_value(in[i + 2]));
+        i += 2;
+      } else {
+        out += in[i];
+      }
     }
+    return out;
+  }
+
+private:
+  /// Set by own_buffer(); shared so requests stay cheap to copy.
+  std::shared_ptr<const std::string> storage_;
 
-    return params;
+  static int hex_value(char c) {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    return std::tolower(static_cast<unsigned char>(c)) - 'a' + 10;
   }
 };
 
+namespace detail {
+
 /**
- * @brief HTTP request parser.
+ * @brief Position of the first `c` in [data, data + size), or `size`.
  *
- * Parses raw HTTP request data into an HttpRequest structure.
- * Handles header parsing, body extraction, and query string separation.
+ * Compares 16 bytes per step with SSE2 where available.
+ */
+inline size_t find_byte(const char *data, size_t size, char c) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i needle = _mm_set1_epi8(c);
+  for (; i + 16 <= size; i += 16) {
+    __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+    if (mask != 0)
+      return i + static_cast<size_t>(__builtin_ctz(mask));
+  }
+#endif
+  const void *hit = std::memchr(data + i, c, size - i);
+  return hit ? static_cast<size_t>(static_cast<const char *>(hit) - data)
+             : size;
+}
+
+} // namespace detail
+
+/**
+ * @brief Incremental, zero-copy HTTP/1.x request parser.
+ *
+ * parse() is called with the bytes received so far for the current
+ * request (a growing prefix of the same request, possibly moved to a
+ * new buffer) until it reports COMPLETE; the search for the end of the
+ * header block resumes where the previous call stopped instead of
+ * rescanning. The request it fills holds views into the last input, so
+ * nothing is copied or allocated, and oversized requests are rejected
+ * once the limit is crossed without buffering anything beyond it.
+ *
+ * reset() before parsing the next request.
  */
 class HttpRequestParser {
 public:
+  enum class Status {
+    INCOMPLETE,        ///< Need more bytes
+    COMPLETE,          ///< Request filled; consumed() bytes belong to it
+    BAD_REQUEST,       ///< Malformed request line or header, or an
+                       ///< ambiguous body length
+    HEADERS_TOO_LARGE, ///< Header block over the limit, or too many headers
+    BODY_TOO_LARGE,    ///< Content-Length over the limit
+    NOT_IMPLEMENTED,   ///< A Transfer-Encoding other than "identity"
+  };
+
+  HttpRequestParser(size_t max_header_bytes, size_t max_body_bytes)
+      : max_header_bytes_(max_header_bytes), max_body_bytes_(max_body_bytes) {}
+
   /**
-   * @brief Parse a raw HTTP request string.
-   *
-   * @param raw_request The complete HTTP request as a string
-   * @return Parsed HttpRequest object, or nullopt if parsing fails
+   * @brief Continue parsing the request at the start of `input`.
    */
-  [[nodiscard]] static std::optional<HttpRequest>
-  parse(const std::string &raw_request) {
-    HttpRequest request;
-
-    // Find header/body boundary
-    size_t header_end = raw_request.find("\r\n\r\n");
-    if (header_end == std::string::npos) {
-      return std::nullopt;
+  [[nodiscard]] Status parse(std::string_view input, HttpRequest &request) {
+    if (header_size_ == 0) {
+      Status status = find_header_end(input);
+      if (status != Status::COMPLETE)
+        return status;
+      status = parse_headers(input.substr(0, header_size_), request_);
+      if (status != Status::COMPLETE)
+        return status;
+      base_ = input.data();
     }
 
-    std::string headers = raw_request.substr(0, header_end);
-    request.body = raw_request.substr(header_end + 4);
-
-    // Parse request line (method and path)
-    std::istringstream header_stream(headers);
-    std::string full_path;
-    header_stream >> request.method >> full_path;
-
-    // Separate path from query string
-    size_t query_pos = full_path.find('?');
-    if (query_pos != std::string::npos) {
-      request.path = full_path.substr(0, query_pos);
-      request.query_string = full_path.substr(query_pos + 1);
-    } else {
-      request.path = full_path;
+    if (input.size() < header_size_ + request_.content_length)
+      return Status::INCOMPLETE;
+    if (input.data() != base_) {
+      // The buffer moved while the body arrived; the header block was
+      // already validated, so this cannot fail
+      static_cast<void>(
+          parse_headers(input.substr(0, header_size_), request_));
+      base_ = input.data();
     }
+    request = request_;
+    request.raw = input.substr(0, consumed());
+    request.body = input.substr(header_size_, request_.content_length);
+    return Status::COMPLETE;
+  }
 
-    // Parse headers
-    std::string line;
-    std::getline(header_stream, line); // Skip first line (already parsed)
+  /// Bytes of input making up the request parse() completed.
+  [[nodiscard]] size_t consumed() const {
+    return header_size_ + request_.content_length;
+  }
+
+  void reset() {
+    scanned_ = 0;
+    header_size_ = 0;
+    base_ = nullptr;
+    request_ = HttpRequest{};
+  }
 
-    while (std::getline(header_stream, line)) {
-      // Convert to lowercase for case-insensitive matching
-      std::string lower_line = line;
-      std::transform(lower_line.begin(), lower_line.end(), lower_line.begin(),
-                     ::tolower);
+private:
+  size_t max_header_bytes_;
+  size_t max_body_bytes_;
+  size_t scanned_ = 0;     ///< Prefix searched for "\r\n\r\n" so far
+  size_t header_size_ = 0; ///< Including "\r\n\r\n"; 0 until found
+  const char *base_ = nullptr; ///< Input the views in request_ point into
+  HttpRequest request_;
 
-      if (lower_line.find("content-length:") != std::string::npos) {
-        size_t colon = line.find(':');
-        request.content_length = std::stoi(line.substr(colon + 1));
+  Status find_header_end(std::string_view input) {
+    const size_t limit = std::min(input.size(), max_header_bytes_);
+    // Resume a few bytes back in case the terminator straddles reads
+    size_t pos = scanned_ > 3 ? scanned_ - 3 : 0;
+    while (pos < limit) {
+      size_t lf = pos + detail::find_byte(input.data() + pos, limit - pos, '\n');
+      if (lf == limit)
+        break;
+      if (lf >= 3 && input.compare(lf - 3, 4, "\r\n\r\n") == 0) {
+        header_size_ = lf + 1;
+        return Status::COMPLETE;
       }
+      pos = lf + 1;
+    }
+    scanned_ = limit;
+    return input.size() >= max_header_bytes_ ? Status::HEADERS_TOO_LARGE
+                                             : Status::INCOMPLETE;
+  }
 
-      if (lower_line.find("content-type:") != std::string::npos &&
-          lower_line.find("application/msgpack") != std::string::npos) {
-        request.is_msgpack = true;
+  /**
+   * @brief Parse the header block `block` (ending in "\r\n\r\n") into
+   *        `request`.
+   *
+   * Bodies are only ever delimited by Content-Length: chunked (or any
+   * other) transfer codings are refused rather than misread, as are
+   * conflicting lengths, since either would let body bytes be taken
+   * for the next pipelined request.
+   */
+  Status parse_headers(std::string_view block, HttpRequest &request) const {
+    request = HttpRequest{};
+    size_t eol = detail::find_byte(block.data(), block.size(), '\n');
+    std::string_view line = HttpRequest::trim(block.substr(0, eol));
+    block.remove_prefix(eol + 1);
+
+    // Request line: METHOD SP target [SP version]
+    size_t sp = line.find(' ');
+    if (sp == 0 || sp == std::string_view::npos)
+      return Status::BAD_REQUEST;
+    request.method = line.substr(0, sp);
+    line = HttpRequest::trim(line.substr(sp + 1));
+    sp = line.find(' ');
+    std::string_view target = line.substr(0, sp);
+    if (target.empty())
+      return Status::BAD_REQUEST;
+    if (sp != std::string_view::npos) {
+      request.version = HttpRequest::trim(line.substr(sp + 1));
+    }
+    size_t query = target.find('?');
+    request.path = target.substr(0, query);
+    if (query != std::string_view::npos) {
+      request.query_string = target.substr(query + 1);
+    }
+
+    std::optional<std::string_view> connection;
+    std::optional<std::string_view> transfer_encoding;
+    bool has_length = false;
+    while (true) {
+      eol = detail::find_byte(block.data(), block.size(), '\n');
+      line = block.substr(0, eol);
+      if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+      if (line.empty())
+        break; // The blank line ending the block
+      block.remove_prefix(eol + 1);
+
+      size_t colon = line.find(':');
+      if (colon == 0 || colon == std::string_view::npos)
+        return Status::BAD_REQUEST;
+      if (request.header_count == HttpRequest::kMaxHeaders)
+        return Status::HEADERS_TOO_LARGE;
+      HttpHeader &header = request.headers[request.header_count++];
+      header.name = line.substr(0, colon);
+      header.value = HttpRequest::trim(line.substr(colon + 1));
+
+      if (HttpRequest::iequals(header.name, "content-length")) {
+        uint64_t length = 0;
+        const char *end = header.value.data() + header.value.size();
+        auto [ptr, ec] = std::from_chars(header.value.data(), end, length);
+        if (ec != std::errc() || ptr != end || header.value.empty())
+          return Status::BAD_REQUEST;
+        if (has_length && length != request.content_length)
+          return Status::BAD_REQUEST;
+        if (length > max_body_bytes_)
+          return Status::BODY_TOO_LARGE;
+        request.content_length = static_cast<size_t>(length);
+        has_length = true;
+      } else if (HttpRequest::iequals(header.name, "transfer-encoding")) {
+        if (transfer_encoding)
+          return Status::NOT_IMPLEMENTED;
+        transfer_encoding = header.value;
+      } else if (HttpRequest::iequals(header.name, "content-type")) {
+        request.is_msgpack =
+            HttpRequest::icontains(header.value, "application/msgpack");
+      } else if (HttpRequest::iequals(header.name, "connection")) {
+        connection = header.value;
       }
     }
 
-    return request;
+    if (transfer_encoding) {
+      if (has_length)
+        return Status::BAD_REQUEST;
+      if (!HttpRequest::iequals(*transfer_encoding, "identity"))
+        return Status::NOT_IMPLEMENTED;
+    }
+
+    std::string_view tokens = connection.value_or(std::string_view());
+    request.keep_alive = request.version == "HTTP/1.1"
+                             ? !HttpRequest::icontains(tokens, "close")
+                             : HttpRequest::icontains(tokens, "keep-alive");
+    return Status::COMPLETE;
   }
 };
 
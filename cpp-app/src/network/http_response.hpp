@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace kvdb {
+
+/**
+ * @brief Response body left where it is: a byte range of an open file
+ *        that is also mapped in memory, such as a value in the store's
+ *        base snapshot.
+ *
+ * Backends send it with sendfile(2) where they can, or else from the
+ * mapping; either way it is never copied into the output queue.
+ * `owner` keeps the descriptor and the mapping alive.
+ */
+struct FileRegion {
+  std::shared_ptr<const void> owner;
+  int fd;
+  uint64_t offset;        ///< Of `bytes` in the file
+  std::string_view bytes; ///< The range, mapped
+};
+
+/**
+ * @brief Source of a response body produced piece by piece, sent with
+ *        chunked transfer encoding.
+ *
+ * The connection asks for the next piece only once the previous ones
+ * have mostly been written, so a slow client holds back the producer
+ * instead of buffering the whole body. next() runs off the reactor
+ * thread, one call at a time, and may take a while.
+ */
+class IBodyStream {
+public:
+  virtual ~IBodyStream() = default;
+
+  /**
+   * @brief Produce the next piece of the body.
+   * @return The piece; empty once the body is complete
+   * @throws std::exception To abort the body (the client sees it
+   *         truncated and the connection is closed)
+   */
+  virtual std::string next() = 0;
+
+  /// Whether next() may block for long (e.g. on disk), so it should not
+  /// take up a worker thread.
+  [[nodiscard]] virtual bool blocking() const { return false; }
+};
+
+/**
+ * @brief HTTP response builder utility.
+ */
+struct HttpResponse {
+  int status_code = 200;
+  std::string body;
+  std::string content_type; ///< Omitted from the headers when empty
+  std::string content_encoding; ///< Omitted from the headers when empty
+  /// When set, the body is this file range and `body` is ignored.
+  std::shared_ptr<const FileRegion> file = nullptr;
+  /// When set, the body is streamed from here and `body` is ignored.
+  std::shared_ptr<IBodyStream> stream = nullptr;
+  /// Further headers, as (name, value).
+  std::vector<std::pair<std::string, std::string>> headers = {};
+
+  [[nodiscard]] size_t content_length() const {
+    return file ? file->bytes.size() : body.size();
+  }
+
+  /**
+   * @brief Serialize the status line and headers, up to and including
+   *        the blank line; the body is written separately.
+   * @param keep_alive Whether the connection stays open afterwards
+   */
+  [[nodiscard]] std::string head(bool keep_alive = false) const {
+    std::string out;
+    out.reserve(128 + content_type.size() + content_encoding.size());
+    out += "HTTP/1.1 ";
+    out += std::to_string(status_code);
+    out += ' ';
+    out += reason_phrase();
+    out += "\r\n";
+    if (!content_type.empty()) {
+      out += "Content-Type: ";
+      out += content_type;
+      out += "\r\n";
+    }
+    if (!content_encoding.empty()) {
+      out += "Content-Encoding: ";
+      out += content_encoding;
+      out += "\r\n";
+    }
+    for (const auto &[name, value] : headers) {
+      out += name;
+      out += ": ";
+      out += value;
+      out += "\r\n";
+    }
+    out += keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    if (stream) {
+      out += "Transfer-Encoding: chunked\r\n\r\n";
+      return out;
+    }
+    out += "Content-Length: ";
+    out += std::to_string(content_length());
+    out += "\r\n\r\n";
+    return out;
+  }
+
+  /**
+   * @brief Serialize the whole response (head and in-memory body).
+   */
+  [[nodiscard]] std::string to_string(bool keep_alive = false) const {
+    return head(keep_alive) + body;
+  }
+
+  [[nodiscard]] const char *reason_phrase() const {
+    switch (status_code) {
+    case 200:
+      return "OK";
+    case 400:
+      return "Bad Request";
+    case 404:
+      return "Not Found";
+    case 413:
+      return "Payload Too Large";
+    case 429:
+      return "Too Many Requests";
+    case 431:
+      return "Request Header Fields Too Large";
+    case 501:
+      return "Not Implemented";
+    case 503:
+      return "Service Unavailable";
+    default:
+      return status_code >= 500 ? "Internal Server Error" : "OK";
+    }
+  }
+
+  static HttpResponse ok(std::string body) {
+    return HttpResponse{200, std::move(body), {}, {}};
+  }
+
+  static HttpResponse msgpack(std::string body) {
+    return HttpResponse{200, std::move(body), "application/msgpack", {}};
+  }
+
+  static HttpResponse from_file(std::shared_ptr<const FileRegion> file,
+                                std::string content_type = {}) {
+    HttpResponse response{200, {}, std::move(content_type), {}};
+    response.file = std::move(file);
+    return response;
+  }
+
+  static HttpResponse from_stream(std::shared_ptr<IBodyStream> stream,
+                                  std::string content_type = {}) {
+    HttpResponse response{200, {}, std::move(content_type), {}};
+    response.stream = std::move(stream);
+    return response;
+  }
+
+  static HttpResponse bad_request(const std::string &body = "Bad Request") {
+    return HttpResponse{400, body, {}, {}};
+  }
+
+  static HttpResponse not_found(const std::string &body = "404 Not Found") {
+    return HttpResponse{404, body, {}, {}};
+  }
+
+  static HttpResponse error(const std::string &body = "Internal Server Error") {
+    return HttpResponse{500, body, {}, {}};
+  }
+
+  static HttpResponse
+  unavailable(const std::string &body = "Service Unavailable") {
+    return HttpResponse{503, body, {}, {}};
+  }
+
+  static HttpResponse
+  too_many_requests(const std::string &body = "Too Many Requests") {
+    return HttpResponse{429, body, {}, {}};
+  }
+};
+
+} // namespace kvdb
@@ -1,124 +1,99 @@
 #pragma once
 
-#include <functional>
-#include <iostream>
-#include <string>
+#include <algorithm>
+#include <csignal>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
-#include "../raft/raft_client.hpp"
-#include "../storage/kv_store.hpp"
-#include "http_request.hpp"
+#include "../logging/logger.hpp"
+#include "epoll_reactor.hpp"
+#include "http_reactor.hpp"
+#include "kv_http_handler.hpp"
+#include "thread_pool.hpp"
+#include "work_stealing_pool.hpp"
+#ifdef KVDB_HAVE_IO_URING
+#include "uring_reactor.hpp"
+#endif
 
 namespace kvdb {
 
 /**
- * @brief HTTP response builder utility.
- */
-struct HttpResponse {
-  int status_code = 200;
-  std::string body;
-
-  /**
-   * @brief Serialize the response to HTTP format.
-   */
-  [[nodiscard]] std::string to_string() const {
-    return "HTTP/1.1 " + std::to_string(status_code) +
-           " OK\r\n"
-           "Content-Length: " +
-           std::to_string(body.size()) + "\r\n\r\n" + body;
-  }
-
-  static HttpResponse ok(const std::string &body) {
-    return HttpResponse{200, body};
-  }
-
-  static HttpResponse not_found(const std::string &body = "404 Not Found") {
-    return HttpResponse{404, body};
-  }
-
-  static HttpResponse error(const std::string &body = "Internal Server Error") {
-    return HttpResponse{500, body};
-  }
-};
-
-/**
- * @brief HTTP request handler for the KV store API.
+ * @brief Non-blocking HTTP server: one reactor thread per core.
  *
- * Implements the business logic for handling HTTP requests.
- * Separates routing and request handling from socket management.
- */
-class KVHttpHandler {
-public:
-  /**
-   * @brief Construct the handler with dependencies.
-   * @param raft_client Client for proposing commands to Raft
-   * @param store Reference to the key-value store for reads
-   */
-  KVHttpHandler(IRaftClient &raft_client, const IKVStore &store)
-      : raft_client_(raft_client), store_(store) {}
-
-  /**
-   * @brief Handle an HTTP request and return a response.
-   */
-  [[nodiscard]] HttpResponse handle(const HttpRequest &request) const {
-    if (request.method == "POST" && request.path == "/insert-val" &&
-        request.is_msgpack) {
-      return handle_insert(request);
-    } else if (request.method == "GET" && request.path == "/get-val") {
-      return handle_get(request);
-    }
-    return HttpResponse::not_found();
-  }
-
-private:
-  IRaftClient &raft_client_;
-  const IKVStore &store_;
-
-  [[nodiscard]] HttpResponse handle_insert(const HttpRequest &request) const {
-    bool success = raft_client_.propose(request.body);
-    return HttpResponse::ok(success ? "ok" : "error");
-  }
-
-  [[nodiscard]] HttpResponse handle_get(const HttpRequest &request) const {
-    auto params = request.query_params();
-    auto it = params.find("key");
-    if (it == params.end()) {
-      return HttpResponse::ok("Key Not Found");
-    }
-
-    auto value = store_.get(it->second);
-    if (value) {
-      return HttpResponse::ok(*value);
-    }
-    return HttpResponse::ok("Key Not Found");
-  }
-};
-
-/**
- * @brief TCP socket-based HTTP server.
+ * Each reactor serves its own SO_REUSEPORT listening socket (the
+ * kernel spreads new connections across them), or one shared socket
+ * where SO_REUSEPORT is unavailable. Every connection is an
+ * HttpConnection state machine, so one thread serves any number of
+ * connections. Reactors are EpollReactor or, when built with it and
+ * the kernel supports it, UringReactor.
+ *
+ * Reactors only move bytes and parse. Requests are handled off the
+ * reactor, and responses are posted back to it:
+ *   - requests go to a WorkStealingPool, queued on the reactor's own
+ *     worker and stolen by idle ones;
+ *   - proposals are sent from there without waiting for them to commit
+ *     (they are answered from the Raft client's thread);
+ *   - reads that wait for a ReadIndex go to a separate ThreadPool.
+ * A burst of slow writes never holds up reads or other clients.
  *
- * Handles low-level socket operations and delegates request
- * handling to KVHttpHandler. Follows Single Responsibility Principle.
+ * Connections are kept alive and may pipeline requests (see
+ * HttpConnection). Each reactor files its connections in a TimerWheel
+ * to close the ones idle for longer than idle_timeout (see
+ * HttpReactor).
  */
 class HttpServer {
 public:
   /**
-   * @brief Construct the HTTP server.
+   * @brief Construct the HTTP server and bind its listening sockets.
    * @param port Port to listen on
    * @param handler Request handler for processing requests
+   * @param options Threading and limits
+   * @throws std::runtime_error If the port cannot be bound
    */
-  HttpServer(int port, KVHttpHandler handler)
-      : port_(port), handler_(std::move(handler)) {
-    setup_socket();
+  HttpServer(int port, KVHttpHandler handler, HttpServerOptions options = {})
+      : port_(port), handler_(std::move(handler)), options_(options),
+        workers_(options.workers ? options.workers : reactor_threads(options)),
+        blocking_(options.blocking_threads) {
+    handler_.set_executor(&workers_);
+    // sendfile(2) has no MSG_NOSIGNAL; a reset peer must be an error
+    // return, not a signal
+    std::signal(SIGPIPE, SIG_IGN);
+    [[maybe_unused]] const bool uring = use_io_uring();
+    const size_t threads = reactor_threads(options_);
+    int shared_fd = -1;
+    for (size_t i = 0; i < threads; ++i) {
+      int fd = shared_fd;
+      if (fd < 0) {
+        bool reuse_port = true;
+        fd = create_listener(&reuse_port);
+        listen_fds_.push_back(fd);
+        if (!reuse_port) {
+          shared_fd = fd;
+        }
+      }
+#ifdef KVDB_HAVE_IO_URING
+      if (uring) {
+        reactors_.push_back(std::make_unique<UringReactor>(
+            fd, i, handler_, workers_, blocking_, options_));
+        continue;
+      }
+#endif
+      reactors_.push_back(std::make_unique<EpollReactor>(
+          fd, shared_fd >= 0, i, handler_, workers_, blocking_, options_));
+    }
   }
 
   ~HttpServer() {
-    if (server_fd_ >= 0) {
-      close(server_fd_);
+    stop();
+    for (int fd : listen_fds_) {
+      close(fd);
     }
   }
 
@@ -127,84 +102,100 @@ public:
   HttpServer &operator=(const HttpServer &) = delete;
 
   /**
-   * @brief Start the server and run the accept loop.
+   * @brief Run the reactors; blocks until stop().
    *
-   * This method blocks indefinitely, accepting and handling connections.
+   * The calling thread runs the first reactor.
    */
   void run() {
-    std::cout << "[HTTP] Server listening on port " << port_ << std::endl;
+    KVDB_LOG(LogLevel::INFO, "HTTP",
+             "Server listening on port " << port_ << " (" << reactors_.size()
+                << " " << backend_name_ << " reactor threads)");
 
-    while (true) {
-      int client_socket = accept(server_fd_, nullptr, nullptr);
-      if (client_socket >= 0) {
-        handle_connection(client_socket);
-      }
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < reactors_.size(); ++i) {
+      threads.emplace_back([reactor = reactors_[i].get()] { reactor->run(); });
+    }
+    reactors_[0]->run();
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+
+  /// Make run() return. Thread-safe.
+  void stop() {
+    for (auto &reactor : reactors_) {
+      reactor->stop();
     }
   }
 
 private:
   int port_;
-  int server_fd_ = -1;
   KVHttpHandler handler_;
+  HttpServerOptions options_;
+  std::vector<int> listen_fds_;
+  const char *backend_name_ = "epoll";
+  std::vector<std::unique_ptr<HttpReactor>> reactors_;
+  // Declared after reactors_ so they drain (and stop posting to the
+  // reactors) before those are destroyed
+  WorkStealingPool workers_;
+  ThreadPool blocking_;
+
+  static size_t reactor_threads(const HttpServerOptions &options) {
+    return options.threads ? options.threads
+                           : std::max(1u, std::thread::hardware_concurrency());
+  }
 
-  static constexpr size_t kBufferSize = 4096;
+  /**
+   * @brief Whether to run UringReactors: asked for, compiled in and
+   *        supported by the running kernel (else epoll, with a note).
+   */
+  bool use_io_uring() {
+    if (options_.backend != HttpBackend::IO_URING)
+      return false;
+#ifdef KVDB_HAVE_IO_URING
+    if (UringReactor::supported()) {
+      backend_name_ = "io_uring";
+      return true;
+    }
+    KVDB_LOG(LogLevel::WARN, "HTTP",
+             "io_uring unavailable on this kernel, using epoll");
+#endif
+    return false;
+  }
 
-  void setup_socket() {
-    server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd_ < 0) {
+  /**
+   * @brief Create a non-blocking listening socket on port_.
+   * @param reuse_port In: ask for SO_REUSEPORT; out: whether it was set
+   */
+  int create_listener(bool *reuse_port) const {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
       throw std::runtime_error("Failed to create socket");
     }
 
     int opt = 1;
-    setsockopt(server_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (*reuse_port &&
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+      *reuse_port = false;
+    }
 
     sockaddr_in address{};
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
     address.sin_port = htons(port_);
 
-    if (bind(server_fd_, reinterpret_cast<sockaddr *>(&address),
-             sizeof(address)) < 0) {
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) <
+        0) {
+      close(fd);
       throw std::runtime_error("Failed to bind socket");
     }
 
-    if (listen(server_fd_, 10) < 0) {
+    if (listen(fd, options_.backlog) < 0) {
+      close(fd);
       throw std::runtime_error("Failed to listen on socket");
     }
-  }
-
-  void handle_connection(int client_socket) {
-    std::vector<char> buffer(kBufferSize);
-
-    int bytes_received = recv(client_socket, buffer.data(), buffer.size(), 0);
-    if (bytes_received <= 0) {
-      close(client_socket);
-      return;
-    }
-
-    std::string raw_request(buffer.data(), bytes_received);
-
-    auto parsed_request = HttpRequestParser::parse(raw_request);
-    if (!parsed_request) {
-      close(client_socket);
-      return;
-    }
-
-    // Read remaining body if needed
-    while (parsed_request->body.size() <
-           static_cast<size_t>(parsed_request->content_length)) {
-      int n = recv(client_socket, buffer.data(), buffer.size(), 0);
-      if (n <= 0)
-        break;
-      parsed_request->body.append(buffer.data(), n);
-    }
-
-    // Handle request and send response
-    HttpResponse response = handler_.handle(*parsed_request);
-    std::string response_str = response.to_string();
-    send(client_socket, response_str.c_str(), response_str.size(), 0);
-
-    close(client_socket);
+    return fd;
   }
 };
 
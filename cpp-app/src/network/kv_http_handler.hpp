@@ -0,0 +1,727 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <msgpack.hpp>
+
+#include "../commands/kv_command.hpp"
+#include "../metrics/metrics.hpp"
+#include "../raft/admission_controller.hpp"
+#include "../raft/proposal_batcher.hpp"
+#include "../raft/raft_client.hpp"
+#include "../raft/read_barrier.hpp"
+#include "../storage/compressed_kv_store.hpp"
+#include "../storage/expiring_kv_store.hpp"
+#include "../storage/kv_store.hpp"
+#include "http_request.hpp"
+#include "http_response.hpp"
+#include "kv_streams.hpp"
+#include "work_stealing_pool.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief HTTP request handler for the KV store API.
+ *
+ * Implements the business logic for handling HTTP requests.
+ * Separates routing and request handling from socket management.
+ */
+class KVHttpHandler {
+public:
+  /**
+   * @brief Construct the handler with dependencies.
+   * @param raft_client Client for proposing commands to Raft
+   * @param store Reference to the key-value store for reads
+   * @param compression The store's compression layer, if any, for
+   *                    GET /stats/compression
+   */
+  KVHttpHandler(IRaftClient &raft_client, const IKVStore &store,
+                const CompressedKVStore *compression = nullptr)
+      : raft_client_(raft_client), store_(store), compression_(compression),
+        commit_latency_(MetricsRegistry::instance().histogram(
+            "kvdb_write_commit_seconds",
+            "Time from proposing a write to learning whether it committed "
+            "(batching, the Propose RPC and the Raft commit).")),
+        committed_(MetricsRegistry::instance().counter(
+            "kvdb_writes_total", "Proposed writes, by outcome.",
+            "outcome=\"committed\"")),
+        failed_(MetricsRegistry::instance().counter(
+            "kvdb_writes_total", "Proposed writes, by outcome.",
+            "outcome=\"failed\"")) {}
+
+  /**
+   * @brief Report `executor`'s counters on GET /stats/executor.
+   */
+  void set_executor(const WorkStealingPool *executor) { executor_ = executor; }
+
+  /**
+   * @brief Serve ?consistency=lease and ?consistency=linearizable reads
+   *        through `barrier`; without one they are refused.
+   */
+  void set_read_barrier(ReadBarrier *barrier) { read_barrier_ = barrier; }
+
+  /**
+   * @brief Cap in-flight proposals with `admission` (see admit()).
+   */
+  void set_admission(AdmissionController *admission) {
+    admission_ = admission;
+  }
+
+  /**
+   * @brief Coalesce writes from concurrent requests into shared Raft
+   *        entries through `batcher` (see ProposalBatcher).
+   */
+  void set_batcher(ProposalBatcher *batcher) { batcher_ = batcher; }
+
+  /**
+   * @brief Serve GET /export from `store` (the same store as reads;
+   *        taking a snapshot needs non-const access).
+   */
+  void set_export_store(IKVStore *store) { export_store_ = store; }
+
+  /**
+   * @brief Take an admission slot for a proposal before it is queued,
+   *        so that an overloaded node refuses it at once.
+   *
+   * Must be called before a request is passed to handle() or
+   * handle_async(), which give the slot back.
+   *
+   * @return The response refusing the request (429 at the in-flight
+   *         limit, 503 while proposals are failing, both with
+   *         Retry-After), if it may not go ahead
+   */
+  [[nodiscard]] std::optional<HttpResponse>
+  admit(const HttpRequest &request) const {
+    if (!admission_ || !proposes(request))
+      return std::nullopt;
+    const auto verdict = admission_->try_admit();
+    if (verdict == AdmissionController::Verdict::ADMITTED)
+      return std::nullopt;
+    HttpResponse response =
+        verdict == AdmissionController::Verdict::OVERLOADED
+            ? HttpResponse::too_many_requests()
+            : HttpResponse::unavailable("Proposals are failing");
+    response.headers.emplace_back(
+        "Retry-After",
+        std::to_string(admission_->retry_after_seconds(verdict)));
+    return response;
+  }
+
+  /**
+   * @brief Whether handling the request blocks on Raft (a ReadIndex), so
+   *        it must not take up a worker thread.
+   *
+   * Proposals do not block in handle_async().
+   */
+  [[nodiscard]] bool waits_for_raft(const HttpRequest &request) const {
+    auto level = request.query_param("consistency");
+    return level && *level != "stale" && read_barrier_;
+  }
+
+  /**
+   * @brief Handle an HTTP request and return a response.
+   *
+   * Thread-safe.
+   */
+  [[nodiscard]] HttpResponse handle(const HttpRequest &request) const {
+    if (proposes(request)) {
+      std::promise<HttpResponse> response;
+      std::future<HttpResponse> committed = response.get_future();
+      handle_async(request, [&response](HttpResponse result) {
+        response.set_value(std::move(result));
+      });
+      return committed.get();
+    } else if (request.method == "POST" && request.path == "/mget" &&
+               request.is_msgpack) {
+      return handle_mget(request);
+    } else if (request.method == "GET" && request.path == "/get-val") {
+      return handle_get(request);
+    } else if (request.method == "GET" && request.path == "/scan") {
+      return handle_scan(request);
+    } else if (request.method == "GET" && request.path == "/prefix") {
+      return handle_prefix(request);
+    } else if (request.method == "GET" &&
+               request.path == "/stats/compression" && compression_) {
+      return handle_compression_stats();
+    } else if (request.method == "GET" && request.path == "/stats/executor" &&
+               executor_) {
+      return handle_executor_stats();
+    } else if (request.method == "GET" &&
+               request.path == "/stats/admission" && admission_) {
+      return handle_admission_stats();
+    } else if (request.method == "GET" &&
+               request.path == "/stats/batching" && batcher_) {
+      return handle_batching_stats();
+    } else if (request.method == "GET" && request.path == "/export" &&
+               export_store_) {
+      return handle_export();
+    } else if (request.method == "GET" && request.path == "/metrics") {
+      return handle_metrics();
+    }
+    return HttpResponse::not_found();
+  }
+
+  /**
+   * @brief Handle an HTTP request and pass the response to `respond`.
+   *
+   * Proposals go out with IRaftClient::propose_async() (through the
+   * batcher, if any), so the calling thread does not wait for them to
+   * commit: `respond` then runs on the Raft client's thread. Everything
+   * else is handle(), and responded to before returning.
+   *
+   * Thread-safe.
+   */
+  void handle_async(const HttpRequest &request,
+                    std::function<void(HttpResponse)> respond) const {
+    if (!proposes(request)) {
+      respond(handle(request));
+      return;
+    }
+    AdmissionSlot slot(admission_);
+    Proposal proposal;
+    if (auto rejected = make_proposal(request, proposal)) {
+      respond(std::move(*rejected));
+      return;
+    }
+    slot.propose(
+        [this, &proposal](IRaftClient::ProposeCallback done) {
+          if (proposal.commands.empty()) {
+            raft_client_.propose_async(std::move(proposal.payload),
+                                       std::move(done));
+          } else {
+            batcher_->submit(std::move(proposal.commands), std::move(done));
+          }
+        },
+        [this, start = MetricsClock::now(),
+         respond = std::move(respond)](bool committed) {
+          commit_latency_.record_since(start);
+          (committed ? committed_ : failed_).add();
+          respond(proposal_response(committed));
+        });
+  }
+
+private:
+  IRaftClient &raft_client_;
+  const IKVStore &store_;
+  const CompressedKVStore *compression_;
+  const WorkStealingPool *executor_ = nullptr;
+  ReadBarrier *read_barrier_ = nullptr;
+  AdmissionController *admission_ = nullptr;
+  ProposalBatcher *batcher_ = nullptr;
+  IKVStore *export_store_ = nullptr;
+  LatencyHistogram &commit_latency_;
+  Counter &committed_;
+  Counter &failed_;
+
+  static constexpr size_t kDefaultScanLimit = 100;
+  static constexpr size_t kMaxScanLimit = 10000;
+  /// Keys per /mget or /mset request.
+  static constexpr size_t kMaxBatchKeys = 10000;
+  /// Values still in the base snapshot are sent from the file from this
+  /// size on; smaller ones are cheaper to copy next to their headers.
+  static constexpr size_t kMinFileBody = 64 * 1024;
+
+  /**
+   * @brief The admission slot admit() took for one proposal.
+   *
+   * propose() reports the proposal's latency and outcome; a request
+   * refused before proposing gives the slot back on destruction.
+   */
+  class AdmissionSlot {
+  public:
+    explicit AdmissionSlot(AdmissionController *admission)
+        : admission_(admission) {}
+
+    ~AdmissionSlot() {
+      if (admission_) {
+        admission_->release();
+      }
+    }
+
+    // Non-copyable
+    AdmissionSlot(const AdmissionSlot &) = delete;
+    AdmissionSlot &operator=(const AdmissionSlot &) = delete;
+
+    /**
+     * @brief Propose with `send`, which passes its callback on to
+     *        IRaftClient::propose_async() or ProposalBatcher::submit();
+     *        `done` runs after the outcome is reported.
+     */
+    void propose(
+        const std::function<void(IRaftClient::ProposeCallback)> &send,
+        IRaftClient::ProposeCallback done) {
+      const auto start = AdmissionController::Clock::now();
+      send([admission = std::exchange(admission_, nullptr), start,
+            done = std::move(done)](bool committed) {
+        if (admission) {
+          admission->complete(AdmissionController::Clock::now() - start,
+                              committed);
+        }
+        done(committed);
+      });
+    }
+
+  private:
+    AdmissionController *admission_;
+  };
+
+  /// Requests that propose a command (the /insert-val and /mset routes).
+  [[nodiscard]] static bool proposes(const HttpRequest &request) {
+    return request.method == "POST" && request.is_msgpack &&
+           (request.path == "/insert-val" || request.path == "/mset");
+  }
+
+  static HttpResponse proposal_response(bool committed) {
+    return HttpResponse::ok(committed ? "ok" : "error");
+  }
+
+  /**
+   * @brief What a request proposes: valid SETs and DELETEs, each
+   *        encoded, for the batcher to coalesce with other requests'; or
+   *        (without a batcher, or for another command) one command
+   *        proposed on its own.
+   */
+  struct Proposal {
+    std::vector<std::string> commands;
+    std::string payload; ///< If `commands` is empty
+  };
+
+  /**
+   * @brief Build the command a proposing request proposes.
+   *
+   * POST /insert-val proposes its body. POST /mset takes a MsgPack array
+   * of SET and DELETE commands (each as for /insert-val), proposed as
+   * one BATCH entry (or in a coalesced one) and applied atomically.
+   *
+   * @return The response rejecting the request instead, if it is
+   *         malformed
+   */
+  [[nodiscard]] std::optional<HttpResponse>
+  make_proposal(const HttpRequest &request, Proposal &proposal) const {
+    if (request.path != "/mset") {
+      return make_insert(request.body, proposal);
+    }
+    std::vector<KVCommandView> commands;
+    bool valid = true;
+    try {
+      MsgPackReader reader(request.body);
+      const uint32_t count = reader.read_array();
+      if (count > kMaxBatchKeys) {
+        return HttpResponse::bad_request("Invalid batch");
+      }
+      commands.reserve(count);
+      for (uint32_t i = 0; i < count; ++i) {
+        commands.push_back(KVCommandView::read(reader));
+        const KVCommandView &command = commands.back();
+        valid = valid &&
+                (command.op == Operation::SET ||
+                 command.op == Operation::DELETE) &&
+                command.is_valid();
+      }
+    } catch (const std::exception &) {
+      return HttpResponse::bad_request("Invalid batch");
+    }
+    if (commands.empty() || !valid) {
+      return HttpResponse::bad_request("Invalid batch");
+    }
+    const uint64_t now_ms = unix_millis();
+    if (!batcher_) {
+      KVCommand batch;
+      batch.op = Operation::BATCH;
+      batch.commands.reserve(commands.size());
+      for (const auto &command : commands) {
+        batch.commands.push_back(KVCommand::from_view(command));
+      }
+      batch.resolve_ttl(now_ms);
+      proposal.payload = batch.to_msgpack();
+      return std::nullopt;
+    }
+    proposal.commands.reserve(commands.size());
+    for (const auto &command : commands) {
+      proposal.commands.push_back(resolved_command(command, now_ms));
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief POST /mget
+   *
+   * Body: a MsgPack array of keys. Returns a MsgPack array with each
+   * key's value, or nil if it is missing, in the same order.
+   */
+  [[nodiscard]] HttpResponse handle_mget(const HttpRequest &request) const {
+    std::vector<std::string> keys;
+    try {
+      msgpack::object_handle handle =
+          msgpack::unpack(request.body.data(), request.body.size());
+      handle.get().convert(keys);
+    } catch (const std::exception &) {
+      return HttpResponse::bad_request("Invalid key list");
+    }
+    if (keys.size() > kMaxBatchKeys) {
+      return HttpResponse::bad_request("Too many keys");
+    }
+    if (auto refused = await_consistency(request)) {
+      return std::move(*refused);
+    }
+
+    const auto values = store_.multi_get(keys);
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    packer.pack_array(static_cast<uint32_t>(values.size()));
+    for (const auto &value : values) {
+      if (value) {
+        packer.pack(*value);
+      } else {
+        packer.pack_nil();
+      }
+    }
+    return HttpResponse::msgpack(std::string(buffer.data(), buffer.size()));
+  }
+
+  /**
+   * @brief The proposal for an /insert-val body, with a SET's relative
+   *        ttl_ms turned into an absolute deadline, so every replica
+   *        applies the same one.
+   *
+   * Bodies that fail to parse or are not a valid command are refused
+   * here rather than proposed: every replica would reject them anyway.
+   * So is anything but a SET or DELETE: EXPIRE is the KeyExpirer's
+   * alone, and batches go through /mset.
+   *
+   * @return The response refusing the body, if it is invalid
+   */
+  [[nodiscard]] std::optional<HttpResponse>
+  make_insert(std::string_view body, Proposal &proposal) const {
+    KVCommandView cmd;
+    try {
+      cmd = KVCommandView::parse(body);
+    } catch (const std::exception &) {
+      return HttpResponse::bad_request("Invalid command");
+    }
+    if (!cmd.is_valid() ||
+        (cmd.op != Operation::SET && cmd.op != Operation::DELETE)) {
+      return HttpResponse::bad_request("Invalid command");
+    }
+    std::string command = resolved_command(cmd, unix_millis());
+    if (batcher_) {
+      proposal.commands.push_back(std::move(command));
+    } else {
+      proposal.payload = std::move(command);
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief A command as proposed: re-encoded with its relative ttl_ms
+   *        resolved, or (without one) exactly as the client sent it.
+   */
+  static std::string resolved_command(const KVCommandView &command,
+                                      uint64_t now_ms) {
+    if (command.ttl_ms == 0)
+      return std::string(command.encoded);
+    KVCommand owned = KVCommand::from_view(command);
+    return owned.resolve_ttl(now_ms) ? owned.to_msgpack()
+                                     : std::string(command.encoded);
+  }
+
+  [[nodiscard]] HttpResponse handle_get(const HttpRequest &request) const {
+    auto key = request.query_param("key");
+    if (!key) {
+      return HttpResponse::ok("Key Not Found");
+    }
+    if (auto refused = await_consistency(request)) {
+      return std::move(*refused);
+    }
+
+    // Values stored compressed go out as they are to clients that can
+    // decode them
+    auto value = store_.get_encoded(*key, [&](std::string_view coding) {
+      return request.accepts_encoding(coding);
+    });
+    if (!value) {
+      return HttpResponse::ok("Key Not Found");
+    }
+    HttpResponse response;
+    if (!value->file) {
+      response = HttpResponse::ok(std::move(value->body));
+    } else if (value->mapped.size() < kMinFileBody) {
+      response = HttpResponse::ok(std::string(value->mapped));
+    } else {
+      // Still in the base snapshot: sent from the file, not copied
+      const MappedSnapshot &file = *value->file;
+      response = HttpResponse::from_file(std::make_shared<FileRegion>(
+          FileRegion{value->file, file.fd(),
+                     file.offset_of(value->mapped.data()), value->mapped}));
+    }
+    response.content_encoding = std::move(value->content_encoding);
+    return response;
+  }
+
+  /**
+   * @brief GET /stats/compression
+   *
+   * Returns the compression counters as a MsgPack map, for tuning
+   * --compression-min-bytes.
+   */
+  [[nodiscard]] HttpResponse handle_compression_stats() const {
+    const CompressionStats stats = compression_->compression_stats();
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    packer.pack_map(9);
+    packer.pack(std::string("min_bytes"));
+    packer.pack(static_cast<uint64_t>(
+        compression_->compression_options().min_bytes));
+    packer.pack(std::string("candidates"));
+    packer.pack(stats.candidates);
+    packer.pack(std::string("compressed"));
+    packer.pack(stats.compressed);
+    packer.pack(std::string("input_bytes"));
+    packer.pack(stats.input_bytes);
+    packer.pack(std::string("output_bytes"));
+    packer.pack(stats.output_bytes);
+    packer.pack(std::string("ratio"));
+    packer.pack(stats.ratio());
+    packer.pack(std::string("compress_ns"));
+    packer.pack(stats.compress_ns);
+    packer.pack(std::string("decompressed"));
+    packer.pack(stats.decompressed);
+    packer.pack(std::string("decompress_ns"));
+    packer.pack(stats.decompress_ns);
+    return HttpResponse::msgpack(std::string(buffer.data(), buffer.size()));
+  }
+
+  /**
+   * @brief GET /stats/executor
+   *
+   * Returns the request workers' counters as a MsgPack map.
+   */
+  [[nodiscard]] HttpResponse handle_executor_stats() const {
+    const WorkStealingStats stats = executor_->stats();
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    packer.pack_map(4);
+    packer.pack(std::string("workers"));
+    packer.pack(static_cast<uint64_t>(stats.queue_depths.size()));
+    packer.pack(std::string("executed"));
+    packer.pack(stats.executed);
+    packer.pack(std::string("stolen"));
+    packer.pack(stats.stolen);
+    packer.pack(std::string("queue_depths"));
+    packer.pack_array(static_cast<uint32_t>(stats.queue_depths.size()));
+    for (size_t depth : stats.queue_depths) {
+      packer.pack(static_cast<uint64_t>(depth));
+    }
+    return HttpResponse::msgpack(std::string(buffer.data(), buffer.size()));
+  }
+
+  /**
+   * @brief GET /stats/admission
+   *
+   * Returns the proposal admission counters as a MsgPack map.
+   */
+  [[nodiscard]] HttpResponse handle_admission_stats() const {
+    const AdmissionStats stats = admission_->stats();
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    packer.pack_map(6);
+    packer.pack(std::string("limit"));
+    packer.pack(stats.limit);
+    packer.pack(std::string("in_flight"));
+    packer.pack(stats.in_flight);
+    packer.pack(std::string("admitted"));
+    packer.pack(stats.admitted);
+    packer.pack(std::string("overloaded"));
+    packer.pack(stats.overloaded);
+    packer.pack(std::string("failing_fast"));
+    packer.pack(stats.failing_fast);
+    packer.pack(std::string("baseline_us"));
+    packer.pack(stats.baseline_us);
+    return HttpResponse::msgpack(std::string(buffer.data(), buffer.size()));
+  }
+
+  /**
+   * @brief GET /stats/batching
+   *
+   * Returns the proposal batcher's counters as a MsgPack map;
+   * `batch_sizes[i]` counts Raft entries of 2^i to 2^(i+1)-1 commands.
+   */
+  [[nodiscard]] HttpResponse handle_batching_stats() const {
+    const BatchingStats stats = batcher_->stats();
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    packer.pack_map(4);
+    packer.pack(std::string("batches"));
+    packer.pack(stats.batches);
+    packer.pack(std::string("submissions"));
+    packer.pack(stats.submissions);
+    packer.pack(std::string("commands"));
+    packer.pack(stats.commands);
+    packer.pack(std::string("batch_sizes"));
+    packer.pack_array(static_cast<uint32_t>(stats.batch_sizes.size()));
+    for (uint64_t count : stats.batch_sizes) {
+      packer.pack(count);
+    }
+    return HttpResponse::msgpack(std::string(buffer.data(), buffer.size()));
+  }
+
+  /**
+   * @brief GET /metrics
+   *
+   * Returns every registered metric in the Prometheus text format.
+   */
+  static HttpResponse handle_metrics() {
+    return HttpResponse{200, MetricsRegistry::instance().render(),
+                        "text/plain; version=0.0.4", {}};
+  }
+
+  /**
+   * @brief GET /scan?start=<key>&end=<key>&limit=<n>
+   *
+   * Returns keys in [start, end) as a MsgPack array of [key, value]
+   * (see serve_range()).
+   */
+  [[nodiscard]] HttpResponse handle_scan(const HttpRequest &request) const {
+    return serve_range(request, request.query_param("start").value_or(""),
+                       request.query_param("end").value_or(""));
+  }
+
+  /**
+   * @brief GET /prefix?prefix=<p>&limit=<n>
+   *
+   * Returns keys starting with the prefix as a MsgPack array of
+   * [key, value] (see serve_range()).
+   */
+  [[nodiscard]] HttpResponse handle_prefix(const HttpRequest &request) const {
+    std::string prefix = request.query_param("prefix").value_or("");
+    std::string end = prefix_upper_bound(prefix);
+    return serve_range(request, std::move(prefix), std::move(end));
+  }
+
+  /**
+   * @brief Serve the pairs in [start, end) for /scan and /prefix.
+   *
+   * Up to `limit` pairs go out in one MsgPack array; when the limit cut
+   * the range short, an X-Next-Cursor header carries the cursor that
+   * resumes it (`cursor=<c>`, which starts after the key it encodes).
+   *
+   * With `stream=true` the range is instead sent with chunked transfer
+   * encoding, as a sequence of MsgPack [key, value] arrays (up to
+   * `limit` pairs if given, else all of them), a page at a time as the
+   * client reads it. A broken-off stream resumes with the cursor of the
+   * last key received (see encode_cursor()).
+   */
+  [[nodiscard]] HttpResponse serve_range(const HttpRequest &request,
+                                         std::string start,
+                                         std::string end) const {
+    const auto stream = request.query_param("stream");
+    const bool streamed = stream && (*stream == "true" || *stream == "1");
+    auto limit = streamed ? parse_limit(request, 0, SIZE_MAX)
+                          : parse_limit(request, kDefaultScanLimit,
+                                        kMaxScanLimit);
+    if (!limit) {
+      return HttpResponse::bad_request("Invalid limit");
+    }
+    if (auto cursor = request.query_param("cursor")) {
+      auto resume = resume_after_cursor(*cursor);
+      if (!resume) {
+        return HttpResponse::bad_request("Invalid cursor");
+      }
+      start = std::max(start, *resume);
+    }
+    if (auto refused = await_consistency(request)) {
+      return std::move(*refused);
+    }
+
+    if (streamed) {
+      return HttpResponse::from_stream(
+          std::make_shared<ScanStream>(store_, std::move(start),
+                                       std::move(end), *limit),
+          "application/msgpack");
+    }
+    const auto pairs = store_.scan(start, end, *limit);
+    HttpResponse response = encode_pairs(pairs);
+    if (*limit > 0 && pairs.size() == *limit) {
+      response.headers.emplace_back("X-Next-Cursor",
+                                    encode_cursor(pairs.back().first));
+    }
+    return response;
+  }
+
+  /**
+   * @brief GET /export
+   *
+   * Streams a point-in-time copy of the whole store, as stored, in the
+   * Raft snapshot record format (see ExportStream), for backups.
+   */
+  [[nodiscard]] HttpResponse handle_export() const {
+    return HttpResponse::from_stream(
+        std::make_shared<ExportStream>(*export_store_),
+        "application/octet-stream");
+  }
+
+  /**
+   * @brief Wait until the read may be served at the request's
+   *        ?consistency= level (default "stale": right away).
+   * @return The response to send instead, if it may not
+   */
+  [[nodiscard]] std::optional<HttpResponse>
+  await_consistency(const HttpRequest &request) const {
+    ReadConsistency level;
+    try {
+      level = parse_read_consistency(
+          request.query_param("consistency").value_or("stale"));
+    } catch (const std::invalid_argument &) {
+      return HttpResponse::bad_request("Invalid consistency");
+    }
+    if (level == ReadConsistency::STALE)
+      return std::nullopt;
+    if (!read_barrier_ || !read_barrier_->wait(level)) {
+      // Only the leader can confirm it is up to date
+      return HttpResponse::unavailable("Not the leader");
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Parse ?limit=, capped at `max`.
+   * @return `fallback` if absent; nullopt if malformed
+   */
+  static std::optional<size_t> parse_limit(const HttpRequest &request,
+                                           size_t fallback, size_t max) {
+    auto value = request.query_param("limit");
+    if (!value) {
+      return fallback;
+    }
+    try {
+      size_t limit = std::stoul(*value);
+      return std::min(limit, max);
+    } catch (const std::exception &) {
+      return std::nullopt;
+    }
+  }
+
+  static HttpResponse encode_pairs(const std::vector<IKVStore::KVPair> &pairs) {
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    packer.pack_array(static_cast<uint32_t>(pairs.size()));
+    for (const auto &[key, value] : pairs) {
+      packer.pack_array(2);
+      packer.pack(key);
+      packer.pack(value);
+    }
+    return HttpResponse::msgpack(std::string(buffer.data(), buffer.size()));
+  }
+};
+
+} // namespace kvdb
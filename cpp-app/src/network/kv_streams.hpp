@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <msgpack.hpp>
+
+#include "../storage/kv_store.hpp"
+#include "../storage/snapshot_stream.hpp"
+#include "http_response.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Encode a pagination cursor: the hex digits of the last key a
+ *        client has received.
+ */
+inline std::string encode_cursor(std::string_view last_key) {
+  static constexpr char kDigits[] = "0123456789abcdef";
+  std::string cursor;
+  cursor.reserve(2 * last_key.size());
+  for (unsigned char c : last_key) {
+    cursor += kDigits[c >> 4];
+    cursor += kDigits[c & 0xf];
+  }
+  return cursor;
+}
+
+/**
+ * @brief Decode a cursor from encode_cursor() into the scan start that
+ *        resumes right after its key.
+ * @return nullopt if the cursor is malformed
+ */
+inline std::optional<std::string> resume_after_cursor(std::string_view cursor) {
+  auto digit = [](char c) -> int {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  };
+  if (cursor.size() % 2 != 0)
+    return std::nullopt;
+  std::string start;
+  start.reserve(cursor.size() / 2 + 1);
+  for (size_t i = 0; i < cursor.size(); i += 2) {
+    const int high = digit(cursor[i]);
+    const int low = digit(cursor[i + 1]);
+    if (high < 0 || low < 0)
+      return std::nullopt;
+    start += static_cast<char>(high << 4 | low);
+  }
+  // The smallest key after it
+  start += '\0';
+  return start;
+}
+
+/**
+ * @brief Streams a range scan as a sequence of MsgPack [key, value]
+ *        arrays, one page of the store at a time.
+ *
+ * Each next() reads up to kPagePairs pairs with IKVStore::scan(),
+ * resuming after the last key sent, so at most one page is held in
+ * memory however large the range is. Pages are read from the live
+ * store: a key written while the stream runs may or may not appear.
+ */
+class ScanStream : public IBodyStream {
+public:
+  /// Pairs read per next().
+  static constexpr size_t kPagePairs = 512;
+
+  /**
+   * @param start Inclusive lower bound ("" = first key)
+   * @param end Exclusive upper bound ("" = unbounded)
+   * @param limit Pairs to send at most (0 = no limit)
+   */
+  ScanStream(const IKVStore &store, std::string start, std::string end,
+             size_t limit)
+      : store_(store), next_(std::move(start)), end_(std::move(end)),
+        remaining_(limit), unlimited_(limit == 0) {}
+
+  std::string next() override {
+    if (done_)
+      return {};
+    const size_t want =
+        unlimited_ ? kPagePairs : std::min(kPagePairs, remaining_);
+    const auto page = store_.scan(next_, end_, want);
+    done_ = page.size() < want || (!unlimited_ && remaining_ == page.size());
+    if (page.empty())
+      return {};
+    if (!unlimited_) {
+      remaining_ -= page.size();
+    }
+    next_ = page.back().first;
+    next_ += '\0';
+
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    for (const auto &[key, value] : page) {
+      packer.pack_array(2);
+      packer.pack(key);
+      packer.pack(value);
+    }
+    return std::string(buffer.data(), buffer.size());
+  }
+
+private:
+  const IKVStore &store_;
+  std::string next_; ///< Where the next page starts
+  std::string end_;
+  size_t remaining_;
+  bool unlimited_;
+  bool done_ = false;
+};
+
+/**
+ * @brief Streams a point-in-time copy of the whole store in the Raft
+ *        snapshot record format (see SnapshotStreamEncoder), for backups.
+ *
+ * IKVSnapshot only pushes pairs to a visitor, so a producer thread
+ * takes the snapshot and encodes it into a queue of at most
+ * kMaxQueuedChunks chunks, which next() pops: the producer advances
+ * only as fast as the client downloads, and pairs are read straight
+ * from the snapshot without copying the store. Values are exported as
+ * stored (with their expiry deadline and compression).
+ */
+class ExportStream : public IBodyStream {
+public:
+  static constexpr size_t kChunkBytes = 256 * 1024;
+  static constexpr size_t kMaxQueuedChunks = 4;
+
+  explicit ExportStream(IKVStore &store) : store_(store) {}
+
+  ~ExportStream() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cancelled_ = true;
+    }
+    cv_.notify_all();
+    if (producer_.joinable()) {
+      producer_.join();
+    }
+  }
+
+  // Non-copyable
+  ExportStream(const ExportStream &) = delete;
+  ExportStream &operator=(const ExportStream &) = delete;
+
+  std::string next() override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!producer_.joinable()) {
+      producer_ = std::thread([this] { produce(); });
+    }
+    cv_.wait(lock, [this] { return !chunks_.empty() || finished_; });
+    if (!chunks_.empty()) {
+      std::string chunk = std::move(chunks_.front());
+      chunks_.pop_front();
+      cv_.notify_all();
+      return chunk;
+    }
+    if (!error_.empty()) {
+      throw std::runtime_error("Export failed: " + error_);
+    }
+    return {};
+  }
+
+  /// Reads the store's files as it iterates the snapshot.
+  [[nodiscard]] bool blocking() const override { return true; }
+
+private:
+  /// Thrown through IKVSnapshot::for_each() to stop a cancelled export.
+  struct Cancelled {};
+
+  IKVStore &store_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::string> chunks_;
+  bool finished_ = false;
+  bool cancelled_ = false;
+  std::string error_; ///< Why the producer stopped early, if it did
+  std::thread producer_;
+
+  void produce() {
+    std::string error;
+    try {
+      std::unique_ptr<IKVSnapshot> snapshot = store_.snapshot();
+      SnapshotStreamEncoder encoder(
+          [this](std::string_view data, bool, uint64_t) {
+            if (!data.empty()) {
+              push(std::string(data));
+            }
+          },
+          kChunkBytes);
+      snapshot->for_each([&encoder](std::string_view key,
+                                    std::string_view value) {
+        encoder.add(key, value);
+      });
+      encoder.finish();
+    } catch (const Cancelled &) {
+    } catch (const std::exception &e) {
+      error = e.what();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    error_ = std::move(error);
+    cv_.notify_all();
+  }
+
+  void push(std::string chunk) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] {
+      return chunks_.size() < kMaxQueuedChunks || cancelled_;
+    });
+    if (cancelled_)
+      throw Cancelled{};
+    chunks_.push_back(std::move(chunk));
+    cv_.notify_all();
+  }
+};
+
+} // namespace kvdb
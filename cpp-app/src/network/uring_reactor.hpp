@@ -0,0 +1,605 @@
+#pragma once
+
+#ifdef KVDB_HAVE_IO_URING
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <liburing.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include "../logging/logger.hpp"
+#include "http_reactor.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Reactor thread over one io_uring instance.
+ *
+ * Instead of readiness events and a syscall per read and write, the
+ * reactor keeps operations queued in its ring and reaps their
+ * completions, one io_uring_enter() per batch:
+ *   - a multishot accept on the listening socket;
+ *   - per connection, a multishot recv filling buffers the kernel
+ *     picks from a provided buffer ring (no buffer is pinned to an idle
+ *     connection), cancelled while HttpConnection::wants_input() is
+ *     false;
+ *   - one write in flight per connection: a sendmsg over
+ *     HttpConnection::gather_output(), file bodies included (sent
+ *     from their mapping); the write that drains a closing
+ *     connection has the socket's close linked to it (IOSQE_IO_LINK),
+ *     so no round trip through the reactor separates the two;
+ *   - a read on an eventfd for post() and stop(), and a timeout for
+ *     the idle tick.
+ *
+ * A connection's state outlives its socket until every operation on
+ * it has completed, since their completions name it by token.
+ * Needs Linux 6.0+ (see supported()).
+ */
+class UringReactor : public HttpReactor {
+public:
+  UringReactor(int listen_fd, size_t index, const KVHttpHandler &handler,
+               WorkStealingPool &workers, ThreadPool &blocking,
+               const HttpServerOptions &options)
+      : HttpReactor(index, handler, workers, blocking, options),
+        listen_fd_(listen_fd) {
+    io_uring_params params{};
+    // Completions are reaped only by this thread; no need to interrupt it
+    params.flags = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SUBMIT_ALL;
+    int ret = io_uring_queue_init_params(kRingEntries, &ring_, &params);
+    if (ret < 0) {
+      params = {};
+      ret = io_uring_queue_init_params(kRingEntries, &ring_, &params);
+    }
+    if (ret < 0) {
+      throw std::runtime_error("io_uring_queue_init failed");
+    }
+
+    buffer_ring_ = io_uring_setup_buf_ring(&ring_, kBufferCount, kBufferGroup,
+                                           0, &ret);
+    if (!buffer_ring_) {
+      io_uring_queue_exit(&ring_);
+      throw std::runtime_error("io_uring buffer ring setup failed");
+    }
+    buffers_.reset(new char[kBufferCount * kBufferSize]);
+    for (unsigned i = 0; i < kBufferCount; ++i) {
+      recycle_buffer(static_cast<uint16_t>(i));
+    }
+
+    wake_fd_ = eventfd(0, EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+      io_uring_free_buf_ring(&ring_, buffer_ring_, kBufferCount,
+                             kBufferGroup);
+      io_uring_queue_exit(&ring_);
+      throw std::runtime_error("eventfd failed");
+    }
+    tick_.tv_sec = 0;
+    tick_.tv_nsec = static_cast<long long>(kIdleTickMs) * 1000 * 1000;
+
+    arm_accept();
+    arm_wake();
+    arm_tick();
+  }
+
+  ~UringReactor() override {
+    await_unanswered();
+    // Tears down whatever is still queued
+    io_uring_free_buf_ring(&ring_, buffer_ring_, kBufferCount, kBufferGroup);
+    io_uring_queue_exit(&ring_);
+    for (auto &[token, connection] : connections_) {
+      // Unless a close is queued: its fd may be reused by now
+      if (connection->state != State::CLOSED && !connection->close_linked) {
+        close(connection->fd);
+      }
+    }
+    close(wake_fd_);
+  }
+
+  /**
+   * @brief Whether the running kernel has what this reactor uses:
+   *        Linux 6.0+ (multishot recv) and every opcode it submits.
+   */
+  static bool supported() {
+    utsname name{};
+    if (uname(&name) != 0)
+      return false;
+    int major = 0;
+    int minor = 0;
+    if (std::sscanf(name.release, "%d.%d", &major, &minor) != 2 ||
+        major < 6)
+      return false;
+
+    io_uring ring{};
+    if (io_uring_queue_init(8, &ring, 0) < 0)
+      return false;
+    bool ok = false;
+    if (io_uring_probe *probe = io_uring_get_probe_ring(&ring)) {
+      ok = true;
+      for (int op : {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG,
+                     IORING_OP_READ, IORING_OP_TIMEOUT, IORING_OP_ASYNC_CANCEL,
+                     IORING_OP_CLOSE}) {
+        ok = ok && io_uring_opcode_supported(probe, op);
+      }
+      io_uring_free_probe(probe);
+    }
+    if (ok) {
+      int ret = 0;
+      io_uring_buf_ring *buffers =
+          io_uring_setup_buf_ring(&ring, 1, kBufferGroup, 0, &ret);
+      ok = buffers != nullptr;
+      if (buffers) {
+        io_uring_free_buf_ring(&ring, buffers, 1, kBufferGroup);
+      }
+    }
+    io_uring_queue_exit(&ring);
+    return ok;
+  }
+
+  void run() override {
+    std::vector<Completion> completions;
+    while (!stopping_.load(std::memory_order_acquire)) {
+      int ret = io_uring_submit_and_wait(&ring_, 1);
+      if (ret < 0 && ret != -EINTR && ret != -EBUSY) {
+        KVDB_LOG(LogLevel::ERROR, "HTTP", "io_uring_enter failed: " << -ret);
+        return;
+      }
+
+      // Copied out first: handling them queues more work on the ring
+      unsigned head;
+      unsigned seen = 0;
+      io_uring_cqe *cqe;
+      io_uring_for_each_cqe(&ring_, head, cqe) {
+        completions.push_back(
+            Completion{io_uring_cqe_get_data64(cqe), cqe->res, cqe->flags});
+        ++seen;
+      }
+      io_uring_cq_advance(&ring_, seen);
+
+      for (const Completion &completion : completions) {
+        on_completion(completion);
+      }
+      completions.clear();
+    }
+  }
+
+  void stop() override {
+    stopping_.store(true, std::memory_order_release);
+    wake();
+  }
+
+private:
+  /// Socket lifecycle; see close_connection().
+  enum class State {
+    OPEN,
+    CLOSING, ///< Cancelling its operations
+    CLOSED,  ///< Close submitted
+  };
+
+  static constexpr size_t kMaxIov = 64;
+  /// Largest last write to link the close to. It is sent whole (see
+  /// start_send()), so the idle timer sees no progress until it is out.
+  static constexpr size_t kMaxLinkedSend = 256 * 1024;
+
+  struct Connection : HttpReactor::Connection {
+    using HttpReactor::Connection::Connection;
+
+    State state = State::OPEN;
+    unsigned pending_ops = 0; ///< Submitted, final completion not reaped
+    bool recv_armed = false;
+    bool recv_cancelling = false;
+    bool sending = false;
+    /// A close is linked to the sendmsg in flight (it may have run)
+    bool close_linked = false;
+    /// The buffers of the sendmsg in flight
+    msghdr message{};
+    iovec iov[kMaxIov];
+  };
+
+  /// What a completion was for: the low bits of its user_data.
+  enum class Op : uint64_t {
+    ACCEPT = 1,
+    WAKE,
+    TICK,
+    RECV,
+    SEND,
+    CANCEL,
+    CLOSE,
+  };
+
+  struct Completion {
+    uint64_t data;
+    int res;
+    uint32_t flags;
+  };
+
+  static constexpr unsigned kOpBits = 4;
+  static constexpr unsigned kRingEntries = 1024;
+  static constexpr unsigned kBufferCount = 256;
+  static constexpr size_t kBufferSize = 8 * 1024;
+  static constexpr int kBufferGroup = 0;
+
+  io_uring ring_{};
+  io_uring_buf_ring *buffer_ring_ = nullptr;
+  std::unique_ptr<char[]> buffers_;
+  int listen_fd_;
+  int wake_fd_ = -1;
+  uint64_t wake_value_ = 0;
+  __kernel_timespec tick_{};
+  std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections_;
+  uint64_t next_token_ = 1; ///< Token 0 is the reactor's own operations
+  std::atomic<bool> stopping_{false};
+  std::mutex mutex_;
+  std::vector<std::function<void()>> tasks_;
+
+  static uint64_t tag(uint64_t token, Op op) {
+    return token << kOpBits | static_cast<uint64_t>(op);
+  }
+
+  /// Next free submission slot, submitting queued ones if the SQ is full.
+  io_uring_sqe *next_sqe(uint64_t data) {
+    io_uring_sqe *sqe = io_uring_get_sqe(&ring_);
+    if (!sqe) {
+      io_uring_submit(&ring_);
+      sqe = io_uring_get_sqe(&ring_);
+      if (!sqe) {
+        throw std::runtime_error("io_uring submission queue full");
+      }
+    }
+    io_uring_sqe_set_data64(sqe, data);
+    return sqe;
+  }
+
+  void post(std::function<void()> task) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    wake();
+  }
+
+  void wake() {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = write(wake_fd_, &one, sizeof(one));
+  }
+
+  void arm_accept() {
+    io_uring_prep_multishot_accept(next_sqe(tag(0, Op::ACCEPT)), listen_fd_,
+                                   nullptr, nullptr, SOCK_CLOEXEC);
+  }
+
+  void arm_wake() {
+    io_uring_prep_read(next_sqe(tag(0, Op::WAKE)), wake_fd_, &wake_value_,
+                       sizeof(wake_value_), 0);
+  }
+
+  void arm_tick() {
+    io_uring_prep_timeout(next_sqe(tag(0, Op::TICK)), &tick_, 0, 0);
+  }
+
+  void recycle_buffer(uint16_t id) {
+    io_uring_buf_ring_add(buffer_ring_, buffers_.get() + id * kBufferSize,
+                          kBufferSize, id,
+                          io_uring_buf_ring_mask(kBufferCount), 0);
+    io_uring_buf_ring_advance(buffer_ring_, 1);
+  }
+
+  void on_completion(const Completion &completion) {
+    const uint64_t token = completion.data >> kOpBits;
+    const auto op = static_cast<Op>(completion.data & ((1u << kOpBits) - 1));
+    switch (op) {
+    case Op::ACCEPT:
+      on_accept(completion);
+      return;
+    case Op::WAKE:
+      on_wake();
+      return;
+    case Op::TICK:
+      close_idle();
+      arm_tick();
+      return;
+    default:
+      break;
+    }
+
+    auto it = connections_.find(token);
+    if (it == connections_.end()) {
+      // Never happens while state is kept until pending_ops drain, but
+      // a selected buffer must go back regardless
+      if (completion.flags & IORING_CQE_F_BUFFER) {
+        recycle_buffer(
+            static_cast<uint16_t>(completion.flags >> IORING_CQE_BUFFER_SHIFT));
+      }
+      return;
+    }
+    Connection &connection = *it->second;
+    switch (op) {
+    case Op::RECV:
+      on_recv(connection, completion);
+      break;
+    case Op::SEND:
+      on_send(connection, completion);
+      break;
+    case Op::CLOSE:
+      --connection.pending_ops;
+      if (connection.close_linked) {
+        on_linked_close(connection, completion);
+      }
+      break;
+    default: // CANCEL
+      --connection.pending_ops;
+      break;
+    }
+    release_if_done(connection);
+  }
+
+  void on_accept(const Completion &completion) {
+    if (!(completion.flags & IORING_CQE_F_MORE)) {
+      arm_accept(); // Multishot ended (e.g. on an error); start another
+    }
+    if (completion.res < 0) {
+      if (completion.res != -ECONNABORTED && completion.res != -EINTR) {
+        KVDB_LOG(LogLevel::ERROR, "HTTP", "accept failed: " << -completion.res);
+      }
+      return;
+    }
+
+    const int fd = completion.res;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    const uint64_t token = next_token_++;
+    auto connection = std::make_unique<Connection>(token, fd, limits_);
+    track_idle(*connection);
+    Connection &added = *connection;
+    connections_.emplace(token, std::move(connection));
+    arm_recv(added);
+  }
+
+  void on_wake() {
+    std::vector<std::function<void()>> tasks;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks.swap(tasks_);
+    }
+    for (auto &task : tasks) {
+      task();
+    }
+    if (!stopping_.load(std::memory_order_acquire)) {
+      arm_wake();
+    }
+  }
+
+  void arm_recv(Connection &connection) {
+    io_uring_sqe *sqe = next_sqe(tag(connection.token, Op::RECV));
+    io_uring_prep_recv_multishot(sqe, connection.fd, nullptr, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    connection.recv_armed = true;
+    ++connection.pending_ops;
+  }
+
+  void on_recv(Connection &connection, const Completion &completion) {
+    if (completion.flags & IORING_CQE_F_BUFFER) {
+      const auto id =
+          static_cast<uint16_t>(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+      if (completion.res > 0 && connection.state == State::OPEN) {
+        connection.http.on_read(buffers_.get() + id * kBufferSize,
+                                static_cast<size_t>(completion.res));
+      }
+      recycle_buffer(id);
+    }
+    if (!(completion.flags & IORING_CQE_F_MORE)) {
+      connection.recv_armed = false;
+      connection.recv_cancelling = false;
+      --connection.pending_ops;
+    }
+    if (connection.state != State::OPEN)
+      return;
+
+    connection.last_active = now_tick();
+    if (completion.res == 0) {
+      connection.peer_closed = true;
+    } else if (completion.res < 0 && completion.res != -ENOBUFS &&
+               completion.res != -ECANCELED) {
+      close_connection(connection.token);
+      return;
+    }
+    // -ENOBUFS: the buffer ring ran dry; progress() re-arms now that
+    // this batch's buffers are back
+    progress(connection);
+  }
+
+  void on_send(Connection &connection, const Completion &completion) {
+    --connection.pending_ops;
+    connection.sending = false;
+    if (connection.state != State::OPEN)
+      return;
+    if (completion.res < 0) {
+      close_connection(connection.token);
+      return;
+    }
+    // Short writes just leave the rest for the next round
+    connection.http.consume_output(static_cast<size_t>(completion.res));
+    connection.last_active = now_tick();
+    if (!connection.close_linked) {
+      progress(connection);
+    }
+  }
+
+  /**
+   * @brief The close linked to a connection's last write completed:
+   *        the connection is done, or, if the write fell short and so
+   *        broke the link, carries on with the rest of its output.
+   */
+  void on_linked_close(Connection &connection, const Completion &completion) {
+    connection.close_linked = false;
+    if (completion.res != -ECANCELED) {
+      // Gone, and its fd number with it: nothing may name it again
+      if (connection.state == State::OPEN) {
+        forget_idle(connection);
+      }
+      connection.state = State::CLOSED;
+    } else if (!connection.sending) {
+      progress(connection);
+    }
+  }
+
+  /**
+   * @brief Handle the complete requests buffered (in order, stopping
+   *        at one that waits for Raft), start writing what is pending,
+   *        and close the connection when it is done.
+   */
+  void progress(Connection &connection) {
+    // A linked close means the last write is out; wait for both to end
+    if (connection.state != State::OPEN || connection.close_linked)
+      return;
+    while (auto request = take_request(connection)) {
+      dispatch(connection.token, std::move(*request));
+    }
+
+    if (connection.http.has_pending_output()) {
+      if (!connection.sending) {
+        start_send(connection);
+      }
+    } else if (!connection.http.handling() &&
+               (connection.http.closing() || connection.peer_closed)) {
+      close_connection(connection.token);
+      return;
+    }
+
+    pull_stream(connection);
+    if (connection.http.wants_input() && !connection.peer_closed) {
+      if (!connection.recv_armed) {
+        arm_recv(connection);
+      }
+    } else if (connection.recv_armed && !connection.recv_cancelling) {
+      // Completes the recv with -ECANCELED; it is re-armed from there
+      io_uring_prep_cancel64(next_sqe(tag(connection.token, Op::CANCEL)),
+                             tag(connection.token, Op::RECV), 0);
+      connection.recv_cancelling = true;
+      ++connection.pending_ops;
+    }
+  }
+
+  /**
+   * @brief Queue the next write of pending output, with the close
+   *        linked to it if it is the connection's last.
+   *
+   * A linked write is sent with MSG_WAITALL: a short write does not
+   * break a link, so the close would cut the rest off. If it fails
+   * anyway the close completes with -ECANCELED and on_linked_close()
+   * carries on.
+   */
+  void start_send(Connection &connection) {
+    connection.message = {};
+    connection.message.msg_iov = connection.iov;
+    connection.message.msg_iovlen =
+        connection.http.gather_output(connection.iov, kMaxIov);
+    // The kernel reads these buffers after we return
+    connection.http.seal_output();
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < connection.message.msg_iovlen; ++i) {
+      bytes += connection.iov[i].iov_len;
+    }
+    const bool last = bytes == connection.http.pending_bytes() &&
+                      bytes <= kMaxLinkedSend &&
+                      !connection.http.handling() &&
+                      (connection.http.closing() || connection.peer_closed);
+    if (last && io_uring_sq_space_left(&ring_) < 2) {
+      // A link ends with its submission: keep the two in one
+      io_uring_submit(&ring_);
+    }
+    io_uring_sqe *sqe = next_sqe(tag(connection.token, Op::SEND));
+    io_uring_prep_sendmsg(sqe, connection.fd, &connection.message,
+                          last ? MSG_NOSIGNAL | MSG_WAITALL : MSG_NOSIGNAL);
+    ++connection.pending_ops;
+    connection.sending = true;
+    if (last) {
+      sqe->flags |= IOSQE_IO_LINK;
+      io_uring_prep_close(next_sqe(tag(connection.token, Op::CLOSE)),
+                          connection.fd);
+      ++connection.pending_ops;
+      connection.close_linked = true;
+    }
+  }
+
+  /// Deliver a response computed off the reactor thread.
+  void complete(uint64_t token, HttpResponse response) override {
+    auto it = connections_.find(token);
+    if (it == connections_.end() || it->second->state != State::OPEN)
+      return; // The client went away meanwhile
+    it->second->http.respond(std::move(response));
+    progress(*it->second);
+  }
+
+  void complete_chunk(uint64_t token, std::string chunk,
+                      bool failed) override {
+    auto it = connections_.find(token);
+    if (it == connections_.end() || it->second->state != State::OPEN)
+      return;
+    it->second->http.on_chunk(std::move(chunk), failed);
+    progress(*it->second);
+  }
+
+  /**
+   * @brief Cancel the connection's operations; the socket is closed
+   *        once they have all completed (see release_if_done()).
+   */
+  void close_connection(uint64_t token) override {
+    auto it = connections_.find(token);
+    if (it == connections_.end() || it->second->state != State::OPEN)
+      return;
+    Connection &connection = *it->second;
+    forget_idle(connection);
+    connection.state = State::CLOSING;
+    if (connection.close_linked) {
+      // The fd may be closed and reused already, so cancel by tag; a
+      // cancelled send takes its linked close with it
+      for (Op op : {Op::SEND, Op::RECV}) {
+        if (op == Op::SEND ? connection.sending : connection.recv_armed) {
+          io_uring_prep_cancel64(next_sqe(tag(token, Op::CANCEL)),
+                                 tag(token, op), 0);
+          ++connection.pending_ops;
+        }
+      }
+    } else if (connection.pending_ops > 0) {
+      io_uring_prep_cancel_fd(next_sqe(tag(token, Op::CANCEL)), connection.fd,
+                              IORING_ASYNC_CANCEL_ALL);
+      ++connection.pending_ops;
+    }
+    release_if_done(connection);
+  }
+
+  void release_if_done(Connection &connection) {
+    if (connection.pending_ops > 0)
+      return;
+    if (connection.state == State::CLOSING) {
+      io_uring_prep_close(next_sqe(tag(connection.token, Op::CLOSE)),
+                          connection.fd);
+      connection.state = State::CLOSED;
+      ++connection.pending_ops;
+    } else if (connection.state == State::CLOSED) {
+      connections_.erase(connection.token);
+    }
+  }
+};
+
+} // namespace kvdb
+
+#endif // KVDB_HAVE_IO_URING
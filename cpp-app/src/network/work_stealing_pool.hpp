@@ -0,0 +1,212 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace kvdb {
+
+/**
+ * @brief Counters exported by WorkStealingPool.
+ */
+struct WorkStealingStats {
+  uint64_t executed = 0; ///< Tasks run
+  uint64_t stolen = 0;   ///< Of those, taken from another worker's queue
+  std::vector<size_t> queue_depths; ///< Tasks waiting, per worker
+};
+
+/**
+ * @brief Worker threads with one task deque each; idle workers steal.
+ *
+ * submit() queues a task on the deque of the worker chosen by the
+ * caller (e.g. the reactor's own core), keeping a connection's work
+ * close to the thread that parsed it. A worker runs its own queue
+ * oldest-first and, when that is empty, takes the newest task from the
+ * first busy sibling, so a burst on one queue spreads over all cores.
+ *
+ * Each deque has its own mutex and is touched by its owner, by
+ * submitters and by the occasional thief; there is no global queue
+ * lock. Queued tasks are counted in an atomic that workers claim from.
+ * A worker that finds nothing polls it for a while (given more than
+ * one core) before parking on a condition variable, and submit() takes
+ * the sleep mutex and notifies only while a worker is parked, so a busy
+ * pool hands off tasks without a shared lock or a system call. Tasks
+ * still queued at destruction are run before the workers exit.
+ */
+class WorkStealingPool {
+public:
+  using Task = std::function<void()>;
+
+  explicit WorkStealingPool(size_t workers) {
+    if (workers == 0) {
+      workers = 1;
+    }
+    queues_.reserve(workers);
+    for (size_t i = 0; i < workers; ++i) {
+      queues_.push_back(std::make_unique<Queue>());
+    }
+    threads_.reserve(workers);
+    for (size_t i = 0; i < workers; ++i) {
+      threads_.emplace_back([this, i] { run(i); });
+    }
+  }
+
+  ~WorkStealingPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stopping_.store(true);
+    }
+    wake_.notify_all();
+    for (auto &thread : threads_) {
+      thread.join();
+    }
+  }
+
+  // Non-copyable
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  [[nodiscard]] size_t workers() const { return queues_.size(); }
+
+  /**
+   * @brief Queue `task` on worker `worker % workers()`. Thread-safe.
+   */
+  void submit(size_t worker, Task task) {
+    Queue &queue = *queues_[worker % queues_.size()];
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.push_back(std::move(task));
+    }
+    // seq_cst against park(): it sees the task or we see the sleeper
+    pending_.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+      // Passing through sleep_mutex_ means a worker that found nothing
+      // under it is waiting by now and gets the notification
+      {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+      }
+      wake_.notify_one();
+    }
+  }
+
+  [[nodiscard]] WorkStealingStats stats() const {
+    WorkStealingStats stats;
+    stats.executed = executed_.load(std::memory_order_relaxed);
+    stats.stolen = stolen_.load(std::memory_order_relaxed);
+    stats.queue_depths.reserve(queues_.size());
+    for (const auto &queue : queues_) {
+      std::lock_guard<std::mutex> lock(queue->mutex);
+      stats.queue_depths.push_back(queue->tasks.size());
+    }
+    return stats;
+  }
+
+private:
+  struct Queue {
+    mutable std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  /// How long an idle worker polls for a task before parking.
+  static constexpr std::chrono::microseconds kSpin{50};
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  std::atomic<size_t> pending_{0};  ///< Tasks queued and not yet claimed
+  std::atomic<size_t> sleepers_{0}; ///< Workers parked, or about to be
+  std::atomic<bool> stopping_{false};
+  std::atomic<uint64_t> executed_{0};
+  std::atomic<uint64_t> stolen_{0};
+  std::vector<std::thread> threads_;
+
+  void run(size_t self) {
+    while (true) {
+      if (!claim() && !spin() && !park())
+        return; // Stopping and drained
+      // A task is reserved for us; find it locally or on a sibling
+      Task task;
+      while (!pop_local(self, task) && !steal(self, task)) {
+        std::this_thread::yield();
+      }
+      task();
+      executed_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  /// Reserve one queued task, if there is any.
+  bool claim() {
+    size_t pending = pending_.load(std::memory_order_seq_cst);
+    while (pending > 0) {
+      if (pending_.compare_exchange_weak(pending, pending - 1,
+                                         std::memory_order_acquire))
+        return true;
+    }
+    return false;
+  }
+
+  /// Poll for a task for up to kSpin; polling only pays with a core to
+  /// spare for the submitters.
+  bool spin() {
+    static const bool multicore = std::thread::hardware_concurrency() > 1;
+    if (!multicore)
+      return false;
+    const auto until = std::chrono::steady_clock::now() + kSpin;
+    do {
+      if (claim())
+        return true;
+      std::this_thread::yield();
+    } while (std::chrono::steady_clock::now() < until);
+    return false;
+  }
+
+  /**
+   * @brief Sleep until a task can be claimed.
+   * @return false once the pool is stopping with nothing left to run
+   */
+  bool park() {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    bool claimed;
+    wake_.wait(lock, [this, &claimed] {
+      claimed = claim();
+      return claimed || stopping_.load();
+    });
+    sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+    return claimed;
+  }
+
+  bool pop_local(size_t self, Task &task) {
+    Queue &queue = *queues_[self];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      return false;
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    return true;
+  }
+
+  bool steal(size_t self, Task &task) {
+    for (size_t i = 1; i < queues_.size(); ++i) {
+      Queue &victim = *queues_[(self + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (victim.tasks.empty())
+        continue;
+      task = std::move(victim.tasks.back());
+      victim.tasks.pop_back();
+      stolen_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    return false;
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace kvdb {
+
+/**
+ * @brief Tunables for AdmissionController.
+ */
+struct AdmissionOptions {
+  /// Ceiling of the adaptive in-flight limit.
+  size_t max_in_flight = 256;
+  /// Floor of the adaptive in-flight limit.
+  size_t min_in_flight = 4;
+  /// Proposals slower than this multiple of the baseline latency
+  /// count as congestion.
+  double latency_tolerance = 2.0;
+  /// After a failed proposal (lost leadership, no quorum, timeout),
+  /// refuse new ones for this long.
+  std::chrono::milliseconds fail_fast{1000};
+};
+
+/**
+ * @brief Counters exported by AdmissionController.
+ */
+struct AdmissionStats {
+  uint64_t limit = 0;     ///< Current in-flight limit
+  uint64_t in_flight = 0; ///< Proposals admitted and not yet finished
+  uint64_t admitted = 0;
+  uint64_t overloaded = 0;  ///< Refused: at the in-flight limit
+  uint64_t failing_fast = 0; ///< Refused: after a failure
+  uint64_t baseline_us = 0; ///< Baseline commit latency
+};
+
+/**
+ * @brief Caps in-flight Raft proposals, adapting the cap to commit
+ *        latency, and fails fast while proposals are failing.
+ *
+ * The limit follows AIMD on latency: each proposal that commits within
+ * latency_tolerance times the baseline (the lowest latency of the last
+ * kBaselineWindow samples) while the limit is in use raises it by about
+ * one per limit's worth of proposals; a slower one cuts it by
+ * kDecrease, at most once per observed latency. Requests over the
+ * limit are refused at once instead of queueing behind a stalled
+ * sidecar.
+ *
+ * A failed proposal usually means the node is not (or no longer) the
+ * leader or has lost its quorum, so every proposal is refused for
+ * fail_fast afterwards; then a single probe is let through, and normal
+ * admission resumes once one commits.
+ *
+ * Thread-safe. Every admitted proposal must be finished with
+ * complete() or release().
+ */
+class AdmissionController {
+public:
+  enum class Verdict {
+    ADMITTED,    ///< Go ahead, then complete() or release()
+    OVERLOADED,  ///< At the in-flight limit
+    FAILING_FAST ///< Proposals are failing; retry later
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  explicit AdmissionController(AdmissionOptions options = {})
+      : options_(options) {
+    options_.min_in_flight =
+        std::min(options_.min_in_flight, options_.max_in_flight);
+    limit_ = static_cast<double>(std::clamp(
+        kInitialLimit, options_.min_in_flight, options_.max_in_flight));
+  }
+
+  // Non-copyable
+  AdmissionController(const AdmissionController &) = delete;
+  AdmissionController &operator=(const AdmissionController &) = delete;
+
+  /// Take an in-flight slot if one is free.
+  [[nodiscard]] Verdict try_admit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (probing_ || Clock::now() < failing_until_) {
+      ++failing_fast_;
+      return Verdict::FAILING_FAST;
+    }
+    if (failing_until_ != Clock::time_point{}) {
+      // The fail-fast window is over: one probe finds out if it is still
+      // failing
+      probing_ = true;
+    } else if (in_flight_ >= static_cast<size_t>(limit_)) {
+      ++overloaded_;
+      return Verdict::OVERLOADED;
+    }
+    ++in_flight_;
+    ++admitted_;
+    return Verdict::ADMITTED;
+  }
+
+  /**
+   * @brief Finish an admitted proposal.
+   * @param latency How long the proposal took
+   * @param committed Whether it was committed
+   */
+  void complete(Clock::duration latency, bool committed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t in_flight = in_flight_--;
+    const Clock::time_point now = Clock::now();
+    if (!committed) {
+      probing_ = false;
+      failing_until_ = now + options_.fail_fast;
+      decrease(now, latency);
+      return;
+    }
+    if (failing_until_ != Clock::time_point{} && now >= failing_until_) {
+      // A proposal committed after the fail-fast window: recovered
+      failing_until_ = {};
+      probing_ = false;
+    }
+    observe_baseline(latency);
+    if (latency > baseline_ * options_.latency_tolerance) {
+      decrease(now, latency);
+    } else if (2 * in_flight >= static_cast<size_t>(limit_)) {
+      // Only grow a limit that is actually in use
+      limit_ = std::min(limit_ + 1.0 / limit_,
+                        static_cast<double>(options_.max_in_flight));
+    }
+  }
+
+  /// Give back an admitted slot without a proposal going out.
+  void release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --in_flight_;
+    probing_ = false;
+  }
+
+  /**
+   * @brief Suggested wait, in whole seconds, before a refused request
+   *        is retried (for Retry-After).
+   */
+  [[nodiscard]] uint32_t retry_after_seconds(Verdict verdict) const {
+    if (verdict != Verdict::FAILING_FAST)
+      return 1;
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto left = std::chrono::ceil<std::chrono::seconds>(
+        failing_until_ - Clock::now());
+    return static_cast<uint32_t>(std::max<int64_t>(1, left.count()));
+  }
+
+  [[nodiscard]] AdmissionStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    AdmissionStats stats;
+    stats.limit = static_cast<uint64_t>(limit_);
+    stats.in_flight = in_flight_;
+    stats.admitted = admitted_;
+    stats.overloaded = overloaded_;
+    stats.failing_fast = failing_fast_;
+    if (baseline_ != Clock::duration::max()) {
+      stats.baseline_us = static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(baseline_)
+              .count());
+    }
+    return stats;
+  }
+
+private:
+  static constexpr size_t kInitialLimit = 32;
+  /// Latency samples over which the baseline is the minimum.
+  static constexpr size_t kBaselineWindow = 512;
+  static constexpr double kDecrease = 0.9;
+
+  AdmissionOptions options_;
+  mutable std::mutex mutex_;
+  double limit_ = 0;
+  size_t in_flight_ = 0;
+  Clock::duration baseline_ = Clock::duration::max();
+  Clock::duration window_min_ = Clock::duration::max();
+  size_t window_samples_ = 0;
+  Clock::time_point last_decrease_{};
+  Clock::time_point failing_until_{}; ///< Epoch while not failing
+  bool probing_ = false;
+  uint64_t admitted_ = 0;
+  uint64_t overloaded_ = 0;
+  uint64_t failing_fast_ = 0;
+
+  /// Track the lowest latency, re-measured every kBaselineWindow
+  /// samples so the baseline also follows the sidecar getting slower.
+  void observe_baseline(Clock::duration latency) {
+    window_min_ = std::min(window_min_, latency);
+    baseline_ = std::min(baseline_, latency);
+    if (++window_samples_ == kBaselineWindow) {
+      baseline_ = window_min_;
+      window_min_ = Clock::duration::max();
+      window_samples_ = 0;
+    }
+  }
+
+  void decrease(Clock::time_point now, Clock::duration latency) {
+    // The proposals in flight together all see the same congestion;
+    // react to it once
+    if (now - last_decrease_ < latency)
+      return;
+    last_decrease_ = now;
+    limit_ = std::max(limit_ * kDecrease,
+                      static_cast<double>(options_.min_in_flight));
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../ipc/shared_memory.hpp"
+#include "../ipc/shared_ring.hpp"
+#include "../logging/logger.hpp"
+#include "../storage/applied_index_kv_store.hpp"
+#include "state_machine.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Sizes of the shared-memory apply ring.
+ */
+struct ApplyRingOptions {
+  /// Data bytes of the request ring; a batch up to half of it fits.
+  size_t request_bytes = 16 * 1024 * 1024;
+};
+
+/**
+ * @brief Header of the apply ring file. Shared with the Go sidecar
+ *        (internal/shmring), like the rest of the layout.
+ */
+struct ApplyRingHeader {
+  uint64_t magic;
+  uint32_t version;
+  std::atomic<uint32_t> state; ///< An ApplyRingServer::State
+  uint32_t pid;                ///< Of the node serving the ring
+};
+
+/**
+ * @brief Serves ApplyBatch over a pair of SharedRings in a file the
+ *        sidecar maps too, in place of the gRPC stream.
+ *
+ * The sidecar writes each batch of committed entries, raw MsgPack as
+ * in the Raft log, into the request ring; a thread of this server
+ * applies it through StateMachineService::apply_batch(), decoding the
+ * entries where they lie in shared memory, and writes the per-entry
+ * results into the response ring, in place. A batch crosses between
+ * the processes with one copy in (by the sidecar) and no system call
+ * while both sides are busy; only a side that has run out of work
+ * sleeps on a futex. One batch is in flight at a time, as on the gRPC
+ * stream.
+ *
+ * File layout (native byte order; offsets in bytes):
+ *
+ *     0     ApplyRingHeader {u64 magic "KVDBRING", u32 version,
+ *           u32 state, u32 pid}
+ *     256   request ring control (SharedRingControl)
+ *     512   response ring control
+ *     4096  request ring data (request_bytes)
+ *     ...   response ring data (half as many bytes)
+ *
+ * Request record (kind 1): {u64 id, u64 index, u64 term, u32 count,
+ * u32 0}, then `count` entries {u32 length, bytes}. index and term are
+ * those of the batch's last entry, as in CommandBatch. Response record
+ * (kind 2): {u64 id, u32 count, u32 0}, then one byte per entry, 1 if
+ * it was applied. The sidecar picks the ids, so it can tell the answer
+ * to its batch from one meant for an earlier sidecar process.
+ *
+ * The ring is an optimisation: the sidecar falls back to the gRPC
+ * stream while the file is missing, if a batch is too large for it,
+ * or once the state is no longer READY or this process is gone. A
+ * request this server cannot parse closes the ring.
+ *
+ * Lifecycle: construct (creates the file), start(), then shutdown()
+ * (also the destructor, which removes the file).
+ */
+class ApplyRingServer {
+public:
+  enum class State : uint32_t { CREATING = 0, READY = 1, CLOSED = 2 };
+
+  static constexpr uint64_t kMagic = 0x474E49524244564BULL; // "KVDBRING"
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kBatchRecord = 1;
+  static constexpr uint32_t kResultsRecord = 2;
+
+  /**
+   * @brief Create the ring file.
+   * @param path Where, normally under /dev/shm
+   * @param state_machine Applies the batches
+   * @throws std::runtime_error If the file cannot be created
+   * @throws std::invalid_argument If request_bytes is too small
+   */
+  ApplyRingServer(const std::string &path, StateMachineService &state_machine,
+                  ApplyRingOptions options = {})
+      : request_bytes_(checked(options.request_bytes)),
+        response_bytes_(align(request_bytes_ / 2)),
+        file_(path, kRequestData + request_bytes_ + response_bytes_),
+        state_machine_(state_machine),
+        header_(*new (file_.data()) ApplyRingHeader{}),
+        requests_(SharedRing::create(file_.data() + kRequestControl,
+                                     request_bytes_,
+                                     kRequestData - kRequestControl)),
+        responses_(SharedRing::create(
+            file_.data() + kResponseControl, response_bytes_,
+            kRequestData + request_bytes_ - kResponseControl)) {
+    header_.magic = kMagic;
+    header_.version = kVersion;
+    header_.pid = static_cast<uint32_t>(::getpid());
+    header_.state.store(static_cast<uint32_t>(State::READY),
+                        std::memory_order_release);
+  }
+
+  ~ApplyRingServer() { shutdown(); }
+
+  // Non-copyable
+  ApplyRingServer(const ApplyRingServer &) = delete;
+  ApplyRingServer &operator=(const ApplyRingServer &) = delete;
+
+  /**
+   * @brief Start serving batches on a thread of its own.
+   */
+  void start() {
+    thread_ = std::thread([this] { run(); });
+    KVDB_LOG(LogLevel::INFO, "ApplyRing",
+             "Serving ApplyBatch on " << file_.path() << " ("
+                                      << request_bytes_ / 1024
+                                      << " KiB ring)");
+  }
+
+  /**
+   * @brief Close the ring and wait for the batch being applied, if any.
+   *
+   * A sidecar waiting for an answer sees the ring closed and resends
+   * its batch over gRPC.
+   */
+  void shutdown() {
+    if (stopping_.exchange(true))
+      return;
+    requests_.wake();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    close();
+  }
+
+private:
+  static constexpr size_t kRequestControl = 256;
+  static constexpr size_t kResponseControl = 512;
+  static constexpr size_t kRequestData = 4096;
+  static constexpr size_t kMinRequestBytes = 64 * 1024;
+  static constexpr size_t kBatchHeaderBytes = 32;
+  static constexpr size_t kResultsHeaderBytes = 16;
+  /// How often an idle server checks whether it is shutting down.
+  static constexpr std::chrono::milliseconds kPollInterval{100};
+
+  size_t request_bytes_;
+  size_t response_bytes_;
+  SharedMemoryFile file_;
+  StateMachineService &state_machine_;
+  ApplyRingHeader &header_;
+  SharedRing requests_;
+  SharedRing responses_;
+  std::vector<std::string_view> entries_; ///< Of the batch being applied
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+
+  /// Round down to a multiple of 8, as SharedRing wants.
+  static size_t align(size_t bytes) { return bytes & ~size_t{7}; }
+
+  static size_t checked(size_t request_bytes) {
+    if (request_bytes < kMinRequestBytes) {
+      throw std::invalid_argument("Apply ring must hold at least 64 KiB");
+    }
+    return align(request_bytes);
+  }
+
+  void run() {
+    try {
+      while (!stopping_.load(std::memory_order_acquire)) {
+        const std::optional<SharedRing::Record> record = requests_.peek();
+        if (!record) {
+          requests_.wait(kPollInterval);
+          continue;
+        }
+        if (record->kind != kBatchRecord) {
+          throw std::runtime_error("Unexpected record in the apply ring");
+        }
+        serve(record->payload);
+      }
+    } catch (const std::exception &e) {
+      KVDB_LOG(LogLevel::ERROR, "ApplyRing",
+               "Closing the apply ring: " << e.what());
+      close();
+    }
+  }
+
+  /// Apply one batch and answer it.
+  void serve(std::string_view batch) {
+    if (batch.size() < kBatchHeaderBytes) {
+      throw std::runtime_error("Truncated batch");
+    }
+    const uint64_t id = read<uint64_t>(batch, 0);
+    const LogPosition position{read<uint64_t>(batch, 8),
+                               read<uint64_t>(batch, 16)};
+    const uint32_t count = read<uint32_t>(batch, 24);
+
+    entries_.clear();
+    size_t at = kBatchHeaderBytes;
+    for (uint32_t i = 0; i < count; ++i) {
+      if (batch.size() - at < 4) {
+        throw std::runtime_error("Truncated batch");
+      }
+      const uint32_t length = read<uint32_t>(batch, at);
+      at += 4;
+      if (batch.size() - at < length) {
+        throw std::runtime_error("Truncated batch");
+      }
+      entries_.push_back(batch.substr(at, length));
+      at += length;
+    }
+
+    // The sidecar reads each answer before sending the next batch, so
+    // there is room unless it went away mid-batch
+    char *reply = nullptr;
+    while ((reply = responses_.try_reserve(
+                kResultsRecord, kResultsHeaderBytes + count)) == nullptr) {
+      if (stopping_.load(std::memory_order_acquire))
+        return;
+      std::this_thread::yield();
+    }
+    std::memcpy(reply, &id, sizeof(id));
+    std::memcpy(reply + 8, &count, sizeof(count));
+    std::memset(reply + 12, 0, 4);
+    state_machine_.apply_batch(
+        entries_, position,
+        reinterpret_cast<uint8_t *>(reply + kResultsHeaderBytes));
+    // Free the request before answering, so the next batch finds room
+    requests_.release();
+    responses_.publish();
+  }
+
+  void close() {
+    header_.state.store(static_cast<uint32_t>(State::CLOSED),
+                        std::memory_order_seq_cst);
+    responses_.wake();
+  }
+
+  template <typename T> static T read(std::string_view data, size_t at) {
+    T value;
+    std::memcpy(&value, data.data() + at, sizeof(T));
+    return value;
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+#include "../commands/kv_command.hpp"
+#include "../logging/logger.hpp"
+#include "../storage/expiring_kv_store.hpp"
+#include "raft_client.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Background thread that deletes expired keys through Raft.
+ *
+ * Every tick it collects due keys from the ExpiringKVStore and proposes
+ * them as EXPIRE commands of up to kMaxBatch keys each. Every node
+ * runs one, but only the leader's proposals are accepted, so a node
+ * that is not the leader skips the tick without collecting anything;
+ * its due keys stay in the index until the leader's EXPIREs remove
+ * them or it becomes the leader itself.
+ */
+class KeyExpirer {
+public:
+  /// Keys per EXPIRE entry.
+  static constexpr size_t kMaxBatch = 1024;
+
+  KeyExpirer(ExpiringKVStore &store, IRaftClient &raft_client,
+             ExpiryOptions options = {})
+      : store_(store), raft_client_(raft_client), options_(options),
+        thread_([this] { run(); }) {}
+
+  ~KeyExpirer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  // Non-copyable
+  KeyExpirer(const KeyExpirer &) = delete;
+  KeyExpirer &operator=(const KeyExpirer &) = delete;
+
+private:
+  ExpiringKVStore &store_;
+  IRaftClient &raft_client_;
+  ExpiryOptions options_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+  std::thread thread_;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+      lock.unlock();
+      if (raft_client_.is_leader()) {
+        expire_due();
+      }
+      lock.lock();
+      cv_.wait_for(lock, options_.tick, [this] { return stopping_; });
+    }
+  }
+
+  void expire_due() {
+    auto due = store_.collect_expired();
+    for (size_t begin = 0; begin < due.size(); begin += kMaxBatch) {
+      KVCommand cmd;
+      cmd.op = Operation::EXPIRE;
+      const size_t end = std::min(due.size(), begin + kMaxBatch);
+      cmd.expired_keys.assign(std::make_move_iterator(due.begin() + begin),
+                              std::make_move_iterator(due.begin() + end));
+      try {
+        if (!raft_client_.propose(cmd.to_msgpack())) {
+          // Lost leadership (or no quorum): collect_expired retries them
+          return;
+        }
+      } catch (const std::exception &e) {
+        KVDB_LOG(LogLevel::ERROR, "Expiry",
+                 "Failed to propose EXPIRE: " << e.what());
+        return;
+      }
+    }
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <msgpack.hpp>
+
+#include "../commands/kv_command.hpp"
+#include "raft_client.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Tunables for ProposalBatcher.
+ */
+struct BatchingOptions {
+  /// Most commands in one Raft entry.
+  size_t max_commands = 128;
+  /// Most command bytes in one Raft entry (one submission larger than
+  /// this still goes out, alone).
+  size_t max_bytes = 1024 * 1024;
+  /// How long a batch waits for more commands before it is proposed
+  /// (zero proposes as soon as a slot is free).
+  std::chrono::microseconds max_delay{0};
+  /// Batches proposed concurrently; commands arriving while all are out
+  /// wait for the next one.
+  size_t max_in_flight = 4;
+};
+
+/**
+ * @brief Counters exported by ProposalBatcher.
+ */
+struct BatchingStats {
+  static constexpr size_t kSizeBuckets = 16;
+
+  uint64_t batches = 0;     ///< Raft entries proposed
+  uint64_t submissions = 0; ///< Client writes they carried
+  uint64_t commands = 0;    ///< SETs and DELETEs they carried
+  /// Bucket i counts batches of [2^i, 2^(i+1)) commands (the last one
+  /// also the larger ones).
+  std::array<uint64_t, kSizeBuckets> batch_sizes{};
+};
+
+/**
+ * @brief Coalesces concurrent client writes into shared Raft entries.
+ *
+ * Each submission is one client write: SETs and DELETEs, each encoded
+ * on its own. A flusher thread proposes what has queued up as one BATCH
+ * command (or, for a lone command, that command) with propose_async(),
+ * and completes every submission in it with the entry's outcome. Like
+ * the WAL's group commit, batches grow with the load: at most
+ * max_in_flight are out at a time, and writes arriving meanwhile
+ * gather into the next one, which may also linger for max_delay.
+ *
+ * A BATCH is applied atomically, so the writes of one batch commit or
+ * fail together; a submission's own commands are never split across
+ * batches.
+ *
+ * Thread-safe.
+ */
+class ProposalBatcher {
+public:
+  ProposalBatcher(IRaftClient &raft_client, BatchingOptions options = {})
+      : raft_client_(raft_client), options_(options) {
+    options_.max_commands = std::max<size_t>(1, options_.max_commands);
+    options_.max_in_flight = std::max<size_t>(1, options_.max_in_flight);
+    flusher_ = std::thread([this] { flush_loop(); });
+  }
+
+  /// Proposes what is still queued and waits for every batch to finish.
+  ~ProposalBatcher() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    flusher_.join();
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return in_flight_ == 0; });
+  }
+
+  // Non-copyable
+  ProposalBatcher(const ProposalBatcher &) = delete;
+  ProposalBatcher &operator=(const ProposalBatcher &) = delete;
+
+  /**
+   * @brief Queue one write for the next batch.
+   * @param commands Its SETs and DELETEs, each MsgPack-encoded and
+   *                 valid (they fail the whole batch otherwise)
+   * @param done Runs with the outcome of the entry carrying them
+   */
+  void submit(std::vector<std::string> commands,
+              IRaftClient::ProposeCallback done) {
+    Submission submission;
+    for (const auto &command : commands) {
+      submission.bytes += command.size();
+    }
+    submission.commands = std::move(commands);
+    submission.done = std::move(done);
+    submission.queued_at = Clock::now();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queued_commands_ += submission.commands.size();
+      queued_bytes_ += submission.bytes;
+      queued_.push_back(std::move(submission));
+    }
+    cv_.notify_all();
+  }
+
+  [[nodiscard]] BatchingStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Submission {
+    std::vector<std::string> commands;
+    size_t bytes = 0;
+    IRaftClient::ProposeCallback done;
+    Clock::time_point queued_at;
+  };
+
+  IRaftClient &raft_client_;
+  BatchingOptions options_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Submission> queued_;
+  size_t queued_commands_ = 0;
+  size_t queued_bytes_ = 0;
+  size_t in_flight_ = 0; ///< Batches proposed and not finished
+  bool stopping_ = false;
+  BatchingStats stats_;
+  std::thread flusher_;
+
+  /// Whether the queue already fills a batch.
+  [[nodiscard]] bool full() const {
+    return queued_commands_ >= options_.max_commands ||
+           queued_bytes_ >= options_.max_bytes;
+  }
+
+  /// Body of flusher_: propose batches until stopped and drained.
+  void flush_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this] {
+        return (!queued_.empty() && in_flight_ < options_.max_in_flight) ||
+               (stopping_ && queued_.empty());
+      });
+      if (queued_.empty())
+        return; // Stopping
+      if (options_.max_delay.count() > 0 && !stopping_) {
+        // Linger for more writes unless the batch is already full
+        cv_.wait_until(lock, queued_.front().queued_at + options_.max_delay,
+                       [this] { return full() || stopping_; });
+      }
+      std::vector<Submission> batch = take_batch();
+      ++in_flight_;
+      lock.unlock();
+      propose(std::move(batch));
+      lock.lock();
+    }
+  }
+
+  /// Pop the submissions of the next batch (at least one).
+  std::vector<Submission> take_batch() {
+    std::vector<Submission> batch;
+    size_t commands = 0;
+    size_t bytes = 0;
+    while (!queued_.empty()) {
+      Submission &next = queued_.front();
+      if (!batch.empty() &&
+          (commands + next.commands.size() > options_.max_commands ||
+           bytes + next.bytes > options_.max_bytes))
+        break;
+      commands += next.commands.size();
+      bytes += next.bytes;
+      queued_commands_ -= next.commands.size();
+      queued_bytes_ -= next.bytes;
+      batch.push_back(std::move(next));
+      queued_.pop_front();
+    }
+
+    ++stats_.batches;
+    stats_.submissions += batch.size();
+    stats_.commands += commands;
+    size_t bucket = 0;
+    while (bucket + 1 < BatchingStats::kSizeBuckets &&
+           (size_t{2} << bucket) <= commands) {
+      ++bucket;
+    }
+    ++stats_.batch_sizes[bucket];
+    return batch;
+  }
+
+  void propose(std::vector<Submission> batch) {
+    std::vector<IRaftClient::ProposeCallback> waiters;
+    waiters.reserve(batch.size());
+    for (auto &submission : batch) {
+      waiters.push_back(std::move(submission.done));
+    }
+    raft_client_.propose_async(
+        encode(batch), [this, waiters = std::move(waiters)](bool committed) {
+          for (const auto &done : waiters) {
+            done(committed);
+          }
+          // Notified under the lock: the destructor may be waiting
+          std::lock_guard<std::mutex> lock(mutex_);
+          --in_flight_;
+          cv_.notify_all();
+        });
+  }
+
+  /**
+   * @brief The entry for a batch: {"op": BATCH, "commands": [...]}
+   *        around the already encoded commands, or a lone command as is.
+   */
+  static std::string encode(std::vector<Submission> &batch) {
+    size_t commands = 0;
+    for (const auto &submission : batch) {
+      commands += submission.commands.size();
+    }
+    if (commands == 1) {
+      return std::move(batch.front().commands.front());
+    }
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    packer.pack_map(2);
+    packer.pack(std::string("op"));
+    packer.pack(static_cast<uint8_t>(Operation::BATCH));
+    packer.pack(std::string("commands"));
+    packer.pack_array(static_cast<uint32_t>(commands));
+    for (const auto &submission : batch) {
+      for (const auto &command : submission.commands) {
+        buffer.write(command.data(), command.size());
+      }
+    }
+    return std::string(buffer.data(), buffer.size());
+  }
+};
+
+} // namespace kvdb
@@ -1,12 +1,24 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "consensus.grpc.pb.h"
 #include <grpcpp/grpcpp.h>
 
+#include "../logging/logger.hpp"
+#include "../metrics/metrics.hpp"
+
 namespace kvdb {
 
 /**
@@ -17,6 +29,9 @@ namespace kvdb {
  */
 class IRaftClient {
 public:
+  /// Receives whether an asynchronous proposal was committed.
+  using ProposeCallback = std::function<void(bool committed)>;
+
   virtual ~IRaftClient() = default;
 
   /**
@@ -26,6 +41,46 @@ public:
    * @return true if the proposal was accepted and committed
    */
   virtual bool propose(const std::string &payload) = 0;
+
+  /**
+   * @brief Propose a command without waiting for it to commit.
+   *
+   * `done` runs once, on a thread of the client's choosing, when the
+   * outcome is known; it should be quick and must not block. The default
+   * implementation calls propose() and so blocks the caller.
+   */
+  virtual void propose_async(std::string payload, ProposeCallback done) {
+    done(propose(payload));
+  }
+
+  /// propose_async() with a future instead of a callback.
+  std::future<bool> propose_future(std::string payload) {
+    auto promise = std::make_shared<std::promise<bool>>();
+    std::future<bool> committed = promise->get_future();
+    propose_async(std::move(payload), [promise](bool ok) {
+      promise->set_value(ok);
+    });
+    return committed;
+  }
+
+  /**
+   * @brief Wait until the local store has applied every entry committed
+   *        so far (Raft ReadIndex), so that reads served next are
+   *        linearizable.
+   *
+   * @return true once caught up; false if this node is not the leader or
+   *         leadership could not be confirmed
+   */
+  virtual bool read_index() { return false; }
+
+  /**
+   * @brief Whether this node is the leader, as far as it knows.
+   *
+   * A local check with no quorum round trip, so it may be briefly stale
+   * around an election. The default answers true, leaving it to the
+   * cluster to refuse a follower's proposals.
+   */
+  virtual bool is_leader() { return true; }
 };
 
 /**
@@ -33,6 +88,17 @@ public:
  *
  * Communicates with the Go sidecar to propose commands
  * to the Raft cluster for consensus.
+ *
+ * propose_async() uses the gRPC async API: calls are started on a
+ * completion queue drained by one thread of the client's own, which
+ * runs the callbacks, so any number of proposals can be in flight
+ * without a thread each. Calls are spread round-robin over one or more
+ * channels, each with its own HTTP/2 connection, so a large proposal
+ * does not hold up the others behind it on a single connection.
+ *
+ * Records each call's round trip in kvdb_raft_rpc_seconds{rpc=...}
+ * (for Propose, that includes the Raft commit) and counts those that
+ * fail in kvdb_raft_rpc_failures_total{rpc=...}.
  */
 class GrpcRaftClient : public IRaftClient {
 public:
@@ -41,16 +107,61 @@ public:
    * @param channel Shared gRPC channel to the Raft sidecar
    */
   explicit GrpcRaftClient(std::shared_ptr<grpc::Channel> channel)
-      : stub_(consensus::RaftNode::NewStub(channel)) {}
+      : GrpcRaftClient(
+            std::vector<std::shared_ptr<grpc::Channel>>{std::move(channel)}) {}
+
+  /**
+   * @brief Construct a Raft client spreading calls over `channels`.
+   * @throws std::invalid_argument If `channels` is empty
+   */
+  explicit GrpcRaftClient(
+      const std::vector<std::shared_ptr<grpc::Channel>> &channels)
+      : propose_latency_(rpc_latency("propose")),
+        propose_failures_(rpc_failures("propose")),
+        read_index_latency_(rpc_latency("read_index")),
+        read_index_failures_(rpc_failures("read_index")),
+        leadership_latency_(rpc_latency("leadership")),
+        leadership_failures_(rpc_failures("leadership")) {
+    if (channels.empty()) {
+      throw std::invalid_argument("GrpcRaftClient needs a channel");
+    }
+    for (const auto &channel : channels) {
+      stubs_.push_back(consensus::RaftNode::NewStub(channel));
+    }
+    completion_thread_ = std::thread([this] { drain_completions(); });
+  }
+
+  /**
+   * @brief Waits for the proposals still in flight (at most the 5-second
+   *        deadline) and their callbacks.
+   */
+  ~GrpcRaftClient() override {
+    completions_.Shutdown();
+    completion_thread_.join();
+  }
+
+  // Non-copyable
+  GrpcRaftClient(const GrpcRaftClient &) = delete;
+  GrpcRaftClient &operator=(const GrpcRaftClient &) = delete;
 
   /**
    * @brief Create a Raft client connected to the specified address.
-   * @param address The sidecar address (e.g., "localhost:50052")
+   * @param address The sidecar address (e.g., "localhost:50052", or
+   *                "unix:/path" for a Unix domain socket)
+   * @param channels Connections to open to it
    */
-  static std::unique_ptr<GrpcRaftClient> connect(const std::string &address) {
-    auto channel =
-        grpc::CreateChannel(address, grpc::InsecureChannelCredentials());
-    return std::make_unique<GrpcRaftClient>(channel);
+  static std::unique_ptr<GrpcRaftClient> connect(const std::string &address,
+                                                 size_t channels = 1) {
+    std::vector<std::shared_ptr<grpc::Channel>> opened;
+    for (size_t i = 0; i < std::max<size_t>(1, channels); ++i) {
+      // Channels with the same target and arguments share one
+      // connection; a local subchannel pool gives each its own
+      grpc::ChannelArguments args;
+      args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+      opened.push_back(grpc::CreateCustomChannel(
+          address, grpc::InsecureChannelCredentials(), args));
+    }
+    return std::make_unique<GrpcRaftClient>(opened);
   }
 
   /**
@@ -72,14 +183,141 @@ public:
     auto deadline = std::chrono::system_clock::now() + kDefaultTimeout;
     context.set_deadline(deadline);
 
-    grpc::Status status = stub_->Propose(&context, cmd, &reply);
-    return status.ok() && reply.success();
+    const auto start = MetricsClock::now();
+    grpc::Status status = next_stub().Propose(&context, cmd, &reply);
+    return finished(start, status.ok() && reply.success(), propose_latency_,
+                    propose_failures_);
+  }
+
+  /**
+   * @brief Start a Propose call; `done` runs on the completion thread.
+   *
+   * Same 5-second timeout as propose().
+   */
+  void propose_async(std::string payload, ProposeCallback done) override {
+    auto call = std::make_unique<AsyncPropose>();
+    call->request.set_data(std::move(payload));
+    call->done = std::move(done);
+    call->start = MetricsClock::now();
+    call->context.set_deadline(std::chrono::system_clock::now() +
+                               kDefaultTimeout);
+    call->reader = next_stub().PrepareAsyncPropose(&call->context,
+                                                   call->request,
+                                                   &completions_);
+    call->reader->StartCall();
+    // The completion queue owns the call until its tag comes back
+    AsyncPropose *tag = call.release();
+    tag->reader->Finish(&tag->reply, &tag->status, tag);
+  }
+
+  /**
+   * @brief Ask the sidecar for a ReadIndex round trip.
+   *
+   * Same 5-second timeout as propose().
+   */
+  bool read_index() override {
+    consensus::ReadIndexRequest request;
+    consensus::ReadIndexResponse reply;
+    grpc::ClientContext context;
+    context.set_deadline(std::chrono::system_clock::now() + kDefaultTimeout);
+
+    const auto start = MetricsClock::now();
+    grpc::Status status = next_stub().ReadIndex(&context, request, &reply);
+    return finished(start, status.ok() && reply.success(),
+                    read_index_latency_, read_index_failures_);
+  }
+
+  /**
+   * @brief Ask the sidecar whether its node is the leader.
+   *
+   * Same 5-second timeout as propose(); false if the call fails.
+   */
+  bool is_leader() override {
+    consensus::LeadershipRequest request;
+    consensus::LeadershipResponse reply;
+    grpc::ClientContext context;
+    context.set_deadline(std::chrono::system_clock::now() + kDefaultTimeout);
+
+    const auto start = MetricsClock::now();
+    grpc::Status status = next_stub().Leadership(&context, request, &reply);
+    return finished(start, status.ok(), leadership_latency_,
+                    leadership_failures_) &&
+           reply.leader();
   }
 
 private:
-  std::unique_ptr<consensus::RaftNode::Stub> stub_;
+  /// State of one propose_async() call, the tag of its completion.
+  struct AsyncPropose {
+    grpc::ClientContext context;
+    consensus::Command request;
+    consensus::ProposeResponse reply;
+    grpc::Status status;
+    std::unique_ptr<grpc::ClientAsyncResponseReader<consensus::ProposeResponse>>
+        reader;
+    ProposeCallback done;
+    MetricsClock::time_point start;
+  };
+
+  LatencyHistogram &propose_latency_;
+  Counter &propose_failures_;
+  LatencyHistogram &read_index_latency_;
+  Counter &read_index_failures_;
+  LatencyHistogram &leadership_latency_;
+  Counter &leadership_failures_;
+
+  std::vector<std::unique_ptr<consensus::RaftNode::Stub>> stubs_;
+  std::atomic<size_t> next_stub_{0};
+  grpc::CompletionQueue completions_;
+  std::thread completion_thread_;
 
   static constexpr std::chrono::seconds kDefaultTimeout{5};
+
+  consensus::RaftNode::Stub &next_stub() {
+    return *stubs_[next_stub_.fetch_add(1, std::memory_order_relaxed) %
+                   stubs_.size()];
+  }
+
+  static LatencyHistogram &rpc_latency(const std::string &rpc) {
+    return MetricsRegistry::instance().histogram(
+        "kvdb_raft_rpc_seconds", "Round trip of gRPC calls to the sidecar.",
+        "rpc=\"" + rpc + "\"");
+  }
+
+  static Counter &rpc_failures(const std::string &rpc) {
+    return MetricsRegistry::instance().counter(
+        "kvdb_raft_rpc_failures_total",
+        "gRPC calls to the sidecar that failed or were refused.",
+        "rpc=\"" + rpc + "\"");
+  }
+
+  /// Record a call that started at `start`; returns `succeeded`.
+  static bool finished(MetricsClock::time_point start, bool succeeded,
+                       LatencyHistogram &latency, Counter &failures) {
+    latency.record_since(start);
+    if (!succeeded) {
+      failures.add();
+    }
+    return succeeded;
+  }
+
+  /// Body of completion_thread_: finish calls until Shutdown().
+  void drain_completions() {
+    void *tag = nullptr;
+    bool ok = false;
+    while (completions_.Next(&tag, &ok)) {
+      std::unique_ptr<AsyncPropose> call(static_cast<AsyncPropose *>(tag));
+      const bool committed =
+          finished(call->start,
+                   ok && call->status.ok() && call->reply.success(),
+                   propose_latency_, propose_failures_);
+      try {
+        call->done(committed);
+      } catch (const std::exception &e) {
+        KVDB_LOG(LogLevel::ERROR, "Raft",
+                 "Proposal callback failed: " << e.what());
+      }
+    }
+  }
 };
 
 } // namespace kvdb
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "raft_client.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief How up to date a read must be.
+ */
+enum class ReadConsistency {
+  STALE,       ///< Whatever the local store holds (may lag on a follower)
+  LEASE,       ///< Leader-local, trusting a recent ReadIndex for a while
+  LINEARIZABLE ///< After a ReadIndex round trip started after the request
+};
+
+/**
+ * @brief Parse a ?consistency= value ("stale", "lease", "linearizable").
+ * @throws std::invalid_argument If unknown
+ */
+inline ReadConsistency parse_read_consistency(std::string_view name) {
+  if (name == "stale")
+    return ReadConsistency::STALE;
+  if (name == "lease")
+    return ReadConsistency::LEASE;
+  if (name == "linearizable")
+    return ReadConsistency::LINEARIZABLE;
+  throw std::invalid_argument("Unknown read consistency: " +
+                              std::string(name));
+}
+
+/**
+ * @brief Makes local reads linearizable with shared ReadIndex round trips.
+ *
+ * A linearizable read needs a ReadIndex issued after the read arrived.
+ * Only one round trip is in flight at a time: readers arriving while it
+ * is out wait for the next one, which a single one of them sends on
+ * behalf of all, so any number of concurrent reads costs at most two
+ * round trips of latency and one RPC per round.
+ *
+ * A successful round also grants a lease of `lease` from the moment it
+ * was sent, during which LEASE reads skip the round trip. This relies on
+ * no other node becoming leader within the lease, so it must stay below
+ * the sidecar's election timeout (and above clock drift); zero disables
+ * it.
+ *
+ * Thread-safe; wait() blocks, so call it off the reactor threads.
+ */
+class ReadBarrier {
+public:
+  ReadBarrier(IRaftClient &raft_client, std::chrono::milliseconds lease)
+      : raft_client_(raft_client), lease_(lease) {}
+
+  // Non-copyable
+  ReadBarrier(const ReadBarrier &) = delete;
+  ReadBarrier &operator=(const ReadBarrier &) = delete;
+
+  /**
+   * @brief Block until a read at `level` may be served from the local
+   *        store.
+   * @return false if it may not (not the leader, or no quorum)
+   */
+  [[nodiscard]] bool wait(ReadConsistency level) {
+    if (level == ReadConsistency::STALE)
+      return true;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (level == ReadConsistency::LEASE && Clock::now() < lease_until_)
+      return true;
+
+    // A round already in flight was sent before we arrived
+    const uint64_t needed = started_ + 1;
+    while (completed_ < needed) {
+      if (in_flight_) {
+        cv_.wait(lock);
+        continue;
+      }
+      in_flight_ = true;
+      const uint64_t round = ++started_;
+      const Clock::time_point sent = Clock::now();
+      lock.unlock();
+      bool ok = false;
+      try {
+        ok = raft_client_.read_index();
+      } catch (const std::exception &) {
+      }
+      lock.lock();
+      in_flight_ = false;
+      completed_ = round;
+      completed_ok_ = ok;
+      lease_until_ = ok ? sent + lease_ : Clock::time_point{};
+      cv_.notify_all();
+    }
+    // Rounds complete in order, so the latest one started after us too
+    return completed_ok_;
+  }
+
+  /// ReadIndex round trips sent so far.
+  [[nodiscard]] uint64_t round_trips() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return started_;
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  IRaftClient &raft_client_;
+  const Clock::duration lease_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  uint64_t started_ = 0;   ///< Rounds sent
+  uint64_t completed_ = 0; ///< Rounds answered (in order)
+  bool completed_ok_ = false; ///< Outcome of round completed_
+  bool in_flight_ = false;
+  Clock::time_point lease_until_{};
+};
+
+} // namespace kvdb
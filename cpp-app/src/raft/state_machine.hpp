@@ -1,14 +1,24 @@
 #pragma once
 
-#include <iostream>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include "consensus.grpc.pb.h"
 #include <grpcpp/grpcpp.h>
 
 #include "../commands/kv_command.hpp"
+#include "../logging/logger.hpp"
+#include "../metrics/metrics.hpp"
+#include "../storage/applied_index_kv_store.hpp"
 #include "../storage/kv_store.hpp"
+#include "../storage/snapshot.hpp"
+#include "../storage/snapshot_stream.hpp"
 
 namespace kvdb {
 
@@ -18,21 +28,61 @@ namespace kvdb {
  * This service receives committed log entries from the Raft
  * sidecar and applies them to the local key-value store.
  *
- * Dependency Injection: Takes an IKVStore reference rather than
- * creating its own storage, allowing for testing and flexibility.
+ * Dependency Injection: Takes a store reference rather than creating
+ * its own storage, allowing for testing and flexibility.
+ *
+ * ApplyBatch applies a stream of batches of entries, folding runs of
+ * SETs, DELETEs and BATCHes into one IKVStore::write_batch, so a whole
+ * batch takes the store's lock and waits for the WAL once.
+ *
+ * Entries (and batches) sent with their Raft position are recorded
+ * as applied together with their writes (see AppliedIndexKVStore);
+ * AppliedIndex reports the position, so a restarted sidecar skips the
+ * entries the store already holds.
+ *
+ * Also serves Raft snapshots: Snapshot streams a point-in-time view of
+ * the store, Restore replaces the store with a streamed snapshot (see
+ * snapshot_stream.hpp for the chunk format).
+ *
+ * Records how long each apply() and apply_batch() takes
+ * (kvdb_apply_seconds{rpc=...}, "apply_ring" for batches from the
+ * shared-memory ring) and, within them, each store write
+ * (kvdb_store_write_seconds), and counts the entries applied.
  */
 class StateMachineService final : public consensus::StateMachine::Service {
 public:
+  /// Apply() logs one in this many entries.
+  static constexpr uint64_t kApplyLogInterval = 1000;
+
   /**
    * @brief Construct the state machine service.
    * @param store Reference to the key-value store to apply changes to
+   * @param restore_path Scratch file for incoming snapshots; must be on
+   *                     the same filesystem as the store's data files
    */
-  explicit StateMachineService(IKVStore &store) : store_(store) {}
+  StateMachineService(AppliedIndexKVStore &store, std::string restore_path)
+      : store_(store), restore_path_(std::move(restore_path)),
+        apply_latency_(MetricsRegistry::instance().histogram(
+            "kvdb_apply_seconds", "Time to apply committed entries.",
+            "rpc=\"apply\"")),
+        apply_batch_latency_(MetricsRegistry::instance().histogram(
+            "kvdb_apply_seconds", "Time to apply committed entries.",
+            "rpc=\"apply_batch\"")),
+        apply_ring_latency_(MetricsRegistry::instance().histogram(
+            "kvdb_apply_seconds", "Time to apply committed entries.",
+            "rpc=\"apply_ring\"")),
+        store_write_latency_(MetricsRegistry::instance().histogram(
+            "kvdb_store_write_seconds",
+            "Time to write applied entries to the store, until durable.")),
+        applied_entries_(MetricsRegistry::instance().counter(
+            "kvdb_applied_entries_total",
+            "Committed entries received to apply.")) {}
 
   /**
    * @brief Apply a committed command from the Raft log.
    *
-   * Deserializes the MsgPack command and applies it to the store.
+   * Decodes the MsgPack command in place (see KVCommandView) and
+   * applies it to the store.
    *
    * @param context gRPC server context
    * @param request The command containing MsgPack-encoded data
@@ -42,95 +92,357 @@ public:
   grpc::Status Apply(grpc::ServerContext *context,
                      const consensus::Command *request,
                      consensus::ApplyResponse *reply) override {
+    return apply(*request, *reply);
+  }
+
+  /**
+   * @brief Apply one committed command: the body of Apply(), for
+   *        servers that take the call themselves (see
+   *        StateMachineServer).
+   */
+  grpc::Status apply(const consensus::Command &request,
+                     consensus::ApplyResponse &reply) {
+    ScopedLatency timed(apply_latency_);
+    applied_entries_.add();
     try {
-      // Deserialize the command from MsgPack
-      KVCommand cmd = KVCommand::from_msgpack(request->data().data(),
-                                              request->data().size());
+      // Decode the command in place, over the request's bytes
+      const KVCommandView cmd = KVCommandView::parse(request.data());
+      const LogPosition position{request.index(), request.term()};
 
-      std::cout << "[StateMachine] Applied: " << cmd.op << " " << cmd.key
-                << std::endl;
+      KVDB_LOG_EVERY_N(LogLevel::INFO, kApplyLogInterval, "StateMachine",
+                       "Applied: " << operation_name(cmd.op) << " "
+                                   << cmd.key);
 
       // Apply the operation to the store
-      switch (cmd.operation_type()) {
+      switch (cmd.op) {
       case Operation::SET:
-        store_.set(cmd.key, cmd.value);
-        break;
       case Operation::DELETE:
-        store_.remove(cmd.key);
+        if (!cmd.is_valid()) {
+          KVDB_LOG(LogLevel::ERROR, "StateMachine", "Invalid command");
+          reply.set_success(false);
+          return grpc::Status::OK;
+        }
+        write({to_batch_write(cmd)}, position);
+        break;
+      case Operation::EXPIRE:
+        cmd.for_each_expired_key(
+            [this](std::string_view key, uint64_t expires_at_ms) {
+              store_.expire(std::string(key), expires_at_ms);
+            });
+        if (position.index != 0) {
+          store_.write_batch({}, position);
+        }
+        break;
+      case Operation::BATCH: {
+        if (!cmd.is_valid()) {
+          KVDB_LOG(LogLevel::ERROR, "StateMachine", "Invalid batch");
+          reply.set_success(false);
+          return grpc::Status::OK;
+        }
+        std::vector<BatchWrite> writes;
+        writes.reserve(cmd.command_count);
+        append_batch_writes(cmd, writes);
+        write(std::move(writes), position);
         break;
+      }
       case Operation::UNKNOWN:
-        std::cerr << "[StateMachine] Unknown operation: " << cmd.op
-                  << std::endl;
-        reply->set_success(false);
+        KVDB_LOG(LogLevel::ERROR, "StateMachine", "Unknown operation");
+        reply.set_success(false);
         return grpc::Status::OK;
       }
 
-      reply->set_success(true);
+      reply.set_success(true);
       return grpc::Status::OK;
 
     } catch (const std::exception &e) {
-      std::cerr << "[StateMachine] Error: " << e.what() << std::endl;
-      reply->set_success(false);
+      KVDB_LOG(LogLevel::ERROR, "StateMachine", "Error: " << e.what());
+      reply.set_success(false);
       return grpc::Status(grpc::StatusCode::INTERNAL, e.what());
     }
   }
 
-private:
-  IKVStore &store_;
-};
-
-/**
- * @brief Wrapper class for managing the gRPC StateMachine server.
- *
- * Provides lifecycle management (start, stop, wait) for the
- * gRPC server hosting the StateMachine service.
- */
-class StateMachineServer {
-public:
   /**
-   * @brief Construct the server with a bound address and store.
-   * @param address The address to listen on (e.g., "0.0.0.0:50051")
-   * @param store Reference to the key-value store
+   * @brief Apply batches of committed commands from the Raft log.
+   *
+   * Each CommandBatch read is answered with one success flag per entry.
+   * Consecutive writes (SET, DELETE, BATCH) are applied together with a
+   * single IKVStore::write_batch, in log order; they succeed or fail
+   * together. An EXPIRE, which must see the writes before it, ends such
+   * a run. Entries that Apply() would reject fail on their own, changing
+   * nothing. The batch's position is recorded with its last run.
    */
-  StateMachineServer(const std::string &address, IKVStore &store)
-      : address_(address), service_(store) {}
+  grpc::Status ApplyBatch(
+      grpc::ServerContext *context,
+      grpc::ServerReaderWriter<consensus::ApplyBatchResponse,
+                               consensus::CommandBatch> *stream) override {
+    consensus::CommandBatch batch;
+    while (stream->Read(&batch)) {
+      consensus::ApplyBatchResponse reply;
+      apply_batch(batch, reply);
+      if (!stream->Write(reply))
+        break;
+    }
+    return grpc::Status::OK;
+  }
 
   /**
-   * @brief Start the gRPC server.
+   * @brief Stream a point-in-time snapshot of the store.
    *
-   * This is non-blocking. Call wait() to block until shutdown.
+   * An empty first chunk is sent as soon as the point in time is fixed,
+   * so the sidecar can let Raft resume applying entries while the rest
+   * streams.
+   *
+   * @param context gRPC server context
+   * @param request Empty request
+   * @param writer Stream of chunks; the last one has `last` set
+   * @return gRPC status
    */
-  void start() {
-    grpc::ServerBuilder builder;
-    builder.AddListeningPort(address_, grpc::InsecureServerCredentials());
-    builder.RegisterService(&service_);
+  grpc::Status Snapshot(grpc::ServerContext *context,
+                        const consensus::SnapshotRequest *request,
+                        grpc::ServerWriter<consensus::SnapshotChunk> *writer)
+      override {
+    try {
+      std::unique_ptr<IKVSnapshot> snapshot = store_.snapshot();
+
+      consensus::SnapshotChunk chunk;
+      auto send = [&](std::string_view data, bool last, uint64_t count) {
+        chunk.set_data(data.data(), data.size());
+        chunk.set_last(last);
+        chunk.set_entry_count(count);
+        if (!writer->Write(chunk)) {
+          throw std::runtime_error("Snapshot stream closed by the sidecar");
+        }
+      };
+      send({}, false, 0);
+
+      SnapshotStreamEncoder encoder(send);
+      snapshot->for_each([&encoder](std::string_view key,
+                                    std::string_view value) {
+        encoder.add(key, value);
+      });
+      encoder.finish();
+
+      KVDB_LOG(LogLevel::INFO, "StateMachine",
+               "Sent snapshot of " << encoder.entry_count() << " entries");
+      return grpc::Status::OK;
 
-    server_ = builder.BuildAndStart();
-    std::cout << "[gRPC] StateMachine listening on " << address_ << std::endl;
+    } catch (const std::exception &e) {
+      KVDB_LOG(LogLevel::ERROR, "StateMachine", "Snapshot error: " << e.what());
+      return grpc::Status(grpc::StatusCode::INTERNAL, e.what());
+    }
   }
 
   /**
-   * @brief Block until the server shuts down.
+   * @brief Replace the store's contents with a streamed snapshot.
+   *
+   * Chunks are spooled to the restore file, which the store then
+   * installs; the store is untouched unless the whole stream arrived.
+   *
+   * @param context gRPC server context
+   * @param reader Stream of chunks
+   * @param reply Response indicating success/failure
+   * @return gRPC status
    */
-  void wait() {
-    if (server_) {
-      server_->Wait();
+  grpc::Status Restore(grpc::ServerContext *context,
+                       grpc::ServerReader<consensus::SnapshotChunk> *reader,
+                       consensus::RestoreResponse *reply) override {
+    try {
+      SnapshotWriter file(restore_path_);
+      SnapshotStreamDecoder decoder(
+          [&file](std::string_view key, std::string_view value) {
+            file.add(key, value);
+          });
+
+      consensus::SnapshotChunk chunk;
+      bool complete = false;
+      while (!complete && reader->Read(&chunk)) {
+        decoder.feed(chunk.data());
+        if (chunk.last()) {
+          decoder.finish(chunk.entry_count());
+          complete = true;
+        }
+      }
+      if (!complete) {
+        throw std::runtime_error("Snapshot stream ended early");
+      }
+      file.finish();
+      store_.restore(restore_path_);
+
+      KVDB_LOG(LogLevel::INFO, "StateMachine",
+               "Restored snapshot of " << decoder.entry_count() << " entries");
+      reply->set_success(true);
+      return grpc::Status::OK;
+
+    } catch (const std::exception &e) {
+      KVDB_LOG(LogLevel::ERROR, "StateMachine", "Restore error: " << e.what());
+      reply->set_success(false);
+      reply->set_error(e.what());
+      return grpc::Status(grpc::StatusCode::INTERNAL, e.what());
     }
   }
 
   /**
-   * @brief Initiate graceful shutdown.
+   * @brief Report the position of the last entry the store holds.
+   *
+   * @param context gRPC server context
+   * @param request Empty request
+   * @param reply Index and term; 0 if none was recorded
+   * @return gRPC status
+   */
+  grpc::Status AppliedIndex(grpc::ServerContext *context,
+                            const consensus::AppliedIndexRequest *request,
+                            consensus::AppliedIndexResponse *reply) override {
+    const LogPosition applied = store_.applied();
+    reply->set_index(applied.index);
+    reply->set_term(applied.term);
+    return grpc::Status::OK;
+  }
+
+  /**
+   * @brief Apply the entries of one batch, recording each one's outcome
+   *        in `reply`: what ApplyBatch() does for each batch it reads.
    */
-  void shutdown() {
-    if (server_) {
-      server_->Shutdown();
-    }
+  void apply_batch(const consensus::CommandBatch &batch,
+                   consensus::ApplyBatchResponse &reply) {
+    ScopedLatency timed(apply_batch_latency_);
+    reply.mutable_success()->Resize(batch.data_size(), false);
+    apply_entries(
+        static_cast<size_t>(batch.data_size()),
+        [&batch](size_t i) -> std::string_view {
+          return batch.data(static_cast<int>(i));
+        },
+        LogPosition{batch.index(), batch.term()},
+        [&reply](size_t i, bool ok) {
+          reply.set_success(static_cast<int>(i), ok);
+        });
+  }
+
+  /**
+   * @brief Apply a batch whose entries are held elsewhere, as
+   *        apply_batch() does: for the shared-memory apply ring (see
+   *        ApplyRingServer), which decodes them where they lie.
+   * @param results Receives one flag per entry (1 if applied)
+   */
+  void apply_batch(const std::vector<std::string_view> &entries,
+                   LogPosition position, uint8_t *results) {
+    ScopedLatency timed(apply_ring_latency_);
+    std::memset(results, 0, entries.size());
+    apply_entries(
+        entries.size(), [&entries](size_t i) { return entries[i]; },
+        position, [results](size_t i, bool ok) { results[i] = ok; });
   }
 
 private:
-  std::string address_;
-  StateMachineService service_;
-  std::unique_ptr<grpc::Server> server_;
+  AppliedIndexKVStore &store_;
+  std::string restore_path_;
+  LatencyHistogram &apply_latency_;
+  LatencyHistogram &apply_batch_latency_;
+  LatencyHistogram &apply_ring_latency_;
+  LatencyHistogram &store_write_latency_;
+  Counter &applied_entries_;
+
+  /**
+   * @brief The body of both apply_batch()es: apply `count` entries,
+   *        `entry(i)` each, calling `set_result(i, true)` for each one
+   *        applied (results start out false).
+   */
+  template <typename Entry, typename SetResult>
+  void apply_entries(size_t count, Entry entry, LogPosition position,
+                     SetResult set_result) {
+    applied_entries_.add(count);
+    std::vector<BatchWrite> writes;
+    std::vector<size_t> pending; ///< Entries whose writes are in `writes`
+    // The last flush also records the batch's position, if any
+    auto flush = [&](bool last) {
+      const bool record = last && position.index != 0;
+      if (pending.empty() && !record)
+        return;
+      bool ok = true;
+      try {
+        write(std::move(writes), record ? position : LogPosition{});
+      } catch (const std::exception &e) {
+        KVDB_LOG(LogLevel::ERROR, "StateMachine", "Error: " << e.what());
+        ok = false;
+      }
+      for (size_t i : pending) {
+        set_result(i, ok);
+      }
+      writes.clear();
+      pending.clear();
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+      KVCommandView cmd;
+      try {
+        cmd = KVCommandView::parse(entry(i));
+      } catch (const std::exception &e) {
+        KVDB_LOG(LogLevel::ERROR, "StateMachine", "Error: " << e.what());
+        continue;
+      }
+      // Validated as in Apply(), so both paths agree on every replica
+      switch (cmd.op) {
+      case Operation::SET:
+      case Operation::DELETE:
+        // Kept out of the run: an empty key would fail every write in it
+        if (!cmd.is_valid()) {
+          KVDB_LOG(LogLevel::ERROR, "StateMachine", "Invalid command");
+          break;
+        }
+        writes.push_back(to_batch_write(cmd));
+        pending.push_back(i);
+        break;
+      case Operation::BATCH:
+        if (!cmd.is_valid()) {
+          KVDB_LOG(LogLevel::ERROR, "StateMachine", "Invalid batch");
+          break;
+        }
+        append_batch_writes(cmd, writes);
+        pending.push_back(i);
+        break;
+      case Operation::EXPIRE:
+        flush(false);
+        try {
+          cmd.for_each_expired_key(
+              [this](std::string_view key, uint64_t expires_at_ms) {
+                store_.expire(std::string(key), expires_at_ms);
+              });
+          set_result(i, true);
+        } catch (const std::exception &e) {
+          KVDB_LOG(LogLevel::ERROR, "StateMachine", "Error: " << e.what());
+        }
+        break;
+      case Operation::UNKNOWN:
+        KVDB_LOG(LogLevel::ERROR, "StateMachine", "Unknown operation");
+        break;
+      }
+    }
+    flush(true);
+  }
+
+  /// Apply writes, recording `position` with them unless it is none.
+  void write(std::vector<BatchWrite> writes, LogPosition position) {
+    ScopedLatency timed(store_write_latency_);
+    if (position.index != 0) {
+      store_.write_batch(std::move(writes), position);
+    } else {
+      store_.write_batch(std::move(writes));
+    }
+  }
+
+  /// A SET or DELETE as a store write: its key and value are copied
+  /// once, here.
+  static BatchWrite to_batch_write(const KVCommandView &command) {
+    return BatchWrite{std::string(command.key), std::string(command.value),
+                      command.expires_at_ms, command.op == Operation::DELETE};
+  }
+
+  /// Append the SETs and DELETEs of a (valid) BATCH to a store batch.
+  static void append_batch_writes(const KVCommandView &batch,
+                                  std::vector<BatchWrite> &writes) {
+    batch.for_each_command([&writes](const KVCommandView &command) {
+      writes.push_back(to_batch_write(command));
+    });
+  }
 };
 
 } // namespace kvdb
@@ -0,0 +1,358 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "consensus.grpc.pb.h"
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/resource_quota.h>
+
+#include "../logging/logger.hpp"
+#include "../storage/applied_index_kv_store.hpp"
+#include "state_machine.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Threading and limits of the StateMachine gRPC server.
+ */
+struct GrpcServerOptions {
+  /// Completion queues serving Apply and ApplyBatch.
+  size_t completion_queues = 1;
+  /// Threads polling each completion queue.
+  size_t pollers_per_queue = 1;
+  /// Pin poller thread i to core i (mod the number of cores).
+  bool pin_pollers = false;
+  /// Largest message sent or received; gRPC's default of 4 MiB is
+  /// smaller than a full ApplyBatch or Restore chunk can be.
+  int max_message_bytes = 64 * 1024 * 1024;
+  /// Most threads gRPC may run, pollers included (0 = gRPC's default).
+  size_t max_threads = 0;
+  /// Memory gRPC may use for calls in flight (0 = unlimited).
+  size_t memory_quota_bytes = 0;
+};
+
+/**
+ * @brief The gRPC server hosting the StateMachine service.
+ *
+ * Apply and ApplyBatch, which carry every committed entry, are served
+ * asynchronously: each completion queue has a fixed set of poller
+ * threads that take calls and apply them inline through
+ * StateMachineService::apply() and apply_batch(), so the apply path
+ * never waits for gRPC's sync server to hand the call to a thread (or
+ * spawn one). There is one ApplyBatch stream per sidecar, so one
+ * poller applies it in log order.
+ *
+ * Snapshot and Restore, rare and long, stay on a small sync pool: they
+ * block on the store and on the stream for the whole transfer. So does
+ * AppliedIndex, called once per sidecar start.
+ *
+ * Lifecycle: start(), then wait() or shutdown() (also the destructor).
+ */
+class StateMachineServer {
+public:
+  /**
+   * @brief Construct the server with a bound address and store.
+   * @param address The address to listen on (e.g., "0.0.0.0:50051", or
+   *                "unix:/path" for a Unix domain socket)
+   * @param store Reference to the key-value store
+   * @param restore_path Scratch file for incoming snapshots
+   * @param options Threading and limits
+   */
+  StateMachineServer(const std::string &address, AppliedIndexKVStore &store,
+                     std::string restore_path, GrpcServerOptions options = {})
+      : address_(address), options_(options),
+        state_machine_(store, std::move(restore_path)),
+        service_(state_machine_) {
+    options_.completion_queues =
+        std::max<size_t>(1, options_.completion_queues);
+    options_.pollers_per_queue =
+        std::max<size_t>(1, options_.pollers_per_queue);
+  }
+
+  ~StateMachineServer() { shutdown(); }
+
+  // Non-copyable
+  StateMachineServer(const StateMachineServer &) = delete;
+  StateMachineServer &operator=(const StateMachineServer &) = delete;
+
+  /**
+   * @brief Start the gRPC server and its pollers.
+   *
+   * This is non-blocking. Call wait() to block until shutdown.
+   *
+   * @throws std::runtime_error If the address cannot be bound
+   */
+  void start() {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(address_, grpc::InsecureServerCredentials());
+    builder.RegisterService(&service_);
+    builder.SetMaxReceiveMessageSize(options_.max_message_bytes);
+    builder.SetMaxSendMessageSize(options_.max_message_bytes);
+    if (options_.max_threads > 0 || options_.memory_quota_bytes > 0) {
+      grpc::ResourceQuota quota("kvdb-state-machine");
+      if (options_.max_threads > 0) {
+        quota.SetMaxThreads(static_cast<int>(options_.max_threads));
+      }
+      if (options_.memory_quota_bytes > 0) {
+        quota.Resize(options_.memory_quota_bytes);
+      }
+      builder.SetResourceQuota(quota);
+    }
+    // Snapshot and Restore only
+    builder.SetSyncServerOption(grpc::ServerBuilder::SyncServerOption::NUM_CQS,
+                                1);
+    builder.SetSyncServerOption(
+        grpc::ServerBuilder::SyncServerOption::MIN_POLLERS, 1);
+    builder.SetSyncServerOption(
+        grpc::ServerBuilder::SyncServerOption::MAX_POLLERS, kSyncPollers);
+    for (size_t i = 0; i < options_.completion_queues; ++i) {
+      queues_.push_back(builder.AddCompletionQueue());
+    }
+
+    server_ = builder.BuildAndStart();
+    if (!server_) {
+      throw std::runtime_error("Cannot serve gRPC on " + address_);
+    }
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t q = 0; q < queues_.size(); ++q) {
+      for (size_t p = 0; p < options_.pollers_per_queue; ++p) {
+        // One pending call of each method per poller
+        new ApplyCall(service_, *queues_[q]);
+        new ApplyBatchCall(service_, *queues_[q]);
+        const size_t index = pollers_.size();
+        pollers_.emplace_back([this, q] { poll(*queues_[q]); });
+        if (options_.pin_pollers) {
+          pin(pollers_.back(), index % cores);
+        }
+      }
+    }
+    KVDB_LOG(LogLevel::INFO, "gRPC",
+             "StateMachine listening on " << address_ << " ("
+                << queues_.size() << " completion queues, " << pollers_.size()
+                << " pollers)");
+  }
+
+  /**
+   * @brief The service, for transports other than gRPC (see
+   *        ApplyRingServer).
+   */
+  StateMachineService &state_machine() { return state_machine_; }
+
+  /**
+   * @brief Block until the server shuts down.
+   */
+  void wait() {
+    if (server_) {
+      server_->Wait();
+    }
+  }
+
+  /**
+   * @brief Initiate graceful shutdown, and wait for the pollers.
+   */
+  void shutdown() {
+    if (!server_ || stopped_)
+      return;
+    stopped_ = true;
+    server_->Shutdown(std::chrono::system_clock::now() + kShutdownGrace);
+    // Pollers drain their queue, freeing the calls left, and return
+    for (auto &queue : queues_) {
+      queue->Shutdown();
+    }
+    for (auto &poller : pollers_) {
+      poller.join();
+    }
+  }
+
+private:
+  /// Sync threads for Snapshot, Restore and AppliedIndex.
+  static constexpr int kSyncPollers = 2;
+
+  /// How long shutdown() lets calls in flight finish before cancelling
+  /// them (the ApplyBatch stream never finishes on its own).
+  static constexpr std::chrono::seconds kShutdownGrace{1};
+
+  /**
+   * @brief The service as registered: Apply and ApplyBatch are taken
+   *        from the completion queues, the others forwarded to the
+   *        StateMachineService.
+   */
+  class AsyncService final
+      : public consensus::StateMachine::WithAsyncMethod_Apply<
+            consensus::StateMachine::WithAsyncMethod_ApplyBatch<
+                consensus::StateMachine::Service>> {
+  public:
+    explicit AsyncService(StateMachineService &state_machine)
+        : state_machine_(state_machine) {}
+
+    StateMachineService &state_machine() { return state_machine_; }
+
+    grpc::Status
+    Snapshot(grpc::ServerContext *context,
+             const consensus::SnapshotRequest *request,
+             grpc::ServerWriter<consensus::SnapshotChunk> *writer) override {
+      return state_machine_.Snapshot(context, request, writer);
+    }
+
+    grpc::Status Restore(grpc::ServerContext *context,
+                         grpc::ServerReader<consensus::SnapshotChunk> *reader,
+                         consensus::RestoreResponse *reply) override {
+      return state_machine_.Restore(context, reader, reply);
+    }
+
+    grpc::Status
+    AppliedIndex(grpc::ServerContext *context,
+                 const consensus::AppliedIndexRequest *request,
+                 consensus::AppliedIndexResponse *reply) override {
+      return state_machine_.AppliedIndex(context, request, reply);
+    }
+
+  private:
+    StateMachineService &state_machine_;
+  };
+
+  /// A call in progress: the tag of each of its operations.
+  class Call {
+  public:
+    virtual ~Call() = default;
+    /// Continue after an operation completed (`ok` as from Next()).
+    virtual void proceed(bool ok) = 0;
+  };
+
+  /// One Apply call, from being requested to being answered.
+  class ApplyCall final : public Call {
+  public:
+    ApplyCall(AsyncService &service, grpc::ServerCompletionQueue &queue)
+        : service_(service), queue_(queue), responder_(&context_) {
+      service_.RequestApply(&context_, &request_, &responder_, &queue_,
+                            &queue_, this);
+    }
+
+    void proceed(bool ok) override {
+      if (!ok || answered_) {
+        delete this; // Shutting down, or answered
+        return;
+      }
+      new ApplyCall(service_, queue_); // Take the next one meanwhile
+      consensus::ApplyResponse reply;
+      const grpc::Status status =
+          service_.state_machine().apply(request_, reply);
+      answered_ = true;
+      responder_.Finish(reply, status, this);
+    }
+
+  private:
+    AsyncService &service_;
+    grpc::ServerCompletionQueue &queue_;
+    grpc::ServerContext context_;
+    consensus::Command request_;
+    grpc::ServerAsyncResponseWriter<consensus::ApplyResponse> responder_;
+    bool answered_ = false;
+  };
+
+  /// One ApplyBatch stream: read a batch, apply it, answer, repeat.
+  class ApplyBatchCall final : public Call {
+  public:
+    ApplyBatchCall(AsyncService &service, grpc::ServerCompletionQueue &queue)
+        : service_(service), queue_(queue), stream_(&context_) {
+      service_.RequestApplyBatch(&context_, &stream_, &queue_, &queue_, this);
+    }
+
+    void proceed(bool ok) override {
+      switch (state_) {
+      case State::REQUESTED:
+        if (!ok) {
+          delete this; // Shutting down
+          return;
+        }
+        new ApplyBatchCall(service_, queue_);
+        read();
+        return;
+      case State::READING:
+        if (!ok) {
+          finish(); // The sidecar closed the stream
+          return;
+        }
+        reply_.Clear();
+        service_.state_machine().apply_batch(batch_, reply_);
+        state_ = State::WRITING;
+        stream_.Write(reply_, this);
+        return;
+      case State::WRITING:
+        if (!ok) {
+          finish();
+          return;
+        }
+        read();
+        return;
+      case State::FINISHING:
+        delete this;
+        return;
+      }
+    }
+
+  private:
+    enum class State { REQUESTED, READING, WRITING, FINISHING };
+
+    AsyncService &service_;
+    grpc::ServerCompletionQueue &queue_;
+    grpc::ServerContext context_;
+    grpc::ServerAsyncReaderWriter<consensus::ApplyBatchResponse,
+                                  consensus::CommandBatch>
+        stream_;
+    consensus::CommandBatch batch_;
+    consensus::ApplyBatchResponse reply_;
+    State state_ = State::REQUESTED;
+
+    void read() {
+      state_ = State::READING;
+      stream_.Read(&batch_, this);
+    }
+
+    void finish() {
+      state_ = State::FINISHING;
+      stream_.Finish(grpc::Status::OK, this);
+    }
+  };
+
+  std::string address_;
+  GrpcServerOptions options_;
+  StateMachineService state_machine_;
+  AsyncService service_;
+  std::unique_ptr<grpc::Server> server_;
+  std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> queues_;
+  std::vector<std::thread> pollers_;
+  bool stopped_ = false;
+
+  /// Body of a poller: run the calls of one queue until it shuts down.
+  static void poll(grpc::ServerCompletionQueue &queue) {
+    void *tag = nullptr;
+    bool ok = false;
+    while (queue.Next(&tag, &ok)) {
+      static_cast<Call *>(tag)->proceed(ok);
+    }
+  }
+
+  static void pin(std::thread &thread, size_t core) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus) !=
+        0) {
+      KVDB_LOG(LogLevel::WARN, "gRPC", "Cannot pin a poller to core " << core);
+    }
+  }
+};
+
+} // namespace kvdb
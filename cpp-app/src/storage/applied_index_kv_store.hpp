@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "kv_store.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Position of an entry in the Raft log.
+ */
+struct LogPosition {
+  uint64_t index = 0; ///< 0 = none
+  uint64_t term = 0;
+};
+
+/**
+ * @brief Decorator that records which Raft entries the store holds.
+ *
+ * The position of the last entry applied is kept under a reserved key,
+ * the empty one (which no client command can name), as a 16-byte
+ * value { u64 index, u64 term } (little-endian). write_batch() with a
+ * position appends it to the batch, so the engine logs it in the same
+ * WAL group as the entries' writes: after a crash the recorded
+ * position is never ahead of the data, and the sidecar can skip every
+ * entry up to it instead of replaying the whole log.
+ *
+ * The key is hidden from reads and scans, and refused by writes. It is
+ * part of snapshot(), so a Raft snapshot (and GET /export) carries the
+ * position it reflects, and restore() picks that up.
+ *
+ * Thread-safe if the wrapped engine is.
+ */
+class AppliedIndexKVStore : public IKVStore {
+public:
+  /**
+   * @throws std::runtime_error If a stored position is malformed
+   */
+  explicit AppliedIndexKVStore(std::unique_ptr<IKVStore> inner)
+      : inner_(std::move(inner)) {
+    load();
+  }
+
+  /// The position of the last entry recorded as applied.
+  [[nodiscard]] LogPosition applied() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return applied_;
+  }
+
+  /**
+   * @brief write_batch(), recording that the store now holds every
+   *        entry up to `applied`.
+   *
+   * With no writes, only records the position (e.g. after entries that
+   * were applied otherwise, or rejected).
+   */
+  void write_batch(std::vector<BatchWrite> writes, LogPosition applied) {
+    require_no_reserved_key(writes);
+    writes.push_back(BatchWrite{std::string(kAppliedKey), encode(applied)});
+    inner_->write_batch(std::move(writes));
+    std::lock_guard<std::mutex> lock(mutex_);
+    applied_ = applied;
+  }
+
+  void set(const std::string &key, const std::string &value) override {
+    require_not_reserved(key);
+    inner_->set(key, value);
+  }
+
+  void set_with_expiry(const std::string &key, const std::string &value,
+                       uint64_t expires_at_ms) override {
+    require_not_reserved(key);
+    inner_->set_with_expiry(key, value, expires_at_ms);
+  }
+
+  [[nodiscard]] std::optional<std::string>
+  get(const std::string &key) const override {
+    if (is_reserved(key))
+      return std::nullopt;
+    return inner_->get(key);
+  }
+
+  [[nodiscard]] std::vector<std::optional<std::string>>
+  multi_get(const std::vector<std::string> &keys) const override {
+    auto values = inner_->multi_get(keys);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (is_reserved(keys[i])) {
+        values[i].reset();
+      }
+    }
+    return values;
+  }
+
+  void write_batch(std::vector<BatchWrite> writes) override {
+    require_no_reserved_key(writes);
+    inner_->write_batch(std::move(writes));
+  }
+
+  bool remove(const std::string &key) override {
+    require_not_reserved(key);
+    return inner_->remove(key);
+  }
+
+  bool expire(const std::string &key, uint64_t expires_at_ms) override {
+    return !is_reserved(key) && inner_->expire(key, expires_at_ms);
+  }
+
+  [[nodiscard]] bool contains(const std::string &key) const override {
+    return !is_reserved(key) && inner_->contains(key);
+  }
+
+  /// The reserved key sorts first; ranges from "" start just after it.
+  [[nodiscard]] std::vector<KVPair> scan(const std::string &start,
+                                         const std::string &end,
+                                         size_t limit) const override {
+    return inner_->scan(start.empty() ? std::string(1, '\0') : start, end,
+                        limit);
+  }
+
+  [[nodiscard]] std::optional<EncodedValue>
+  get_encoded(const std::string &key,
+              const CodingFilter &accepts) const override {
+    if (is_reserved(key))
+      return std::nullopt;
+    return inner_->get_encoded(key, accepts);
+  }
+
+  void for_each(const IKVSnapshot::Visitor &visit) const override {
+    inner_->for_each([&](std::string_view key, std::string_view value) {
+      if (!key.empty()) {
+        visit(key, value);
+      }
+    });
+  }
+
+  /// Includes the recorded position, as of the snapshot.
+  std::unique_ptr<IKVSnapshot> snapshot() override {
+    return inner_->snapshot();
+  }
+
+  /// The position becomes the snapshot's (none if it carries none).
+  void restore(const std::string &path) override {
+    inner_->restore(path);
+    load();
+  }
+
+private:
+  /// Key of the recorded position.
+  static constexpr const char *kAppliedKey = "";
+  static constexpr size_t kEncodedSize = 2 * sizeof(uint64_t);
+
+  std::unique_ptr<IKVStore> inner_;
+  mutable std::mutex mutex_; ///< Guards applied_
+  LogPosition applied_;
+
+  static bool is_reserved(const std::string &key) { return key.empty(); }
+
+  static void require_not_reserved(const std::string &key) {
+    if (is_reserved(key)) {
+      throw std::invalid_argument("The empty key is reserved");
+    }
+  }
+
+  static void require_no_reserved_key(const std::vector<BatchWrite> &writes) {
+    for (const auto &write : writes) {
+      require_not_reserved(write.key);
+    }
+  }
+
+  static std::string encode(LogPosition position) {
+    std::string value(kEncodedSize, '\0');
+    std::memcpy(value.data(), &position.index, sizeof(uint64_t));
+    std::memcpy(value.data() + sizeof(uint64_t), &position.term,
+                sizeof(uint64_t));
+    return value;
+  }
+
+  void load() {
+    LogPosition position;
+    if (auto value = inner_->get(std::string(kAppliedKey))) {
+      if (value->size() != kEncodedSize) {
+        throw std::runtime_error("Malformed applied Raft position");
+      }
+      std::memcpy(&position.index, value->data(), sizeof(uint64_t));
+      std::memcpy(&position.term, value->data() + sizeof(uint64_t),
+                  sizeof(uint64_t));
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    applied_ = position;
+  }
+};
+
+} // namespace kvdb
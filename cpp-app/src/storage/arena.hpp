@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace kvdb {
+
+/**
+ * @brief Byte counts reported by SlabArena.
+ */
+struct ArenaStats {
+  size_t segment_bytes = 0; ///< Bytes reserved in slab segments
+  size_t large_bytes = 0;   ///< Bytes in dedicated large allocations
+  size_t live_bytes = 0;    ///< Bytes handed out and not yet freed
+};
+
+/**
+ * @brief Size-class slab allocator for keys and values.
+ *
+ * Small blocks are carved from 256 KiB segments in power-of-two size
+ * classes (16 B .. 4 KiB), so keys and values of similar size end up
+ * packed next to each other instead of scattered across the heap, and a
+ * freed block is recycled through its class's free list. Blocks larger
+ * than the biggest class get a dedicated allocation.
+ *
+ * Callers must pass the same size to deallocate() that they passed to
+ * allocate(). Not thread-safe.
+ */
+class SlabArena {
+public:
+  SlabArena() = default;
+
+  ~SlabArena() {
+    for (char *p : large_blocks_) {
+      delete[] p;
+    }
+  }
+
+  // Non-copyable
+  SlabArena(const SlabArena &) = delete;
+  SlabArena &operator=(const SlabArena &) = delete;
+
+  /**
+   * @brief Allocate a block of at least `size` bytes.
+   */
+  char *allocate(size_t size) {
+    if (size == 0)
+      return nullptr;
+
+    if (size > kMaxClassSize) {
+      char *p = new char[size];
+      large_blocks_.insert(p);
+      stats_.large_bytes += size;
+      stats_.live_bytes += size;
+      return p;
+    }
+
+    const size_t cls = size_class(size);
+    const size_t block = kMinClassSize << cls;
+    stats_.live_bytes += block;
+
+    if (FreeBlock *head = free_lists_[cls]) {
+      free_lists_[cls] = head->next;
+      return reinterpret_cast<char *>(head);
+    }
+
+    if (bump_remaining_ < block) {
+      segments_.push_back(std::make_unique<char[]>(kSegmentSize));
+      bump_ = segments_.back().get();
+      bump_remaining_ = kSegmentSize;
+      stats_.segment_bytes += kSegmentSize;
+    }
+    char *p = bump_;
+    bump_ += block;
+    bump_remaining_ -= block;
+    return p;
+  }
+
+  /**
+   * @brief Return a block obtained from allocate(size).
+   */
+  void deallocate(char *p, size_t size) {
+    if (!p || size == 0)
+      return;
+
+    if (size > kMaxClassSize) {
+      large_blocks_.erase(p);
+      delete[] p;
+      stats_.large_bytes -= size;
+      stats_.live_bytes -= size;
+      return;
+    }
+
+    const size_t cls = size_class(size);
+    stats_.live_bytes -= kMinClassSize << cls;
+    auto *block = reinterpret_cast<FreeBlock *>(p);
+    block->next = free_lists_[cls];
+    free_lists_[cls] = block;
+  }
+
+  [[nodiscard]] const ArenaStats &stats() const { return stats_; }
+
+private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  static constexpr size_t kMinClassSize = 16;
+  static constexpr size_t kNumClasses = 9; // 16 B .. 4 KiB
+  static constexpr size_t kMaxClassSize = kMinClassSize << (kNumClasses - 1);
+  static constexpr size_t kSegmentSize = 256 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> segments_;
+  std::unordered_set<char *> large_blocks_;
+  std::array<FreeBlock *, kNumClasses> free_lists_{};
+  char *bump_ = nullptr;
+  size_t bump_remaining_ = 0;
+  ArenaStats stats_;
+
+  static size_t size_class(size_t size) {
+    size_t cls = 0;
+    while ((kMinClassSize << cls) < size) {
+      ++cls;
+    }
+    return cls;
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "flat_hash_table.hpp"
+#include "kv_store.hpp"
+#include "persistence.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Persistent key-value store backed by an arena-allocated flat table.
+ *
+ * Same persistence and locking contract as PersistentKVStore, but
+ * entries live in a FlatHashTable: no per-entry heap node, short keys
+ * inline in the slot, keys and values packed in slab segments. Reads
+ * take a shared lock.
+ *
+ * A B+-tree index (owning copies of the keys, since inline keys move
+ * on rehash) serves scan().
+ *
+ * Values are always copied into the arena, so
+ * PersistenceOptions::lazy_values has no effect on this engine.
+ */
+class ArenaKVStore : public IKVStore {
+public:
+  explicit ArenaKVStore(std::string db_path, PersistenceOptions options = {})
+      : persistence_(std::move(db_path), options) {
+    load();
+  }
+
+  /**
+   * @brief Store a key-value pair and append it to the WAL.
+   */
+  void set(const std::string &key, const std::string &value) override {
+    uint64_t lsn;
+    {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      lsn = persistence_.append_set(key, value);
+      put(key, value);
+    }
+    persistence_.wait_durable(lsn);
+  }
+
+  /**
+   * @brief Retrieve a value by key.
+   * @return The value if found, std::nullopt otherwise.
+   */
+  [[nodiscard]] std::optional<std::string>
+  get(const std::string &key) const override {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto value = table_.find(key);
+    if (value) {
+      return std::string(*value);
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Retrieve many values under one shared lock.
+   */
+  [[nodiscard]] std::vector<std::optional<std::string>>
+  multi_get(const std::vector<std::string> &keys) const override {
+    std::vector<std::optional<std::string>> values;
+    values.reserve(keys.size());
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (const auto &key : keys) {
+      auto value = table_.find(key);
+      if (value) {
+        values.emplace_back(std::string(*value));
+      } else {
+        values.emplace_back(std::nullopt);
+      }
+    }
+    return values;
+  }
+
+  /**
+   * @brief Apply and log a batch under one lock; waits for durability
+   *        once, for the last record.
+   * @throws std::runtime_error If a write has a deadline
+   */
+  void write_batch(std::vector<BatchWrite> writes) override {
+    require_no_expiry(writes);
+    uint64_t lsn = 0;
+    {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      for (const auto &write : writes) {
+        if (!write.remove) {
+          lsn = persistence_.append_set(write.key, write.value);
+          put(write.key, write.value);
+        } else if (table_.contains(write.key)) {
+          lsn = persistence_.append_remove(write.key);
+          table_.erase(write.key);
+          index_.erase(write.key);
+        }
+      }
+    }
+    if (lsn != 0) {
+      persistence_.wait_durable(lsn);
+    }
+  }
+
+  /**
+   * @brief Remove a key-value pair and append the deletion to the WAL.
+   * @return true if the key existed and was removed.
+   */
+  bool remove(const std::string &key) override {
+    uint64_t lsn;
+    {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      if (!table_.contains(key)) {
+        return false;
+      }
+      lsn = persistence_.append_remove(key);
+      table_.erase(key);
+      index_.erase(key);
+    }
+    persistence_.wait_durable(lsn);
+    return true;
+  }
+
+  /**
+   * @brief Check if a key exists in the store.
+   */
+  [[nodiscard]] bool contains(const std::string &key) const override {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return table_.contains(key);
+  }
+
+  /**
+   * @brief Ordered range scan over [start, end) via the key index.
+   */
+  [[nodiscard]] std::vector<KVPair> scan(const std::string &start,
+                                         const std::string &end,
+                                         size_t limit) const override {
+    std::vector<KVPair> result;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    index_.for_each_from(start, [&](std::string_view key) {
+      if (result.size() >= limit || (!end.empty() && key >= end))
+        return false;
+      result.emplace_back(std::string(key), std::string(*table_.find(key)));
+      return true;
+    });
+    return result;
+  }
+
+  void for_each(const IKVSnapshot::Visitor &visit) const override {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    index_.for_each_from({}, [&](std::string_view key) {
+      visit(key, *table_.find(key));
+      return true;
+    });
+  }
+
+  /**
+   * @brief Point-in-time view via a checkpoint of the base file and WAL.
+   */
+  [[nodiscard]] std::unique_ptr<IKVSnapshot> snapshot() override {
+    return std::make_unique<MappedKVSnapshot>(persistence_.checkpoint());
+  }
+
+  /**
+   * @brief Install a snapshot file as the new base and reload from it.
+   */
+  void restore(const std::string &path) override {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto base = persistence_.restore_base(path);
+    table_.clear();
+    index_.clear();
+    table_.reserve(base->entry_count());
+    base->for_each([this](std::string_view key, std::string_view value) {
+      put(key, value);
+    });
+  }
+
+  /**
+   * @brief Memory accounting for the table and its arena.
+   */
+  [[nodiscard]] TableMemoryStats memory_stats() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return table_.memory_stats();
+  }
+
+private:
+  LogPersistence persistence_;
+  FlatHashTable table_;
+  OrderedIndex<std::string> index_;
+  mutable std::shared_mutex mutex_;
+
+  void put(std::string_view key, std::string_view value) {
+    if (!table_.contains(key)) {
+      index_.insert(std::string(key));
+    }
+    table_.insert_or_assign(key, value);
+  }
+
+  /**
+   * @brief Rebuild the table from the base snapshot and WAL.
+   */
+  void load() {
+    persistence_.recover(
+        [this](WalRecordType type, std::string_view key,
+               std::string_view value) {
+          if (type == WalRecordType::SET) {
+            put(key, value);
+          } else if (table_.erase(key)) {
+            index_.erase(key);
+          }
+        },
+        [this](std::shared_ptr<const MappedSnapshot> base) {
+          table_.reserve(base->entry_count());
+        });
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace kvdb {
+
+/**
+ * @brief Stable 64-bit hash for on-disk structures.
+ *
+ * FNV-1a with a murmur finalizer. Unlike std::hash its output is fixed,
+ * so filters written by one build can be read by another.
+ */
+inline uint64_t stable_hash(std::string_view data) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (unsigned char c : data) {
+    h ^= c;
+    h *= 0x100000001b3ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/**
+ * @brief Builds a serialized bloom filter over a set of keys.
+ *
+ * Serialized form: the bit array followed by one byte holding the
+ * number of probes. Probes use double hashing (h1 + i * h2), so each
+ * key costs one hash.
+ */
+class BloomFilterBuilder {
+public:
+  /**
+   * @param bits_per_key Filter size; 10 gives roughly a 1% false
+   *                     positive rate
+   */
+  explicit BloomFilterBuilder(size_t bits_per_key)
+      : bits_per_key_(bits_per_key) {}
+
+  void add(std::string_view key) { hashes_.push_back(stable_hash(key)); }
+
+  /**
+   * @brief Serialize the filter for every key added so far.
+   */
+  [[nodiscard]] std::string finish() const {
+    // k = bits_per_key * ln(2) minimizes the false positive rate
+    size_t probes = bits_per_key_ * 69 / 100;
+    probes = probes < 1 ? 1 : (probes > 30 ? 30 : probes);
+
+    size_t bits = hashes_.size() * bits_per_key_;
+    bits = bits < 64 ? 64 : bits;
+    const size_t bytes = (bits + 7) / 8;
+    bits = bytes * 8;
+
+    std::string filter(bytes + 1, '\0');
+    for (uint64_t h : hashes_) {
+      const uint64_t delta = (h >> 33) | (h << 31);
+      for (size_t i = 0; i < probes; ++i) {
+        const uint64_t bit = h % bits;
+        filter[bit / 8] = static_cast<char>(filter[bit / 8] | (1 << (bit % 8)));
+        h += delta;
+      }
+    }
+    filter[bytes] = static_cast<char>(probes);
+    return filter;
+  }
+
+private:
+  size_t bits_per_key_;
+  std::vector<uint64_t> hashes_;
+};
+
+/**
+ * @brief Test a key against a filter produced by BloomFilterBuilder.
+ * @return false if the key is definitely absent
+ */
+inline bool bloom_may_contain(std::string_view filter, std::string_view key) {
+  if (filter.size() < 2)
+    return true; // no usable filter: never rule a key out
+  const size_t bytes = filter.size() - 1;
+  const size_t bits = bytes * 8;
+  const auto probes = static_cast<unsigned char>(filter[bytes]);
+
+  uint64_t h = stable_hash(key);
+  const uint64_t delta = (h >> 33) | (h << 31);
+  for (size_t i = 0; i < probes; ++i) {
+    const uint64_t bit = h % bits;
+    if ((static_cast<unsigned char>(filter[bit / 8]) & (1 << (bit % 8))) == 0)
+      return false;
+    h += delta;
+  }
+  return true;
+}
+
+} // namespace kvdb
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "kv_store.hpp"
+#include "value_codec.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Decorator that compresses values before they reach an engine.
+ *
+ * Values are encoded by ValueCodec on set() and decoded on every read,
+ * so the engine, its WAL, snapshots and the Raft snapshot stream all
+ * hold the compressed bytes and a value is only decompressed when it is
+ * actually read. get_encoded() skips even that for HTTP clients that
+ * accept the stored coding.
+ *
+ * Keys are stored as given, so ordering and scans are unaffected.
+ * Thread-safe if the wrapped engine is.
+ */
+class CompressedKVStore : public IKVStore {
+public:
+  /**
+   * @throws std::runtime_error If the dictionary cannot be loaded
+   */
+  CompressedKVStore(std::unique_ptr<IKVStore> inner,
+                    CompressionOptions options)
+      : inner_(std::move(inner)), codec_(std::move(options)) {}
+
+  void set(const std::string &key, const std::string &value) override {
+    inner_->set(key, codec_.encode(value));
+  }
+
+  void set_with_expiry(const std::string &key, const std::string &value,
+                       uint64_t expires_at_ms) override {
+    inner_->set_with_expiry(key, codec_.encode(value), expires_at_ms);
+  }
+
+  [[nodiscard]] std::optional<std::string>
+  get(const std::string &key) const override {
+    auto stored = inner_->get(key);
+    if (stored) {
+      return codec_.decode(*stored);
+    }
+    return std::nullopt;
+  }
+
+  [[nodiscard]] std::vector<std::optional<std::string>>
+  multi_get(const std::vector<std::string> &keys) const override {
+    auto values = inner_->multi_get(keys);
+    for (auto &value : values) {
+      if (value) {
+        value = codec_.decode(*value);
+      }
+    }
+    return values;
+  }
+
+  void write_batch(std::vector<BatchWrite> writes) override {
+    for (auto &write : writes) {
+      if (!write.remove) {
+        write.value = codec_.encode(write.value);
+      }
+    }
+    inner_->write_batch(std::move(writes));
+  }
+
+  bool remove(const std::string &key) override { return inner_->remove(key); }
+
+  bool expire(const std::string &key, uint64_t expires_at_ms) override {
+    return inner_->expire(key, expires_at_ms);
+  }
+
+  [[nodiscard]] bool contains(const std::string &key) const override {
+    return inner_->contains(key);
+  }
+
+  [[nodiscard]] std::vector<KVPair> scan(const std::string &start,
+                                         const std::string &end,
+                                         size_t limit) const override {
+    auto pairs = inner_->scan(start, end, limit);
+    for (auto &pair : pairs) {
+      pair.second = codec_.decode(pair.second);
+    }
+    return pairs;
+  }
+
+  /**
+   * @brief Like get(), but serve the stored bytes as they are if the
+   *        client accepts their coding (see ValueCodec::content_coding),
+   *        and leave them wherever the engine left them (e.g. mapped)
+   *        unless they have to be decompressed.
+   */
+  [[nodiscard]] std::optional<EncodedValue>
+  get_encoded(const std::string &key,
+              const CodingFilter &accepts) const override {
+    auto stored =
+        inner_->get_encoded(key, [](std::string_view) { return false; });
+    if (!stored)
+      return std::nullopt;
+
+    std::string_view payload;
+    const char *coding = ValueCodec::content_coding(stored->bytes(), &payload);
+    if (coding && accepts(coding)) {
+      stored->content_encoding = coding;
+    } else if (!ValueCodec::raw_value(stored->bytes(), &payload)) {
+      return EncodedValue{codec_.decode(stored->bytes()), {}};
+    }
+    narrow(*stored, payload);
+    return stored;
+  }
+
+  void for_each(const IKVSnapshot::Visitor &visit) const override {
+    inner_->for_each([&](std::string_view key, std::string_view stored) {
+      visit(key, codec_.decode(stored));
+    });
+  }
+
+  /// Snapshots carry values in their stored (compressed) form.
+  std::unique_ptr<IKVSnapshot> snapshot() override {
+    return inner_->snapshot();
+  }
+
+  void restore(const std::string &path) override { inner_->restore(path); }
+
+  [[nodiscard]] CompressionStats compression_stats() const {
+    return codec_.stats();
+  }
+
+  [[nodiscard]] const CompressionOptions &compression_options() const {
+    return codec_.options();
+  }
+
+private:
+  std::unique_ptr<IKVStore> inner_;
+  ValueCodec codec_;
+
+  /// Shrink `value` to `part`, a view into its bytes.
+  static void narrow(EncodedValue &value, std::string_view part) {
+    if (value.file) {
+      value.mapped = part;
+    } else {
+      const size_t size = part.size();
+      value.body.erase(0, static_cast<size_t>(part.data() - value.body.data()));
+      value.body.resize(size);
+    }
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace kvdb {
+
+namespace detail {
+
+/**
+ * @brief Build the reflected CRC-32 (IEEE 802.3) lookup table at compile time.
+ */
+constexpr std::array<uint32_t, 256> make_crc32_table() {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; ++k) {
+      c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    }
+    table[i] = c;
+  }
+  return table;
+}
+
+inline constexpr std::array<uint32_t, 256> kCrc32Table = make_crc32_table();
+
+} // namespace detail
+
+/**
+ * @brief Compute (or continue) a CRC-32 checksum over a byte range.
+ *
+ * @param data Pointer to the bytes to checksum
+ * @param size Number of bytes
+ * @param crc Running checksum from a previous call (0 to start)
+ * @return The updated checksum
+ */
+inline uint32_t crc32(const void *data, size_t size, uint32_t crc = 0) {
+  const auto *p = static_cast<const unsigned char *>(data);
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i) {
+    crc = detail::kCrc32Table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+} // namespace kvdb
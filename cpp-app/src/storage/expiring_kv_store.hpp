@@ -0,0 +1,373 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "kv_store.hpp"
+#include "timer_wheel.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Current Unix time in milliseconds (the unit of key deadlines).
+ */
+inline uint64_t unix_millis() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+}
+
+/**
+ * @brief Tunables for key expiry.
+ */
+struct ExpiryOptions {
+  /// Timer wheel resolution; keys are collected at most this late.
+  std::chrono::milliseconds tick{100};
+  /// When a collected key is offered again if no EXPIRE for it has been
+  /// applied (e.g. the proposal failed because leadership was lost).
+  std::chrono::milliseconds retry_delay{1000};
+};
+
+/**
+ * @brief Decorator that adds per-key deadlines to an engine.
+ *
+ * A key set with a deadline is stored with an 11-byte header
+ * { "\0KT", u64 expires_at_ms } (little-endian) in front of its value,
+ * so the deadline survives restarts, WAL replay and Raft snapshots.
+ * A value that happens to start with the magic is stored behind a
+ * header with a 0 (never) deadline.
+ *
+ * Reads check the deadline on the value they fetch, so a key reads as
+ * missing the moment it expires, on every replica, at no extra cost.
+ * Actually deleting it has to go through Raft: an in-memory expiry
+ * index (one intrusive timer per expiring key in a hierarchical
+ * TimerWheel, rebuilt from the engine on start-up) hands due keys to
+ * the KeyExpirer, which proposes them in batched EXPIRE commands;
+ * applying one calls expire(). Scheduling, cancelling and collecting a
+ * key are all O(1).
+ *
+ * Mutations are expected in Raft apply order; the index follows the
+ * engine's contents as long as no two writers race on the same key.
+ */
+class ExpiringKVStore : public IKVStore {
+public:
+  using Expired = std::pair<std::string, uint64_t>;
+
+  explicit ExpiringKVStore(std::unique_ptr<IKVStore> inner,
+                           ExpiryOptions options = {})
+      : inner_(std::move(inner)), options_(options),
+        wheel_(unix_millis() / static_cast<uint64_t>(options.tick.count())) {
+    rebuild();
+  }
+
+  void set(const std::string &key, const std::string &value) override {
+    inner_->set(key, wrap(value, 0));
+    std::lock_guard<std::mutex> lock(mutex_);
+    forget(key);
+  }
+
+  void set_with_expiry(const std::string &key, const std::string &value,
+                       uint64_t expires_at_ms) override {
+    inner_->set(key, wrap(value, expires_at_ms));
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (expires_at_ms == 0) {
+      forget(key);
+    } else {
+      track(key, expires_at_ms);
+    }
+  }
+
+  [[nodiscard]] std::optional<std::string>
+  get(const std::string &key) const override {
+    auto stored = inner_->get(key);
+    if (!stored)
+      return std::nullopt;
+    const uint64_t deadline = deadline_of(*stored);
+    if (deadline != 0 && deadline <= unix_millis())
+      return std::nullopt;
+    return unwrap(std::move(*stored));
+  }
+
+  /// get(), keeping a value the engine left mapped where it is.
+  [[nodiscard]] std::optional<EncodedValue>
+  get_encoded(const std::string &key,
+              const CodingFilter &accepts) const override {
+    auto value =
+        inner_->get_encoded(key, [](std::string_view) { return false; });
+    if (!value)
+      return std::nullopt;
+    const std::string_view stored = value->bytes();
+    const uint64_t deadline = deadline_of(stored);
+    if (deadline != 0 && deadline <= unix_millis())
+      return std::nullopt;
+    if (has_header(stored)) {
+      if (value->file) {
+        value->mapped.remove_prefix(kHeaderSize);
+      } else {
+        value->body.erase(0, kHeaderSize);
+      }
+    }
+    return value;
+  }
+
+  [[nodiscard]] std::vector<std::optional<std::string>>
+  multi_get(const std::vector<std::string> &keys) const override {
+    auto values = inner_->multi_get(keys);
+    const uint64_t now = unix_millis();
+    for (auto &value : values) {
+      if (!value)
+        continue;
+      const uint64_t deadline = deadline_of(*value);
+      if (deadline != 0 && deadline <= now) {
+        value.reset();
+      } else {
+        value = unwrap(std::move(*value));
+      }
+    }
+    return values;
+  }
+
+  /**
+   * @brief Store deadlines in the values and hand the batch to the
+   *        engine, then update the expiry index.
+   */
+  void write_batch(std::vector<BatchWrite> writes) override {
+    std::vector<Expired> deadlines;
+    deadlines.reserve(writes.size());
+    for (auto &write : writes) {
+      deadlines.emplace_back(write.key,
+                             write.remove ? 0 : write.expires_at_ms);
+      if (!write.remove) {
+        write.value = wrap(write.value, write.expires_at_ms);
+        write.expires_at_ms = 0;
+      }
+    }
+    inner_->write_batch(std::move(writes));
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &[key, expires_at_ms] : deadlines) {
+      if (expires_at_ms == 0) {
+        forget(key);
+      } else {
+        track(key, expires_at_ms);
+      }
+    }
+  }
+
+  bool remove(const std::string &key) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      forget(key);
+    }
+    return inner_->remove(key);
+  }
+
+  [[nodiscard]] bool contains(const std::string &key) const override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = index_.find(key);
+      if (it != index_.end() && it->second.expires_at_ms <= unix_millis())
+        return false;
+    }
+    return inner_->contains(key);
+  }
+
+  /**
+   * @brief Range scan that skips expired keys, paging through the
+   *        engine until `limit` live pairs are found.
+   */
+  [[nodiscard]] std::vector<KVPair> scan(const std::string &start,
+                                         const std::string &end,
+                                         size_t limit) const override {
+    std::vector<KVPair> result;
+    std::string from = start;
+    const uint64_t now = unix_millis();
+    while (result.size() < limit) {
+      const size_t want = limit - result.size();
+      auto page = inner_->scan(from, end, want);
+      for (auto &[key, stored] : page) {
+        const uint64_t deadline = deadline_of(stored);
+        if (deadline == 0 || deadline > now) {
+          result.emplace_back(std::move(key), unwrap(std::move(stored)));
+        }
+      }
+      if (page.size() < want)
+        break;
+      from = page.back().first + '\0';
+    }
+    return result;
+  }
+
+  /**
+   * @brief Apply an EXPIRE: delete the key if its deadline is still
+   *        `expires_at_ms`.
+   *
+   * Deterministic across replicas: it consults the stored deadline,
+   * never the local clock.
+   */
+  bool expire(const std::string &key, uint64_t expires_at_ms) override {
+    auto stored = inner_->get(key);
+    if (!stored || deadline_of(*stored) != expires_at_ms) {
+      return false;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      forget(key);
+    }
+    return inner_->remove(key);
+  }
+
+  /// Skips expired keys, as scan() does.
+  void for_each(const IKVSnapshot::Visitor &visit) const override {
+    const uint64_t now = unix_millis();
+    inner_->for_each([&](std::string_view key, std::string_view stored) {
+      const uint64_t deadline = deadline_of(stored);
+      if (deadline == 0 || deadline > now) {
+        visit(key, has_header(stored) ? stored.substr(kHeaderSize) : stored);
+      }
+    });
+  }
+
+  /// Snapshots carry the stored values, deadlines included.
+  std::unique_ptr<IKVSnapshot> snapshot() override {
+    return inner_->snapshot();
+  }
+
+  void restore(const std::string &path) override {
+    inner_->restore(path);
+    rebuild();
+  }
+
+  /**
+   * @brief Collect every key whose deadline has passed, for EXPIREs.
+   *
+   * Each collected key is offered again after retry_delay unless an
+   * EXPIRE for it is applied first.
+   *
+   * @return (key, deadline) pairs
+   */
+  [[nodiscard]] std::vector<Expired> collect_expired() {
+    std::vector<Expired> expired;
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t now_ms = unix_millis();
+    const uint64_t retry_tick = to_tick(
+        now_ms + static_cast<uint64_t>(options_.retry_delay.count()));
+    wheel_.advance(now_ms / tick_ms(), [&](TimerWheel::Timer *timer) {
+      auto *entry = static_cast<Entry *>(timer);
+      expired.emplace_back(*entry->key, entry->expires_at_ms);
+      wheel_.schedule(entry, retry_tick);
+    });
+    return expired;
+  }
+
+  /// Number of keys with a deadline.
+  [[nodiscard]] size_t expiring_keys() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.size();
+  }
+
+private:
+  static constexpr char kMagic[3] = {'\0', 'K', 'T'};
+  static constexpr size_t kHeaderSize = sizeof(kMagic) + sizeof(uint64_t);
+
+  struct Entry : TimerWheel::Timer {
+    uint64_t expires_at_ms = 0;
+    const std::string *key = nullptr; ///< The index_ key owning this entry
+  };
+
+  std::unique_ptr<IKVStore> inner_;
+  ExpiryOptions options_;
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Entry> index_;
+  TimerWheel wheel_;
+
+  [[nodiscard]] uint64_t tick_ms() const {
+    return static_cast<uint64_t>(options_.tick.count());
+  }
+
+  /// First tick at or after `ms`, so a key is never collected early.
+  [[nodiscard]] uint64_t to_tick(uint64_t ms) const {
+    return (ms + tick_ms() - 1) / tick_ms();
+  }
+
+  static bool has_header(std::string_view stored) {
+    return stored.size() >= kHeaderSize &&
+           std::memcmp(stored.data(), kMagic, sizeof(kMagic)) == 0;
+  }
+
+  /// Stored deadline, 0 if none.
+  static uint64_t deadline_of(std::string_view stored) {
+    if (!has_header(stored))
+      return 0;
+    uint64_t v = 0;
+    for (size_t i = 0; i < sizeof(v); ++i) {
+      v |= static_cast<uint64_t>(
+               static_cast<unsigned char>(stored[sizeof(kMagic) + i]))
+           << (8 * i);
+    }
+    return v;
+  }
+
+  static std::string wrap(const std::string &value, uint64_t expires_at_ms) {
+    if (expires_at_ms == 0 && !has_header(value))
+      return value;
+    std::string out(kHeaderSize, '\0');
+    std::memcpy(out.data(), kMagic, sizeof(kMagic));
+    for (size_t i = 0; i < sizeof(expires_at_ms); ++i) {
+      out[sizeof(kMagic) + i] = static_cast<char>(expires_at_ms >> (8 * i));
+    }
+    out += value;
+    return out;
+  }
+
+  static std::string unwrap(std::string stored) {
+    if (has_header(stored)) {
+      stored.erase(0, kHeaderSize);
+    }
+    return stored;
+  }
+
+  /// Caller holds mutex_.
+  void track(const std::string &key, uint64_t expires_at_ms) {
+    auto [it, inserted] = index_.try_emplace(key);
+    Entry &entry = it->second;
+    entry.key = &it->first;
+    entry.expires_at_ms = expires_at_ms;
+    wheel_.schedule(&entry, to_tick(expires_at_ms));
+  }
+
+  /// Caller holds mutex_.
+  void forget(const std::string &key) {
+    auto it = index_.find(key);
+    if (it == index_.end())
+      return;
+    wheel_.cancel(&it->second);
+    index_.erase(it);
+  }
+
+  /**
+   * @brief Re-create the index from the deadlines stored in the engine.
+   */
+  void rebuild() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wheel_.clear();
+    index_.clear();
+    inner_->for_each([this](std::string_view key, std::string_view stored) {
+      const uint64_t deadline = deadline_of(stored);
+      if (deadline != 0) {
+        track(std::string(key), deadline);
+      }
+    });
+  }
+};
+
+} // namespace kvdb
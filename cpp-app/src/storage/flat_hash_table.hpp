@@ -0,0 +1,383 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "arena.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Memory accounting for FlatHashTable.
+ */
+struct TableMemoryStats {
+  size_t keys = 0;
+  size_t capacity = 0;
+  size_t table_bytes = 0;      ///< Control bytes + slot array
+  size_t key_bytes = 0;        ///< Logical bytes of all keys
+  size_t value_bytes = 0;      ///< Logical bytes of all values
+  size_t inline_keys = 0;      ///< Keys stored inside their slot
+  ArenaStats arena;
+
+  /**
+   * @brief Total resident bytes attributable to the table, per key.
+   */
+  [[nodiscard]] double bytes_per_key() const {
+    if (keys == 0)
+      return 0.0;
+    return static_cast<double>(table_bytes + arena.segment_bytes +
+                               arena.large_bytes) /
+           static_cast<double>(keys);
+  }
+};
+
+/**
+ * @brief Open-addressing, Swiss-table style byte-string map.
+ *
+ * One control byte per slot holds either a state (empty / deleted) or
+ * the low 7 bits of the key hash. Lookups scan a 16-slot group of
+ * control bytes at once (one SSE2 compare + movemask where available)
+ * and only touch a slot when its 7-bit tag matches, so a miss usually
+ * costs a single cache line. Groups are probed triangularly.
+ *
+ * Slots are 32 bytes. Keys up to kInlineKeySize bytes are stored in the
+ * slot itself; longer keys and all values live in a SlabArena.
+ *
+ * Not thread-safe.
+ */
+class FlatHashTable {
+public:
+  static constexpr size_t kInlineKeySize = 16;
+
+  FlatHashTable() = default;
+
+  ~FlatHashTable() { clear_slots(); }
+
+  // Non-copyable
+  FlatHashTable(const FlatHashTable &) = delete;
+  FlatHashTable &operator=(const FlatHashTable &) = delete;
+
+  /**
+   * @brief Look up a key.
+   * @return View of the value (valid until the next mutation), or
+   *         std::nullopt if absent
+   */
+  [[nodiscard]] std::optional<std::string_view>
+  find(std::string_view key) const {
+    if (capacity_ == 0)
+      return std::nullopt;
+    size_t index = find_index(key, hash(key));
+    if (index == kNotFound)
+      return std::nullopt;
+    const Slot &slot = slots_[index];
+    return std::string_view(slot.value, slot.value_len);
+  }
+
+  [[nodiscard]] bool contains(std::string_view key) const {
+    return capacity_ != 0 && find_index(key, hash(key)) != kNotFound;
+  }
+
+  /**
+   * @brief Insert or overwrite a key.
+   */
+  void insert_or_assign(std::string_view key, std::string_view value) {
+    const uint64_t h = hash(key);
+    if (capacity_ != 0) {
+      size_t index = find_index(key, h);
+      if (index != kNotFound) {
+        assign_value(slots_[index], value);
+        return;
+      }
+    }
+
+    if (growth_left_ == 0) {
+      rehash(size_ + 1 > capacity_ * 7 / 16 ? capacity_ * 2 : capacity_);
+    }
+
+    size_t index = find_free(h);
+    if (ctrl_[index] == kEmpty) {
+      --growth_left_;
+    }
+    ctrl_[index] = h2(h);
+    Slot &slot = slots_[index];
+    slot = Slot{};
+    store_key(slot, key);
+    assign_value(slot, value);
+    ++size_;
+    key_bytes_ += key.size();
+  }
+
+  /**
+   * @brief Remove a key.
+   * @return true if the key was present
+   */
+  bool erase(std::string_view key) {
+    if (capacity_ == 0)
+      return false;
+    size_t index = find_index(key, hash(key));
+    if (index == kNotFound)
+      return false;
+
+    key_bytes_ -= slots_[index].key_len;
+    release_slot(slots_[index]);
+    --size_;
+
+    // A group that still has an empty slot ends every probe sequence
+    // reaching it, so the freed slot can go straight back to empty.
+    const size_t group = index & ~(kGroupSize - 1);
+    if (match(group, kEmpty) != 0) {
+      ctrl_[index] = kEmpty;
+      ++growth_left_;
+    } else {
+      ctrl_[index] = kDeleted;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Pre-size the table for `count` keys.
+   */
+  void reserve(size_t count) {
+    size_t needed = kGroupSize;
+    while (needed * 7 / 8 < count) {
+      needed *= 2;
+    }
+    if (needed > capacity_) {
+      rehash(needed);
+    }
+  }
+
+  [[nodiscard]] size_t size() const { return size_; }
+
+  /**
+   * @brief Remove every entry. Freed blocks stay in the arena for reuse.
+   */
+  void clear() {
+    clear_slots();
+    ctrl_.reset();
+    slots_.reset();
+    capacity_ = 0;
+    size_ = 0;
+    growth_left_ = 0;
+    key_bytes_ = 0;
+  }
+
+  /**
+   * @brief Report memory use, including arena overhead.
+   */
+  [[nodiscard]] TableMemoryStats memory_stats() const {
+    TableMemoryStats stats;
+    stats.keys = size_;
+    stats.capacity = capacity_;
+    stats.table_bytes = capacity_ * (sizeof(Slot) + 1);
+    stats.key_bytes = key_bytes_;
+    stats.value_bytes = value_bytes_;
+    stats.inline_keys = inline_keys_;
+    stats.arena = arena_.stats();
+    return stats;
+  }
+
+private:
+  struct Slot {
+    uint32_t key_len;
+    uint32_t value_len;
+    union {
+      char inline_key[kInlineKeySize];
+      char *key_ptr;
+    };
+    char *value;
+
+    [[nodiscard]] const char *key_data() const {
+      return key_len <= kInlineKeySize ? inline_key : key_ptr;
+    }
+  };
+  static_assert(sizeof(Slot) == 32, "Slot should stay half a cache line");
+
+  static constexpr size_t kGroupSize = 16;
+  static constexpr size_t kNotFound = ~size_t{0};
+  static constexpr uint8_t kEmpty = 0x80;
+  static constexpr uint8_t kDeleted = 0xFE;
+
+  std::unique_ptr<uint8_t[]> ctrl_;
+  std::unique_ptr<Slot[]> slots_;
+  size_t capacity_ = 0;
+  size_t size_ = 0;
+  size_t growth_left_ = 0;
+  size_t key_bytes_ = 0;
+  size_t value_bytes_ = 0;
+  size_t inline_keys_ = 0;
+  SlabArena arena_;
+
+  static uint64_t hash(std::string_view key) {
+    uint64_t h = std::hash<std::string_view>{}(key);
+    // Finalizer so both tag (low bits) and group (high bits) are well mixed
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  static uint8_t h2(uint64_t h) { return static_cast<uint8_t>(h & 0x7F); }
+
+  /**
+   * @brief Bitmask of slots in the group whose control byte equals `tag`.
+   */
+  [[nodiscard]] uint32_t match(size_t group, uint8_t tag) const {
+#if defined(__SSE2__)
+    __m128i ctrl =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(&ctrl_[group]));
+    __m128i needle = _mm_set1_epi8(static_cast<char>(tag));
+    return static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, needle)));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupSize; ++i) {
+      if (ctrl_[group + i] == tag)
+        mask |= 1u << i;
+    }
+    return mask;
+#endif
+  }
+
+  /**
+   * @brief Bitmask of empty or deleted slots (high bit set) in the group.
+   */
+  [[nodiscard]] uint32_t match_free(size_t group) const {
+#if defined(__SSE2__)
+    __m128i ctrl =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(&ctrl_[group]));
+    return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupSize; ++i) {
+      if (ctrl_[group + i] & 0x80)
+        mask |= 1u << i;
+    }
+    return mask;
+#endif
+  }
+
+  static int lowest_bit(uint32_t mask) { return __builtin_ctz(mask); }
+
+  [[nodiscard]] size_t find_index(std::string_view key, uint64_t h) const {
+    const size_t groups_mask = capacity_ / kGroupSize - 1;
+    size_t group = (h >> 7) & groups_mask;
+    for (size_t step = 1;; ++step) {
+      const size_t base = group * kGroupSize;
+      for (uint32_t mask = match(base, h2(h)); mask; mask &= mask - 1) {
+        size_t index = base + static_cast<size_t>(lowest_bit(mask));
+        const Slot &slot = slots_[index];
+        if (slot.key_len == key.size() &&
+            std::memcmp(slot.key_data(), key.data(), key.size()) == 0) {
+          return index;
+        }
+      }
+      if (match(base, kEmpty) != 0)
+        return kNotFound;
+      group = (group + step) & groups_mask;
+    }
+  }
+
+  [[nodiscard]] size_t find_free(uint64_t h) const {
+    const size_t groups_mask = capacity_ / kGroupSize - 1;
+    size_t group = (h >> 7) & groups_mask;
+    for (size_t step = 1;; ++step) {
+      const size_t base = group * kGroupSize;
+      uint32_t mask = match_free(base);
+      if (mask != 0)
+        return base + static_cast<size_t>(lowest_bit(mask));
+      group = (group + step) & groups_mask;
+    }
+  }
+
+  void store_key(Slot &slot, std::string_view key) {
+    slot.key_len = static_cast<uint32_t>(key.size());
+    if (key.size() <= kInlineKeySize) {
+      if (!key.empty()) {
+        std::memcpy(slot.inline_key, key.data(), key.size());
+      }
+      ++inline_keys_;
+    } else {
+      slot.key_ptr = arena_.allocate(key.size());
+      std::memcpy(slot.key_ptr, key.data(), key.size());
+    }
+  }
+
+  void assign_value(Slot &slot, std::string_view value) {
+    if (slot.value) {
+      value_bytes_ -= slot.value_len;
+      arena_.deallocate(slot.value, slot.value_len);
+      slot.value = nullptr;
+    }
+    slot.value_len = static_cast<uint32_t>(value.size());
+    if (!value.empty()) {
+      slot.value = arena_.allocate(value.size());
+      std::memcpy(slot.value, value.data(), value.size());
+    }
+    value_bytes_ += value.size();
+  }
+
+  void release_slot(Slot &slot) {
+    if (slot.key_len > kInlineKeySize) {
+      arena_.deallocate(slot.key_ptr, slot.key_len);
+    } else {
+      --inline_keys_;
+    }
+    value_bytes_ -= slot.value_len;
+    arena_.deallocate(slot.value, slot.value_len);
+    slot.value = nullptr;
+  }
+
+  void clear_slots() {
+    for (size_t i = 0; i < capacity_; ++i) {
+      if ((ctrl_[i] & 0x80) == 0) {
+        release_slot(slots_[i]);
+      }
+    }
+  }
+
+  /**
+   * @brief Move every live slot into a table of `new_capacity` slots.
+   *
+   * Slots only hold pointers into the arena, so moving them is a plain
+   * copy; this also drops all tombstones.
+   */
+  void rehash(size_t new_capacity) {
+    if (new_capacity < kGroupSize) {
+      new_capacity = kGroupSize;
+    }
+
+    auto old_ctrl = std::move(ctrl_);
+    auto old_slots = std::move(slots_);
+    const size_t old_capacity = capacity_;
+
+    ctrl_ = std::make_unique<uint8_t[]>(new_capacity);
+    std::memset(ctrl_.get(), kEmpty, new_capacity);
+    slots_ = std::make_unique<Slot[]>(new_capacity);
+    capacity_ = new_capacity;
+    growth_left_ = new_capacity * 7 / 8;
+
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if ((old_ctrl[i] & 0x80) != 0)
+        continue;
+      const Slot &slot = old_slots[i];
+      const uint64_t h =
+          hash(std::string_view(slot.key_data(), slot.key_len));
+      size_t index = find_free(h);
+      ctrl_[index] = h2(h);
+      slots_[index] = slot;
+      --growth_left_;
+    }
+  }
+};
+
+} // namespace kvdb
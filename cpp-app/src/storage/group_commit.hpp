@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace kvdb {
+
+/**
+ * @brief Leader-based group commit for one append-only log.
+ *
+ * Writers take an LSN right after appending (under the log's own append
+ * lock) and later, with their locks dropped, call wait(). The first
+ * waiter becomes the sync leader: it optionally lingers for more
+ * writers, then issues one sync covering every record appended so far.
+ * Writers that arrive meanwhile ride on that sync or the next one:
+ * they sleep until it completes, and only the writer that fills the
+ * batch wakes the lingering leader early.
+ *
+ * Thread-safe.
+ */
+class GroupCommit {
+public:
+  /**
+   * @param max_batch Stop lingering once this many records are pending
+   * @param max_delay How long a leader lingers (zero syncs immediately)
+   */
+  GroupCommit(size_t max_batch, std::chrono::microseconds max_delay)
+      : max_batch_(max_batch), max_delay_(max_delay) {}
+
+  // Non-copyable
+  GroupCommit(const GroupCommit &) = delete;
+  GroupCommit &operator=(const GroupCommit &) = delete;
+
+  /**
+   * @brief Assign the LSN of a record that was just appended.
+   */
+  uint64_t next_lsn() {
+    return appended_lsn_.fetch_add(1, std::memory_order_release) + 1;
+  }
+
+  /**
+   * @brief Highest LSN handed out so far.
+   */
+  [[nodiscard]] uint64_t appended_lsn() const {
+    return appended_lsn_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Block until `lsn` is covered by a completed sync.
+   *
+   * @param sync Flushes the log; returns the highest LSN it covers
+   *             (read appended_lsn() before flushing)
+   * @throws Whatever `sync` throws, in the leader that called it
+   */
+  template <typename SyncFn> void wait(uint64_t lsn, SyncFn &&sync) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (durable_lsn_ < lsn) {
+      if (syncing_) {
+        if (lingering_ && batch_full()) {
+          leader_cv_.notify_one();
+        }
+        // Ride on the leader's sync; if it does not cover us (or fails),
+        // the next round picks a new leader
+        followers_cv_.wait(
+            lock, [this, lsn]() { return durable_lsn_ >= lsn || !syncing_; });
+        continue;
+      }
+
+      syncing_ = true;
+      if (max_delay_.count() > 0) {
+        lingering_ = true;
+        leader_cv_.wait_for(lock, max_delay_,
+                            [this]() { return batch_full(); });
+        lingering_ = false;
+      }
+      lock.unlock();
+
+      uint64_t target = 0;
+      try {
+        target = sync();
+      } catch (...) {
+        lock.lock();
+        syncing_ = false;
+        followers_cv_.notify_all();
+        throw;
+      }
+
+      lock.lock();
+      durable_lsn_ = std::max(durable_lsn_, target);
+      syncing_ = false;
+      followers_cv_.notify_all();
+    }
+  }
+
+private:
+  const size_t max_batch_;
+  const std::chrono::microseconds max_delay_;
+
+  std::atomic<uint64_t> appended_lsn_{0};
+  std::mutex mutex_;
+  std::condition_variable leader_cv_;    ///< The lingering leader
+  std::condition_variable followers_cv_; ///< Writers riding on a sync
+  uint64_t durable_lsn_ = 0;
+  bool syncing_ = false;
+  bool lingering_ = false; ///< The leader waits for more writers
+
+  /// Whether enough records are pending to stop lingering; mutex_ held.
+  [[nodiscard]] bool batch_full() const {
+    return appended_lsn() - durable_lsn_ >= max_batch_;
+  }
+};
+
+} // namespace kvdb
@@ -1,13 +1,88 @@
 #pragma once
 
-#include <fstream>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ordered_index.hpp"
+#include "persistence.hpp"
+#include "stored_value.hpp"
 
 namespace kvdb {
 
+/**
+ * @brief Read-only, point-in-time view of a store, taken for a Raft
+ *        snapshot.
+ *
+ * Iterating one never blocks the store's writers, which keep changing
+ * the live contents meanwhile.
+ */
+class IKVSnapshot {
+public:
+  using Visitor =
+      std::function<void(std::string_view key, std::string_view value)>;
+
+  virtual ~IKVSnapshot() = default;
+
+  /// Visit every live pair exactly once, in no particular order.
+  virtual void for_each(const Visitor &visit) const = 0;
+};
+
+/**
+ * @brief Snapshot backed by a mapped base file and the logs on top of
+ *        it (see LogPersistence::checkpoint).
+ */
+class MappedKVSnapshot : public IKVSnapshot {
+public:
+  explicit MappedKVSnapshot(LogCheckpoint checkpoint)
+      : checkpoint_(std::move(checkpoint)) {}
+
+  void for_each(const Visitor &visit) const override {
+    checkpoint_.for_each(visit);
+  }
+
+private:
+  LogCheckpoint checkpoint_;
+};
+
+/**
+ * @brief A value ready to be sent to an HTTP client (see
+ *        IKVStore::get_encoded).
+ */
+struct EncodedValue {
+  std::string body;
+  /// Content coding of body, e.g. "zstd"; empty if it is the value itself.
+  std::string content_encoding;
+  /// Set if the bytes were left in the engine's mapped base snapshot
+  /// (PersistenceOptions::lazy_values): they are then `mapped`, a view
+  /// into this file's mapping, and `body` is empty.
+  std::shared_ptr<const MappedSnapshot> file = nullptr;
+  std::string_view mapped = {};
+
+  /// The bytes to send, wherever they are.
+  [[nodiscard]] std::string_view bytes() const {
+    return file ? mapped : std::string_view(body);
+  }
+};
+
+/**
+ * @brief One mutation of a batch (see IKVStore::write_batch).
+ */
+struct BatchWrite {
+  std::string key;
+  std::string value;          ///< Unused for a remove
+  uint64_t expires_at_ms = 0; ///< As for set_with_expiry()
+  bool remove = false;
+};
+
 /**
  * @brief Abstract interface for key-value storage.
  *
@@ -16,34 +91,186 @@ namespace kvdb {
  */
 class IKVStore {
 public:
+  using KVPair = std::pair<std::string, std::string>;
+  /// Whether the client accepts a content coding, e.g. "zstd".
+  using CodingFilter = std::function<bool(std::string_view coding)>;
+
   virtual ~IKVStore() = default;
 
   virtual void set(const std::string &key, const std::string &value) = 0;
   virtual std::optional<std::string> get(const std::string &key) const = 0;
   virtual bool remove(const std::string &key) = 0;
   virtual bool contains(const std::string &key) const = 0;
+
+  /**
+   * @brief set(), but the key reads as missing from `expires_at_ms`
+   *        (Unix time in ms; 0 = never) on.
+   * @throws std::runtime_error If the store does not support expiry
+   */
+  virtual void set_with_expiry(const std::string &key,
+                               const std::string &value,
+                               uint64_t expires_at_ms) {
+    if (expires_at_ms != 0) {
+      throw std::runtime_error("Storage engine does not support key expiry");
+    }
+    set(key, value);
+  }
+
+  /**
+   * @brief Delete a key if its deadline is exactly `expires_at_ms`
+   *        (applies a replicated EXPIRE, see ExpiringKVStore).
+   * @return true if the key was deleted
+   */
+  virtual bool expire(const std::string &key, uint64_t expires_at_ms) {
+    return false;
+  }
+
+  /**
+   * @brief get() for many keys at once.
+   * @return One result per key, in order
+   */
+  [[nodiscard]] virtual std::vector<std::optional<std::string>>
+  multi_get(const std::vector<std::string> &keys) const {
+    std::vector<std::optional<std::string>> values;
+    values.reserve(keys.size());
+    for (const auto &key : keys) {
+      values.push_back(get(key));
+    }
+    return values;
+  }
+
+  /**
+   * @brief Apply writes in order, as set_with_expiry() and remove()
+   *        would.
+   *
+   * Engines that override this apply the batch under their locks in
+   * one go, so readers see all of it or none of it, and wait for
+   * durability once. This fallback applies the writes one by one.
+   */
+  virtual void write_batch(std::vector<BatchWrite> writes) {
+    for (auto &write : writes) {
+      if (write.remove) {
+        remove(write.key);
+      } else {
+        set_with_expiry(write.key, write.value, write.expires_at_ms);
+      }
+    }
+  }
+
+  /**
+   * @brief Ordered range scan over [start, end).
+   *
+   * To page through a large range, call again with start set to the
+   * last returned key plus a trailing '\0'.
+   *
+   * @param start Inclusive lower bound ("" = first key)
+   * @param end Exclusive upper bound ("" = unbounded)
+   * @param limit Maximum number of pairs to return
+   */
+  virtual std::vector<KVPair> scan(const std::string &start,
+                                   const std::string &end,
+                                   size_t limit) const = 0;
+
+  /**
+   * @brief All pairs whose key starts with `prefix`, in key order.
+   */
+  [[nodiscard]] std::vector<KVPair> prefix(const std::string &prefix,
+                                           size_t limit) const {
+    return scan(prefix, prefix_upper_bound(prefix), limit);
+  }
+
+  /**
+   * @brief get(), but a value stored compressed in a content coding the
+   *        client accepts may be returned without decompressing it, and
+   *        one still in a mapped base snapshot without copying it.
+   */
+  [[nodiscard]] virtual std::optional<EncodedValue>
+  get_encoded(const std::string &key, const CodingFilter &accepts) const {
+    auto value = get(key);
+    if (value) {
+      return EncodedValue{std::move(*value), {}};
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Visit every live pair, as get() would return it, in no
+   *        particular order.
+   *
+   * Reads the in-memory contents under the store's lock, so it is
+   * cheaper than iterating a snapshot() but holds off writers until it
+   * returns; `visit` must not call back into the store. Meant for
+   * rebuilding derived state on start-up and after restore().
+   */
+  virtual void for_each(const IKVSnapshot::Visitor &visit) const = 0;
+
+  /**
+   * @brief Capture a point-in-time view for a Raft snapshot.
+   *
+   * Returns at once, without copying the data: the view reads it when
+   * iterated, which may take a while but never blocks writers.
+   */
+  virtual std::unique_ptr<IKVSnapshot> snapshot() = 0;
+
+  /**
+   * @brief Replace the entire contents with a snapshot file.
+   *
+   * @param path File in the binary snapshot format (see snapshot.hpp),
+   *             on the same filesystem as the store; it is consumed
+   */
+  virtual void restore(const std::string &path) = 0;
+
+protected:
+  /**
+   * @brief For write_batch() overrides of engines without expiry.
+   * @throws std::runtime_error If a write has a deadline, as
+   *         set_with_expiry() would
+   */
+  static void require_no_expiry(const std::vector<BatchWrite> &writes) {
+    for (const auto &write : writes) {
+      if (!write.remove && write.expires_at_ms != 0) {
+        throw std::runtime_error("Storage engine does not support key expiry");
+      }
+    }
+  }
 };
 
 /**
  * @brief Thread-safe, persistent key-value store.
  *
- * Implements IKVStore with file-based persistence and mutex protection.
- * Uses copy-on-read to avoid lock contention on reads.
+ * Implements IKVStore with log-structured persistence (see
+ * LogPersistence) and mutex protection. Each mutation appends one
+ * WAL record; values are copied out on read.
+ *
+ * With PersistenceOptions::lazy_values, values loaded from the base
+ * snapshot stay in its memory mapping and are paged in on first read.
+ *
+ * A B+-tree index over the map's keys (borrowed, not copied) serves
+ * scan(); point operations only touch the hash map, except that
+ * inserting or removing a key also updates the index.
  */
 class PersistentKVStore : public IKVStore {
 public:
-  explicit PersistentKVStore(std::string db_path)
-      : db_path_(std::move(db_path)) {
+  explicit PersistentKVStore(std::string db_path,
+                             PersistenceOptions options = {})
+      : persistence_(std::move(db_path), options),
+        lazy_values_(options.lazy_values) {
     load();
   }
 
   /**
-   * @brief Store a key-value pair and persist to disk.
+   * @brief Store a key-value pair and append it to the WAL.
+   *
+   * Returns once the record is durable under the configured sync policy.
    */
   void set(const std::string &key, const std::string &value) override {
-    std::lock_guard<std::mutex> lock(mutex_);
-    store_[key] = value;
-    persist();
+    uint64_t lsn;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      lsn = persistence_.append_set(key, value);
+      put(key, StoredValue{value, {}});
+    }
+    persistence_.wait_durable(lsn);
   }
 
   /**
@@ -55,22 +282,92 @@ public:
     std::lock_guard<std::mutex> lock(mutex_);
     auto it = store_.find(key);
     if (it != store_.end()) {
-      return it->second;
+      return std::string(it->second.view());
     }
     return std::nullopt;
   }
 
   /**
-   * @brief Remove a key-value pair and persist to disk.
+   * @brief Retrieve many values under one lock.
+   */
+  [[nodiscard]] std::vector<std::optional<std::string>>
+  multi_get(const std::vector<std::string> &keys) const override {
+    std::vector<std::optional<std::string>> values;
+    values.reserve(keys.size());
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &key : keys) {
+      auto it = store_.find(key);
+      if (it != store_.end()) {
+        values.emplace_back(std::string(it->second.view()));
+      } else {
+        values.emplace_back(std::nullopt);
+      }
+    }
+    return values;
+  }
+
+  /**
+   * @brief Apply and log a batch under one lock; waits for durability
+   *        once, for the last record.
+   * @throws std::runtime_error If a write has a deadline
+   */
+  void write_batch(std::vector<BatchWrite> writes) override {
+    require_no_expiry(writes);
+    uint64_t lsn = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto &write : writes) {
+        if (!write.remove) {
+          lsn = persistence_.append_set(write.key, write.value);
+          put(write.key, StoredValue{std::move(write.value), {}});
+          continue;
+        }
+        auto it = store_.find(write.key);
+        if (it != store_.end()) {
+          lsn = persistence_.append_remove(write.key);
+          index_.erase(write.key);
+          store_.erase(it);
+        }
+      }
+    }
+    if (lsn != 0) {
+      persistence_.wait_durable(lsn);
+    }
+  }
+
+  /**
+   * @brief Remove a key-value pair and append the deletion to the WAL.
    * @return true if the key existed and was removed.
    */
   bool remove(const std::string &key) override {
+    uint64_t lsn;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = store_.find(key);
+      if (it == store_.end()) {
+        return false;
+      }
+      lsn = persistence_.append_remove(key);
+      index_.erase(key);
+      store_.erase(it);
+    }
+    persistence_.wait_durable(lsn);
+    return true;
+  }
+
+  /// Leaves a value still in the base snapshot where it is.
+  [[nodiscard]] std::optional<EncodedValue>
+  get_encoded(const std::string &key,
+              const CodingFilter &accepts) const override {
     std::lock_guard<std::mutex> lock(mutex_);
-    bool erased = store_.erase(key) > 0;
-    if (erased) {
-      persist();
+    auto it = store_.find(key);
+    if (it == store_.end()) {
+      return std::nullopt;
     }
-    return erased;
+    if (base_ && it->second.mapped.data()) {
+      return EncodedValue{{}, {}, base_, it->second.mapped};
+    }
+    return EncodedValue{std::string(it->second.view()), {}};
   }
 
   /**
@@ -81,40 +378,103 @@ public:
     return store_.count(key) > 0;
   }
 
-private:
-  std::string db_path_;
-  std::unordered_map<std::string, std::string> store_;
-  mutable std::mutex mutex_;
+  /**
+   * @brief Ordered range scan over [start, end) via the key index.
+   */
+  [[nodiscard]] std::vector<KVPair> scan(const std::string &start,
+                                         const std::string &end,
+                                         size_t limit) const override {
+    std::vector<KVPair> result;
+    std::lock_guard<std::mutex> lock(mutex_);
+    index_.for_each_from(start, [&](std::string_view key) {
+      if (result.size() >= limit || (!end.empty() && key >= end))
+        return false;
+      auto it = store_.find(std::string(key));
+      result.emplace_back(it->first, std::string(it->second.view()));
+      return true;
+    });
+    return result;
+  }
+
+  void for_each(const IKVSnapshot::Visitor &visit) const override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &[key, value] : store_) {
+      visit(key, value.view());
+    }
+  }
 
   /**
-   * @brief Load data from disk into memory.
+   * @brief Point-in-time view via a checkpoint of the base file and WAL.
    */
-  void load() {
-    std::ifstream file(db_path_);
-    if (!file.is_open())
-      return;
-
-    std::string line;
-    while (std::getline(file, line)) {
-      size_t eq_pos = line.find('=');
-      if (eq_pos != std::string::npos) {
-        store_[line.substr(0, eq_pos)] = line.substr(eq_pos + 1);
+  [[nodiscard]] std::unique_ptr<IKVSnapshot> snapshot() override {
+    return std::make_unique<MappedKVSnapshot>(persistence_.checkpoint());
+  }
+
+  /**
+   * @brief Install a snapshot file as the new base and reload from it.
+   */
+  void restore(const std::string &path) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto base = persistence_.restore_base(path);
+    index_.clear();
+    store_.clear();
+    base_.reset();
+    store_.reserve(base->entry_count());
+    base->for_each([this](std::string_view key, std::string_view value) {
+      if (lazy_values_) {
+        put(key, StoredValue{{}, value});
+      } else {
+        put(key, StoredValue{std::string(value), {}});
       }
+    });
+    if (lazy_values_) {
+      base_ = std::move(base);
     }
   }
 
+private:
+  LogPersistence persistence_;
+  bool lazy_values_;
+  std::shared_ptr<const MappedSnapshot> base_;
+  std::unordered_map<std::string, StoredValue> store_;
+  OrderedIndex<std::string_view> index_; // views into store_ keys
+  mutable std::mutex mutex_;
+
   /**
-   * @brief Persist in-memory data to disk.
-   *
-   * Note: This is a simple implementation. Production systems
-   * should use fsync() and write-ahead logging for durability.
+   * @brief Insert or overwrite an entry, indexing new keys.
    */
-  void persist() {
-    std::ofstream file(db_path_, std::ios::trunc);
-    for (const auto &[key, value] : store_) {
-      file << key << "=" << value << "\n";
+  void put(std::string_view key, StoredValue value) {
+    auto [it, inserted] = store_.try_emplace(std::string(key));
+    it->second = std::move(value);
+    if (inserted) {
+      index_.insert(it->first);
     }
   }
+
+  /**
+   * @brief Rebuild the in-memory map from the base snapshot and WAL.
+   */
+  void load() {
+    persistence_.recover(
+        [this](WalRecordType type, std::string_view key,
+               std::string_view value) {
+          if (type == WalRecordType::DELETE) {
+            if (index_.erase(key)) {
+              store_.erase(std::string(key));
+            }
+          } else if (base_ && base_->contains(value.data())) {
+            put(key, StoredValue{{}, value});
+          } else {
+            put(key, StoredValue{std::string(value), {}});
+          }
+        },
+        [this](std::shared_ptr<const MappedSnapshot> base) {
+          store_.reserve(base->entry_count());
+          if (lazy_values_) {
+            base_ = std::move(base);
+          }
+        });
+  }
 };
 
 } // namespace kvdb
@@ -0,0 +1,1066 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../logging/logger.hpp"
+#include "group_commit.hpp"
+#include "kv_store.hpp"
+#include "memtable.hpp"
+#include "persistence.hpp"
+#include "sorted_iterator.hpp"
+#include "sstable.hpp"
+#include "wal.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Tunables for LsmKVStore.
+ */
+struct LsmOptions {
+  /// Memtable size that triggers a flush to level 0.
+  size_t memtable_bytes = 4 * 1024 * 1024;
+  /// Uncompressed size of one SSTable data block.
+  size_t block_bytes = 4096;
+  size_t bloom_bits_per_key = 10;
+  /// Number of level-0 tables that triggers an L0 -> L1 compaction.
+  size_t l0_compaction_trigger = 4;
+  /// Size budget of level 1; each deeper level gets `level_multiplier`x.
+  uint64_t level1_max_bytes = 32 * 1024 * 1024;
+  size_t level_multiplier = 10;
+  /// Compaction output is split into tables of about this size.
+  uint64_t target_file_bytes = 4 * 1024 * 1024;
+  size_t num_levels = 7;
+};
+
+/**
+ * @brief Shape and activity counters of an LsmKVStore.
+ */
+struct LsmStats {
+  std::vector<size_t> level_tables;
+  std::vector<uint64_t> level_bytes;
+  size_t memtable_bytes = 0;
+  uint64_t flushes = 0;
+  uint64_t compactions = 0;
+  uint64_t trivial_moves = 0;
+  /// Writes that blocked because the previous memtable was still flushing.
+  uint64_t write_stalls = 0;
+};
+
+/**
+ * @brief Log-structured merge-tree store for datasets larger than RAM.
+ *
+ * Writes go to a WAL and a sorted memtable. A full memtable is frozen
+ * and flushed by a background thread into a level-0 SSTable; the same
+ * thread runs leveled compaction: level 0 (overlapping tables) is
+ * merged into level 1 once it holds l0_compaction_trigger tables, and
+ * a deeper level that exceeds its size budget has one table merged
+ * into the next level. Levels >= 1 hold sorted, non-overlapping tables.
+ * Only the memtables, block indexes and bloom filters live in memory.
+ *
+ * All files live in `<db_path>.lsm/`: `<n>.log` WALs, `<n>.sst` tables
+ * and a MANIFEST listing the live tables, rewritten atomically after
+ * every flush or compaction. Recovery replays the WALs not yet covered
+ * by the manifest.
+ *
+ * Reads take a shared lock only long enough to probe the active
+ * memtable and pin the immutable components (frozen memtable plus the
+ * current table set), then search those without any lock. Writes hold
+ * the lock exclusively while appending; durability follows
+ * PersistenceOptions::sync_policy, with group commit for BATCH.
+ * remove() must know whether the key exists, so it searches the tables
+ * while holding the write lock.
+ *
+ * snapshot() pins the same immutable components plus a copy of the
+ * active memtable; restore() bulk-loads a snapshot file straight into
+ * bottom-level tables.
+ */
+class LsmKVStore : public IKVStore {
+public:
+  /**
+   * @brief Open (or create) the store.
+   * @param db_path Base path; files go into `<db_path>.lsm/`
+   * @param persistence WAL sync policy and group commit settings
+   * @param options LSM tunables
+   * @throws std::invalid_argument If `options` has fewer than two levels
+   *         or a zero memtable size
+   * @throws std::runtime_error If existing files cannot be recovered
+   */
+  explicit LsmKVStore(std::string db_path, PersistenceOptions persistence = {},
+                      LsmOptions options = {})
+      : dir_(std::move(db_path) + ".lsm"), persistence_(persistence),
+        options_(options), commit_(persistence.group_commit_max_batch,
+                                   persistence.group_commit_max_delay) {
+    if (options_.num_levels < 2) {
+      throw std::invalid_argument("LsmKVStore needs at least two levels");
+    }
+    if (options_.memtable_bytes == 0) {
+      throw std::invalid_argument("LsmKVStore needs a non-empty memtable");
+    }
+    mem_ = std::make_shared<MemTable>();
+    version_ = std::make_shared<Version>(options_.num_levels);
+    compact_pointer_.resize(options_.num_levels);
+    recover();
+    worker_ = std::thread([this]() { background_loop(); });
+  }
+
+  ~LsmKVStore() override {
+    {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    work_cv_.notify_all();
+    if (worker_.joinable()) {
+      worker_.join();
+    }
+  }
+
+  // Non-copyable
+  LsmKVStore(const LsmKVStore &) = delete;
+  LsmKVStore &operator=(const LsmKVStore &) = delete;
+
+  /**
+   * @brief Store a key-value pair.
+   *
+   * Returns once the record is durable under the configured sync policy.
+   */
+  void set(const std::string &key, const std::string &value) override {
+    uint64_t lsn;
+    {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      make_room(lock);
+      lsn = append(WalRecordType::SET, key, value);
+    }
+    wait_durable(lsn);
+  }
+
+  /**
+   * @brief Retrieve a value by key.
+   * @return The value if found, std::nullopt otherwise.
+   */
+  [[nodiscard]] std::optional<std::string>
+  get(const std::string &key) const override {
+    std::string value;
+    if (lookup(key, &value) == LookupResult::FOUND) {
+      return value;
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Retrieve many values, probing the memtable for all of them
+   *        under one shared lock.
+   */
+  [[nodiscard]] std::vector<std::optional<std::string>>
+  multi_get(const std::vector<std::string> &keys) const override {
+    std::vector<std::optional<std::string>> values(keys.size());
+    std::vector<size_t> misses;
+    std::shared_ptr<const MemTable> imm;
+    std::shared_ptr<const Version> version;
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      std::string value;
+      for (size_t i = 0; i < keys.size(); ++i) {
+        LookupResult result = mem_->get(keys[i], &value);
+        if (result == LookupResult::FOUND) {
+          values[i] = std::move(value);
+        } else if (result == LookupResult::NOT_FOUND) {
+          misses.push_back(i);
+        }
+      }
+      imm = imm_;
+      version = version_;
+    }
+    std::string value;
+    for (size_t i : misses) {
+      if (lookup_frozen(keys[i], &value, imm.get(), *version) ==
+          LookupResult::FOUND) {
+        values[i] = std::move(value);
+      }
+    }
+    return values;
+  }
+
+  /**
+   * @brief Write a batch into one memtable under one lock; waits for
+   *        durability once, for the last record.
+   * @throws std::runtime_error If a write has a deadline
+   */
+  void write_batch(std::vector<BatchWrite> writes) override {
+    require_no_expiry(writes);
+    uint64_t lsn = 0;
+    {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      make_room(lock);
+      for (const auto &write : writes) {
+        if (!write.remove) {
+          lsn = append(WalRecordType::SET, write.key, write.value);
+          continue;
+        }
+        std::string ignored;
+        LookupResult found = mem_->get(write.key, &ignored);
+        if (found == LookupResult::NOT_FOUND) {
+          found = lookup_frozen(write.key, &ignored, imm_.get(), *version_);
+        }
+        if (found == LookupResult::FOUND) {
+          lsn = append(WalRecordType::DELETE, write.key, {});
+        }
+      }
+    }
+    if (lsn != 0) {
+      wait_durable(lsn);
+    }
+  }
+
+  /**
+   * @brief Remove a key by writing a tombstone.
+   * @return true if the key existed and was removed.
+   */
+  bool remove(const std::string &key) override {
+    uint64_t lsn;
+    {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      make_room(lock);
+      std::string ignored;
+      LookupResult found = mem_->get(key, &ignored);
+      if (found == LookupResult::NOT_FOUND) {
+        found = lookup_frozen(key, &ignored, imm_.get(), *version_);
+      }
+      if (found != LookupResult::FOUND) {
+        return false;
+      }
+      lsn = append(WalRecordType::DELETE, key, {});
+    }
+    wait_durable(lsn);
+    return true;
+  }
+
+  /**
+   * @brief Check if a key exists in the store.
+   */
+  [[nodiscard]] bool contains(const std::string &key) const override {
+    std::string ignored;
+    return lookup(key, &ignored) == LookupResult::FOUND;
+  }
+
+  /**
+   * @brief Ordered range scan over [start, end), merging all components.
+   */
+  [[nodiscard]] std::vector<KVPair> scan(const std::string &start,
+                                         const std::string &end,
+                                         size_t limit) const override {
+    std::vector<KVPair> result;
+    if (limit == 0)
+      return result;
+
+    std::unique_ptr<MemTable> active;
+    std::shared_ptr<const MemTable> imm;
+    std::shared_ptr<const Version> version;
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      active = mem_->copy_range(start, end, limit);
+      imm = imm_;
+      version = version_;
+    }
+
+    auto merged = merge_components(*active, imm.get(), *version, start, end);
+    for (merged->seek(start); merged->valid() && result.size() < limit;
+         merged->next()) {
+      if (!end.empty() && merged->key() >= end)
+        break;
+      if (!merged->deleted()) {
+        result.emplace_back(std::string(merged->key()),
+                            std::string(merged->value()));
+      }
+    }
+    return result;
+  }
+
+  /**
+   * @brief Point-in-time view: a copy of the active memtable plus the
+   *        pinned frozen memtable and table set.
+   *
+   * Only the copy happens under the (shared) lock; it is bounded by
+   * LsmOptions::memtable_bytes. Pinned tables stay on disk until the
+   * snapshot is released, even if compaction retires them.
+   */
+  [[nodiscard]] std::unique_ptr<IKVSnapshot> snapshot() override {
+    return capture();
+  }
+
+  /**
+   * @brief Iterates a snapshot(): most of the data is in tables on disk,
+   *        so holding the lock for the whole pass would stall writers.
+   */
+  void for_each(const IKVSnapshot::Visitor &visit) const override {
+    capture()->for_each(visit);
+  }
+
+  /**
+   * @brief Replace all contents with a snapshot file.
+   *
+   * The entries are sorted and written as bottom-level tables, then
+   * swapped in for every existing table, memtable and WAL under one
+   * manifest update. Background work is held off meanwhile; reads and
+   * writes block only for the swap.
+   */
+  void restore(const std::string &path) override {
+    std::lock_guard<std::mutex> maintenance(maintenance_mutex_);
+
+    auto base = MappedSnapshot::open(path, true);
+    std::vector<SortedVectorIterator::Entry> entries;
+    entries.reserve(base->entry_count());
+    base->for_each([&entries](std::string_view key, std::string_view value) {
+      entries.emplace_back(key, value);
+    });
+    std::sort(entries.begin(), entries.end(),
+              [](const SortedVectorIterator::Entry &a,
+                 const SortedVectorIterator::Entry &b) {
+                return a.first < b.first;
+              });
+    SortedVectorIterator it(entries);
+    auto tables = write_tables(it, false, options_.target_file_bytes);
+
+    auto version = std::make_shared<Version>(options_.num_levels);
+    version->levels.back() = tables;
+    std::shared_ptr<const Version> old_version;
+    std::vector<uint64_t> obsolete_wals;
+    const uint64_t number = next_file_number_++;
+    {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      try {
+        write_manifest(*version, number);
+      } catch (...) {
+        for (const auto &table : tables) {
+          table->mark_obsolete();
+        }
+        throw;
+      }
+      {
+        std::lock_guard<std::mutex> sync_lock(sync_mutex_);
+        wal_.open(wal_path(number));
+      }
+      obsolete_wals.swap(imm_wal_numbers_);
+      obsolete_wals.push_back(wal_number_);
+      wal_number_ = number;
+      mem_ = std::make_shared<MemTable>();
+      imm_.reset();
+      old_version = std::move(version_);
+      version_ = version;
+    }
+    flushed_cv_.notify_all();
+
+    log_number_ = number;
+    std::fill(compact_pointer_.begin(), compact_pointer_.end(), std::string());
+    for (const auto &level : old_version->levels) {
+      for (const auto &table : level) {
+        table->mark_obsolete();
+      }
+    }
+    for (uint64_t obsolete : obsolete_wals) {
+      std::remove(wal_path(obsolete).c_str());
+    }
+    std::remove(path.c_str());
+  }
+
+  /**
+   * @brief Snapshot of the tree shape and background activity.
+   */
+  [[nodiscard]] LsmStats stats() const {
+    LsmStats stats;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (const auto &level : version_->levels) {
+      uint64_t bytes = 0;
+      for (const auto &table : level) {
+        bytes += table->file_size();
+      }
+      stats.level_tables.push_back(level.size());
+      stats.level_bytes.push_back(bytes);
+    }
+    stats.memtable_bytes = mem_->approximate_bytes();
+    stats.flushes = flushes_.load(std::memory_order_relaxed);
+    stats.compactions = compactions_.load(std::memory_order_relaxed);
+    stats.trivial_moves = trivial_moves_.load(std::memory_order_relaxed);
+    stats.write_stalls = write_stalls_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+private:
+  /**
+   * @brief Immutable set of live tables. Replaced wholesale (copy on
+   *        write) by the background thread, so readers can pin one.
+   *
+   * Level 0 is ordered newest first; deeper levels by smallest key.
+   */
+  struct Version {
+    explicit Version(size_t num_levels) : levels(num_levels) {}
+    std::vector<std::vector<std::shared_ptr<SSTable>>> levels;
+  };
+
+  static constexpr const char *kManifestHeader = "kvdb-lsm-manifest 1";
+
+  struct Snapshot : IKVSnapshot {
+    std::unique_ptr<MemTable> active;
+    std::shared_ptr<const MemTable> imm;
+    std::shared_ptr<const Version> version;
+
+    void for_each(const Visitor &visit) const override {
+      auto merged = merge_components(*active, imm.get(), *version, {}, {});
+      for (merged->seek_to_first(); merged->valid(); merged->next()) {
+        if (!merged->deleted()) {
+          visit(merged->key(), merged->value());
+        }
+      }
+    }
+  };
+
+  /// Copy the active memtable and pin the rest (see snapshot()).
+  [[nodiscard]] std::unique_ptr<Snapshot> capture() const {
+    auto snapshot = std::make_unique<Snapshot>();
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    snapshot->active = mem_->copy_range({}, {}, mem_->size());
+    snapshot->imm = imm_;
+    snapshot->version = version_;
+    return snapshot;
+  }
+
+  std::string dir_;
+  PersistenceOptions persistence_;
+  LsmOptions options_;
+
+  // Guards mem_, imm_, imm_wal_numbers_, version_, the WAL and stopping_.
+  // Lock order: mutex_ -> sync_mutex_.
+  mutable std::shared_mutex mutex_;
+  std::condition_variable_any work_cv_;    // background thread wake-up
+  std::condition_variable_any flushed_cv_; // imm_ was flushed
+  std::shared_ptr<MemTable> mem_;
+  std::shared_ptr<const MemTable> imm_;
+  std::vector<uint64_t> imm_wal_numbers_; // WALs whose records are in imm_
+  std::shared_ptr<const Version> version_;
+  bool stopping_ = false;
+
+  WriteAheadLog wal_;
+  uint64_t wal_number_ = 0;
+  GroupCommit commit_;
+  std::mutex sync_mutex_;
+  std::atomic<uint64_t> next_file_number_{1};
+
+  // Owned by whoever holds maintenance_mutex_: the background thread
+  // while it runs a flush or compaction, or restore().
+  // Lock order: maintenance_mutex_ -> mutex_.
+  std::mutex maintenance_mutex_;
+  std::thread worker_;
+  uint64_t log_number_ = 0; // WALs numbered below this are obsolete
+  std::vector<std::string> compact_pointer_;
+
+  std::atomic<uint64_t> flushes_{0};
+  std::atomic<uint64_t> compactions_{0};
+  std::atomic<uint64_t> trivial_moves_{0};
+  mutable std::atomic<uint64_t> write_stalls_{0};
+
+  // ---- Write path ----
+
+  /**
+   * @brief Append one record to the WAL and the memtable. Caller holds
+   *        mutex_ exclusively.
+   */
+  uint64_t append(WalRecordType type, std::string_view key,
+                  std::string_view value) {
+    wal_.append(type, key, value);
+    if (persistence_.sync_policy == SyncPolicy::WRITE) {
+      wal_.sync();
+    }
+    const uint64_t lsn = commit_.next_lsn();
+    if (type == WalRecordType::SET) {
+      mem_->put(key, value);
+    } else {
+      mem_->remove(key);
+    }
+    return lsn;
+  }
+
+  void wait_durable(uint64_t lsn) {
+    if (persistence_.sync_policy != SyncPolicy::BATCH)
+      return;
+    commit_.wait(lsn, [this]() {
+      std::lock_guard<std::mutex> sync_lock(sync_mutex_);
+      const uint64_t target = commit_.appended_lsn();
+      wal_.sync();
+      return target;
+    });
+  }
+
+  /**
+   * @brief Freeze a full memtable, stalling while the previous one is
+   *        still being flushed. Caller holds mutex_ exclusively.
+   */
+  void make_room(std::unique_lock<std::shared_mutex> &lock) {
+    while (mem_->approximate_bytes() >= options_.memtable_bytes) {
+      if (imm_) {
+        write_stalls_.fetch_add(1, std::memory_order_relaxed);
+        flushed_cv_.wait(lock);
+        continue;
+      }
+
+      const uint64_t number = next_file_number_++;
+      {
+        // Sync the outgoing log so group-commit waiters whose records it
+        // holds are covered by the next sync of the new one
+        std::lock_guard<std::mutex> sync_lock(sync_mutex_);
+        if (persistence_.sync_policy != SyncPolicy::NONE) {
+          wal_.sync();
+        }
+        wal_.open(wal_path(number));
+      }
+      imm_wal_numbers_.push_back(wal_number_);
+      wal_number_ = number;
+      imm_ = std::move(mem_);
+      mem_ = std::make_shared<MemTable>();
+      work_cv_.notify_one();
+    }
+  }
+
+  // ---- Read path ----
+
+  LookupResult lookup(std::string_view key, std::string *value) const {
+    std::shared_ptr<const MemTable> imm;
+    std::shared_ptr<const Version> version;
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      LookupResult result = mem_->get(key, value);
+      if (result != LookupResult::NOT_FOUND)
+        return result;
+      imm = imm_;
+      version = version_;
+    }
+    return lookup_frozen(key, value, imm.get(), *version);
+  }
+
+  /**
+   * @brief Merge the given components, newest first, skipping tables
+   *        outside [start, end) ("" = unbounded).
+   */
+  static std::unique_ptr<MergingIterator>
+  merge_components(const MemTable &active, const MemTable *imm,
+                   const Version &version, std::string_view start,
+                   std::string_view end) {
+    auto in_range = [&](const SSTable &table) {
+      return table.largest() >= start && (end.empty() || table.smallest() < end);
+    };
+
+    std::vector<std::unique_ptr<ISortedIterator>> children;
+    children.push_back(active.iterator());
+    if (imm) {
+      children.push_back(imm->iterator());
+    }
+    for (const auto &table : version.levels[0]) {
+      if (in_range(*table)) {
+        children.push_back(table->iterator());
+      }
+    }
+    for (size_t level = 1; level < version.levels.size(); ++level) {
+      std::vector<std::shared_ptr<SSTable>> tables;
+      for (const auto &table : version.levels[level]) {
+        if (in_range(*table)) {
+          tables.push_back(table);
+        }
+      }
+      if (!tables.empty()) {
+        children.push_back(std::make_unique<LevelIterator>(std::move(tables)));
+      }
+    }
+    return std::make_unique<MergingIterator>(std::move(children));
+  }
+
+  /**
+   * @brief Search the frozen memtable and tables, newest first.
+   */
+  static LookupResult lookup_frozen(std::string_view key, std::string *value,
+                                    const MemTable *imm,
+                                    const Version &version) {
+    if (imm) {
+      LookupResult result = imm->get(key, value);
+      if (result != LookupResult::NOT_FOUND)
+        return result;
+    }
+    for (const auto &table : version.levels[0]) {
+      LookupResult result = table->get(key, value);
+      if (result != LookupResult::NOT_FOUND)
+        return result;
+    }
+    for (size_t level = 1; level < version.levels.size(); ++level) {
+      const auto &tables = version.levels[level];
+      auto it = std::lower_bound(tables.begin(), tables.end(), key,
+                                 [](const std::shared_ptr<SSTable> &t,
+                                    std::string_view k) {
+                                   return t->largest() < k;
+                                 });
+      if (it == tables.end() || (*it)->smallest() > key)
+        continue;
+      LookupResult result = (*it)->get(key, value);
+      if (result != LookupResult::NOT_FOUND)
+        return result;
+    }
+    return LookupResult::NOT_FOUND;
+  }
+
+  // ---- Background flush and compaction ----
+
+  void background_loop() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    while (true) {
+      work_cv_.wait(lock, [this]() {
+        return stopping_ || imm_ || pick_level(*version_).has_value();
+      });
+      if (stopping_)
+        return;
+      lock.unlock();
+
+      bool failed = false;
+      {
+        std::lock_guard<std::mutex> maintenance(maintenance_mutex_);
+        // Decide only now: a restore() may have run since the wake-up
+        bool flush;
+        std::optional<size_t> level;
+        {
+          std::shared_lock<std::shared_mutex> state(mutex_);
+          flush = imm_ != nullptr;
+          level = flush ? std::nullopt : pick_level(*version_);
+        }
+        try {
+          if (flush) {
+            flush_memtable();
+          } else if (level) {
+            compact(*level);
+          }
+        } catch (const std::exception &e) {
+          KVDB_LOG(LogLevel::ERROR, "Storage",
+                   "LSM " << (flush ? "flush" : "compaction") << " failed: "
+                      << e.what());
+          failed = true;
+        }
+      }
+
+      lock.lock();
+      if (failed && !stopping_) {
+        // Retry later rather than spinning on a persistent I/O error
+        work_cv_.wait_for(lock, std::chrono::seconds(1));
+      }
+    }
+  }
+
+  /**
+   * @brief Level most in need of compaction, if any.
+   */
+  [[nodiscard]] std::optional<size_t> pick_level(const Version &version) const {
+    if (version.levels[0].size() >= options_.l0_compaction_trigger)
+      return 0;
+
+    std::optional<size_t> picked;
+    double best = 1.0;
+    double max_bytes = static_cast<double>(options_.level1_max_bytes);
+    for (size_t level = 1; level + 1 < version.levels.size(); ++level) {
+      uint64_t bytes = 0;
+      for (const auto &table : version.levels[level]) {
+        bytes += table->file_size();
+      }
+      const double score = static_cast<double>(bytes) / max_bytes;
+      if (score >= best) {
+        best = score;
+        picked = level;
+      }
+      max_bytes *= static_cast<double>(options_.level_multiplier);
+    }
+    return picked;
+  }
+
+  /**
+   * @brief Write the frozen memtable to a new level-0 table.
+   */
+  void flush_memtable() {
+    std::shared_ptr<const MemTable> imm;
+    uint64_t log_number;
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      imm = imm_;
+      // Stable: no memtable can be frozen while imm_ is set
+      log_number = wal_number_;
+    }
+
+    auto it = imm->iterator();
+    auto tables = write_tables(*it, false,
+                               std::numeric_limits<uint64_t>::max());
+
+    auto version = std::make_shared<Version>(*version_);
+    version->levels[0].insert(version->levels[0].begin(), tables.begin(),
+                              tables.end());
+    write_manifest(*version, log_number);
+
+    std::vector<uint64_t> obsolete_wals;
+    {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      version_ = version;
+      imm_.reset();
+      obsolete_wals.swap(imm_wal_numbers_);
+    }
+    flushed_cv_.notify_all();
+    log_number_ = log_number;
+    for (uint64_t number : obsolete_wals) {
+      std::remove(wal_path(number).c_str());
+    }
+    flushes_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Merge tables from `level` into `level + 1`.
+   *
+   * All of level 0, or one table of a deeper level (round robin across
+   * its key space), is merged with the overlapping tables of the next
+   * level. A deeper-level table with no overlap is moved without
+   * rewriting it. Tombstones are dropped once no deeper level could
+   * hold an older value for their key.
+   */
+  void compact(size_t level) {
+    const Version &current = *version_;
+    std::vector<std::shared_ptr<SSTable>> inputs;
+    if (level == 0) {
+      inputs = current.levels[0];
+    } else {
+      inputs.push_back(pick_table(level, current.levels[level]));
+    }
+
+    std::string smallest = inputs.front()->smallest();
+    std::string largest = inputs.front()->largest();
+    for (const auto &table : inputs) {
+      smallest = std::min(smallest, table->smallest());
+      largest = std::max(largest, table->largest());
+    }
+    std::vector<std::shared_ptr<SSTable>> next_inputs;
+    for (const auto &table : current.levels[level + 1]) {
+      if (table->overlaps(smallest, largest)) {
+        next_inputs.push_back(table);
+      }
+    }
+
+    auto version = std::make_shared<Version>(current);
+    remove_tables(version->levels[level], inputs);
+    remove_tables(version->levels[level + 1], next_inputs);
+
+    const bool trivial_move = level > 0 && next_inputs.empty();
+    std::vector<std::shared_ptr<SSTable>> outputs;
+    if (trivial_move) {
+      outputs = inputs;
+    } else {
+      bool bottom = true;
+      for (size_t deeper = level + 2; deeper < current.levels.size();
+           ++deeper) {
+        bottom = bottom && current.levels[deeper].empty();
+      }
+
+      // Newest first: level-0 tables are already ordered that way
+      std::vector<std::unique_ptr<ISortedIterator>> children;
+      for (const auto &table : inputs) {
+        children.push_back(table->iterator());
+      }
+      children.push_back(std::make_unique<LevelIterator>(next_inputs));
+      MergingIterator merged(std::move(children));
+      outputs = write_tables(merged, bottom, options_.target_file_bytes);
+    }
+
+    auto &target = version->levels[level + 1];
+    target.insert(target.end(), outputs.begin(), outputs.end());
+    std::sort(target.begin(), target.end(),
+              [](const std::shared_ptr<SSTable> &a,
+                 const std::shared_ptr<SSTable> &b) {
+                return a->smallest() < b->smallest();
+              });
+    write_manifest(*version, log_number_);
+
+    {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      version_ = version;
+    }
+
+    if (trivial_move) {
+      trivial_moves_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    // Files go away once in-flight readers release them
+    for (const auto &table : inputs) {
+      table->mark_obsolete();
+    }
+    for (const auto &table : next_inputs) {
+      table->mark_obsolete();
+    }
+    compactions_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Next table of `level` to compact, cycling through key space.
+   */
+  std::shared_ptr<SSTable>
+  pick_table(size_t level, const std::vector<std::shared_ptr<SSTable>> &tables) {
+    const std::string &pointer = compact_pointer_[level];
+    auto it = std::find_if(tables.begin(), tables.end(),
+                           [&](const std::shared_ptr<SSTable> &t) {
+                             return t->smallest() > pointer;
+                           });
+    const auto &table = it != tables.end() ? *it : tables.front();
+    compact_pointer_[level] = table->largest();
+    return table;
+  }
+
+  static void remove_tables(std::vector<std::shared_ptr<SSTable>> &level,
+                            const std::vector<std::shared_ptr<SSTable>> &gone) {
+    level.erase(std::remove_if(level.begin(), level.end(),
+                               [&](const std::shared_ptr<SSTable> &t) {
+                                 return std::find(gone.begin(), gone.end(),
+                                                  t) != gone.end();
+                               }),
+                level.end());
+  }
+
+  /**
+   * @brief Write an iterator's entries into new tables of about
+   *        `max_file_bytes` each.
+   */
+  std::vector<std::shared_ptr<SSTable>>
+  write_tables(ISortedIterator &it, bool drop_tombstones,
+               uint64_t max_file_bytes) {
+    std::vector<std::shared_ptr<SSTable>> tables;
+    std::unique_ptr<SSTableWriter> writer;
+    uint64_t number = 0;
+
+    auto finish_table = [&]() {
+      writer->finish();
+      writer.reset();
+      tables.push_back(SSTable::open(table_path(number), number));
+    };
+
+    try {
+      for (it.seek_to_first(); it.valid(); it.next()) {
+        if (drop_tombstones && it.deleted())
+          continue;
+        if (!writer) {
+          number = next_file_number_++;
+          writer = std::make_unique<SSTableWriter>(
+              table_path(number), options_.block_bytes,
+              options_.bloom_bits_per_key);
+        }
+        writer->add(it.key(), it.value(), it.deleted());
+        if (writer->file_size() >= max_file_bytes) {
+          finish_table();
+        }
+      }
+      if (writer) {
+        finish_table();
+      }
+      sync_path(dir_);
+    } catch (...) {
+      for (const auto &table : tables) {
+        table->mark_obsolete();
+      }
+      throw;
+    }
+    return tables;
+  }
+
+  // ---- Files and recovery ----
+
+  [[nodiscard]] std::string wal_path(uint64_t number) const {
+    return dir_ + "/" + std::to_string(number) + ".log";
+  }
+
+  [[nodiscard]] std::string table_path(uint64_t number) const {
+    return dir_ + "/" + std::to_string(number) + ".sst";
+  }
+
+  [[nodiscard]] std::string manifest_path() const {
+    return dir_ + "/MANIFEST";
+  }
+
+  /**
+   * @brief Atomically replace the manifest with `version`.
+   */
+  void write_manifest(const Version &version, uint64_t log_number) {
+    std::ostringstream out;
+    out << kManifestHeader << "\n"
+        << "next_file " << next_file_number_.load() << "\n"
+        << "log_number " << log_number << "\n";
+    for (size_t level = 0; level < version.levels.size(); ++level) {
+      for (const auto &table : version.levels[level]) {
+        out << "table " << level << " " << table->file_number() << "\n";
+      }
+    }
+    const std::string content = out.str();
+
+    const std::string tmp = manifest_path() + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    0644);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to create " + tmp + ": " +
+                               std::strerror(errno));
+    }
+    bool ok = ::write(fd, content.data(), content.size()) ==
+                  static_cast<ssize_t>(content.size()) &&
+              ::fsync(fd) == 0;
+    ok = (::close(fd) == 0) && ok;
+    if (!ok || std::rename(tmp.c_str(), manifest_path().c_str()) != 0) {
+      std::remove(tmp.c_str());
+      throw std::runtime_error("Failed to publish " + manifest_path());
+    }
+    sync_path(dir_);
+  }
+
+  /**
+   * @brief Load the manifest and tables, then replay unflushed WALs.
+   *
+   * Replayed records become the frozen memtable, so the background
+   * thread flushes them right away and writers start on a fresh WAL.
+   * Files a crash left behind (temp files, tables no manifest refers
+   * to) are deleted.
+   */
+  void recover() {
+    if (::mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+      throw std::runtime_error("Failed to create " + dir_ + ": " +
+                               std::strerror(errno));
+    }
+
+    uint64_t next_file = 1;
+    std::set<uint64_t> live_tables;
+    auto version = std::make_shared<Version>(options_.num_levels);
+
+    std::ifstream manifest(manifest_path());
+    if (manifest.is_open()) {
+      std::string line;
+      if (!std::getline(manifest, line) || line != kManifestHeader) {
+        throw std::runtime_error("Bad LSM manifest: " + manifest_path());
+      }
+      while (std::getline(manifest, line)) {
+        std::istringstream fields(line);
+        std::string tag;
+        fields >> tag;
+        if (tag == "next_file") {
+          fields >> next_file;
+        } else if (tag == "log_number") {
+          fields >> log_number_;
+        } else if (tag == "table") {
+          size_t level = 0;
+          uint64_t number = 0;
+          fields >> level >> number;
+          if (!fields || level >= options_.num_levels) {
+            throw std::runtime_error("Bad LSM manifest entry: " + line);
+          }
+          version->levels[level].push_back(
+              SSTable::open(table_path(number), number));
+          live_tables.insert(number);
+        }
+      }
+    }
+    std::sort(version->levels[0].begin(), version->levels[0].end(),
+              [](const std::shared_ptr<SSTable> &a,
+                 const std::shared_ptr<SSTable> &b) {
+                return a->file_number() > b->file_number();
+              });
+    for (size_t level = 1; level < version->levels.size(); ++level) {
+      std::sort(version->levels[level].begin(), version->levels[level].end(),
+                [](const std::shared_ptr<SSTable> &a,
+                   const std::shared_ptr<SSTable> &b) {
+                  return a->smallest() < b->smallest();
+                });
+    }
+    version_ = version;
+
+    std::vector<uint64_t> wals;
+    DIR *dir = ::opendir(dir_.c_str());
+    if (!dir) {
+      throw std::runtime_error("Failed to list " + dir_);
+    }
+    while (dirent *entry = ::readdir(dir)) {
+      const std::string name = entry->d_name;
+      const std::string path = dir_ + "/" + name;
+      char *suffix = nullptr;
+      const uint64_t number = std::strtoull(name.c_str(), &suffix, 10);
+      if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+        std::remove(path.c_str());
+      } else if (suffix != name.c_str() && std::strcmp(suffix, ".log") == 0) {
+        wals.push_back(number);
+        next_file = std::max(next_file, number + 1);
+      } else if (suffix != name.c_str() && std::strcmp(suffix, ".sst") == 0) {
+        if (live_tables.count(number) == 0) {
+          std::remove(path.c_str());
+        }
+        next_file = std::max(next_file, number + 1);
+      }
+    }
+    ::closedir(dir);
+    std::sort(wals.begin(), wals.end());
+
+    auto recovered = std::make_shared<MemTable>();
+    for (uint64_t number : wals) {
+      if (number < log_number_) {
+        std::remove(wal_path(number).c_str());
+        continue;
+      }
+      WriteAheadLog::replay(wal_path(number),
+                            [&recovered](WalRecordType type,
+                                         std::string_view key,
+                                         std::string_view value) {
+                              if (type == WalRecordType::SET) {
+                                recovered->put(key, value);
+                              } else {
+                                recovered->remove(key);
+                              }
+                            });
+      imm_wal_numbers_.push_back(number);
+    }
+    if (!recovered->empty()) {
+      imm_ = std::move(recovered);
+    } else {
+      for (uint64_t number : imm_wal_numbers_) {
+        std::remove(wal_path(number).c_str());
+      }
+      imm_wal_numbers_.clear();
+    }
+
+    next_file_number_ = next_file;
+    wal_number_ = next_file_number_++;
+    wal_.open(wal_path(wal_number_));
+  }
+
+  static void sync_path(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || ::fsync(fd) != 0) {
+      if (fd >= 0)
+        ::close(fd);
+      throw std::runtime_error("Failed to fsync " + path);
+    }
+    ::close(fd);
+  }
+};
+
+} // namespace kvdb
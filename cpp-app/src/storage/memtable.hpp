@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "sorted_iterator.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief In-memory, sorted write buffer of the LSM tree.
+ *
+ * Holds the newest version of each recently written key; a deletion is
+ * kept as a tombstone (std::nullopt) so it can shadow older values in
+ * flushed tables. Once full, the memtable is frozen and flushed to an
+ * SSTable by the background thread.
+ *
+ * Not thread-safe: the owner serializes writers against readers.
+ */
+class MemTable {
+public:
+  using Map = std::map<std::string, std::optional<std::string>, std::less<>>;
+
+  class Iterator;
+
+  void put(std::string_view key, std::string_view value) {
+    assign(key, std::optional<std::string>(std::in_place, value));
+  }
+
+  void remove(std::string_view key) { assign(key, std::nullopt); }
+
+  /**
+   * @brief Look up one key.
+   * @param value Receives the value when FOUND
+   */
+  LookupResult get(std::string_view key, std::string *value) const {
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+      return LookupResult::NOT_FOUND;
+    if (!it->second)
+      return LookupResult::DELETED;
+    *value = *it->second;
+    return LookupResult::FOUND;
+  }
+
+  /**
+   * @brief Copy the entries of [start, end) up to and including the
+   *        `live_limit`-th live entry.
+   *
+   * Tombstones in the range are copied too, since they must still hide
+   * older values when merged with flushed tables.
+   */
+  [[nodiscard]] std::unique_ptr<MemTable>
+  copy_range(std::string_view start, std::string_view end,
+             size_t live_limit) const {
+    auto copy = std::make_unique<MemTable>();
+    size_t live = 0;
+    for (auto it = entries_.lower_bound(start);
+         it != entries_.end() && live < live_limit; ++it) {
+      if (!end.empty() && it->first >= end)
+        break;
+      copy->assign(it->first, it->second);
+      if (it->second)
+        ++live;
+    }
+    return copy;
+  }
+
+  /**
+   * @brief Approximate heap footprint, used to decide when to flush.
+   */
+  [[nodiscard]] size_t approximate_bytes() const { return bytes_; }
+  [[nodiscard]] size_t size() const { return entries_.size(); }
+  [[nodiscard]] bool empty() const { return entries_.empty(); }
+
+  [[nodiscard]] std::unique_ptr<Iterator> iterator() const;
+
+private:
+  // Rough per-entry cost of a std::map node plus two std::strings
+  static constexpr size_t kEntryOverhead = 96;
+
+  Map entries_;
+  size_t bytes_ = 0;
+
+  static size_t entry_bytes(const std::string &key,
+                            const std::optional<std::string> &value) {
+    return kEntryOverhead + key.size() + (value ? value->size() : 0);
+  }
+
+  void assign(std::string_view key, std::optional<std::string> value) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+      it = entries_.emplace(std::string(key), std::nullopt).first;
+    } else {
+      bytes_ -= entry_bytes(it->first, it->second);
+    }
+    it->second = std::move(value);
+    bytes_ += entry_bytes(it->first, it->second);
+  }
+};
+
+/**
+ * @brief Iterator over a memtable that is no longer being written.
+ */
+class MemTable::Iterator : public ISortedIterator {
+public:
+  explicit Iterator(const Map &entries)
+      : entries_(entries), it_(entries.end()) {}
+
+  void seek(std::string_view target) override {
+    it_ = entries_.lower_bound(target);
+  }
+  void seek_to_first() override { it_ = entries_.begin(); }
+  [[nodiscard]] bool valid() const override { return it_ != entries_.end(); }
+  [[nodiscard]] std::string_view key() const override { return it_->first; }
+  [[nodiscard]] std::string_view value() const override {
+    return it_->second ? std::string_view(*it_->second) : std::string_view();
+  }
+  [[nodiscard]] bool deleted() const override { return !it_->second; }
+  void next() override { ++it_; }
+
+private:
+  const Map &entries_;
+  Map::const_iterator it_;
+};
+
+inline std::unique_ptr<MemTable::Iterator> MemTable::iterator() const {
+  return std::make_unique<Iterator>(entries_);
+}
+
+} // namespace kvdb
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace kvdb {
+
+/**
+ * @brief In-memory B+-tree over keys, used as an ordered secondary index.
+ *
+ * Holds keys only; the owning store keeps values in its hash table so
+ * point lookups never touch the tree. Leaves are chained for range
+ * scans. Nodes hold up to kMaxKeys keys and are rebalanced (borrow or
+ * merge) on erase, so the tree stays within half occupancy.
+ *
+ * `Key` is std::string (the tree owns its keys) or std::string_view
+ * (the tree borrows keys whose storage the owner keeps stable, e.g.
+ * unordered_map nodes; the owner must erase from the index first).
+ *
+ * Not thread-safe.
+ */
+template <typename Key> class OrderedIndex {
+public:
+  OrderedIndex() : root_(std::make_unique<Node>(true)) {}
+
+  // Non-copyable
+  OrderedIndex(const OrderedIndex &) = delete;
+  OrderedIndex &operator=(const OrderedIndex &) = delete;
+
+  /**
+   * @brief Insert a key.
+   * @return false if it was already present
+   */
+  bool insert(const Key &key) {
+    Split split;
+    if (!insert_into(*root_, key, split))
+      return false;
+    if (split.right) {
+      auto new_root = std::make_unique<Node>(false);
+      new_root->separators.push_back(std::move(split.separator));
+      new_root->children.push_back(std::move(root_));
+      new_root->children.push_back(std::move(split.right));
+      root_ = std::move(new_root);
+    }
+    ++size_;
+    return true;
+  }
+
+  /**
+   * @brief Erase a key.
+   * @return true if it was present
+   */
+  bool erase(std::string_view key) {
+    if (!erase_from(*root_, key))
+      return false;
+    if (!root_->leaf && root_->separators.empty()) {
+      root_ = std::move(root_->children.front());
+    }
+    --size_;
+    return true;
+  }
+
+  [[nodiscard]] size_t size() const { return size_; }
+
+  void clear() {
+    root_ = std::make_unique<Node>(true);
+    size_ = 0;
+  }
+
+  /**
+   * @brief Visit keys >= start in ascending order.
+   *
+   * @param start Inclusive lower bound
+   * @param visit Called per key; return false to stop
+   */
+  template <typename Visitor>
+  void for_each_from(std::string_view start, Visitor &&visit) const {
+    const Node *node = root_.get();
+    while (!node->leaf) {
+      node = node->children[child_index(*node, start)].get();
+    }
+
+    auto it = std::lower_bound(node->keys.begin(), node->keys.end(), start,
+                               [](const Key &a, std::string_view b) {
+                                 return std::string_view(a) < b;
+                               });
+    size_t pos = static_cast<size_t>(it - node->keys.begin());
+
+    while (node) {
+      for (; pos < node->keys.size(); ++pos) {
+        if (!visit(std::string_view(node->keys[pos])))
+          return;
+      }
+      node = node->next;
+      pos = 0;
+    }
+  }
+
+private:
+  static constexpr size_t kMaxKeys = 64;
+  static constexpr size_t kMinKeys = kMaxKeys / 2;
+
+  /**
+   * Leaves hold keys; internal nodes hold separators. Separators are
+   * always owned copies: a separator can outlive the leaf key it was
+   * copied from, so it must not borrow that key's storage.
+   */
+  struct Node {
+    explicit Node(bool is_leaf) : leaf(is_leaf) {}
+
+    bool leaf;
+    std::vector<Key> keys;                       // leaves only
+    std::vector<std::string> separators;         // internal nodes only
+    std::vector<std::unique_ptr<Node>> children; // internal nodes only
+    Node *next = nullptr;                        // leaf chain
+
+    [[nodiscard]] size_t count() const {
+      return leaf ? keys.size() : separators.size();
+    }
+  };
+
+  struct Split {
+    std::string separator;
+    std::unique_ptr<Node> right;
+  };
+
+  std::unique_ptr<Node> root_;
+  size_t size_ = 0;
+
+  /**
+   * @brief Child to descend into: child i holds [sep[i-1], sep[i]).
+   */
+  static size_t child_index(const Node &node, std::string_view key) {
+    auto it = std::upper_bound(
+        node.separators.begin(), node.separators.end(), key,
+        [](std::string_view a, const std::string &b) { return a < b; });
+    return static_cast<size_t>(it - node.separators.begin());
+  }
+
+  bool insert_into(Node &node, const Key &key, Split &split) {
+    if (node.leaf) {
+      auto it = std::lower_bound(node.keys.begin(), node.keys.end(), key,
+                                 [](const Key &a, const Key &b) {
+                                   return std::string_view(a) <
+                                          std::string_view(b);
+                                 });
+      if (it != node.keys.end() &&
+          std::string_view(*it) == std::string_view(key))
+        return false;
+      node.keys.insert(it, key);
+
+      if (node.keys.size() > kMaxKeys) {
+        auto right = std::make_unique<Node>(true);
+        const size_t mid = node.keys.size() / 2;
+        right->keys.assign(std::make_move_iterator(node.keys.begin() + mid),
+                           std::make_move_iterator(node.keys.end()));
+        node.keys.resize(mid);
+        right->next = node.next;
+        node.next = right.get();
+        split.separator = std::string(std::string_view(right->keys.front()));
+        split.right = std::move(right);
+      }
+      return true;
+    }
+
+    const size_t index = child_index(node, std::string_view(key));
+    Split child_split;
+    if (!insert_into(*node.children[index], key, child_split))
+      return false;
+
+    if (child_split.right) {
+      node.separators.insert(node.separators.begin() + index,
+                             std::move(child_split.separator));
+      node.children.insert(node.children.begin() + index + 1,
+                           std::move(child_split.right));
+
+      if (node.separators.size() > kMaxKeys) {
+        auto right = std::make_unique<Node>(false);
+        const size_t mid = node.separators.size() / 2;
+        split.separator = std::move(node.separators[mid]);
+        right->separators.assign(
+            std::make_move_iterator(node.separators.begin() + mid + 1),
+            std::make_move_iterator(node.separators.end()));
+        right->children.assign(
+            std::make_move_iterator(node.children.begin() + mid + 1),
+            std::make_move_iterator(node.children.end()));
+        node.separators.resize(mid);
+        node.children.resize(mid + 1);
+        split.right = std::move(right);
+      }
+    }
+    return true;
+  }
+
+  bool erase_from(Node &node, std::string_view key) {
+    if (node.leaf) {
+      auto it = std::lower_bound(node.keys.begin(), node.keys.end(), key,
+                                 [](const Key &a, std::string_view b) {
+                                   return std::string_view(a) < b;
+                                 });
+      if (it == node.keys.end() || std::string_view(*it) != key)
+        return false;
+      node.keys.erase(it);
+      return true;
+    }
+
+    const size_t index = child_index(node, key);
+    if (!erase_from(*node.children[index], key))
+      return false;
+    if (node.children[index]->count() < kMinKeys) {
+      rebalance(node, index);
+    }
+    return true;
+  }
+
+  /**
+   * @brief Fix an underfull child by borrowing from or merging with a
+   *        sibling.
+   */
+  static void rebalance(Node &parent, size_t index) {
+    Node &child = *parent.children[index];
+
+    if (index > 0 && parent.children[index - 1]->count() > kMinKeys) {
+      Node &left = *parent.children[index - 1];
+      if (child.leaf) {
+        child.keys.insert(child.keys.begin(), std::move(left.keys.back()));
+        left.keys.pop_back();
+        parent.separators[index - 1] =
+            std::string(std::string_view(child.keys.front()));
+      } else {
+        child.separators.insert(child.separators.begin(),
+                                std::move(parent.separators[index - 1]));
+        child.children.insert(child.children.begin(),
+                              std::move(left.children.back()));
+        parent.separators[index - 1] = std::move(left.separators.back());
+        left.separators.pop_back();
+        left.children.pop_back();
+      }
+      return;
+    }
+
+    if (index + 1 < parent.children.size() &&
+        parent.children[index + 1]->count() > kMinKeys) {
+      Node &right = *parent.children[index + 1];
+      if (child.leaf) {
+        child.keys.push_back(std::move(right.keys.front()));
+        right.keys.erase(right.keys.begin());
+        parent.separators[index] =
+            std::string(std::string_view(right.keys.front()));
+      } else {
+        child.separators.push_back(std::move(parent.separators[index]));
+        child.children.push_back(std::move(right.children.front()));
+        parent.separators[index] = std::move(right.separators.front());
+        right.separators.erase(right.separators.begin());
+        right.children.erase(right.children.begin());
+      }
+      return;
+    }
+
+    // Neither sibling can spare a key: merge with one of them
+    const size_t left_index = index > 0 ? index - 1 : index;
+    Node &left = *parent.children[left_index];
+    Node &right = *parent.children[left_index + 1];
+    if (left.leaf) {
+      left.keys.insert(left.keys.end(),
+                       std::make_move_iterator(right.keys.begin()),
+                       std::make_move_iterator(right.keys.end()));
+      left.next = right.next;
+    } else {
+      left.separators.push_back(std::move(parent.separators[left_index]));
+      left.separators.insert(left.separators.end(),
+                             std::make_move_iterator(right.separators.begin()),
+                             std::make_move_iterator(right.separators.end()));
+      left.children.insert(left.children.end(),
+                           std::make_move_iterator(right.children.begin()),
+                           std::make_move_iterator(right.children.end()));
+    }
+    parent.separators.erase(parent.separators.begin() + left_index);
+    parent.children.erase(parent.children.begin() + left_index + 1);
+  }
+};
+
+/**
+ * @brief Smallest string greater than every string starting with `prefix`.
+ *
+ * @return The exclusive upper bound, or "" if there is none (the prefix
+ *         is empty or all 0xFF bytes), meaning "unbounded"
+ */
+inline std::string prefix_upper_bound(std::string_view prefix) {
+  std::string end(prefix);
+  while (!end.empty()) {
+    auto &last = reinterpret_cast<unsigned char &>(end.back());
+    if (last != 0xFF) {
+      ++last;
+      return end;
+    }
+    end.pop_back();
+  }
+  return end;
+}
+
+} // namespace kvdb
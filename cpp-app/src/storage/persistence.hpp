@@ -0,0 +1,517 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../logging/logger.hpp"
+#include "../metrics/metrics.hpp"
+#include "group_commit.hpp"
+#include "snapshot.hpp"
+#include "wal.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief When WAL appends are forced to stable storage.
+ */
+enum class SyncPolicy {
+  NONE,  ///< Never fdatasync; rely on the page cache
+  BATCH, ///< Group commit: concurrent writers share one fdatasync
+  WRITE  ///< fdatasync after every record
+};
+
+/**
+ * @brief Parse a sync policy name ("none", "batch", "write").
+ * @throws std::invalid_argument On an unknown name
+ */
+inline SyncPolicy parse_sync_policy(const std::string &name) {
+  if (name == "none")
+    return SyncPolicy::NONE;
+  if (name == "batch")
+    return SyncPolicy::BATCH;
+  if (name == "write")
+    return SyncPolicy::WRITE;
+  throw std::invalid_argument("Unknown WAL sync policy: " + name);
+}
+
+/**
+ * @brief Tunables for log-structured persistence.
+ */
+struct PersistenceOptions {
+  /// Active WAL size that triggers folding it into the base file.
+  size_t compaction_threshold_bytes = 64 * 1024 * 1024;
+  SyncPolicy sync_policy = SyncPolicy::BATCH;
+  /// Group commit: stop gathering once this many records are pending.
+  size_t group_commit_max_batch = 128;
+  /// Group commit: how long a sync leader waits for more writers.
+  /// Zero syncs immediately; writers arriving meanwhile share the next one.
+  std::chrono::microseconds group_commit_max_delay{0};
+  /// Verify the base snapshot's body checksum on every open.
+  bool verify_checksums = true;
+  /// Keep base-snapshot values in the mapping instead of copying them
+  /// to the heap at startup (stores that support it read them lazily).
+  bool lazy_values = false;
+};
+
+/**
+ * @brief Point-in-time image of a LogPersistence: a base snapshot plus
+ *        the logged mutations on top of it (see
+ *        LogPersistence::checkpoint).
+ *
+ * Holds the base mapping and the log files open, so compactions and
+ * WAL rotations that replace or delete them afterwards do not change
+ * it. for_each() folds the logs into the base as it goes, keeping only
+ * their net effect in memory; taking the image copies nothing.
+ */
+class LogCheckpoint {
+public:
+  using Visitor = MappedSnapshot::Visitor;
+
+  /// An open log file, of which the image covers the first `bytes`.
+  struct Log {
+    std::shared_ptr<std::ifstream> file;
+    size_t bytes;
+  };
+
+  LogCheckpoint(std::shared_ptr<const MappedSnapshot> base,
+                std::vector<Log> logs)
+      : base_(std::move(base)), logs_(std::move(logs)) {}
+
+  /// Visit every live pair exactly once, in no particular order.
+  void for_each(const Visitor &visit) const {
+    std::unordered_map<std::string, std::optional<std::string>> delta;
+    for (const Log &log : logs_) {
+      log.file->clear();
+      log.file->seekg(0);
+      WriteAheadLog::replay(
+          *log.file, log.bytes,
+          [&delta](WalRecordType type, std::string_view key,
+                   std::string_view value) {
+            if (type == WalRecordType::SET) {
+              delta[std::string(key)] = std::string(value);
+            } else {
+              delta[std::string(key)] = std::nullopt;
+            }
+          });
+    }
+
+    if (base_) {
+      base_->for_each([&](std::string_view key, std::string_view value) {
+        if (delta.find(std::string(key)) == delta.end()) {
+          visit(key, value);
+        }
+      });
+    }
+    for (const auto &[key, value] : delta) {
+      if (value) {
+        visit(key, *value);
+      }
+    }
+  }
+
+private:
+  std::shared_ptr<const MappedSnapshot> base_;
+  std::vector<Log> logs_;
+};
+
+/**
+ * @brief Log-structured persistence: a base snapshot plus a write-ahead log.
+ *
+ * The base file uses the binary snapshot format (see snapshot.hpp); a
+ * legacy `key=value` text file is converted in place on first open.
+ * Each mutation costs one appended WAL record instead of a full
+ * rewrite of the data file. Once the active WAL grows past the
+ * compaction threshold it is sealed (renamed to `<base>.wal.old`) and
+ * a fresh WAL is started; a background thread then folds the sealed
+ * log into the base file and deletes it.
+ *
+ * Compaction works purely on files, so it never takes the owning
+ * store's lock. Recovery order is base → sealed WAL → active WAL;
+ * replaying a sealed log that was already folded is harmless because
+ * records carry full values.
+ *
+ * The current base stays mapped, and a compaction replaces the file by
+ * rename without touching an existing mapping, so a point-in-time
+ * image is just that mapping plus the logs written since, held open:
+ * checkpoint() takes one for Raft snapshots without writing anything.
+ *
+ * Durability follows PersistenceOptions::sync_policy. Appends return
+ * a log sequence number; with SyncPolicy::BATCH the caller drops its
+ * own locks and calls wait_durable(), where the first waiter becomes
+ * the sync leader and issues one fdatasync covering every record
+ * appended so far (group commit). The time writers spend there is
+ * recorded in kvdb_wal_durable_wait_seconds.
+ *
+ * Thread-safe: appends may come from multiple threads.
+ */
+class LogPersistence {
+public:
+  using Visitor = WriteAheadLog::Visitor;
+  using BaseCallback =
+      std::function<void(std::shared_ptr<const MappedSnapshot> base)>;
+
+  explicit LogPersistence(std::string base_path,
+                          PersistenceOptions options = {})
+      : base_path_(std::move(base_path)), wal_path_(base_path_ + ".wal"),
+        sealed_path_(base_path_ + ".wal.old"), options_(options),
+        commit_(options.group_commit_max_batch,
+                options.group_commit_max_delay) {}
+
+  ~LogPersistence() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    idle_cv_.notify_all();
+    if (compactor_.joinable()) {
+      compactor_.join();
+    }
+  }
+
+  // Non-copyable
+  LogPersistence(const LogPersistence &) = delete;
+  LogPersistence &operator=(const LogPersistence &) = delete;
+
+  /**
+   * @brief Replay all persisted state and open the WAL for appending.
+   *
+   * Must be called once, before any append. Values from the base file
+   * are views into its mapping; callers that keep them must also keep
+   * the mapping handed to on_base.
+   *
+   * @param visit Called for every recovered mutation, oldest first
+   * @param on_base Called with the mapped base snapshot (if any) before
+   *                its entries are visited, e.g. to pre-size a table
+   */
+  void recover(const Visitor &visit, const BaseCallback &on_base = {}) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (file_exists(base_path_) &&
+        !MappedSnapshot::is_snapshot_file(base_path_)) {
+      uint64_t converted = convert_legacy_text_db(base_path_);
+      KVDB_LOG(LogLevel::INFO, "Storage",
+               "Converted legacy text data file " << base_path_ << " ("
+                  << converted << " entries)");
+    }
+
+    if (file_exists(base_path_)) {
+      base_ = MappedSnapshot::open(base_path_, options_.verify_checksums);
+      if (on_base) {
+        on_base(base_);
+      }
+      base_->for_each([&visit](std::string_view key, std::string_view value) {
+        visit(WalRecordType::SET, key, value);
+      });
+    }
+
+    bool has_sealed = file_exists(sealed_path_);
+    if (has_sealed) {
+      WriteAheadLog::replay(sealed_path_, visit);
+    }
+
+    // Drop a torn tail so new records are appended after intact ones
+    size_t valid = WriteAheadLog::replay(wal_path_, visit);
+    if (file_exists(wal_path_) &&
+        ::truncate(wal_path_.c_str(), static_cast<off_t>(valid)) != 0) {
+      throw std::runtime_error("Failed to truncate WAL " + wal_path_);
+    }
+
+    wal_.open(wal_path_);
+    compaction_pending_ = has_sealed;
+    compactor_ = std::thread([this]() { compaction_loop(); });
+    if (has_sealed) {
+      cv_.notify_one();
+    }
+  }
+
+  /**
+   * @brief Record a SET mutation.
+   * @return Log sequence number to pass to wait_durable()
+   */
+  uint64_t append_set(std::string_view key, std::string_view value) {
+    return append(WalRecordType::SET, key, value);
+  }
+
+  /**
+   * @brief Record a DELETE mutation.
+   * @return Log sequence number to pass to wait_durable()
+   */
+  uint64_t append_remove(std::string_view key) {
+    return append(WalRecordType::DELETE, key, {});
+  }
+
+  /**
+   * @brief Block until the record with the given LSN is on stable storage.
+   *
+   * A no-op unless the policy is SyncPolicy::BATCH (WRITE syncs inside
+   * append, NONE never syncs). Must not be called while holding a lock
+   * that other writers need, or no batch can form.
+   *
+   * @throws std::runtime_error If the shared fdatasync fails
+   */
+  void wait_durable(uint64_t lsn) {
+    if (options_.sync_policy != SyncPolicy::BATCH)
+      return;
+
+    ScopedLatency timed(durable_wait_latency_);
+    commit_.wait(lsn, [this]() { return sync_active_wal(); });
+  }
+
+  /**
+   * @brief Capture the state as of this call: the base mapping, the
+   *        sealed WAL if a compaction is pending, and the active WAL up
+   *        to its current end.
+   *
+   * Only opens files, under the append lock, so writers are held up
+   * for that long and never for a compaction; the image does its
+   * reading when iterated.
+   *
+   * @throws std::runtime_error If the persistence is shutting down or
+   *         a log cannot be opened
+   */
+  LogCheckpoint checkpoint() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      throw std::runtime_error("Storage is shutting down");
+    }
+    // The compactor installs a new base and drops the sealed WAL
+    // together under mutex_, so these always match
+    std::vector<LogCheckpoint::Log> logs;
+    if (file_exists(sealed_path_)) {
+      logs.push_back(LogCheckpoint::Log{open_log(sealed_path_), SIZE_MAX});
+    }
+    if (wal_.size_bytes() > 0) {
+      logs.push_back(
+          LogCheckpoint::Log{open_log(wal_path_), wal_.size_bytes()});
+    }
+    return LogCheckpoint(base_, std::move(logs));
+  }
+
+  /**
+   * @brief Make the snapshot file at `path` the new base and discard
+   *        every logged mutation.
+   *
+   * The file is validated, then renamed over the base file, so it must
+   * live on the same filesystem. The caller keeps its own writers out
+   * for the duration (the owning store holds its write lock). A crash
+   * before the WAL is emptied can leave stale records on top of the new
+   * base; Raft restores the snapshot again on restart.
+   *
+   * @return Mapping of the new base, to reload the in-memory state from
+   * @throws std::runtime_error If the file is invalid or cannot be moved
+   */
+  std::shared_ptr<const MappedSnapshot> restore_base(const std::string &path) {
+    auto base = MappedSnapshot::open(path, true);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    wait_idle(lock);
+    if (stopping_) {
+      throw std::runtime_error("Storage is shutting down");
+    }
+    std::lock_guard<std::mutex> sync_lock(sync_mutex_);
+    if (std::rename(path.c_str(), base_path_.c_str()) != 0) {
+      throw std::runtime_error("Failed to install snapshot " + path);
+    }
+    base_ = base;
+    // Unlinked rather than truncated: checkpoints may hold it open
+    wal_.close();
+    if (::unlink(wal_path_.c_str()) != 0 && errno != ENOENT) {
+      wal_.open(wal_path_);
+      throw std::runtime_error("Failed to remove WAL " + wal_path_);
+    }
+    wal_.open(wal_path_);
+    sync_path(parent_dir(base_path_));
+    return base;
+  }
+
+private:
+  std::string base_path_;
+  std::string wal_path_;
+  std::string sealed_path_;
+  PersistenceOptions options_;
+
+  WriteAheadLog wal_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable idle_cv_; // compaction_pending_ went false
+  std::thread compactor_;
+  std::shared_ptr<const MappedSnapshot> base_; // Of base_path_; mutex_
+  bool compaction_pending_ = false;
+  bool stopping_ = false;
+
+  // Lock order: mutex_ -> sync_mutex_. The group commit's own lock is
+  // never held while acquiring either of them.
+  GroupCommit commit_;
+  std::mutex sync_mutex_;
+  LatencyHistogram &durable_wait_latency_ =
+      MetricsRegistry::instance().histogram(
+          "kvdb_wal_durable_wait_seconds",
+          "Time a writer waits for its WAL record to be durable (group "
+          "commit).");
+
+  uint64_t append(WalRecordType type, std::string_view key,
+                  std::string_view value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wal_.append(type, key, value);
+    if (options_.sync_policy == SyncPolicy::WRITE) {
+      wal_.sync();
+    }
+    uint64_t lsn = commit_.next_lsn();
+    if (wal_.size_bytes() >= options_.compaction_threshold_bytes &&
+        !compaction_pending_) {
+      seal_active_wal();
+    }
+    return lsn;
+  }
+
+  /**
+   * @brief Wait until no compaction is pending. Caller holds mutex_.
+   */
+  void wait_idle(std::unique_lock<std::mutex> &lock) {
+    idle_cv_.wait(lock, [this]() { return stopping_ || !compaction_pending_; });
+  }
+
+  /**
+   * @brief fdatasync the active WAL.
+   * @return The highest LSN now known to be durable
+   */
+  uint64_t sync_active_wal() {
+    std::lock_guard<std::mutex> lock(sync_mutex_);
+    uint64_t target = commit_.appended_lsn();
+    wal_.sync();
+    return target;
+  }
+
+  /**
+   * @brief Swap the active WAL out for compaction. Caller holds mutex_.
+   *
+   * The outgoing log is synced first so that group-commit waiters
+   * whose records it holds are covered by the next sync of the new log.
+   */
+  void seal_active_wal() {
+    std::lock_guard<std::mutex> sync_lock(sync_mutex_);
+    if (options_.sync_policy != SyncPolicy::NONE) {
+      wal_.sync();
+    }
+    wal_.close();
+    if (std::rename(wal_path_.c_str(), sealed_path_.c_str()) != 0) {
+      wal_.open(wal_path_);
+      throw std::runtime_error("Failed to seal WAL " + wal_path_);
+    }
+    wal_.open(wal_path_);
+    compaction_pending_ = true;
+    cv_.notify_one();
+  }
+
+  void compaction_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this]() { return stopping_ || compaction_pending_; });
+      if (stopping_)
+        return;
+
+      lock.unlock();
+      try {
+        compact();
+      } catch (const std::exception &e) {
+        KVDB_LOG(LogLevel::ERROR, "Storage", "Compaction failed: " << e.what());
+      }
+      lock.lock();
+      compaction_pending_ = file_exists(sealed_path_);
+      if (!compaction_pending_) {
+        idle_cv_.notify_all();
+      }
+      if (compaction_pending_ && !stopping_) {
+        // Retry later rather than spinning on a persistent I/O error
+        cv_.wait_for(lock, std::chrono::seconds(1));
+      }
+    }
+  }
+
+  /**
+   * @brief Fold the sealed WAL into the base snapshot.
+   *
+   * Only the sealed log's net effect is held in memory; base entries
+   * are streamed from the old mapping into the new snapshot. Only the
+   * compactor touches the base file and the sealed log while a
+   * compaction is pending, so the lock is only taken to pick up the
+   * current base and to install the new one.
+   */
+  void compact() {
+    std::shared_ptr<const MappedSnapshot> base;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      base = base_;
+    }
+    const LogCheckpoint folded(
+        std::move(base),
+        {LogCheckpoint::Log{open_log(sealed_path_), SIZE_MAX}});
+
+    SnapshotWriter writer(base_path_);
+    folded.for_each([&writer](std::string_view key, std::string_view value) {
+      writer.add(key, value);
+    });
+    writer.finish();
+    sync_path(parent_dir(base_path_));
+    auto compacted = MappedSnapshot::open(base_path_, false);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    base_ = std::move(compacted);
+    if (std::remove(sealed_path_.c_str()) != 0) {
+      throw std::runtime_error("Failed to remove sealed WAL " + sealed_path_);
+    }
+  }
+
+  /**
+   * @brief Open a log for a LogCheckpoint to read.
+   * @throws std::runtime_error If it cannot be opened
+   */
+  static std::shared_ptr<std::ifstream> open_log(const std::string &path) {
+    auto file = std::make_shared<std::ifstream>(path, std::ios::binary);
+    if (!file->is_open()) {
+      throw std::runtime_error("Failed to open WAL " + path);
+    }
+    return file;
+  }
+
+  static std::string parent_dir(const std::string &path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos)
+      return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+  }
+
+  static void sync_path(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || ::fsync(fd) != 0) {
+      if (fd >= 0)
+        ::close(fd);
+      throw std::runtime_error("Failed to fsync " + path);
+    }
+    ::close(fd);
+  }
+
+  static bool file_exists(const std::string &path) {
+    return ::access(path.c_str(), F_OK) == 0;
+  }
+};
+
+} // namespace kvdb
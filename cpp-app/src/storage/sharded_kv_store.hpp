@@ -0,0 +1,434 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "kv_store.hpp"
+#include "persistence.hpp"
+#include "stored_value.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Per-shard lock and traffic counters.
+ */
+struct ShardStats {
+  uint64_t reads = 0;
+  uint64_t writes = 0;
+  /// Lock acquisitions that found the shard lock held and had to block.
+  uint64_t contended = 0;
+  uint64_t keys = 0;
+};
+
+/**
+ * @brief Lock-striped, persistent key-value store.
+ *
+ * Keys are spread over N independent shards by hash; each shard has its
+ * own std::shared_mutex, so concurrent readers never block one another
+ * and only block writers to the same shard. Persistence is shared with
+ * PersistentKVStore (one LogPersistence), and the WAL record for a key
+ * is appended while its shard is held exclusively, so per-key WAL order
+ * always matches in-memory order.
+ *
+ * scan() goes through one B+-tree index over all keys, guarded by its
+ * own shared_mutex. Only inserting or removing a key takes that lock
+ * (nested inside the shard lock); overwrites and reads never do. A scan
+ * collects keys under the index lock and then reads each value from
+ * its shard, so it is not a point-in-time view: keys removed in
+ * between are skipped.
+ */
+class ShardedKVStore : public IKVStore {
+public:
+  /**
+   * @brief Open the store.
+   * @param db_path Base data file (same format as PersistentKVStore)
+   * @param shard_count Number of shards (must be > 0)
+   * @param options Persistence tunables
+   */
+  ShardedKVStore(std::string db_path, size_t shard_count,
+                 PersistenceOptions options = {})
+      : persistence_(std::move(db_path), options),
+        lazy_values_(options.lazy_values) {
+    if (shard_count == 0) {
+      throw std::invalid_argument("ShardedKVStore needs at least one shard");
+    }
+    shards_ = std::make_unique<Shard[]>(shard_count);
+    shard_count_ = shard_count;
+    load();
+  }
+
+  /**
+   * @brief Store a key-value pair and append it to the WAL.
+   */
+  void set(const std::string &key, const std::string &value) override {
+    Shard &shard = shard_for(key);
+    uint64_t lsn;
+    {
+      std::unique_lock<std::shared_mutex> lock = shard.lock_exclusive();
+      lsn = persistence_.append_set(key, value);
+      put(shard, key, StoredValue{value, {}});
+    }
+    persistence_.wait_durable(lsn);
+  }
+
+  /**
+   * @brief Retrieve a value by key.
+   * @return The value if found, std::nullopt otherwise.
+   */
+  [[nodiscard]] std::optional<std::string>
+  get(const std::string &key) const override {
+    const Shard &shard = shard_for(key);
+    std::shared_lock<std::shared_mutex> lock = shard.lock_shared();
+    auto it = shard.map.find(key);
+    if (it != shard.map.end()) {
+      return std::string(it->second.view());
+    }
+    return std::nullopt;
+  }
+
+  /// Leaves a value still in the base snapshot where it is.
+  [[nodiscard]] std::optional<EncodedValue>
+  get_encoded(const std::string &key,
+              const CodingFilter &accepts) const override {
+    const Shard &shard = shard_for(key);
+    std::shared_lock<std::shared_mutex> lock = shard.lock_shared();
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+      return std::nullopt;
+    }
+    // base_ only changes in restore(), under every shard's lock
+    if (base_ && it->second.mapped.data()) {
+      return EncodedValue{{}, {}, base_, it->second.mapped};
+    }
+    return EncodedValue{std::string(it->second.view()), {}};
+  }
+
+  /**
+   * @brief Retrieve many values, taking each shard's lock once.
+   */
+  [[nodiscard]] std::vector<std::optional<std::string>>
+  multi_get(const std::vector<std::string> &keys) const override {
+    std::vector<std::optional<std::string>> values(keys.size());
+    for (const auto &[index, positions] : group_by_shard(keys)) {
+      const Shard &shard = shards_[index];
+      std::shared_lock<std::shared_mutex> lock = shard.lock_shared();
+      for (size_t position : positions) {
+        auto it = shard.map.find(keys[position]);
+        if (it != shard.map.end()) {
+          values[position] = std::string(it->second.view());
+        }
+      }
+    }
+    return values;
+  }
+
+  /**
+   * @brief Apply and log a batch holding every shard it touches
+   *        exclusively (taken in index order, as restore() does); waits
+   *        for durability once, for the last record.
+   * @throws std::runtime_error If a write has a deadline
+   */
+  void write_batch(std::vector<BatchWrite> writes) override {
+    require_no_expiry(writes);
+    std::vector<size_t> indices;
+    indices.reserve(writes.size());
+    for (const auto &write : writes) {
+      indices.push_back(shard_index(write.key));
+    }
+    std::vector<size_t> order = indices;
+    std::sort(order.begin(), order.end());
+    order.erase(std::unique(order.begin(), order.end()), order.end());
+
+    uint64_t lsn = 0;
+    {
+      std::vector<std::unique_lock<std::shared_mutex>> locks;
+      locks.reserve(order.size());
+      for (size_t index : order) {
+        locks.push_back(shards_[index].lock_exclusive());
+      }
+      for (size_t i = 0; i < writes.size(); ++i) {
+        BatchWrite &write = writes[i];
+        Shard &shard = shards_[indices[i]];
+        if (!write.remove) {
+          lsn = persistence_.append_set(write.key, write.value);
+          put(shard, write.key, StoredValue{std::move(write.value), {}});
+          continue;
+        }
+        auto it = shard.map.find(write.key);
+        if (it != shard.map.end()) {
+          lsn = persistence_.append_remove(write.key);
+          {
+            std::unique_lock<std::shared_mutex> index_lock(index_mutex_);
+            index_.erase(write.key);
+          }
+          shard.map.erase(it);
+        }
+      }
+    }
+    if (lsn != 0) {
+      persistence_.wait_durable(lsn);
+    }
+  }
+
+  /**
+   * @brief Remove a key-value pair and append the deletion to the WAL.
+   * @return true if the key existed and was removed.
+   */
+  bool remove(const std::string &key) override {
+    Shard &shard = shard_for(key);
+    uint64_t lsn;
+    {
+      std::unique_lock<std::shared_mutex> lock = shard.lock_exclusive();
+      auto it = shard.map.find(key);
+      if (it == shard.map.end()) {
+        return false;
+      }
+      lsn = persistence_.append_remove(key);
+      {
+        std::unique_lock<std::shared_mutex> index_lock(index_mutex_);
+        index_.erase(key);
+      }
+      shard.map.erase(it);
+    }
+    persistence_.wait_durable(lsn);
+    return true;
+  }
+
+  /**
+   * @brief Check if a key exists in the store.
+   */
+  [[nodiscard]] bool contains(const std::string &key) const override {
+    const Shard &shard = shard_for(key);
+    std::shared_lock<std::shared_mutex> lock = shard.lock_shared();
+    return shard.map.count(key) > 0;
+  }
+
+  /**
+   * @brief Ordered range scan over [start, end) via the key index.
+   */
+  [[nodiscard]] std::vector<KVPair> scan(const std::string &start,
+                                         const std::string &end,
+                                         size_t limit) const override {
+    std::vector<std::string> keys;
+    {
+      std::shared_lock<std::shared_mutex> index_lock(index_mutex_);
+      index_.for_each_from(start, [&](std::string_view key) {
+        if (keys.size() >= limit || (!end.empty() && key >= end))
+          return false;
+        keys.emplace_back(key);
+        return true;
+      });
+    }
+
+    std::vector<KVPair> result;
+    result.reserve(keys.size());
+    for (auto &key : keys) {
+      if (auto value = get(key)) {
+        result.emplace_back(std::move(key), std::move(*value));
+      }
+    }
+    return result;
+  }
+
+  /**
+   * @brief Visit each shard in turn under its shared lock (so the pass
+   *        is consistent per shard, not across shards).
+   */
+  void for_each(const IKVSnapshot::Visitor &visit) const override {
+    for (size_t i = 0; i < shard_count_; ++i) {
+      const Shard &shard = shards_[i];
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      for (const auto &[key, value] : shard.map) {
+        visit(key, value.view());
+      }
+    }
+  }
+
+  /**
+   * @brief Point-in-time view via a checkpoint of the base file and WAL.
+   */
+  [[nodiscard]] std::unique_ptr<IKVSnapshot> snapshot() override {
+    return std::make_unique<MappedKVSnapshot>(persistence_.checkpoint());
+  }
+
+  /**
+   * @brief Install a snapshot file as the new base and reload from it.
+   *
+   * Holds every shard exclusively, in index order, for the duration.
+   */
+  void restore(const std::string &path) override {
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    locks.reserve(shard_count_);
+    for (size_t i = 0; i < shard_count_; ++i) {
+      locks.push_back(shards_[i].lock_exclusive());
+    }
+
+    auto base = persistence_.restore_base(path);
+    {
+      std::unique_lock<std::shared_mutex> index_lock(index_mutex_);
+      index_.clear();
+    }
+    base_.reset();
+    const size_t per_shard = base->entry_count() / shard_count_ + 1;
+    for (size_t i = 0; i < shard_count_; ++i) {
+      shards_[i].map.clear();
+      shards_[i].map.reserve(per_shard);
+    }
+    base->for_each([this](std::string_view key, std::string_view value) {
+      if (lazy_values_) {
+        put(shard_for(key), key, StoredValue{{}, value});
+      } else {
+        put(shard_for(key), key, StoredValue{std::string(value), {}});
+      }
+    });
+    if (lazy_values_) {
+      base_ = std::move(base);
+    }
+  }
+
+  [[nodiscard]] size_t shard_count() const { return shard_count_; }
+
+  /**
+   * @brief Snapshot each shard's counters, for tuning the shard count.
+   */
+  [[nodiscard]] std::vector<ShardStats> shard_stats() const {
+    std::vector<ShardStats> stats(shard_count_);
+    for (size_t i = 0; i < shard_count_; ++i) {
+      const Shard &shard = shards_[i];
+      stats[i].reads = shard.reads.load(std::memory_order_relaxed);
+      stats[i].writes = shard.writes.load(std::memory_order_relaxed);
+      stats[i].contended = shard.contended.load(std::memory_order_relaxed);
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      stats[i].keys = shard.map.size();
+    }
+    return stats;
+  }
+
+private:
+  /**
+   * @brief One lock stripe. Cache-line aligned to avoid false sharing
+   *        between neighbouring shards' locks and counters.
+   */
+  struct alignas(64) Shard {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string, StoredValue> map;
+    mutable std::atomic<uint64_t> reads{0};
+    mutable std::atomic<uint64_t> writes{0};
+    mutable std::atomic<uint64_t> contended{0};
+
+    std::shared_lock<std::shared_mutex> lock_shared() const {
+      reads.fetch_add(1, std::memory_order_relaxed);
+      std::shared_lock<std::shared_mutex> lock(mutex, std::try_to_lock);
+      if (!lock.owns_lock()) {
+        contended.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+      }
+      return lock;
+    }
+
+    std::unique_lock<std::shared_mutex> lock_exclusive() {
+      writes.fetch_add(1, std::memory_order_relaxed);
+      std::unique_lock<std::shared_mutex> lock(mutex, std::try_to_lock);
+      if (!lock.owns_lock()) {
+        contended.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+      }
+      return lock;
+    }
+  };
+
+  LogPersistence persistence_;
+  bool lazy_values_;
+  std::shared_ptr<const MappedSnapshot> base_;
+  std::unique_ptr<Shard[]> shards_;
+  size_t shard_count_ = 0;
+  OrderedIndex<std::string_view> index_; // views into shard map keys
+  mutable std::shared_mutex index_mutex_;
+
+  /**
+   * @brief Insert or overwrite an entry. Caller holds the shard lock.
+   */
+  void put(Shard &shard, std::string_view key, StoredValue value) {
+    auto [it, inserted] = shard.map.try_emplace(std::string(key));
+    it->second = std::move(value);
+    if (inserted) {
+      std::unique_lock<std::shared_mutex> index_lock(index_mutex_);
+      index_.insert(it->first);
+    }
+  }
+
+  /**
+   * @brief Pick a shard from the key hash.
+   *
+   * The hash is remixed first so that shard selection and the shard's
+   * own bucket selection don't consume the same low bits.
+   */
+  [[nodiscard]] size_t shard_index(std::string_view key) const {
+    uint64_t h = std::hash<std::string_view>{}(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h % shard_count_);
+  }
+
+  /// Positions of `keys` by shard index, for one lock per shard.
+  [[nodiscard]] std::unordered_map<size_t, std::vector<size_t>>
+  group_by_shard(const std::vector<std::string> &keys) const {
+    std::unordered_map<size_t, std::vector<size_t>> groups;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      groups[shard_index(keys[i])].push_back(i);
+    }
+    return groups;
+  }
+
+  Shard &shard_for(std::string_view key) { return shards_[shard_index(key)]; }
+
+  const Shard &shard_for(std::string_view key) const {
+    return shards_[shard_index(key)];
+  }
+
+  /**
+   * @brief Rebuild all shards from the base snapshot and WAL.
+   *
+   * Runs in the constructor, before the store is shared, so shard locks
+   * are not taken.
+   */
+  void load() {
+    persistence_.recover(
+        [this](WalRecordType type, std::string_view key,
+               std::string_view value) {
+          Shard &shard = shard_for(key);
+          if (type == WalRecordType::DELETE) {
+            if (index_.erase(key)) {
+              shard.map.erase(std::string(key));
+            }
+          } else if (base_ && base_->contains(value.data())) {
+            put(shard, key, StoredValue{{}, value});
+          } else {
+            put(shard, key, StoredValue{std::string(value), {}});
+          }
+        },
+        [this](std::shared_ptr<const MappedSnapshot> base) {
+          size_t per_shard = base->entry_count() / shard_count_ + 1;
+          for (size_t i = 0; i < shard_count_; ++i) {
+            shards_[i].map.reserve(per_shard);
+          }
+          if (lazy_values_) {
+            base_ = std::move(base);
+          }
+        });
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crc32.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief On-disk layout of a binary snapshot file.
+ *
+ *   [SnapshotHeader]
+ *   [data block]   entry_count x { u32 key_len, u32 value_len, key, value }
+ *   [index block]  entry_count x u64 file offset of each entry
+ *
+ * The header checksums itself and the data + index blocks, so a
+ * snapshot is either fully valid or rejected. Integers use host byte
+ * order, like the WAL.
+ */
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_crc; ///< crc32 of the header with this field zeroed
+  uint64_t entry_count;
+  uint64_t data_offset;
+  uint64_t index_offset;
+  uint64_t file_size;
+  uint32_t body_crc; ///< crc32 of data block followed by index block
+  uint32_t reserved;
+};
+
+inline constexpr char kSnapshotMagic[8] = {'K', 'V', 'S', 'N',
+                                           'A', 'P', '\0', '\1'};
+inline constexpr uint32_t kSnapshotVersion = 1;
+
+/**
+ * @brief Streaming writer for the binary snapshot format.
+ *
+ * Entries are appended one at a time, so callers never need the whole
+ * dataset in memory. finish() writes the index and header, fsyncs and
+ * atomically renames the temp file over the target.
+ */
+class SnapshotWriter {
+public:
+  explicit SnapshotWriter(std::string path)
+      : path_(std::move(path)), tmp_path_(path_ + ".tmp") {
+    file_ = std::fopen(tmp_path_.c_str(), "wb");
+    if (!file_) {
+      throw std::runtime_error("Failed to create " + tmp_path_ + ": " +
+                               std::strerror(errno));
+    }
+    SnapshotHeader placeholder{};
+    write(&placeholder, sizeof(placeholder), false);
+    offset_ = sizeof(SnapshotHeader);
+  }
+
+  ~SnapshotWriter() {
+    if (file_) {
+      std::fclose(file_);
+      std::remove(tmp_path_.c_str());
+    }
+  }
+
+  // Non-copyable
+  SnapshotWriter(const SnapshotWriter &) = delete;
+  SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+  /**
+   * @brief Append one key-value entry.
+   */
+  void add(std::string_view key, std::string_view value) {
+    const auto key_len = static_cast<uint32_t>(key.size());
+    const auto value_len = static_cast<uint32_t>(value.size());
+    index_.push_back(offset_);
+    write(&key_len, sizeof(key_len));
+    write(&value_len, sizeof(value_len));
+    write(key.data(), key.size());
+    write(value.data(), value.size());
+  }
+
+  /**
+   * @brief Finalize and atomically publish the snapshot.
+   * @throws std::runtime_error On any I/O failure
+   */
+  void finish() {
+    SnapshotHeader header{};
+    std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version = kSnapshotVersion;
+    header.entry_count = index_.size();
+    header.data_offset = sizeof(SnapshotHeader);
+    header.index_offset = offset_;
+
+    write(index_.data(), index_.size() * sizeof(uint64_t));
+    header.file_size = offset_;
+    header.body_crc = body_crc_;
+    header.header_crc = crc32(&header, sizeof(header));
+
+    if (std::fseek(file_, 0, SEEK_SET) != 0) {
+      throw std::runtime_error("Failed to seek in " + tmp_path_);
+    }
+    write(&header, sizeof(header), false);
+
+    bool ok = std::fflush(file_) == 0 && ::fsync(fileno(file_)) == 0;
+    ok = (std::fclose(file_) == 0) && ok;
+    file_ = nullptr;
+    if (!ok || std::rename(tmp_path_.c_str(), path_.c_str()) != 0) {
+      std::remove(tmp_path_.c_str());
+      throw std::runtime_error("Failed to publish snapshot " + path_);
+    }
+  }
+
+  [[nodiscard]] uint64_t entry_count() const { return index_.size(); }
+
+private:
+  std::string path_;
+  std::string tmp_path_;
+  std::FILE *file_ = nullptr;
+  uint64_t offset_ = 0;
+  uint32_t body_crc_ = 0;
+  std::vector<uint64_t> index_;
+
+  void write(const void *data, size_t size, bool is_body = true) {
+    if (size == 0)
+      return;
+    if (std::fwrite(data, 1, size, file_) != size) {
+      throw std::runtime_error("Failed to write " + tmp_path_);
+    }
+    if (is_body) {
+      body_crc_ = crc32(data, size, body_crc_);
+      offset_ += size;
+    }
+  }
+};
+
+/**
+ * @brief Read-only, memory-mapped view of a snapshot file.
+ *
+ * Keys and values handed out by for_each() point straight into the
+ * mapping and stay valid for the lifetime of this object, even if the
+ * file is replaced or unlinked meanwhile. The file is kept open too, so
+ * a mapped value can also be sent from it with sendfile(2) (see fd()
+ * and offset_of()).
+ */
+class MappedSnapshot {
+public:
+  using Visitor = std::function<void(std::string_view key,
+                                     std::string_view value)>;
+
+  /**
+   * @brief Map and validate a snapshot file.
+   *
+   * @param path Snapshot file
+   * @param verify_checksum Check body_crc (touches every page)
+   * @throws std::runtime_error If the file is missing or corrupt
+   */
+  static std::shared_ptr<const MappedSnapshot> open(const std::string &path,
+                                                    bool verify_checksum) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to open snapshot " + path + ": " +
+                               std::strerror(errno));
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+      ::close(fd);
+      throw std::runtime_error("Snapshot too small: " + path);
+    }
+
+    const auto size = static_cast<size_t>(st.st_size);
+    void *addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error("Failed to mmap snapshot " + path);
+    }
+
+    std::shared_ptr<MappedSnapshot> snapshot(
+        new MappedSnapshot(fd, static_cast<const char *>(addr), size));
+    snapshot->validate(path, verify_checksum);
+    return snapshot;
+  }
+
+  ~MappedSnapshot() {
+    ::munmap(const_cast<char *>(base_), size_);
+    ::close(fd_);
+  }
+
+  // Non-copyable
+  MappedSnapshot(const MappedSnapshot &) = delete;
+  MappedSnapshot &operator=(const MappedSnapshot &) = delete;
+
+  [[nodiscard]] uint64_t entry_count() const { return header_.entry_count; }
+
+  /**
+   * @brief Whether a pointer lies inside this mapping.
+   */
+  [[nodiscard]] bool contains(const char *p) const {
+    return p >= base_ && p < base_ + size_;
+  }
+
+  /// The mapped file, open for reading.
+  [[nodiscard]] int fd() const { return fd_; }
+
+  /// File offset of a byte inside the mapping (see contains()).
+  [[nodiscard]] uint64_t offset_of(const char *p) const {
+    return static_cast<uint64_t>(p - base_);
+  }
+
+  /**
+   * @brief Visit every entry in file order.
+   */
+  void for_each(const Visitor &visit) const {
+    const char *index = base_ + header_.index_offset;
+    for (uint64_t i = 0; i < header_.entry_count; ++i) {
+      uint64_t offset = 0;
+      std::memcpy(&offset, index + i * sizeof(uint64_t), sizeof(offset));
+
+      uint32_t key_len = 0;
+      uint32_t value_len = 0;
+      std::memcpy(&key_len, base_ + offset, sizeof(key_len));
+      std::memcpy(&value_len, base_ + offset + sizeof(key_len),
+                  sizeof(value_len));
+      const char *key = base_ + offset + 2 * sizeof(uint32_t);
+      visit(std::string_view(key, key_len),
+            std::string_view(key + key_len, value_len));
+    }
+  }
+
+  /**
+   * @brief Whether a file starts with the snapshot magic.
+   */
+  static bool is_snapshot_file(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(kSnapshotMagic)] = {};
+    return file.read(magic, sizeof(magic)) &&
+           std::memcmp(magic, kSnapshotMagic, sizeof(magic)) == 0;
+  }
+
+private:
+  int fd_;
+  const char *base_;
+  size_t size_;
+  SnapshotHeader header_{};
+
+  MappedSnapshot(int fd, const char *base, size_t size)
+      : fd_(fd), base_(base), size_(size) {}
+
+  void validate(const std::string &path, bool verify_checksum) {
+    std::memcpy(&header_, base_, sizeof(header_));
+
+    SnapshotHeader unsummed = header_;
+    unsummed.header_crc = 0;
+    if (std::memcmp(header_.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) !=
+            0 ||
+        header_.version != kSnapshotVersion ||
+        crc32(&unsummed, sizeof(unsummed)) != header_.header_crc) {
+      throw std::runtime_error("Bad snapshot header: " + path);
+    }
+
+    const uint64_t index_bytes = header_.entry_count * sizeof(uint64_t);
+    if (header_.file_size != size_ || header_.data_offset > size_ ||
+        header_.index_offset < header_.data_offset ||
+        header_.index_offset + index_bytes != size_) {
+      throw std::runtime_error("Bad snapshot layout: " + path);
+    }
+
+    if (verify_checksum) {
+      ::madvise(const_cast<char *>(base_), size_, MADV_SEQUENTIAL);
+      uint32_t crc = crc32(base_ + header_.data_offset,
+                           size_ - header_.data_offset);
+      if (crc != header_.body_crc) {
+        throw std::runtime_error("Snapshot checksum mismatch: " + path);
+      }
+    }
+
+    // Bounds-check every entry so for_each() can trust the offsets
+    const char *index = base_ + header_.index_offset;
+    for (uint64_t i = 0; i < header_.entry_count; ++i) {
+      uint64_t offset = 0;
+      std::memcpy(&offset, index + i * sizeof(uint64_t), sizeof(offset));
+      if (offset < header_.data_offset ||
+          offset + 2 * sizeof(uint32_t) > header_.index_offset) {
+        throw std::runtime_error("Bad snapshot entry offset: " + path);
+      }
+      uint32_t key_len = 0;
+      uint32_t value_len = 0;
+      std::memcpy(&key_len, base_ + offset, sizeof(key_len));
+      std::memcpy(&value_len, base_ + offset + sizeof(key_len),
+                  sizeof(value_len));
+      if (offset + 2 * sizeof(uint32_t) + key_len + value_len >
+          header_.index_offset) {
+        throw std::runtime_error("Bad snapshot entry length: " + path);
+      }
+    }
+  }
+};
+
+/**
+ * @brief Convert a legacy `key=value` text data file to a binary snapshot.
+ *
+ * The file is rewritten in place (via temp file + rename). Lines
+ * without '=' are skipped, matching the old loader.
+ *
+ * @return Number of entries converted
+ */
+inline uint64_t convert_legacy_text_db(const std::string &path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open legacy data file " + path);
+  }
+
+  SnapshotWriter writer(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    size_t eq_pos = line.find('=');
+    if (eq_pos != std::string::npos) {
+      std::string_view view(line);
+      writer.add(view.substr(0, eq_pos), view.substr(eq_pos + 1));
+    }
+  }
+  writer.finish();
+  return writer.entry_count();
+}
+
+} // namespace kvdb
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace kvdb {
+
+/// Target payload size of one streamed snapshot chunk.
+inline constexpr size_t kSnapshotChunkBytes = 1024 * 1024;
+
+/**
+ * @brief Splits key-value pairs into the chunked snapshot wire format.
+ *
+ * The chunks' payloads, concatenated, form a sequence of records
+ *
+ *   { u32 key_len, u32 value_len, key, value }
+ *
+ * with little-endian lengths (the stream may cross machines, unlike the
+ * on-disk formats). Records straddle chunk boundaries freely, so every
+ * chunk but the last carries exactly `chunk_bytes` of payload however
+ * large a single value is. The last chunk also carries the record
+ * count, which lets the receiver detect a truncated stream.
+ */
+class SnapshotStreamEncoder {
+public:
+  using ChunkSink = std::function<void(std::string_view data, bool last,
+                                       uint64_t entry_count)>;
+
+  explicit SnapshotStreamEncoder(ChunkSink sink,
+                                 size_t chunk_bytes = kSnapshotChunkBytes)
+      : sink_(std::move(sink)), chunk_bytes_(chunk_bytes) {
+    buffer_.reserve(chunk_bytes_);
+  }
+
+  void add(std::string_view key, std::string_view value) {
+    char header[2 * sizeof(uint32_t)];
+    put_u32(header, static_cast<uint32_t>(key.size()));
+    put_u32(header + sizeof(uint32_t), static_cast<uint32_t>(value.size()));
+    append(std::string_view(header, sizeof(header)));
+    append(key);
+    append(value);
+    ++entry_count_;
+  }
+
+  /**
+   * @brief Emit the final chunk (possibly with an empty payload).
+   */
+  void finish() {
+    sink_(buffer_, true, entry_count_);
+    buffer_.clear();
+  }
+
+  [[nodiscard]] uint64_t entry_count() const { return entry_count_; }
+
+private:
+  ChunkSink sink_;
+  size_t chunk_bytes_;
+  std::string buffer_;
+  uint64_t entry_count_ = 0;
+
+  static void put_u32(char *out, uint32_t v) {
+    for (size_t i = 0; i < sizeof(v); ++i) {
+      out[i] = static_cast<char>(v >> (8 * i));
+    }
+  }
+
+  void append(std::string_view data) {
+    while (!data.empty()) {
+      const size_t take = std::min(data.size(), chunk_bytes_ - buffer_.size());
+      buffer_.append(data.data(), take);
+      data.remove_prefix(take);
+      if (buffer_.size() == chunk_bytes_) {
+        sink_(buffer_, false, 0);
+        buffer_.clear();
+      }
+    }
+  }
+};
+
+/**
+ * @brief Reassembles records from chunks produced by SnapshotStreamEncoder.
+ *
+ * Records that lie within one chunk are handed out as views into it;
+ * only a record split across chunks is copied.
+ */
+class SnapshotStreamDecoder {
+public:
+  using Visitor =
+      std::function<void(std::string_view key, std::string_view value)>;
+
+  explicit SnapshotStreamDecoder(Visitor visit) : visit_(std::move(visit)) {}
+
+  /**
+   * @brief Consume one chunk's payload.
+   */
+  void feed(std::string_view data) {
+    if (!pending_.empty()) {
+      // Complete the record that straddles the previous chunk
+      if (!take_pending(data, kHeaderSize))
+        return;
+      if (!take_pending(data, record_size(pending_)))
+        return;
+      emit(pending_);
+      pending_.clear();
+    }
+    while (data.size() >= kHeaderSize) {
+      const size_t size = record_size(data);
+      if (data.size() < size)
+        break;
+      emit(data.substr(0, size));
+      data.remove_prefix(size);
+    }
+    pending_.assign(data.data(), data.size());
+  }
+
+  /**
+   * @brief Check the stream ended cleanly.
+   * @param entry_count Record count announced by the final chunk
+   * @throws std::runtime_error On a partial record or a count mismatch
+   */
+  void finish(uint64_t entry_count) const {
+    if (!pending_.empty()) {
+      throw std::runtime_error("Snapshot stream ends inside a record");
+    }
+    if (entry_count != entry_count_) {
+      throw std::runtime_error("Snapshot stream holds " +
+                               std::to_string(entry_count_) +
+                               " entries, expected " +
+                               std::to_string(entry_count));
+    }
+  }
+
+  [[nodiscard]] uint64_t entry_count() const { return entry_count_; }
+
+private:
+  static constexpr size_t kHeaderSize = 2 * sizeof(uint32_t);
+
+  Visitor visit_;
+  std::string pending_;
+  uint64_t entry_count_ = 0;
+
+  static uint32_t get_u32(const char *in) {
+    uint32_t v = 0;
+    for (size_t i = 0; i < sizeof(v); ++i) {
+      v |= static_cast<uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return v;
+  }
+
+  /// Size of the record starting at `data`, which holds its header.
+  static size_t record_size(std::string_view data) {
+    return kHeaderSize + get_u32(data.data()) +
+           get_u32(data.data() + sizeof(uint32_t));
+  }
+
+  /**
+   * @brief Move bytes from `data` into pending_ until it holds `size`.
+   * @return false if `data` ran out first
+   */
+  bool take_pending(std::string_view &data, size_t size) {
+    if (pending_.size() >= size)
+      return true;
+    const size_t take = std::min(size - pending_.size(), data.size());
+    pending_.append(data.data(), take);
+    data.remove_prefix(take);
+    return pending_.size() == size;
+  }
+
+  void emit(std::string_view record) {
+    const uint32_t key_len = get_u32(record.data());
+    visit_(record.substr(kHeaderSize, key_len),
+           record.substr(kHeaderSize + key_len));
+    ++entry_count_;
+  }
+};
+
+} // namespace kvdb
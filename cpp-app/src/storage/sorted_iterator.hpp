@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace kvdb {
+
+/**
+ * @brief Outcome of a point lookup in one LSM component.
+ *
+ * DELETED means the component holds a tombstone for the key, which
+ * hides any older value further down.
+ */
+enum class LookupResult { NOT_FOUND, FOUND, DELETED };
+
+/**
+ * @brief Forward iterator over key-ordered entries, tombstones included.
+ *
+ * Views returned by key() and value() stay valid until the iterator
+ * moves.
+ */
+class ISortedIterator {
+public:
+  virtual ~ISortedIterator() = default;
+
+  /// Position at the first entry with key >= target.
+  virtual void seek(std::string_view target) = 0;
+  virtual void seek_to_first() = 0;
+  [[nodiscard]] virtual bool valid() const = 0;
+  [[nodiscard]] virtual std::string_view key() const = 0;
+  [[nodiscard]] virtual std::string_view value() const = 0;
+  /// Whether the current entry is a tombstone.
+  [[nodiscard]] virtual bool deleted() const = 0;
+  virtual void next() = 0;
+};
+
+/**
+ * @brief Merges several sorted iterators into one.
+ *
+ * Children are given newest first. When several children hold the same
+ * key, only the newest entry is surfaced and the older ones are skipped,
+ * so a tombstone correctly shadows older values. Tombstones themselves
+ * are still surfaced; callers decide whether to drop them.
+ *
+ * The next entry is found by a linear scan over the children, which is
+ * cheaper than a heap for the handful of sources an LSM read touches.
+ */
+class MergingIterator : public ISortedIterator {
+public:
+  explicit MergingIterator(
+      std::vector<std::unique_ptr<ISortedIterator>> children)
+      : children_(std::move(children)) {}
+
+  void seek(std::string_view target) override {
+    for (auto &child : children_) {
+      child->seek(target);
+    }
+    pick_current();
+  }
+
+  void seek_to_first() override {
+    for (auto &child : children_) {
+      child->seek_to_first();
+    }
+    pick_current();
+  }
+
+  [[nodiscard]] bool valid() const override { return current_ != nullptr; }
+  [[nodiscard]] std::string_view key() const override {
+    return current_->key();
+  }
+  [[nodiscard]] std::string_view value() const override {
+    return current_->value();
+  }
+  [[nodiscard]] bool deleted() const override { return current_->deleted(); }
+
+  void next() override {
+    // Copy first: advancing the current child invalidates its key view
+    const std::string key(current_->key());
+    for (auto &child : children_) {
+      if (child->valid() && child->key() == key) {
+        child->next();
+      }
+    }
+    pick_current();
+  }
+
+private:
+  std::vector<std::unique_ptr<ISortedIterator>> children_;
+  ISortedIterator *current_ = nullptr;
+
+  void pick_current() {
+    current_ = nullptr;
+    for (auto &child : children_) {
+      // Strict '<' keeps the newest child on ties
+      if (child->valid() && (!current_ || child->key() < current_->key())) {
+        current_ = child.get();
+      }
+    }
+  }
+};
+
+/**
+ * @brief Iterator over a key-sorted vector of live entries.
+ *
+ * The vector and the data its views point to must outlive the iterator.
+ */
+class SortedVectorIterator : public ISortedIterator {
+public:
+  using Entry = std::pair<std::string_view, std::string_view>;
+
+  explicit SortedVectorIterator(const std::vector<Entry> &entries)
+      : entries_(entries), it_(entries.end()) {}
+
+  void seek(std::string_view target) override {
+    it_ = std::lower_bound(
+        entries_.begin(), entries_.end(), target,
+        [](const Entry &entry, std::string_view k) { return entry.first < k; });
+  }
+  void seek_to_first() override { it_ = entries_.begin(); }
+  [[nodiscard]] bool valid() const override { return it_ != entries_.end(); }
+  [[nodiscard]] std::string_view key() const override { return it_->first; }
+  [[nodiscard]] std::string_view value() const override {
+    return it_->second;
+  }
+  [[nodiscard]] bool deleted() const override { return false; }
+  void next() override { ++it_; }
+
+private:
+  const std::vector<Entry> &entries_;
+  std::vector<Entry>::const_iterator it_;
+};
+
+} // namespace kvdb
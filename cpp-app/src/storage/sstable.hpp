@@ -0,0 +1,576 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bloom_filter.hpp"
+#include "crc32.hpp"
+#include "sorted_iterator.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief On-disk layout of a sorted string table (SSTable).
+ *
+ *   [data block]*  entries { u32 key_len, u32 value_len, key, value }
+ *                  followed by u32 crc32 of the entries
+ *   [index block]  u32 first_key_len, first_key, then per data block
+ *                  { u32 last_key_len, last_key, u64 offset, u32 size }
+ *   [bloom block]  serialized BloomFilterBuilder output
+ *   [SSTableFooter]
+ *
+ * Entries are sorted by key, one entry per key. value_len ==
+ * kTombstoneLength marks a deletion. Integers use host byte order, like
+ * the WAL; tables are node-local files.
+ */
+struct SSTableFooter {
+  uint64_t index_offset;
+  uint64_t index_size;
+  uint64_t bloom_offset;
+  uint64_t bloom_size;
+  uint64_t entry_count;
+  uint32_t meta_crc; ///< crc32 of index block followed by bloom block
+  uint32_t version;
+  char magic[8];
+};
+
+inline constexpr char kSSTableMagic[8] = {'K', 'V', 'S', 'S',
+                                          'T', 'B', '\0', '\1'};
+inline constexpr uint32_t kSSTableVersion = 1;
+inline constexpr uint32_t kTombstoneLength = 0xFFFFFFFFu;
+
+/**
+ * @brief Streaming SSTable builder.
+ *
+ * Keys must be added in strictly increasing order. finish() writes the
+ * index, bloom filter and footer, fsyncs and atomically renames the
+ * temp file over the target.
+ */
+class SSTableWriter {
+public:
+  SSTableWriter(std::string path, size_t block_bytes, size_t bloom_bits_per_key)
+      : path_(std::move(path)), tmp_path_(path_ + ".tmp"),
+        block_bytes_(block_bytes), bloom_(bloom_bits_per_key) {
+    file_ = std::fopen(tmp_path_.c_str(), "wb");
+    if (!file_) {
+      throw std::runtime_error("Failed to create " + tmp_path_ + ": " +
+                               std::strerror(errno));
+    }
+  }
+
+  ~SSTableWriter() {
+    if (file_) {
+      std::fclose(file_);
+      std::remove(tmp_path_.c_str());
+    }
+  }
+
+  // Non-copyable
+  SSTableWriter(const SSTableWriter &) = delete;
+  SSTableWriter &operator=(const SSTableWriter &) = delete;
+
+  /**
+   * @brief Append an entry; `deleted` writes a tombstone.
+   */
+  void add(std::string_view key, std::string_view value, bool deleted) {
+    if (entry_count_ == 0) {
+      first_key_ = std::string(key);
+    }
+    const auto key_len = static_cast<uint32_t>(key.size());
+    const uint32_t value_len =
+        deleted ? kTombstoneLength : static_cast<uint32_t>(value.size());
+    append(block_, &key_len, sizeof(key_len));
+    append(block_, &value_len, sizeof(value_len));
+    block_.append(key.data(), key.size());
+    if (!deleted) {
+      block_.append(value.data(), value.size());
+    }
+    last_key_ = std::string(key);
+    bloom_.add(key);
+    ++entry_count_;
+
+    if (block_.size() >= block_bytes_) {
+      flush_block();
+    }
+  }
+
+  /**
+   * @brief Finalize and atomically publish the table.
+   * @throws std::runtime_error On any I/O failure
+   */
+  void finish() {
+    flush_block();
+
+    std::string index;
+    const auto first_len = static_cast<uint32_t>(first_key_.size());
+    append(index, &first_len, sizeof(first_len));
+    index += first_key_;
+    index += index_entries_;
+    const std::string bloom = bloom_.finish();
+
+    SSTableFooter footer{};
+    footer.index_offset = offset_;
+    footer.index_size = index.size();
+    footer.bloom_offset = offset_ + index.size();
+    footer.bloom_size = bloom.size();
+    footer.entry_count = entry_count_;
+    footer.meta_crc = crc32(bloom.data(), bloom.size(),
+                            crc32(index.data(), index.size()));
+    footer.version = kSSTableVersion;
+    std::memcpy(footer.magic, kSSTableMagic, sizeof(footer.magic));
+
+    write(index.data(), index.size());
+    write(bloom.data(), bloom.size());
+    write(&footer, sizeof(footer));
+
+    bool ok = std::fflush(file_) == 0 && ::fsync(fileno(file_)) == 0;
+    ok = (std::fclose(file_) == 0) && ok;
+    file_ = nullptr;
+    if (!ok || std::rename(tmp_path_.c_str(), path_.c_str()) != 0) {
+      std::remove(tmp_path_.c_str());
+      throw std::runtime_error("Failed to publish SSTable " + path_);
+    }
+  }
+
+  [[nodiscard]] uint64_t entry_count() const { return entry_count_; }
+
+  /**
+   * @brief Bytes written so far, including the pending block.
+   */
+  [[nodiscard]] uint64_t file_size() const { return offset_ + block_.size(); }
+
+private:
+  std::string path_;
+  std::string tmp_path_;
+  size_t block_bytes_;
+  std::FILE *file_ = nullptr;
+  uint64_t offset_ = 0;
+  uint64_t entry_count_ = 0;
+  std::string block_;
+  std::string index_entries_;
+  std::string first_key_;
+  std::string last_key_;
+  BloomFilterBuilder bloom_;
+
+  static void append(std::string &out, const void *data, size_t size) {
+    out.append(static_cast<const char *>(data), size);
+  }
+
+  void flush_block() {
+    if (block_.empty())
+      return;
+    const uint32_t checksum = crc32(block_.data(), block_.size());
+    const auto size = static_cast<uint32_t>(block_.size());
+    append(block_, &checksum, sizeof(checksum));
+
+    const auto key_len = static_cast<uint32_t>(last_key_.size());
+    append(index_entries_, &key_len, sizeof(key_len));
+    index_entries_ += last_key_;
+    append(index_entries_, &offset_, sizeof(offset_));
+    append(index_entries_, &size, sizeof(size));
+
+    write(block_.data(), block_.size());
+    block_.clear();
+  }
+
+  void write(const void *data, size_t size) {
+    if (size == 0)
+      return;
+    if (std::fwrite(data, 1, size, file_) != size) {
+      throw std::runtime_error("Failed to write " + tmp_path_);
+    }
+    offset_ += size;
+  }
+};
+
+/**
+ * @brief Read-only handle to an SSTable file.
+ *
+ * The block index and bloom filter are loaded into memory on open; data
+ * blocks are read with pread(2) on demand and checksummed on every read
+ * (hot blocks stay in the OS page cache). A point lookup costs one
+ * filter probe and, unless the filter rules the key out, one block read.
+ *
+ * Tables are shared between versions of the LSM tree. Once compaction
+ * replaces a table it is marked obsolete, and the file is deleted when
+ * the last reader drops its reference.
+ *
+ * Thread-safe: all methods are const and pread does not move the file
+ * offset.
+ */
+class SSTable : public std::enable_shared_from_this<SSTable> {
+public:
+  class Iterator;
+
+  /**
+   * @brief Open and validate a table file.
+   * @throws std::runtime_error If the file is missing or corrupt
+   */
+  static std::shared_ptr<SSTable> open(const std::string &path,
+                                       uint64_t file_number) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to open SSTable " + path + ": " +
+                               std::strerror(errno));
+    }
+    std::shared_ptr<SSTable> table(new SSTable(path, file_number, fd));
+    table->load_meta();
+    return table;
+  }
+
+  ~SSTable() {
+    ::close(fd_);
+    if (obsolete_.load(std::memory_order_acquire)) {
+      ::unlink(path_.c_str());
+    }
+  }
+
+  // Non-copyable
+  SSTable(const SSTable &) = delete;
+  SSTable &operator=(const SSTable &) = delete;
+
+  /**
+   * @brief Look up one key.
+   * @param value Receives the value when FOUND
+   */
+  LookupResult get(std::string_view key, std::string *value) const {
+    if (key < smallest_ || key > largest_ || !bloom_may_contain(bloom_, key))
+      return LookupResult::NOT_FOUND;
+
+    const size_t block = find_block(key);
+    if (block == index_.size())
+      return LookupResult::NOT_FOUND;
+
+    const std::string data = read_block(block);
+    size_t pos = 0;
+    std::string_view entry_key;
+    std::string_view entry_value;
+    bool deleted = false;
+    while (parse_entry(data, pos, entry_key, entry_value, deleted)) {
+      if (entry_key == key) {
+        if (deleted)
+          return LookupResult::DELETED;
+        value->assign(entry_value);
+        return LookupResult::FOUND;
+      }
+      if (entry_key > key)
+        break;
+    }
+    return LookupResult::NOT_FOUND;
+  }
+
+  [[nodiscard]] std::unique_ptr<Iterator> iterator() const;
+
+  /// Delete the file once the last reference is dropped.
+  void mark_obsolete() const {
+    obsolete_.store(true, std::memory_order_release);
+  }
+
+  [[nodiscard]] uint64_t file_number() const { return file_number_; }
+  [[nodiscard]] uint64_t file_size() const { return file_size_; }
+  [[nodiscard]] uint64_t entry_count() const { return entry_count_; }
+  [[nodiscard]] const std::string &smallest() const { return smallest_; }
+  [[nodiscard]] const std::string &largest() const { return largest_; }
+  [[nodiscard]] const std::string &path() const { return path_; }
+
+  /**
+   * @brief Whether the table's key range intersects [start, end].
+   */
+  [[nodiscard]] bool overlaps(std::string_view start,
+                              std::string_view end) const {
+    return !(largest_ < start || smallest_ > end);
+  }
+
+private:
+  struct BlockHandle {
+    std::string last_key;
+    uint64_t offset;
+    uint32_t size; ///< Entry bytes, excluding the trailing crc
+  };
+
+  std::string path_;
+  uint64_t file_number_;
+  int fd_;
+  uint64_t file_size_ = 0;
+  uint64_t entry_count_ = 0;
+  std::string smallest_;
+  std::string largest_;
+  std::vector<BlockHandle> index_;
+  std::string bloom_;
+  mutable std::atomic<bool> obsolete_{false};
+
+  SSTable(std::string path, uint64_t file_number, int fd)
+      : path_(std::move(path)), file_number_(file_number), fd_(fd) {}
+
+  void pread_exact(void *out, size_t size, uint64_t offset) const {
+    auto *dst = static_cast<char *>(out);
+    while (size > 0) {
+      ssize_t n = ::pread(fd_, dst, size, static_cast<off_t>(offset));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) {
+        throw std::runtime_error("Short read from SSTable " + path_);
+      }
+      dst += n;
+      size -= static_cast<size_t>(n);
+      offset += static_cast<uint64_t>(n);
+    }
+  }
+
+  void load_meta() {
+    struct stat st {};
+    if (::fstat(fd_, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(SSTableFooter)) {
+      throw std::runtime_error("SSTable too small: " + path_);
+    }
+    file_size_ = static_cast<uint64_t>(st.st_size);
+
+    SSTableFooter footer{};
+    pread_exact(&footer, sizeof(footer), file_size_ - sizeof(footer));
+    if (std::memcmp(footer.magic, kSSTableMagic, sizeof(kSSTableMagic)) != 0 ||
+        footer.version != kSSTableVersion ||
+        footer.bloom_offset != footer.index_offset + footer.index_size ||
+        footer.bloom_offset + footer.bloom_size !=
+            file_size_ - sizeof(footer)) {
+      throw std::runtime_error("Bad SSTable footer: " + path_);
+    }
+    entry_count_ = footer.entry_count;
+
+    std::string meta(footer.index_size + footer.bloom_size, '\0');
+    pread_exact(meta.data(), meta.size(), footer.index_offset);
+    if (crc32(meta.data(), meta.size()) != footer.meta_crc) {
+      throw std::runtime_error("SSTable index checksum mismatch: " + path_);
+    }
+    bloom_ = meta.substr(footer.index_size);
+
+    std::string_view index(meta.data(), footer.index_size);
+    size_t pos = 0;
+    auto read_u32 = [&](uint32_t &out) {
+      if (pos + sizeof(out) > index.size())
+        throw std::runtime_error("Bad SSTable index: " + path_);
+      std::memcpy(&out, index.data() + pos, sizeof(out));
+      pos += sizeof(out);
+    };
+    auto read_string = [&](std::string &out) {
+      uint32_t len = 0;
+      read_u32(len);
+      if (pos + len > index.size())
+        throw std::runtime_error("Bad SSTable index: " + path_);
+      out.assign(index.data() + pos, len);
+      pos += len;
+    };
+
+    read_string(smallest_);
+    while (pos < index.size()) {
+      BlockHandle handle;
+      read_string(handle.last_key);
+      if (pos + sizeof(handle.offset) > index.size())
+        throw std::runtime_error("Bad SSTable index: " + path_);
+      std::memcpy(&handle.offset, index.data() + pos, sizeof(handle.offset));
+      pos += sizeof(handle.offset);
+      read_u32(handle.size);
+      if (handle.offset + handle.size + sizeof(uint32_t) > footer.index_offset)
+        throw std::runtime_error("Bad SSTable block handle: " + path_);
+      index_.push_back(std::move(handle));
+    }
+    if (!index_.empty()) {
+      largest_ = index_.back().last_key;
+    }
+  }
+
+  /**
+   * @brief First block whose last key is >= key (index_.size() if none).
+   */
+  [[nodiscard]] size_t find_block(std::string_view key) const {
+    auto it = std::lower_bound(
+        index_.begin(), index_.end(), key,
+        [](const BlockHandle &h, std::string_view k) { return h.last_key < k; });
+    return static_cast<size_t>(it - index_.begin());
+  }
+
+  /**
+   * @brief Read and checksum one data block.
+   * @throws std::runtime_error On I/O error or checksum mismatch
+   */
+  [[nodiscard]] std::string read_block(size_t i) const {
+    const BlockHandle &handle = index_[i];
+    std::string data(handle.size + sizeof(uint32_t), '\0');
+    pread_exact(data.data(), data.size(), handle.offset);
+
+    uint32_t checksum = 0;
+    std::memcpy(&checksum, data.data() + handle.size, sizeof(checksum));
+    data.resize(handle.size);
+    if (crc32(data.data(), data.size()) != checksum) {
+      throw std::runtime_error("SSTable block checksum mismatch: " + path_);
+    }
+    return data;
+  }
+
+  /**
+   * @brief Decode the entry at `pos` and advance past it.
+   * @return false at the end of the block
+   */
+  static bool parse_entry(std::string_view block, size_t &pos,
+                          std::string_view &key, std::string_view &value,
+                          bool &deleted) {
+    if (pos + 2 * sizeof(uint32_t) > block.size())
+      return false;
+    uint32_t key_len = 0;
+    uint32_t value_len = 0;
+    std::memcpy(&key_len, block.data() + pos, sizeof(key_len));
+    std::memcpy(&value_len, block.data() + pos + sizeof(key_len),
+                sizeof(value_len));
+    deleted = value_len == kTombstoneLength;
+    const size_t stored_value_len = deleted ? 0 : value_len;
+    const size_t body = pos + 2 * sizeof(uint32_t);
+    if (body + key_len + stored_value_len > block.size())
+      return false;
+    key = block.substr(body, key_len);
+    value = block.substr(body + key_len, stored_value_len);
+    pos = body + key_len + stored_value_len;
+    return true;
+  }
+
+  friend class Iterator;
+};
+
+/**
+ * @brief Iterator over one table, reading a block at a time.
+ *
+ * Holds a reference to its table, so the file outlives a concurrent
+ * compaction that obsoletes it.
+ */
+class SSTable::Iterator : public ISortedIterator {
+public:
+  explicit Iterator(std::shared_ptr<const SSTable> table)
+      : table_(std::move(table)) {}
+
+  void seek(std::string_view target) override {
+    load_block(table_->find_block(target));
+    while (valid_ && key_ < target) {
+      next();
+    }
+  }
+
+  void seek_to_first() override { load_block(0); }
+
+  [[nodiscard]] bool valid() const override { return valid_; }
+  [[nodiscard]] std::string_view key() const override { return key_; }
+  [[nodiscard]] std::string_view value() const override { return value_; }
+  [[nodiscard]] bool deleted() const override { return deleted_; }
+
+  void next() override {
+    if (parse_entry(block_, pos_, key_, value_, deleted_))
+      return;
+    load_block(block_index_ + 1);
+  }
+
+private:
+  std::shared_ptr<const SSTable> table_;
+  size_t block_index_ = 0;
+  std::string block_;
+  size_t pos_ = 0;
+  bool valid_ = false;
+  std::string_view key_;
+  std::string_view value_;
+  bool deleted_ = false;
+
+  void load_block(size_t index) {
+    valid_ = false;
+    for (block_index_ = index; block_index_ < table_->index_.size();
+         ++block_index_) {
+      block_ = table_->read_block(block_index_);
+      pos_ = 0;
+      if (parse_entry(block_, pos_, key_, value_, deleted_)) {
+        valid_ = true;
+        return;
+      }
+    }
+  }
+};
+
+inline std::unique_ptr<SSTable::Iterator> SSTable::iterator() const {
+  return std::make_unique<Iterator>(shared_from_this());
+}
+
+/**
+ * @brief Iterator over a level's tables: sorted, non-overlapping, in
+ *        key order. Only one table is open for reading at a time.
+ */
+class LevelIterator : public ISortedIterator {
+public:
+  explicit LevelIterator(std::vector<std::shared_ptr<SSTable>> tables)
+      : tables_(std::move(tables)) {}
+
+  void seek(std::string_view target) override {
+    auto it = std::lower_bound(tables_.begin(), tables_.end(), target,
+                               [](const std::shared_ptr<SSTable> &t,
+                                  std::string_view k) {
+                                 return t->largest() < k;
+                               });
+    open_table(static_cast<size_t>(it - tables_.begin()));
+    if (current_) {
+      current_->seek(target);
+      skip_exhausted();
+    }
+  }
+
+  void seek_to_first() override {
+    open_table(0);
+    if (current_) {
+      current_->seek_to_first();
+      skip_exhausted();
+    }
+  }
+
+  [[nodiscard]] bool valid() const override {
+    return current_ && current_->valid();
+  }
+  [[nodiscard]] std::string_view key() const override {
+    return current_->key();
+  }
+  [[nodiscard]] std::string_view value() const override {
+    return current_->value();
+  }
+  [[nodiscard]] bool deleted() const override { return current_->deleted(); }
+
+  void next() override {
+    current_->next();
+    skip_exhausted();
+  }
+
+private:
+  std::vector<std::shared_ptr<SSTable>> tables_;
+  size_t table_index_ = 0;
+  std::unique_ptr<SSTable::Iterator> current_;
+
+  void open_table(size_t index) {
+    table_index_ = index;
+    current_ = index < tables_.size() ? tables_[index]->iterator() : nullptr;
+  }
+
+  void skip_exhausted() {
+    while (current_ && !current_->valid()) {
+      open_table(table_index_ + 1);
+      if (current_) {
+        current_->seek_to_first();
+      }
+    }
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace kvdb {
+
+/**
+ * @brief A value owned on the heap or borrowed from a mapped snapshot.
+ *
+ * Borrowed values are only valid while the owning store keeps the
+ * MappedSnapshot alive.
+ */
+struct StoredValue {
+  std::string owned;
+  std::string_view mapped; ///< Non-null data() when borrowed
+
+  [[nodiscard]] std::string_view view() const {
+    return mapped.data() ? mapped : std::string_view(owned);
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace kvdb {
+
+/**
+ * @brief Hierarchical timing wheel over caller-owned, intrusive timers.
+ *
+ * kLevels wheels of kSlots slots; a slot at level L spans kSlots^L
+ * ticks. A timer is filed at the level matching how far off it is and
+ * cascades one level down each time the wheel below wraps, so
+ * schedule() and cancel() are O(1) and each timer is moved at most
+ * kLevels - 1 times before it fires. Empty stretches of time are
+ * skipped whole, so advancing over a long idle period is cheap too.
+ *
+ * Timers beyond the top level's range (kSlots^kLevels ticks) are parked
+ * in its furthest slot and re-filed when it comes round.
+ *
+ * Not thread-safe.
+ */
+class TimerWheel {
+public:
+  static constexpr unsigned kSlotBits = 6;
+  static constexpr size_t kSlots = size_t{1} << kSlotBits;
+  static constexpr size_t kLevels = 6;
+
+  /**
+   * @brief Intrusive timer; embed it in the caller's record.
+   *
+   * The record must not move while the timer is scheduled.
+   */
+  struct Timer {
+    uint64_t tick = 0;
+    size_t level = 0; ///< Wheel it is filed at, while scheduled
+    Timer *prev = nullptr;
+    Timer *next = nullptr;
+
+    [[nodiscard]] bool scheduled() const { return prev != nullptr; }
+  };
+
+  /// @param now First tick that has not been processed yet
+  explicit TimerWheel(uint64_t now) : now_(now) { clear(); }
+
+  // Non-copyable (slots point at themselves)
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+  /**
+   * @brief (Re)schedule a timer to fire at `tick`.
+   *
+   * A tick that has already passed fires on the next advance().
+   */
+  void schedule(Timer *timer, uint64_t tick) {
+    if (timer->scheduled()) {
+      cancel(timer);
+    }
+    timer->tick = tick;
+    file(timer);
+    ++size_;
+  }
+
+  void cancel(Timer *timer) {
+    if (!timer->scheduled())
+      return;
+    unlink(timer);
+    --level_size_[timer->level];
+    --size_;
+  }
+
+  /**
+   * @brief Fire every timer due at or before `tick`, in tick order.
+   *
+   * @param fire Called with each due timer, already unscheduled; it may
+   *             schedule timers again (including the one it was given)
+   */
+  template <typename Fire> void advance(uint64_t tick, Fire &&fire) {
+    while (now_ <= tick) {
+      if (size_ == 0) {
+        now_ = tick + 1;
+        return;
+      }
+      skip_empty_levels();
+      if (now_ > tick) {
+        now_ = tick + 1;
+        return;
+      }
+      if ((now_ & kMask) == 0) {
+        cascade();
+      }
+
+      // Detach the whole slot first, so that timers fire() reschedules
+      // land in later slots
+      Timer due;
+      due.prev = due.next = &due;
+      Timer &slot = slots_[0][now_ & kMask];
+      if (slot.next != &slot) {
+        due.next = slot.next;
+        due.prev = slot.prev;
+        due.next->prev = &due;
+        due.prev->next = &due;
+        slot.prev = slot.next = &slot;
+      }
+      ++now_;
+
+      while (due.next != &due) {
+        Timer *timer = due.next;
+        unlink(timer);
+        --level_size_[0];
+        --size_;
+        fire(timer);
+      }
+    }
+  }
+
+  /**
+   * @brief Forget every timer (their records are the caller's to free).
+   */
+  void clear() {
+    for (auto &level : slots_) {
+      for (Timer &slot : level) {
+        slot.prev = slot.next = &slot;
+      }
+    }
+    level_size_.fill(0);
+    size_ = 0;
+  }
+
+  [[nodiscard]] size_t size() const { return size_; }
+
+  /// First tick not processed yet.
+  [[nodiscard]] uint64_t now() const { return now_; }
+
+private:
+  static constexpr uint64_t kMask = kSlots - 1;
+
+  std::array<std::array<Timer, kSlots>, kLevels> slots_;
+  std::array<size_t, kLevels> level_size_{};
+  size_t size_ = 0;
+  uint64_t now_;
+
+  static constexpr uint64_t span(size_t level) {
+    return uint64_t{1} << (kSlotBits * level);
+  }
+
+  /// Level a timer belongs at, relative to now_.
+  [[nodiscard]] size_t level_for(uint64_t tick) const {
+    const uint64_t delta = tick > now_ ? tick - now_ : 0;
+    size_t level = 0;
+    while (level + 1 < kLevels && delta >= span(level + 1)) {
+      ++level;
+    }
+    return level;
+  }
+
+  void file(Timer *timer) {
+    uint64_t tick = timer->tick > now_ ? timer->tick : now_;
+    const size_t level = level_for(tick);
+    if (tick - now_ >= span(kLevels)) {
+      tick = now_ + span(kLevels) - 1;
+    }
+    Timer &slot = slots_[level][(tick >> (kSlotBits * level)) & kMask];
+    timer->level = level;
+    timer->next = &slot;
+    timer->prev = slot.prev;
+    slot.prev->next = timer;
+    slot.prev = timer;
+    ++level_size_[level];
+  }
+
+  static void unlink(Timer *timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = timer->next = nullptr;
+  }
+
+  /**
+   * @brief Jump now_ to the next tick where anything can happen.
+   *
+   * If levels 0..L-1 are empty, nothing fires before the next multiple
+   * of span(L), where level L cascades.
+   */
+  void skip_empty_levels() {
+    size_t empty = 0;
+    while (empty + 1 < kLevels && level_size_[empty] == 0) {
+      ++empty;
+    }
+    if (empty == 0)
+      return;
+    const uint64_t step = span(empty);
+    now_ = (now_ + step - 1) & ~(step - 1);
+  }
+
+  /// Re-file the slots whose span starts at now_, top level last.
+  void cascade() {
+    for (size_t level = 1; level < kLevels; ++level) {
+      if ((now_ & (span(level) - 1)) != 0)
+        break;
+      Timer &slot = slots_[level][(now_ >> (kSlotBits * level)) & kMask];
+      Timer *timer = slot.next;
+      slot.prev = slot.next = &slot;
+      while (timer != &slot) {
+        Timer *next = timer->next;
+        --level_size_[level];
+        file(timer);
+        timer = next;
+      }
+    }
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,467 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#ifdef KVDB_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef KVDB_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#include "crc32.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Value compression algorithm.
+ */
+enum class Compression {
+  NONE, ///< Store values as given
+  LZ4,  ///< Fast, moderate ratio (needs KVDB_WITH_LZ4)
+  ZSTD  ///< Better ratio, optional dictionary (needs KVDB_WITH_ZSTD)
+};
+
+/**
+ * @brief Parse a compression name ("none", "lz4", "zstd").
+ * @throws std::invalid_argument On an unknown name or a codec this
+ *         build was compiled without
+ */
+inline Compression parse_compression(const std::string &name) {
+  if (name == "none")
+    return Compression::NONE;
+  if (name == "lz4") {
+#ifdef KVDB_HAVE_LZ4
+    return Compression::LZ4;
+#else
+    throw std::invalid_argument("Built without LZ4 (KVDB_WITH_LZ4=OFF)");
+#endif
+  }
+  if (name == "zstd") {
+#ifdef KVDB_HAVE_ZSTD
+    return Compression::ZSTD;
+#else
+    throw std::invalid_argument("Built without zstd (KVDB_WITH_ZSTD=OFF)");
+#endif
+  }
+  throw std::invalid_argument("Unknown compression: " + name);
+}
+
+/**
+ * @brief Tunables for value compression.
+ */
+struct CompressionOptions {
+  Compression codec = Compression::NONE;
+  /// Values shorter than this are stored as given.
+  size_t min_bytes = 1024;
+  /// zstd compression level (LZ4 ignores it).
+  int level = 3;
+  /// Raw dictionary file, e.g. trained with `zstd --train`; empty = none.
+  std::string dictionary_path;
+};
+
+/**
+ * @brief Point-in-time copy of a ValueCodec's counters.
+ */
+struct CompressionStats {
+  /// Values at least min_bytes long, i.e. considered for compression.
+  uint64_t candidates = 0;
+  /// Candidates stored compressed (the rest did not shrink).
+  uint64_t compressed = 0;
+  uint64_t input_bytes = 0;  ///< Raw size of all candidates
+  uint64_t output_bytes = 0; ///< Stored size of all candidates
+  uint64_t compress_ns = 0;
+  uint64_t decompressed = 0;
+  uint64_t decompress_ns = 0;
+
+  /// Raw / stored size over all candidates (1.0 if none yet).
+  [[nodiscard]] double ratio() const {
+    return output_bytes == 0 ? 1.0
+                             : static_cast<double>(input_bytes) /
+                                   static_cast<double>(output_bytes);
+  }
+};
+
+/**
+ * @brief Encodes values for storage, compressing those above a size
+ *        threshold.
+ *
+ * An encoded value starts with a 12-byte header
+ *
+ *   { "\0KZ", u8 codec, u32 raw_len, u32 dictionary_crc }
+ *
+ * (little-endian; dictionary_crc is 0 without a dictionary) followed by
+ * the compressed bytes: a standard zstd frame, or an LZ4 block. Short or
+ * incompressible values are stored unchanged, so existing data needs no
+ * migration; a raw value that happens to start with the magic is
+ * escaped with codec NONE.
+ *
+ * decode() understands every codec compiled in, whatever codec is
+ * configured for writing, so a node can read values replicated from a
+ * differently configured one (dictionary values need the same
+ * dictionary, checked by its crc).
+ *
+ * Thread-safe. Counters are relaxed atomics.
+ */
+class ValueCodec {
+public:
+  static constexpr size_t kHeaderSize = 12;
+
+  /**
+   * @throws std::runtime_error If the dictionary cannot be loaded
+   */
+  explicit ValueCodec(CompressionOptions options = {})
+      : options_(std::move(options)) {
+    if (!options_.dictionary_path.empty()) {
+      load_dictionary(options_.dictionary_path);
+    }
+  }
+
+  ~ValueCodec() {
+#ifdef KVDB_HAVE_ZSTD
+    ZSTD_freeCDict(cdict_);
+    ZSTD_freeDDict(ddict_);
+#endif
+  }
+
+  // Non-copyable
+  ValueCodec(const ValueCodec &) = delete;
+  ValueCodec &operator=(const ValueCodec &) = delete;
+
+  [[nodiscard]] const CompressionOptions &options() const { return options_; }
+
+  /**
+   * @brief Whether a stored value carries the codec header.
+   */
+  static bool is_encoded(std::string_view stored) {
+    return stored.size() >= kHeaderSize &&
+           std::memcmp(stored.data(), kMagic, sizeof(kMagic)) == 0;
+  }
+
+  /**
+   * @brief Turn a value into its stored form.
+   */
+  [[nodiscard]] std::string encode(std::string_view value) {
+    if (options_.codec != Compression::NONE &&
+        value.size() >= options_.min_bytes) {
+      const auto start = std::chrono::steady_clock::now();
+      std::string stored = compress(value);
+      const auto elapsed = std::chrono::steady_clock::now() - start;
+
+      candidates_.fetch_add(1, std::memory_order_relaxed);
+      input_bytes_.fetch_add(value.size(), std::memory_order_relaxed);
+      compress_ns_.fetch_add(nanoseconds(elapsed), std::memory_order_relaxed);
+      if (!stored.empty() && stored.size() < value.size()) {
+        compressed_.fetch_add(1, std::memory_order_relaxed);
+        output_bytes_.fetch_add(stored.size(), std::memory_order_relaxed);
+        return stored;
+      }
+      output_bytes_.fetch_add(value.size(), std::memory_order_relaxed);
+    }
+    if (is_encoded(value)) {
+      std::string escaped(kHeaderSize, '\0');
+      fill_header(escaped, Compression::NONE, value.size(), 0);
+      escaped.append(value.data(), value.size());
+      return escaped;
+    }
+    return std::string(value);
+  }
+
+  /**
+   * @brief Recover the original value from its stored form.
+   * @throws std::runtime_error On a corrupt value or a codec or
+   *         dictionary this node lacks
+   */
+  [[nodiscard]] std::string decode(std::string_view stored) const {
+    if (!is_encoded(stored))
+      return std::string(stored);
+
+    const auto codec = static_cast<Compression>(stored[sizeof(kMagic)]);
+    const uint32_t raw_len = get_u32(stored.data() + 4);
+    const uint32_t dict_crc = get_u32(stored.data() + 8);
+    const std::string_view payload = stored.substr(kHeaderSize);
+    if (codec == Compression::NONE)
+      return std::string(payload);
+    if (dict_crc != 0 && dict_crc != dictionary_crc_) {
+      throw std::runtime_error("Value needs a compression dictionary that "
+                               "is not loaded");
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::string value = decompress(codec, payload, raw_len, dict_crc != 0);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    decompressed_.fetch_add(1, std::memory_order_relaxed);
+    decompress_ns_.fetch_add(nanoseconds(elapsed), std::memory_order_relaxed);
+    return value;
+  }
+
+  /**
+   * @brief HTTP content coding (RFC 9110) a stored value can be served
+   *        in as is, if any.
+   *
+   * Only dictionary-free zstd frames qualify: LZ4 blocks have no
+   * registered coding and clients cannot know our dictionary.
+   *
+   * @param payload Receives the bytes to send
+   * @return The coding name, or nullptr
+   */
+  static const char *content_coding(std::string_view stored,
+                                    std::string_view *payload) {
+    if (!is_encoded(stored) ||
+        static_cast<Compression>(stored[sizeof(kMagic)]) !=
+            Compression::ZSTD ||
+        get_u32(stored.data() + 8) != 0)
+      return nullptr;
+    *payload = stored.substr(kHeaderSize);
+    return "zstd";
+  }
+
+  /**
+   * @brief The value itself, if `stored` holds it uncompressed.
+   *
+   * @param value Receives a view of it into `stored`
+   * @return false if it has to be decoded
+   */
+  static bool raw_value(std::string_view stored, std::string_view *value) {
+    if (!is_encoded(stored)) {
+      *value = stored;
+      return true;
+    }
+    if (static_cast<Compression>(stored[sizeof(kMagic)]) !=
+        Compression::NONE)
+      return false;
+    *value = stored.substr(kHeaderSize);
+    return true;
+  }
+
+  [[nodiscard]] CompressionStats stats() const {
+    CompressionStats stats;
+    stats.candidates = candidates_.load(std::memory_order_relaxed);
+    stats.compressed = compressed_.load(std::memory_order_relaxed);
+    stats.input_bytes = input_bytes_.load(std::memory_order_relaxed);
+    stats.output_bytes = output_bytes_.load(std::memory_order_relaxed);
+    stats.compress_ns = compress_ns_.load(std::memory_order_relaxed);
+    stats.decompressed = decompressed_.load(std::memory_order_relaxed);
+    stats.decompress_ns = decompress_ns_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+private:
+  static constexpr char kMagic[3] = {'\0', 'K', 'Z'};
+
+  /// Most raw bytes an LZ4 block can expand to per compressed byte (a
+  /// match length grows by at most 255 per byte).
+  static constexpr uint64_t kLz4MaxRatio = 255;
+  /// Same for zstd: a 4-byte RLE block stands for up to 128 KiB.
+  static constexpr uint64_t kZstdMaxRatio = (128 * 1024) / 4;
+
+  CompressionOptions options_;
+  std::string dictionary_;
+  uint32_t dictionary_crc_ = 0;
+#ifdef KVDB_HAVE_ZSTD
+  ZSTD_CDict *cdict_ = nullptr;
+  ZSTD_DDict *ddict_ = nullptr;
+#endif
+
+  std::atomic<uint64_t> candidates_{0};
+  std::atomic<uint64_t> compressed_{0};
+  std::atomic<uint64_t> input_bytes_{0};
+  std::atomic<uint64_t> output_bytes_{0};
+  std::atomic<uint64_t> compress_ns_{0};
+  mutable std::atomic<uint64_t> decompressed_{0};
+  mutable std::atomic<uint64_t> decompress_ns_{0};
+
+  template <typename Duration> static uint64_t nanoseconds(Duration d) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+  }
+
+  static void put_u32(char *out, uint32_t v) {
+    for (size_t i = 0; i < sizeof(v); ++i) {
+      out[i] = static_cast<char>(v >> (8 * i));
+    }
+  }
+
+  static uint32_t get_u32(const char *in) {
+    uint32_t v = 0;
+    for (size_t i = 0; i < sizeof(v); ++i) {
+      v |= static_cast<uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return v;
+  }
+
+  /// Write the header into the first kHeaderSize bytes of `out`.
+  static void fill_header(std::string &out, Compression codec, size_t raw_len,
+                          uint32_t dict_crc) {
+    std::memcpy(out.data(), kMagic, sizeof(kMagic));
+    out[sizeof(kMagic)] = static_cast<char>(codec);
+    put_u32(out.data() + 4, static_cast<uint32_t>(raw_len));
+    put_u32(out.data() + 8, dict_crc);
+  }
+
+  void load_dictionary(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+      throw std::runtime_error("Failed to open compression dictionary " +
+                               path);
+    }
+    dictionary_.assign(std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>());
+    if (dictionary_.empty()) {
+      throw std::runtime_error("Empty compression dictionary " + path);
+    }
+    dictionary_crc_ = crc32(dictionary_.data(), dictionary_.size());
+    if (dictionary_crc_ == 0) {
+      dictionary_crc_ = 1; // 0 means "no dictionary" in the header
+    }
+#ifdef KVDB_HAVE_ZSTD
+    cdict_ = ZSTD_createCDict(dictionary_.data(), dictionary_.size(),
+                              options_.level);
+    ddict_ = ZSTD_createDDict(dictionary_.data(), dictionary_.size());
+    if (!cdict_ || !ddict_) {
+      ZSTD_freeCDict(cdict_);
+      ZSTD_freeDDict(ddict_);
+      throw std::runtime_error("Invalid zstd dictionary " + path);
+    }
+#endif
+  }
+
+  /**
+   * @brief Compress with the configured codec.
+   * @return The encoded value, or "" if the codec failed
+   */
+  [[nodiscard]] std::string compress(std::string_view value) const {
+#ifdef KVDB_HAVE_ZSTD
+    if (options_.codec == Compression::ZSTD) {
+      struct CCtxDeleter {
+        void operator()(ZSTD_CCtx *ctx) const { ZSTD_freeCCtx(ctx); }
+      };
+      thread_local std::unique_ptr<ZSTD_CCtx, CCtxDeleter> ctx(
+          ZSTD_createCCtx());
+
+      std::string out(kHeaderSize + ZSTD_compressBound(value.size()), '\0');
+      char *dst = out.data() + kHeaderSize;
+      const size_t cap = out.size() - kHeaderSize;
+      const size_t n =
+          cdict_ ? ZSTD_compress_usingCDict(ctx.get(), dst, cap, value.data(),
+                                            value.size(), cdict_)
+                 : ZSTD_compressCCtx(ctx.get(), dst, cap, value.data(),
+                                     value.size(), options_.level);
+      if (ZSTD_isError(n))
+        return {};
+      out.resize(kHeaderSize + n);
+      fill_header(out, Compression::ZSTD, value.size(), active_dictionary());
+      return out;
+    }
+#endif
+#ifdef KVDB_HAVE_LZ4
+    if (options_.codec == Compression::LZ4) {
+      const int src_len = static_cast<int>(value.size());
+      std::string out(kHeaderSize + LZ4_compressBound(src_len), '\0');
+      char *dst = out.data() + kHeaderSize;
+      const int cap = static_cast<int>(out.size() - kHeaderSize);
+      int n;
+      if (dictionary_.empty()) {
+        n = LZ4_compress_default(value.data(), dst, src_len, cap);
+      } else {
+        LZ4_stream_t stream;
+        LZ4_initStream(&stream, sizeof(stream));
+        LZ4_loadDict(&stream, dictionary_.data(),
+                     static_cast<int>(dictionary_.size()));
+        n = LZ4_compress_fast_continue(&stream, value.data(), dst, src_len,
+                                       cap, 1);
+      }
+      if (n <= 0)
+        return {};
+      out.resize(kHeaderSize + static_cast<size_t>(n));
+      fill_header(out, Compression::LZ4, value.size(), active_dictionary());
+      return out;
+    }
+#endif
+    return {};
+  }
+
+  /// Header crc for values compressed now: 0 without a dictionary.
+  [[nodiscard]] uint32_t active_dictionary() const {
+    return dictionary_.empty() ? 0 : dictionary_crc_;
+  }
+
+  [[nodiscard]] std::string decompress(Compression codec,
+                                       std::string_view payload,
+                                       uint32_t raw_len,
+                                       bool with_dictionary) const {
+#ifdef KVDB_HAVE_ZSTD
+    if (codec == Compression::ZSTD) {
+      check_raw_len(raw_len, payload, kZstdMaxRatio);
+      std::string value(raw_len, '\0');
+      struct DCtxDeleter {
+        void operator()(ZSTD_DCtx *ctx) const { ZSTD_freeDCtx(ctx); }
+      };
+      thread_local std::unique_ptr<ZSTD_DCtx, DCtxDeleter> ctx(
+          ZSTD_createDCtx());
+
+      const size_t n =
+          with_dictionary
+              ? ZSTD_decompress_usingDDict(ctx.get(), value.data(), raw_len,
+                                           payload.data(), payload.size(),
+                                           ddict_)
+              : ZSTD_decompressDCtx(ctx.get(), value.data(), raw_len,
+                                    payload.data(), payload.size());
+      if (ZSTD_isError(n) || n != raw_len) {
+        throw std::runtime_error("Corrupt zstd value");
+      }
+      return value;
+    }
+#endif
+#ifdef KVDB_HAVE_LZ4
+    if (codec == Compression::LZ4) {
+      check_raw_len(raw_len, payload, kLz4MaxRatio);
+      std::string value(raw_len, '\0');
+      const int n =
+          with_dictionary
+              ? LZ4_decompress_safe_usingDict(
+                    payload.data(), value.data(),
+                    static_cast<int>(payload.size()),
+                    static_cast<int>(raw_len), dictionary_.data(),
+                    static_cast<int>(dictionary_.size()))
+              : LZ4_decompress_safe(payload.data(), value.data(),
+                                    static_cast<int>(payload.size()),
+                                    static_cast<int>(raw_len));
+      if (n < 0 || static_cast<uint32_t>(n) != raw_len) {
+        throw std::runtime_error("Corrupt LZ4 value");
+      }
+      return value;
+    }
+#endif
+    throw std::runtime_error("Value compressed with a codec this build "
+                             "lacks (codec " +
+                             std::to_string(static_cast<int>(codec)) + ")");
+  }
+
+  /**
+   * @brief Reject a header claiming more raw bytes than the payload can
+   *        expand to, before allocating them.
+   * @throws std::runtime_error On such a header
+   */
+  static void check_raw_len(uint32_t raw_len, std::string_view payload,
+                            uint64_t max_ratio) {
+    if (raw_len > payload.size() * max_ratio) {
+      throw std::runtime_error("Corrupt compressed value: " +
+                               std::to_string(payload.size()) +
+                               " bytes cannot expand to " +
+                               std::to_string(raw_len));
+    }
+  }
+};
+
+} // namespace kvdb
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../metrics/metrics.hpp"
+#include "crc32.hpp"
+
+namespace kvdb {
+
+/**
+ * @brief Mutation kinds recorded in the write-ahead log.
+ */
+enum class WalRecordType : uint8_t { SET = 1, DELETE = 2 };
+
+/**
+ * @brief Append-only, checksummed write-ahead log.
+ *
+ * Every mutation is written as one self-describing frame:
+ *
+ *   [u32 payload_len][u32 crc32(payload)][payload]
+ *   payload := [u8 type][u32 key_len][key bytes][value bytes]
+ *
+ * Integers are stored in host byte order; the log is a node-local
+ * file and is never shipped between machines. A torn frame at the
+ * tail (crash mid-write) fails its checksum and ends replay.
+ *
+ * Every sync() is timed in kvdb_wal_sync_seconds.
+ *
+ * Not thread-safe: callers serialize appends.
+ */
+class WriteAheadLog {
+public:
+  using Visitor = std::function<void(WalRecordType type, std::string_view key,
+                                     std::string_view value)>;
+
+  WriteAheadLog() = default;
+
+  ~WriteAheadLog() { close(); }
+
+  // Non-copyable
+  WriteAheadLog(const WriteAheadLog &) = delete;
+  WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+  /**
+   * @brief Open (or create) the log file for appending.
+   * @throws std::runtime_error If the file cannot be opened
+   */
+  void open(const std::string &path) {
+    close();
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                 0644);
+    if (fd_ < 0) {
+      throw std::runtime_error("Failed to open WAL " + path + ": " +
+                               std::strerror(errno));
+    }
+    struct stat st {};
+    size_bytes_ = (::fstat(fd_, &st) == 0) ? static_cast<size_t>(st.st_size)
+                                           : 0;
+  }
+
+  /**
+   * @brief Close the log file if open.
+   */
+  void close() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  [[nodiscard]] bool is_open() const { return fd_ >= 0; }
+
+  /**
+   * @brief Current size of the log file in bytes.
+   */
+  [[nodiscard]] size_t size_bytes() const { return size_bytes_; }
+
+  /**
+   * @brief Append one framed record with a single write(2).
+   * @throws std::runtime_error If the write fails
+   */
+  void append(WalRecordType type, std::string_view key,
+              std::string_view value) {
+    const auto key_len = static_cast<uint32_t>(key.size());
+    const auto payload_len =
+        static_cast<uint32_t>(1 + sizeof(key_len) + key.size() + value.size());
+
+    frame_.resize(kFrameHeaderSize + payload_len);
+    char *payload = frame_.data() + kFrameHeaderSize;
+    payload[0] = static_cast<char>(type);
+    std::memcpy(payload + 1, &key_len, sizeof(key_len));
+    if (!key.empty()) {
+      std::memcpy(payload + 1 + sizeof(key_len), key.data(), key.size());
+    }
+    if (!value.empty()) {
+      std::memcpy(payload + 1 + sizeof(key_len) + key.size(), value.data(),
+                  value.size());
+    }
+
+    const uint32_t checksum = crc32(payload, payload_len);
+    std::memcpy(frame_.data(), &payload_len, sizeof(payload_len));
+    std::memcpy(frame_.data() + sizeof(payload_len), &checksum,
+                sizeof(checksum));
+
+    write_all(frame_.data(), frame_.size());
+    size_bytes_ += frame_.size();
+  }
+
+  /**
+   * @brief Flush appended records to stable storage (fdatasync).
+   * @throws std::runtime_error If the sync fails
+   */
+  void sync() {
+    if (fd_ < 0)
+      return;
+    ScopedLatency timed(sync_latency_);
+    if (::fdatasync(fd_) != 0) {
+      throw std::runtime_error(std::string("WAL fdatasync failed: ") +
+                               std::strerror(errno));
+    }
+  }
+
+  /**
+   * @brief Replay every intact record in a log file, in order.
+   *
+   * Stops at the first short or corrupt frame.
+   *
+   * @param path Log file to read (a missing file replays nothing)
+   * @param visit Called once per record
+   * @return Number of bytes covered by intact records
+   */
+  static size_t replay(const std::string &path, const Visitor &visit) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+      return 0;
+    return replay(file, SIZE_MAX, visit);
+  }
+
+  /**
+   * @brief Replay the intact records among the first `limit` bytes of
+   *        an open log, from its current position.
+   * @return Number of bytes covered by intact records
+   */
+  static size_t replay(std::istream &file, size_t limit,
+                       const Visitor &visit) {
+    size_t valid_bytes = 0;
+    std::vector<char> payload;
+    char header[kFrameHeaderSize];
+
+    while (limit - valid_bytes >= kFrameHeaderSize &&
+           file.read(header, kFrameHeaderSize)) {
+      uint32_t payload_len = 0;
+      uint32_t checksum = 0;
+      std::memcpy(&payload_len, header, sizeof(payload_len));
+      std::memcpy(&checksum, header + sizeof(payload_len), sizeof(checksum));
+      if (payload_len < 1 + sizeof(uint32_t) || payload_len > kMaxRecordSize ||
+          payload_len > limit - valid_bytes - kFrameHeaderSize)
+        break;
+
+      payload.resize(payload_len);
+      if (!file.read(payload.data(), payload_len))
+        break;
+      if (crc32(payload.data(), payload_len) != checksum)
+        break;
+
+      uint32_t key_len = 0;
+      std::memcpy(&key_len, payload.data() + 1, sizeof(key_len));
+      const size_t key_off = 1 + sizeof(key_len);
+      if (key_len > payload_len - key_off)
+        break;
+
+      const auto type = static_cast<WalRecordType>(payload[0]);
+      if (type != WalRecordType::SET && type != WalRecordType::DELETE)
+        break;
+
+      visit(type, std::string_view(payload.data() + key_off, key_len),
+            std::string_view(payload.data() + key_off + key_len,
+                             payload_len - key_off - key_len));
+      valid_bytes += kFrameHeaderSize + payload_len;
+    }
+    return valid_bytes;
+  }
+
+private:
+  int fd_ = -1;
+  size_t size_bytes_ = 0;
+  std::vector<char> frame_;
+  LatencyHistogram &sync_latency_ = MetricsRegistry::instance().histogram(
+      "kvdb_wal_sync_seconds", "Time to fdatasync a write-ahead log.");
+
+  static constexpr size_t kFrameHeaderSize = 2 * sizeof(uint32_t);
+  static constexpr uint32_t kMaxRecordSize = 1u << 30;
+
+  void write_all(const char *data, size_t size) {
+    while (size > 0) {
+      ssize_t n = ::write(fd_, data, size);
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        // Drop the partial frame so later appends stay replayable
+        int err = errno;
+        (void)::ftruncate(fd_, static_cast<off_t>(size_bytes_));
+        errno = err;
+        throw std::runtime_error(std::string("WAL write failed: ") +
+                                 std::strerror(errno));
+      }
+      data += n;
+      size -= static_cast<size_t>(n);
+    }
+  }
+};
+
+} // namespace kvdb
@@ -8,20 +8,45 @@ SIDE_PORT=50052
 APP_PORT=50051
 HTTP_PORT=8080
 DATA_DIR=/app/data
+# tcp (loopback ports), uds (Unix sockets) or shm (Unix sockets + apply ring)
+LOCAL_TRANSPORT=${LOCAL_TRANSPORT:-tcp}
+SOCKET_DIR=/tmp/kvdb
+APPLY_RING=/dev/shm/kvdb-apply-$ID
+
+CPP_ARGS=""
+APP_ADDR="localhost:$APP_PORT"
+SIDE_ARGS="-srv $SIDE_PORT"
+case "$LOCAL_TRANSPORT" in
+    tcp) ;;
+    uds|shm)
+        mkdir -p $SOCKET_DIR
+        CPP_ARGS="--grpc-socket=$SOCKET_DIR/app.sock --sidecar-socket=$SOCKET_DIR/sidecar.sock"
+        APP_ADDR="unix:$SOCKET_DIR/app.sock"
+        SIDE_ARGS="-srv-socket $SOCKET_DIR/sidecar.sock"
+        if [ "$LOCAL_TRANSPORT" = "shm" ]; then
+            CPP_ARGS="$CPP_ARGS --apply-ring=$APPLY_RING"
+            SIDE_ARGS="$SIDE_ARGS -apply-ring $APPLY_RING"
+        fi
+        ;;
+    *)
+        echo "Unknown LOCAL_TRANSPORT: $LOCAL_TRANSPORT (tcp, uds or shm)"
+        exit 1
+        ;;
+esac
 
 echo "--- Starting Node $ID ---"
 
 # 1. Start C++ App (Background)
 # Usage: ./kvdb_node <http_port> <my_grpc_port> <sidecar_port> <db_file>
 echo "Starting C++ KVDB..."
-./kvdb_node $HTTP_PORT $APP_PORT $SIDE_PORT $DATA_DIR/kv.db &
+./kvdb_node $CPP_ARGS $HTTP_PORT $APP_PORT $SIDE_PORT $DATA_DIR/kv.db &
 CPP_PID=$!
 
 # Wait for C++ to warm up
 sleep 2
 
 # 2. Build Go Arguments
-GO_ARGS="-id $ID -raft $RAFT_PORT -srv $SIDE_PORT -app localhost:$APP_PORT -mgmt $MGMT_PORT -data $DATA_DIR"
+GO_ARGS="-id $ID -raft $RAFT_PORT $SIDE_ARGS -app $APP_ADDR -mgmt $MGMT_PORT -data $DATA_DIR"
 
 # Docker specific: We must advertise our hostname so other containers can find us
 GO_ARGS="$GO_ARGS -advertise $ID"
@@ -31,6 +31,9 @@ func main() {
 	// Create FSM
 	stateMachineClient := fsm.NewStateMachineClient(backendClient.StateMachineClient)
 	raftFSM := fsm.NewCppFSM(stateMachineClient)
+	if cfg.ApplyRing != "" {
+		raftFSM.UseApplyRing(cfg.ApplyRing)
+	}
 
 	// Create Raft node
 	node, err := raftnode.New(cfg, raftFSM, nil)
@@ -81,7 +84,7 @@ func main() {
 	)
 
 	// Start serving (blocks until shutdown)
-	if err := grpcServer.Start(cfg.SidecarPort); err != nil {
+	if err := grpcServer.Start(cfg.SidecarListenAddr()); err != nil {
 		log.Fatalf("gRPC server failed: %v", err)
 	}
 }
@@ -11,7 +11,9 @@ type Config struct {
 	NodeID        string
 	RaftPort      string
 	SidecarPort   string
+	SidecarSocket string
 	AppAddr       string
+	ApplyRing     string
 	MgmtPort      string
 	Bootstrap     bool
 	DataDir       string
@@ -24,7 +26,9 @@ var flags struct {
 	nodeID        *string
 	raftPort      *string
 	sidecarPort   *string
+	sidecarSocket *string
 	appAddr       *string
+	applyRing     *string
 	mgmtPort      *string
 	bootstrap     *bool
 	dataDir       *string
@@ -36,7 +40,9 @@ func init() {
 	flags.nodeID = flag.String("id", "node1", "Unique Node ID")
 	flags.raftPort = flag.String("raft", "8088", "Raft TCP Port")
 	flags.sidecarPort = flag.String("srv", "50052", "Sidecar gRPC Port")
-	flags.appAddr = flag.String("app", "localhost:50051", "Address of C++ App gRPC")
+	flags.sidecarSocket = flag.String("srv-socket", "", "Serve the sidecar gRPC API on this Unix socket instead of the -srv port")
+	flags.appAddr = flag.String("app", "localhost:50051", "Address of C++ App gRPC (host:port, or unix:/path for a Unix socket)")
+	flags.applyRing = flag.String("apply-ring", "", "Shared-memory apply ring created by the C++ App (its --apply-ring)")
 	flags.mgmtPort = flag.String("mgmt", "6000", "Management HTTP Port")
 	flags.bootstrap = flag.Bool("bootstrap", false, "Bootstrap the cluster (Leader only)")
 	flags.dataDir = flag.String("data", "raft-data", "Directory to store Raft logs")
@@ -51,7 +57,9 @@ func Parse() *Config {
 		NodeID:        *flags.nodeID,
 		RaftPort:      *flags.raftPort,
 		SidecarPort:   *flags.sidecarPort,
+		SidecarSocket: *flags.sidecarSocket,
 		AppAddr:       *flags.appAddr,
+		ApplyRing:     *flags.applyRing,
 		MgmtPort:      *flags.mgmtPort,
 		Bootstrap:     *flags.bootstrap,
 		DataDir:       *flags.dataDir,
@@ -65,6 +73,15 @@ func (c *Config) BindAddr() string {
 	return "0.0.0.0:" + c.RaftPort
 }
 
+// SidecarListenAddr returns the network and address the sidecar gRPC API is
+// served on: the Unix socket if one is set, or else the TCP port.
+func (c *Config) SidecarListenAddr() (network, address string) {
+	if c.SidecarSocket != "" {
+		return "unix", c.SidecarSocket
+	}
+	return "tcp", ":" + c.SidecarPort
+}
+
 // AdvertiseAddr returns the address to advertise to other nodes.
 func (c *Config) AdvertiseAddr() string {
 	if c.RaftAdvertise != "" {
@@ -76,7 +93,7 @@ func (c *Config) AdvertiseAddr() string {
 // String returns a human-readable representation of the config.
 func (c *Config) String() string {
 	return fmt.Sprintf(
-		"Config{NodeID: %s, RaftPort: %s, SidecarPort: %s, AppAddr: %s, MgmtPort: %s, Bootstrap: %v, DataDir: %s}",
-		c.NodeID, c.RaftPort, c.SidecarPort, c.AppAddr, c.MgmtPort, c.Bootstrap, c.DataDir,
+		"Config{NodeID: %s, RaftPort: %s, SidecarPort: %s, SidecarSocket: %s, AppAddr: %s, ApplyRing: %s, MgmtPort: %s, Bootstrap: %v, DataDir: %s}",
+		c.NodeID, c.RaftPort, c.SidecarPort, c.SidecarSocket, c.AppAddr, c.ApplyRing, c.MgmtPort, c.Bootstrap, c.DataDir,
 	)
 }
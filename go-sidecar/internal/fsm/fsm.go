@@ -2,19 +2,33 @@
 package fsm
 
 import (
+	"bufio"
 	"context"
+	"encoding/binary"
+	"errors"
+	"fmt"
 	"io"
 	"log"
+	"sync/atomic"
+	"time"
 
 	"github.com/hashicorp/raft"
+	"google.golang.org/grpc"
+	"google.golang.org/protobuf/proto"
 
+	"my-raft-sidecar/internal/shmring"
 	pb "my-raft-sidecar/pb"
 )
 
-// StateMachineClient defines the interface for applying commands to the state machine.
+// StateMachineClient defines the interface for applying commands to the state machine
+// and for streaming its snapshots.
 // This abstraction allows for easier testing and decoupling from gRPC.
 type StateMachineClient interface {
 	Apply(ctx context.Context, cmd *pb.Command) (*pb.ApplyResponse, error)
+	ApplyBatch(ctx context.Context) (pb.StateMachine_ApplyBatchClient, error)
+	Snapshot(ctx context.Context) (pb.StateMachine_SnapshotClient, error)
+	Restore(ctx context.Context) (pb.StateMachine_RestoreClient, error)
+	AppliedIndex(ctx context.Context) (*pb.AppliedIndexResponse, error)
 }
 
 // grpcStateMachineClient wraps the generated gRPC client to satisfy our interface.
@@ -27,14 +41,72 @@ func (g *grpcStateMachineClient) Apply(ctx context.Context, cmd *pb.Command) (*p
 	return g.client.Apply(ctx, cmd)
 }
 
+// ApplyBatch opens a batched apply stream to the C++ backend.
+func (g *grpcStateMachineClient) ApplyBatch(ctx context.Context) (pb.StateMachine_ApplyBatchClient, error) {
+	return g.client.ApplyBatch(ctx)
+}
+
+// Snapshot opens a snapshot stream from the C++ backend.
+func (g *grpcStateMachineClient) Snapshot(ctx context.Context) (pb.StateMachine_SnapshotClient, error) {
+	return g.client.Snapshot(ctx, &pb.SnapshotRequest{})
+}
+
+// Restore opens a restore stream to the C++ backend.
+func (g *grpcStateMachineClient) Restore(ctx context.Context) (pb.StateMachine_RestoreClient, error) {
+	return g.client.Restore(ctx)
+}
+
+// AppliedIndex asks the C++ backend how far its store has applied the log,
+// waiting for the backend to come up.
+func (g *grpcStateMachineClient) AppliedIndex(ctx context.Context) (*pb.AppliedIndexResponse, error) {
+	return g.client.AppliedIndex(ctx, &pb.AppliedIndexRequest{}, grpc.WaitForReady(true))
+}
+
 // NewStateMachineClient creates a StateMachineClient from a gRPC client.
 func NewStateMachineClient(client pb.StateMachineClient) StateMachineClient {
 	return &grpcStateMachineClient{client: client}
 }
 
+// ringRetryInterval is how long the FSM sends batches over gRPC after failing
+// to attach the apply ring, before trying again.
+const ringRetryInterval = time.Second
+
+// ErrRejected is the response to a log entry the backend refused to apply
+// (it does not parse or is invalid).
+var ErrRejected = errors.New("backend rejected the command")
+
 // CppFSM implements the raft.FSM interface, forwarding Apply calls to the C++ backend.
+//
+// It is also a raft.BatchingFSM: Raft hands it every batch of committed
+// entries at once, and ApplyBatch sends them in one message over a
+// long-lived ApplyBatch stream, so applying costs one round trip per batch
+// instead of one RPC per entry.
+//
+// With an apply ring configured (UseApplyRing), batches go through shared
+// memory instead while the backend serves the ring, and over the stream
+// otherwise.
+//
+// Entries are sent with their index and term, which the backend records
+// with their writes. After a restart, Resume makes the FSM skip the entries
+// the backend already holds, so Raft replaying the log costs nothing for
+// them.
 type CppFSM struct {
 	client StateMachineClient
+	// applied is the index of the last log entry handed to the backend.
+	applied atomic.Uint64
+	// skip is the index up to which entries are already in the backend's
+	// store and are not sent again.
+	skip uint64
+	// batches is the open ApplyBatch stream, or nil; only used from Raft's
+	// FSM goroutine, like every FSM method but AppliedIndex.
+	batches      pb.StateMachine_ApplyBatchClient
+	closeBatches context.CancelFunc
+	// ringPath is the backend's shared-memory apply ring, or empty; ring is
+	// the attached ring, or nil. Only used from Raft's FSM goroutine.
+	ringPath    string
+	ring        *shmring.Channel
+	ringAttempt time.Time
+	ringFailing bool
 }
 
 // NewCppFSM creates a new FSM that delegates to the given state machine client.
@@ -42,43 +114,314 @@ func NewCppFSM(client StateMachineClient) *CppFSM {
 	return &CppFSM{client: client}
 }
 
+// UseApplyRing makes the FSM send batches of entries over the backend's
+// shared-memory apply ring at path (kvdb_node --apply-ring) while it serves
+// one. It must be called before Raft starts applying entries.
+func (f *CppFSM) UseApplyRing(path string) {
+	f.ringPath = path
+}
+
 // Apply applies a Raft log entry to the C++ backend.
 func (f *CppFSM) Apply(l *raft.Log) interface{} {
-	_, err := f.client.Apply(context.Background(), &pb.Command{Data: l.Data})
+	if l.Index <= f.skip {
+		f.applied.Store(l.Index)
+		return nil
+	}
+	_, err := f.client.Apply(context.Background(), &pb.Command{Data: l.Data, Index: l.Index, Term: l.Term})
 	if err != nil {
 		log.Printf("ERROR: Failed to apply to C++ DB: %v", err)
-		return err
 	}
-	return nil
+	f.applied.Store(l.Index)
+	return err
+}
+
+// ApplyBatch applies a batch of committed log entries with one round trip.
+// Configuration entries are only recorded; the backend has no use for them.
+// The batch carries the position of its last entry, which the backend
+// records as applied.
+func (f *CppFSM) ApplyBatch(logs []*raft.Log) []interface{} {
+	responses := make([]interface{}, len(logs))
+	batch := &pb.CommandBatch{Data: make([][]byte, 0, len(logs))}
+	for _, l := range logs {
+		if f.sends(l) {
+			batch.Data = append(batch.Data, l.Data)
+		}
+	}
+	if len(logs) > 0 {
+		batch.Index = logs[len(logs)-1].Index
+		batch.Term = logs[len(logs)-1].Term
+	}
+	if len(batch.Data) > 0 {
+		results, err := f.sendBatch(batch)
+		if err != nil {
+			log.Printf("ERROR: Failed to apply batch to C++ DB: %v", err)
+		}
+		next := 0
+		for i, l := range logs {
+			if !f.sends(l) {
+				continue
+			}
+			if err != nil {
+				responses[i] = err
+			} else if !results[next] {
+				responses[i] = ErrRejected
+			}
+			next++
+		}
+	}
+	if len(logs) > 0 {
+		f.applied.Store(logs[len(logs)-1].Index)
+	}
+	return responses
+}
+
+// sends reports whether an entry goes to the backend: a command it does not
+// hold yet.
+func (f *CppFSM) sends(l *raft.Log) bool {
+	return l.Type == raft.LogCommand && l.Index > f.skip
+}
+
+// sendBatch sends one batch over the apply ring or else the ApplyBatch
+// stream, opening it first if needed, and returns the backend's per-entry
+// results. A broken stream (e.g. the backend restarted) is reopened and the
+// batch resent once: applying entries again, in order, leaves the store as it
+// was.
+func (f *CppFSM) sendBatch(batch *pb.CommandBatch) ([]bool, error) {
+	if results, ok := f.sendOverRing(batch); ok {
+		return results, nil
+	}
+	var err error
+	for attempt := 0; attempt < 2; attempt++ {
+		if f.batches == nil {
+			ctx, cancel := context.WithCancel(context.Background())
+			f.batches, err = f.client.ApplyBatch(ctx)
+			if err != nil {
+				cancel()
+				f.batches = nil
+				continue
+			}
+			f.closeBatches = cancel
+		}
+		var resp *pb.ApplyBatchResponse
+		if err = f.batches.Send(batch); err == nil {
+			resp, err = f.batches.Recv()
+		}
+		if err == nil && len(resp.Success) != len(batch.Data) {
+			err = fmt.Errorf("backend answered %d of %d entries", len(resp.Success), len(batch.Data))
+		}
+		if err == nil {
+			return resp.Success, nil
+		}
+		f.closeBatches()
+		f.batches = nil
+	}
+	return nil, err
+}
+
+// sendOverRing sends one batch over the apply ring, attaching it first if
+// needed. ok is false if the batch has to go over gRPC instead: no ring is
+// configured or attached, the batch is too large for it, or the backend
+// stopped serving it (the ring is then dropped, and attached again later).
+func (f *CppFSM) sendOverRing(batch *pb.CommandBatch) (results []bool, ok bool) {
+	if f.ringPath == "" {
+		return nil, false
+	}
+	if f.ring == nil {
+		if time.Since(f.ringAttempt) < ringRetryInterval {
+			return nil, false
+		}
+		f.ringAttempt = time.Now()
+		ring, err := shmring.Attach(f.ringPath)
+		if err != nil {
+			if !f.ringFailing {
+				log.Printf("Applying over gRPC: cannot attach apply ring %s: %v", f.ringPath, err)
+				f.ringFailing = true
+			}
+			return nil, false
+		}
+		log.Printf("Applying over the shared-memory ring %s", f.ringPath)
+		f.ring = ring
+		f.ringFailing = false
+	}
+	results, err := f.ring.Apply(batch.Index, batch.Term, batch.Data)
+	if errors.Is(err, shmring.ErrTooLarge) {
+		return nil, false
+	}
+	if err != nil {
+		log.Printf("Applying over gRPC: apply ring failed: %v", err)
+		f.ring.Close()
+		f.ring = nil
+		f.ringFailing = true
+		return nil, false
+	}
+	return results, true
+}
+
+// StoreConfiguration records that a configuration entry has been applied;
+// the backend itself has no use for it.
+func (f *CppFSM) StoreConfiguration(index uint64, _ raft.Configuration) {
+	f.applied.Store(index)
+}
+
+// AppliedPosition asks the backend for the index and term of the last entry
+// its store holds (0 if it has recorded none).
+func (f *CppFSM) AppliedPosition(ctx context.Context) (index, term uint64, err error) {
+	resp, err := f.client.AppliedIndex(ctx)
+	if err != nil {
+		return 0, 0, err
+	}
+	return resp.Index, resp.Term, nil
+}
+
+// Resume makes the FSM skip the entries up to index, which the backend
+// already holds, and report them applied. It must be called before Raft
+// starts applying entries.
+func (f *CppFSM) Resume(index uint64) {
+	f.skip = index
+	f.applied.Store(index)
+}
+
+// AppliedIndex returns the index of the last command or configuration entry
+// the FSM has applied. Unlike raft.Raft.AppliedIndex, which runs ahead while
+// entries are queued for the FSM, the backend has seen every command up to it.
+// Noop and barrier entries are not reported.
+func (f *CppFSM) AppliedIndex() uint64 {
+	return f.applied.Load()
 }
 
-// Snapshot returns a snapshot of the FSM state.
-// Currently returns a dummy snapshot as snapshot support is not fully implemented.
+// Snapshot captures a point-in-time snapshot of the C++ store.
+// It returns as soon as the backend has fixed the point in time (signalled
+// by an empty first chunk); the data is streamed later by Persist, while
+// Raft keeps applying new entries.
 func (f *CppFSM) Snapshot() (raft.FSMSnapshot, error) {
-	return &DummySnapshot{}, nil
+	ctx, cancel := context.WithCancel(context.Background())
+	stream, err := f.client.Snapshot(ctx)
+	if err == nil {
+		_, err = stream.Recv()
+	}
+	if err != nil {
+		cancel()
+		return nil, fmt.Errorf("failed to start snapshot: %w", err)
+	}
+	return &StreamSnapshot{stream: stream, cancel: cancel}, nil
 }
 
-// Restore restores the FSM from a snapshot.
-// Currently a no-op as snapshot support is not fully implemented.
+// Restore replaces the C++ store's contents with a snapshot written by
+// StreamSnapshot.Persist.
 func (f *CppFSM) Restore(rc io.ReadCloser) error {
 	defer rc.Close()
+
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+	stream, err := f.client.Restore(ctx)
+	if err != nil {
+		return fmt.Errorf("failed to start restore: %w", err)
+	}
+
+	r := bufio.NewReader(rc)
+	for {
+		chunk, err := readChunk(r)
+		if err != nil {
+			return fmt.Errorf("failed to read snapshot: %w", err)
+		}
+		// On a send error the backend has ended the call; its status is
+		// reported by CloseAndRecv below.
+		if err := stream.Send(chunk); err != nil || chunk.Last {
+			break
+		}
+	}
+
+	resp, err := stream.CloseAndRecv()
+	if err != nil {
+		return fmt.Errorf("failed to restore snapshot: %w", err)
+	}
+	if !resp.Success {
+		return fmt.Errorf("failed to restore snapshot: %s", resp.Error)
+	}
+	// The store now holds the snapshot, and Raft applies what follows it
+	f.skip = 0
 	return nil
 }
 
-// DummySnapshot is a placeholder snapshot implementation.
-type DummySnapshot struct{}
+// StreamSnapshot is a snapshot being streamed from the C++ backend.
+// It is stored as a sequence of frames, each a little-endian uint32 length
+// followed by one marshalled SnapshotChunk, ending with the chunk that has
+// Last set.
+type StreamSnapshot struct {
+	stream pb.StateMachine_SnapshotClient
+	cancel context.CancelFunc
+}
 
 // Persist writes the snapshot to the given sink.
-func (d *DummySnapshot) Persist(sink raft.SnapshotSink) error {
-	defer sink.Close()
-	return nil
+func (s *StreamSnapshot) Persist(sink raft.SnapshotSink) error {
+	if err := s.persist(sink); err != nil {
+		sink.Cancel()
+		return err
+	}
+	return sink.Close()
+}
+
+func (s *StreamSnapshot) persist(w io.Writer) error {
+	bw := bufio.NewWriter(w)
+	for {
+		chunk, err := s.stream.Recv()
+		if err != nil {
+			return fmt.Errorf("failed to receive snapshot chunk: %w", err)
+		}
+		if err := writeChunk(bw, chunk); err != nil {
+			return fmt.Errorf("failed to write snapshot: %w", err)
+		}
+		if chunk.Last {
+			return bw.Flush()
+		}
+	}
 }
 
 // Release releases any resources held by the snapshot.
-func (d *DummySnapshot) Release() {}
+func (s *StreamSnapshot) Release() {
+	s.cancel()
+}
+
+// writeChunk appends one length-prefixed chunk frame.
+func writeChunk(w io.Writer, chunk *pb.SnapshotChunk) error {
+	data, err := proto.Marshal(chunk)
+	if err != nil {
+		return err
+	}
+	var header [4]byte
+	binary.LittleEndian.PutUint32(header[:], uint32(len(data)))
+	if _, err := w.Write(header[:]); err != nil {
+		return err
+	}
+	_, err = w.Write(data)
+	return err
+}
+
+// readChunk reads one frame written by writeChunk.
+func readChunk(r io.Reader) (*pb.SnapshotChunk, error) {
+	var header [4]byte
+	if _, err := io.ReadFull(r, header[:]); err != nil {
+		return nil, err
+	}
+	data := make([]byte, binary.LittleEndian.Uint32(header[:]))
+	if _, err := io.ReadFull(r, data); err != nil {
+		return nil, err
+	}
+	chunk := &pb.SnapshotChunk{}
+	if err := proto.Unmarshal(data, chunk); err != nil {
+		return nil, err
+	}
+	return chunk, nil
+}
 
 // Ensure CppFSM implements raft.FSM at compile time.
 var _ raft.FSM = (*CppFSM)(nil)
 
-// Ensure DummySnapshot implements raft.FSMSnapshot at compile time.
-var _ raft.FSMSnapshot = (*DummySnapshot)(nil)
+// Ensure Raft hands CppFSM whole batches of entries.
+var _ raft.BatchingFSM = (*CppFSM)(nil)
+
+// Ensure CppFSM sees configuration entries too, so AppliedIndex tracks them.
+var _ raft.ConfigurationStore = (*CppFSM)(nil)
+
+// Ensure StreamSnapshot implements raft.FSMSnapshot at compile time.
+var _ raft.FSMSnapshot = (*StreamSnapshot)(nil)
@@ -2,11 +2,14 @@
 package raftnode
 
 import (
+	"context"
+	"errors"
 	"fmt"
 	"log"
 	"net"
 	"os"
 	"path/filepath"
+	"sync/atomic"
 	"time"
 
 	"github.com/hashicorp/raft"
@@ -15,11 +18,50 @@ import (
 	"my-raft-sidecar/internal/config"
 )
 
+// snapshotRetain is the number of snapshots kept on disk.
+const snapshotRetain = 2
+
+// maxAppendEntries caps the entries per AppendEntries RPC, and so the
+// batches handed to the FSM's ApplyBatch (the default is 64).
+const maxAppendEntries = 512
+
+// readIndexPoll is how often ReadIndex rechecks the FSM's applied index.
+const readIndexPoll = time.Millisecond
+
+// resumeTimeout bounds the wait for the backend's applied index on start-up.
+const resumeTimeout = 30 * time.Second
+
+// ErrLeaderNotReady is returned by ReadIndex until a new leader has applied
+// an entry of its own term, before which its commit index may be stale.
+var ErrLeaderNotReady = errors.New("leader has not yet applied its first entry")
+
+// FSM is a raft.FSM that reports how far it has applied the log.
+type FSM interface {
+	raft.FSM
+	// AppliedIndex returns the index of the last entry the FSM has applied.
+	AppliedIndex() uint64
+}
+
+// ResumableFSM is an FSM whose backend keeps its state across restarts and
+// records how far it has applied the log.
+type ResumableFSM interface {
+	FSM
+	// AppliedPosition returns the index and term of the last entry the
+	// backend holds (0 if none).
+	AppliedPosition(ctx context.Context) (index, term uint64, err error)
+	// Resume makes the FSM skip the entries up to index.
+	Resume(index uint64)
+}
+
 // Node wraps the Raft instance and provides high-level operations.
 type Node struct {
 	Raft      *raft.Raft
 	Transport *raft.NetworkTransport
 	config    *config.Config
+	fsm       FSM
+	// readyIndex is the index of the barrier applied since this node last
+	// became leader, or 0 while it is not a ready leader.
+	readyIndex atomic.Uint64
 }
 
 // Options contains optional parameters for creating a Raft node.
@@ -39,7 +81,7 @@ func DefaultOptions() *Options {
 }
 
 // New creates and configures a new Raft node.
-func New(cfg *config.Config, fsm raft.FSM, opts *Options) (*Node, error) {
+func New(cfg *config.Config, fsm FSM, opts *Options) (*Node, error) {
 	if opts == nil {
 		opts = DefaultOptions()
 	}
@@ -52,6 +94,9 @@ func New(cfg *config.Config, fsm raft.FSM, opts *Options) (*Node, error) {
 	// Configure Raft
 	raftConfig := raft.DefaultConfig()
 	raftConfig.LocalID = raft.ServerID(cfg.NodeID)
+	// Let concurrent proposals share log appends and FSM batches
+	raftConfig.MaxAppendEntries = maxAppendEntries
+	raftConfig.BatchApplyCh = true
 
 	// Setup log store
 	logStore, err := raftboltdb.NewBoltStore(filepath.Join(cfg.DataDir, "logs.dat"))
@@ -59,6 +104,18 @@ func New(cfg *config.Config, fsm raft.FSM, opts *Options) (*Node, error) {
 		return nil, fmt.Errorf("failed to create log store: %w", err)
 	}
 
+	// Setup snapshot store; snapshots are streamed from the C++ backend
+	snapshotStore, err := raft.NewFileSnapshotStore(cfg.DataDir, snapshotRetain, os.Stderr)
+	if err != nil {
+		return nil, fmt.Errorf("failed to create snapshot store: %w", err)
+	}
+
+	// Skip what the backend already holds, and if that covers the latest
+	// snapshot, do not restore it either
+	if resumable, ok := fsm.(ResumableFSM); ok && resume(resumable, logStore, snapshotStore) {
+		raftConfig.NoSnapshotRestoreOnStart = true
+	}
+
 	// Create transport
 	transport, err := createTransport(cfg, opts)
 	if err != nil {
@@ -71,18 +128,85 @@ func New(cfg *config.Config, fsm raft.FSM, opts *Options) (*Node, error) {
 		fsm,
 		logStore,
 		logStore, // Use same store for stable store
-		raft.NewDiscardSnapshotStore(),
+		snapshotStore,
 		transport,
 	)
 	if err != nil {
 		return nil, fmt.Errorf("failed to create raft instance: %w", err)
 	}
 
-	return &Node{
+	n := &Node{
 		Raft:      r,
 		Transport: transport,
 		config:    cfg,
-	}, nil
+		fsm:       fsm,
+	}
+	go n.watchLeadership()
+	return n, nil
+}
+
+// resume lets the FSM skip the entries its backend already holds, once the
+// local log (or the latest snapshot) confirms the backend's position: a
+// backend that kept its data while the Raft state was wiped must replay
+// everything. It reports whether the backend is at least as recent as the
+// latest snapshot, which then need not be restored; if it is older, Raft
+// restores the snapshot as usual.
+func resume(fsm ResumableFSM, logs raft.LogStore, snapshots raft.SnapshotStore) bool {
+	ctx, cancel := context.WithTimeout(context.Background(), resumeTimeout)
+	defer cancel()
+	index, term, err := fsm.AppliedPosition(ctx)
+	if err != nil {
+		log.Printf("Cannot read the backend's applied index, replaying the whole log: %v", err)
+		return false
+	}
+	if index == 0 {
+		return false
+	}
+	metas, err := snapshots.List()
+	if err != nil {
+		log.Printf("Cannot list snapshots, replaying the whole log: %v", err)
+		return false
+	}
+	var latest *raft.SnapshotMeta
+	if len(metas) > 0 {
+		latest = metas[0]
+	}
+	if latest != nil && latest.Index > index {
+		return false
+	}
+
+	var entry raft.Log
+	confirmed := logs.GetLog(index, &entry) == nil && entry.Term == term
+	if !confirmed && latest != nil && latest.Index == index {
+		confirmed = latest.Term == term
+	}
+	if !confirmed {
+		log.Printf("Backend's applied index %d (term %d) is not in the local log, replaying the whole log", index, term)
+		return false
+	}
+	log.Printf("Backend holds the log up to index %d (term %d), skipping it", index, term)
+	fsm.Resume(index)
+	return true
+}
+
+// watchLeadership applies a barrier whenever this node becomes leader. Once
+// it completes, the FSM has applied everything committed in earlier terms,
+// and the commit index is known to be current (see ReadIndex).
+func (n *Node) watchLeadership() {
+	for isLeader := range n.Raft.LeaderCh() {
+		n.readyIndex.Store(0)
+		if !isLeader {
+			continue
+		}
+		future := n.Raft.Barrier(0)
+		if err := future.Error(); err != nil {
+			log.Printf("Leadership barrier failed: %v", err)
+			continue
+		}
+		if indexed, ok := future.(raft.IndexFuture); ok && n.IsLeader() {
+			n.readyIndex.Store(indexed.Index())
+		}
+	}
 }
 
 // createTransport creates and configures the Raft network transport.
@@ -141,6 +265,34 @@ func (n *Node) Apply(data []byte, timeout time.Duration) error {
 	return future.Error()
 }
 
+// ReadIndex waits until the local FSM has applied every entry committed when
+// it was called, after confirming with a quorum that this node is still the
+// leader. Reads served by the backend once it returns are linearizable.
+// It returns the commit index waited for.
+func (n *Node) ReadIndex(ctx context.Context) (uint64, error) {
+	if !n.IsLeader() {
+		return 0, raft.ErrNotLeader
+	}
+	if n.readyIndex.Load() == 0 {
+		return 0, ErrLeaderNotReady
+	}
+	index := n.Raft.CommitIndex()
+	if err := n.Raft.VerifyLeader().Error(); err != nil {
+		return 0, err
+	}
+
+	// Noop and barrier entries never reach the FSM; the leadership barrier
+	// covers the only ones a leader appends
+	for max(n.fsm.AppliedIndex(), n.readyIndex.Load()) < index {
+		select {
+		case <-ctx.Done():
+			return 0, ctx.Err()
+		case <-time.After(readIndexPoll):
+		}
+	}
+	return index, nil
+}
+
 // IsLeader returns true if this node is currently the leader.
 func (n *Node) IsLeader() bool {
 	return n.Raft.State() == raft.Leader
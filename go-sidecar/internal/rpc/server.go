@@ -6,6 +6,7 @@ import (
 	"fmt"
 	"log"
 	"net"
+	"os"
 	"time"
 
 	"google.golang.org/grpc"
@@ -41,10 +42,36 @@ func (s *Server) Propose(ctx context.Context, cmd *pb.Command) (*pb.ProposeRespo
 	return &pb.ProposeResponse{Success: true}, nil
 }
 
-// Start starts the gRPC server on the specified port.
-func (s *Server) Start(port string) error {
-	addr := ":" + port
-	lis, err := net.Listen("tcp", addr)
+// ReadIndex waits until the local backend has applied everything committed so
+// far, so that the reads it serves next are linearizable. Only the leader can
+// serve it.
+func (s *Server) ReadIndex(ctx context.Context, _ *pb.ReadIndexRequest) (*pb.ReadIndexResponse, error) {
+	index, err := s.node.ReadIndex(ctx)
+	if err != nil {
+		return &pb.ReadIndexResponse{
+			Success: false,
+			Error:   err.Error(),
+		}, nil
+	}
+	return &pb.ReadIndexResponse{Success: true, Index: index}, nil
+}
+
+// Leadership reports whether this node currently believes it is the leader,
+// without confirming it with a quorum.
+func (s *Server) Leadership(_ context.Context, _ *pb.LeadershipRequest) (*pb.LeadershipResponse, error) {
+	return &pb.LeadershipResponse{Leader: s.node.IsLeader()}, nil
+}
+
+// Start starts the gRPC server on the specified network ("tcp" or "unix") and
+// address. A socket file left at a Unix address by an earlier run is
+// replaced.
+func (s *Server) Start(network, addr string) error {
+	if network == "unix" {
+		if err := os.Remove(addr); err != nil && !os.IsNotExist(err) {
+			return fmt.Errorf("failed to remove stale socket %s: %w", addr, err)
+		}
+	}
+	lis, err := net.Listen(network, addr)
 	if err != nil {
 		return fmt.Errorf("failed to listen on %s: %w", addr, err)
 	}
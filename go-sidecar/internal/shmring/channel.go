@@ -0,0 +1,208 @@
+// Package shmring is the sidecar's end of the C++ backend's shared-memory
+// apply ring (cpp-app/src/raft/apply_ring.hpp): the same batches of committed
+// entries as the gRPC ApplyBatch stream, written as raw MsgPack into memory
+// both processes map, and answered the same way.
+//
+// The file the backend creates holds a header and two rings:
+//
+//	0     {u64 magic "KVDBRING", u32 version, u32 state, u32 pid}
+//	256   request ring control block (sidecar -> backend)
+//	512   response ring control block (backend -> sidecar)
+//	4096  the rings' data
+//
+// A request record (kind 1) is {u64 id, u64 index, u64 term, u32 count, u32 0}
+// followed by count entries {u32 length, bytes}; its answer (kind 2) is
+// {u64 id, u32 count, u32 0} followed by one byte per entry, 1 if it was
+// applied. Everything is in native byte order: both processes run on one host.
+package shmring
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"os"
+	"sync/atomic"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+const (
+	magic      = 0x474E49524244564B // "KVDBRING"
+	version    = 1
+	stateReady = 1
+
+	stateOffset     = 12
+	pidOffset       = 16
+	requestControl  = 256
+	responseControl = 512
+	headerBytes     = 4096
+
+	kindBatch     = 1
+	kindResults   = 2
+	batchHeader   = 32
+	resultsHeader = 16
+
+	// pollInterval is how often a waiting sidecar checks that the backend
+	// still serves the ring.
+	pollInterval = 100 * time.Millisecond
+	// spaceRetry is how long to wait for room in the request ring.
+	spaceRetry = 50 * time.Microsecond
+)
+
+var (
+	// ErrTooLarge is returned for a batch that does not fit in the ring; it
+	// has to go over gRPC.
+	ErrTooLarge = errors.New("batch too large for the apply ring")
+
+	// ErrClosed is returned once the backend no longer serves the ring: it
+	// closed it, or its process is gone.
+	ErrClosed = errors.New("apply ring closed by the backend")
+)
+
+// Channel is a mapped apply ring. Like the FSM methods calling it, it is used
+// from one goroutine at a time.
+type Channel struct {
+	mem       []byte
+	state     *uint32
+	pid       int
+	requests  *ring
+	responses *ring
+}
+
+// Attach maps the apply ring the backend created at path.
+func Attach(path string) (*Channel, error) {
+	f, err := os.OpenFile(path, os.O_RDWR, 0)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close()
+	info, err := f.Stat()
+	if err != nil {
+		return nil, err
+	}
+	if info.Size() < headerBytes {
+		return nil, fmt.Errorf("%s is not an apply ring", path)
+	}
+	mem, err := syscall.Mmap(int(f.Fd()), 0, int(info.Size()),
+		syscall.PROT_READ|syscall.PROT_WRITE, syscall.MAP_SHARED)
+	if err != nil {
+		return nil, fmt.Errorf("failed to map %s: %w", path, err)
+	}
+
+	c := &Channel{
+		mem:   mem,
+		state: (*uint32)(unsafe.Pointer(&mem[stateOffset])),
+		pid:   int(binary.NativeEndian.Uint32(mem[pidOffset:])),
+	}
+	if binary.NativeEndian.Uint64(mem) != magic || binary.NativeEndian.Uint32(mem[8:]) != version {
+		c.Close()
+		return nil, fmt.Errorf("%s is not a version %d apply ring", path, version)
+	}
+	if !c.alive() {
+		c.Close()
+		return nil, ErrClosed
+	}
+	if c.requests, err = newRing(mem, requestControl); err == nil {
+		c.responses, err = newRing(mem, responseControl)
+	}
+	if err != nil {
+		c.Close()
+		return nil, err
+	}
+	return c, nil
+}
+
+// Apply sends one batch of entries (index and term being the last entry's)
+// and waits for the backend to apply it, returning whether each entry was
+// applied.
+func (c *Channel) Apply(index, term uint64, entries [][]byte) ([]bool, error) {
+	size := batchHeader
+	for _, e := range entries {
+		size += 4 + len(e)
+	}
+	if size > c.requests.maxPayload() || resultsHeader+len(entries) > c.responses.maxPayload() {
+		return nil, ErrTooLarge
+	}
+
+	// The record's position in the ring identifies it: positions only grow,
+	// even across sidecar restarts
+	id := atomic.LoadUint64(c.requests.head)
+	var payload []byte
+	for {
+		if payload = c.requests.tryReserve(kindBatch, size); payload != nil {
+			break
+		}
+		// The backend frees each batch before answering it, so only a batch
+		// left by an earlier sidecar process can be in the way
+		if !c.alive() {
+			return nil, ErrClosed
+		}
+		time.Sleep(spaceRetry)
+		id = atomic.LoadUint64(c.requests.head)
+	}
+	binary.NativeEndian.PutUint64(payload, id)
+	binary.NativeEndian.PutUint64(payload[8:], index)
+	binary.NativeEndian.PutUint64(payload[16:], term)
+	binary.NativeEndian.PutUint32(payload[24:], uint32(len(entries)))
+	binary.NativeEndian.PutUint32(payload[28:], 0)
+	at := batchHeader
+	for _, e := range entries {
+		binary.NativeEndian.PutUint32(payload[at:], uint32(len(e)))
+		at += 4 + copy(payload[at+4:], e)
+	}
+	c.requests.publish()
+	return c.results(id, len(entries))
+}
+
+// results waits for the answer to batch id, skipping answers to batches of an
+// earlier sidecar process.
+func (c *Channel) results(id uint64, count int) ([]bool, error) {
+	for {
+		kind, payload, ok, err := c.responses.peek()
+		if err != nil {
+			return nil, err
+		}
+		if !ok {
+			if !c.responses.wait(pollInterval) && !c.alive() {
+				return nil, ErrClosed
+			}
+			continue
+		}
+		if kind != kindResults || len(payload) < resultsHeader {
+			return nil, fmt.Errorf("%w: unexpected record", errCorrupt)
+		}
+		if binary.NativeEndian.Uint64(payload) != id {
+			c.responses.release()
+			continue
+		}
+		if int(binary.NativeEndian.Uint32(payload[8:])) != count || len(payload) < resultsHeader+count {
+			return nil, fmt.Errorf("%w: backend answered the wrong number of entries", errCorrupt)
+		}
+		results := make([]bool, count)
+		for i := range results {
+			results[i] = payload[resultsHeader+i] != 0
+		}
+		c.responses.release()
+		return results, nil
+	}
+}
+
+// alive reports whether the backend still serves the ring.
+func (c *Channel) alive() bool {
+	if atomic.LoadUint32(c.state) != stateReady {
+		return false
+	}
+	err := syscall.Kill(c.pid, 0)
+	return err == nil || errors.Is(err, syscall.EPERM)
+}
+
+// Close unmaps the ring.
+func (c *Channel) Close() error {
+	if c.mem == nil {
+		return nil
+	}
+	err := syscall.Munmap(c.mem)
+	c.mem = nil
+	return err
+}
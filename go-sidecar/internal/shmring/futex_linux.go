@@ -0,0 +1,34 @@
+//go:build linux
+
+package shmring
+
+import (
+	"math"
+	"runtime"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+const (
+	futexWaitOp = 0 // FUTEX_WAIT, not private: the word is shared between processes
+	futexWakeOp = 1 // FUTEX_WAKE
+)
+
+// futexWait sleeps until addr is woken or timeout passes, unless *addr no
+// longer holds val.
+func futexWait(addr *uint32, val uint32, timeout time.Duration) {
+	ts := syscall.NsecToTimespec(int64(timeout))
+	syscall.Syscall6(syscall.SYS_FUTEX, uintptr(unsafe.Pointer(addr)), futexWaitOp,
+		uintptr(val), uintptr(unsafe.Pointer(&ts)), 0, 0)
+}
+
+// futexWake wakes every waiter sleeping on addr.
+func futexWake(addr *uint32) {
+	syscall.Syscall6(syscall.SYS_FUTEX, uintptr(unsafe.Pointer(addr)), futexWakeOp,
+		math.MaxInt32, 0, 0, 0)
+}
+
+func spinPause() {
+	runtime.Gosched()
+}
@@ -0,0 +1,23 @@
+//go:build !linux
+
+package shmring
+
+import (
+	"runtime"
+	"time"
+)
+
+// pollSleep is how long a waiter sleeps between checks without futexes.
+const pollSleep = 50 * time.Microsecond
+
+// futexWait polls: without futexes, a waiter sleeps briefly instead.
+func futexWait(_ *uint32, _ uint32, timeout time.Duration) {
+	time.Sleep(min(timeout, pollSleep))
+}
+
+// futexWake does nothing: waiters poll.
+func futexWake(_ *uint32) {}
+
+func spinPause() {
+	runtime.Gosched()
+}
@@ -0,0 +1,188 @@
+package shmring
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"runtime"
+	"sync/atomic"
+	"time"
+	"unsafe"
+)
+
+const (
+	// Offsets in a ring's 256-byte control block (SharedRingControl).
+	headOffset     = 0
+	tailOffset     = 64
+	signalOffset   = 128
+	waitersOffset  = 132
+	capacityOffset = 192
+	dataOffset     = 200
+
+	recordHeader = 8
+	kindWrap     = 0
+
+	// spin is how long a consumer polls for a record before sleeping on the
+	// futex: waking a sleeper costs a system call on both sides and tens of
+	// microseconds.
+	spin = 50 * time.Microsecond
+)
+
+var errCorrupt = errors.New("corrupt apply ring")
+
+// ring is one process's end of a SharedRing (cpp-app/src/ipc/shared_ring.hpp):
+// a single-producer single-consumer ring of variable-size records in shared
+// memory. A record is a {u32 length, u32 kind} header and its payload, padded
+// to 8 bytes, and never wraps around the end of the ring: a wrap record
+// (kind 0) fills the space left before the end instead. head and tail count
+// bytes published and released, and never wrap.
+//
+// A consumer with nothing to read polls briefly, then sleeps on a futex in
+// signal, which the producer bumps on every publish and wakes only while
+// waiters is non-zero.
+type ring struct {
+	head     *uint64
+	tail     *uint64
+	signal   *uint32
+	waiters  *uint32
+	data     []byte
+	capacity uint64
+	// reserved is the producer's head once the reserved record is published.
+	reserved uint64
+	// next is the consumer's tail once the peeked record is released.
+	next uint64
+}
+
+// newRing maps the ring whose control block is at offset control in mem.
+func newRing(mem []byte, control int) (*ring, error) {
+	if control+256 > len(mem) {
+		return nil, errCorrupt
+	}
+	block := mem[control:]
+	capacity := binary.NativeEndian.Uint64(block[capacityOffset:])
+	offset := binary.NativeEndian.Uint64(block[dataOffset:])
+	if capacity == 0 || capacity%8 != 0 || offset+capacity > uint64(len(block)) {
+		return nil, fmt.Errorf("%w: ring of %d bytes at %d", errCorrupt, capacity, offset)
+	}
+	return &ring{
+		head:     (*uint64)(unsafe.Pointer(&block[headOffset])),
+		tail:     (*uint64)(unsafe.Pointer(&block[tailOffset])),
+		signal:   (*uint32)(unsafe.Pointer(&block[signalOffset])),
+		waiters:  (*uint32)(unsafe.Pointer(&block[waitersOffset])),
+		data:     block[offset : offset+capacity],
+		capacity: capacity,
+	}, nil
+}
+
+// maxPayload is the largest payload a record can carry: half the ring, so it
+// always fits once the ring is empty.
+func (r *ring) maxPayload() int {
+	return int(r.capacity/2 - recordHeader)
+}
+
+func recordSize(payload int) uint64 {
+	return (recordHeader + uint64(payload) + 7) &^ 7
+}
+
+// tryReserve returns room for the n-byte payload of the next record, or nil
+// if the ring has none until the consumer releases more. The record is not
+// visible to the consumer before publish.
+func (r *ring) tryReserve(kind uint32, n int) []byte {
+	size := recordSize(n)
+	head := atomic.LoadUint64(r.head)
+	tail := atomic.LoadUint64(r.tail)
+	offset := head % r.capacity
+	var skip uint64
+	if offset+size > r.capacity {
+		skip = r.capacity - offset
+	}
+	if head+skip+size-tail > r.capacity {
+		return nil
+	}
+	if skip > 0 {
+		r.writeHeader(offset, 0, kindWrap)
+	}
+	start := (head + skip) % r.capacity
+	r.writeHeader(start, uint32(n), kind)
+	r.reserved = head + skip + size
+	return r.data[start+recordHeader : start+recordHeader+uint64(n)]
+}
+
+// publish makes the reserved record visible, waking the consumer if it
+// sleeps.
+func (r *ring) publish() {
+	atomic.StoreUint64(r.head, r.reserved)
+	atomic.AddUint32(r.signal, 1)
+	if atomic.LoadUint32(r.waiters) != 0 {
+		futexWake(r.signal)
+	}
+}
+
+// peek returns the next published record, skipping wrap records; ok is false
+// if there is none. The payload stays valid until release.
+func (r *ring) peek() (kind uint32, payload []byte, ok bool, err error) {
+	tail := atomic.LoadUint64(r.tail)
+	head := atomic.LoadUint64(r.head)
+	if head-tail > r.capacity || (head-tail)%8 != 0 {
+		return 0, nil, false, errCorrupt
+	}
+	for tail != head {
+		offset := tail % r.capacity
+		length := binary.NativeEndian.Uint32(r.data[offset:])
+		kind := binary.NativeEndian.Uint32(r.data[offset+4:])
+		if kind == kindWrap {
+			tail += r.capacity - offset
+			atomic.StoreUint64(r.tail, tail)
+			continue
+		}
+		size := recordSize(int(length))
+		if size > r.capacity-offset || size > head-tail {
+			return 0, nil, false, errCorrupt
+		}
+		r.next = tail + size
+		start := offset + recordHeader
+		return kind, r.data[start : start+uint64(length)], true, nil
+	}
+	return 0, nil, false, nil
+}
+
+// release frees the record last returned by peek.
+func (r *ring) release() {
+	atomic.StoreUint64(r.tail, r.next)
+}
+
+// wait waits up to timeout for a record to be published, and reports
+// whether one is there to peek.
+func (r *ring) wait(timeout time.Duration) bool {
+	if r.readable() {
+		return true
+	}
+	// Polling only pays with a core for each side
+	if runtime.NumCPU() > 1 {
+		for spinUntil := time.Now().Add(spin); time.Now().Before(spinUntil); {
+			if r.readable() {
+				return true
+			}
+			spinPause()
+		}
+	}
+	seen := atomic.LoadUint32(r.signal)
+	atomic.AddUint32(r.waiters, 1)
+	ready := r.readable()
+	if !ready {
+		// Returns at once if a publish has bumped the signal since seen
+		futexWait(r.signal, seen, timeout)
+		ready = r.readable()
+	}
+	atomic.AddUint32(r.waiters, ^uint32(0))
+	return ready
+}
+
+func (r *ring) readable() bool {
+	return atomic.LoadUint64(r.tail) != atomic.LoadUint64(r.head)
+}
+
+func (r *ring) writeHeader(offset uint64, length, kind uint32) {
+	binary.NativeEndian.PutUint32(r.data[offset:], length)
+	binary.NativeEndian.PutUint32(r.data[offset+4:], kind)
+}
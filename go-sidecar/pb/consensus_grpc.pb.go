@@ -19,7 +19,9 @@ import (
 const _ = grpc.SupportPackageIsVersion9
 
 const (
-	RaftNode_Propose_FullMethodName = "/consensus.RaftNode/Propose"
+	RaftNode_Propose_FullMethodName    = "/consensus.RaftNode/Propose"
+	RaftNode_ReadIndex_FullMethodName  = "/consensus.RaftNode/ReadIndex"
+	RaftNode_Leadership_FullMethodName = "/consensus.RaftNode/Leadership"
 )
 
 // RaftNodeClient is the client API for RaftNode service.
@@ -27,6 +29,13 @@ const (
 // For semantics around ctx use and closing/ending streaming RPCs, please refer to https://pkg.go.dev/google.golang.org/grpc/?tab=doc#ClientConn.NewStream.
 type RaftNodeClient interface {
 	Propose(ctx context.Context, in *Command, opts ...grpc.CallOption) (*ProposeResponse, error)
+	// Confirm leadership with a quorum, then wait until every entry
+	// committed before the call has been applied to the local store, so
+	// local reads that follow are linearizable (Raft ReadIndex).
+	ReadIndex(ctx context.Context, in *ReadIndexRequest, opts ...grpc.CallOption) (*ReadIndexResponse, error)
+	// Whether this node is the leader, as far as it knows: a local check,
+	// with no quorum round trip.
+	Leadership(ctx context.Context, in *LeadershipRequest, opts ...grpc.CallOption) (*LeadershipResponse, error)
 }
 
 type raftNodeClient struct {
@@ -47,11 +56,38 @@ func (c *raftNodeClient) Propose(ctx context.Context, in *Command, opts ...grpc.
 	return out, nil
 }
 
+func (c *raftNodeClient) ReadIndex(ctx context.Context, in *ReadIndexRequest, opts ...grpc.CallOption) (*ReadIndexResponse, error) {
+	cOpts := append([]grpc.CallOption{grpc.StaticMethod()}, opts...)
+	out := new(ReadIndexResponse)
+	err := c.cc.Invoke(ctx, RaftNode_ReadIndex_FullMethodName, in, out, cOpts...)
+	if err != nil {
+		return nil, err
+	}
+	return out, nil
+}
+
+func (c *raftNodeClient) Leadership(ctx context.Context, in *LeadershipRequest, opts ...grpc.CallOption) (*LeadershipResponse, error) {
+	cOpts := append([]grpc.CallOption{grpc.StaticMethod()}, opts...)
+	out := new(LeadershipResponse)
+	err := c.cc.Invoke(ctx, RaftNode_Leadership_FullMethodName, in, out, cOpts...)
+	if err != nil {
+		return nil, err
+	}
+	return out, nil
+}
+
 // RaftNodeServer is the server API for RaftNode service.
 // All implementations must embed UnimplementedRaftNodeServer
 // for forward compatibility.
 type RaftNodeServer interface {
 	Propose(context.Context, *Command) (*ProposeResponse, error)
+	// Confirm leadership with a quorum, then wait until every entry
+	// committed before the call has been applied to the local store, so
+	// local reads that follow are linearizable (Raft ReadIndex).
+	ReadIndex(context.Context, *ReadIndexRequest) (*ReadIndexResponse, error)
+	// Whether this node is the leader, as far as it knows: a local check,
+	// with no quorum round trip.
+	Leadership(context.Context, *LeadershipRequest) (*LeadershipResponse, error)
 	mustEmbedUnimplementedRaftNodeServer()
 }
 
@@ -65,6 +101,12 @@ type UnimplementedRaftNodeServer struct{}
 func (UnimplementedRaftNodeServer) Propose(context.Context, *Command) (*ProposeResponse, error) {
 	return nil, status.Error(codes.Unimplemented, "method Propose not implemented")
 }
+func (UnimplementedRaftNodeServer) ReadIndex(context.Context, *ReadIndexRequest) (*ReadIndexResponse, error) {
+	return nil, status.Error(codes.Unimplemented, "method ReadIndex not implemented")
+}
+func (UnimplementedRaftNodeServer) Leadership(context.Context, *LeadershipRequest) (*LeadershipResponse, error) {
+	return nil, status.Error(codes.Unimplemented, "method Leadership not implemented")
+}
 func (UnimplementedRaftNodeServer) mustEmbedUnimplementedRaftNodeServer() {}
 func (UnimplementedRaftNodeServer) testEmbeddedByValue()                  {}
 
@@ -104,6 +146,42 @@ func _RaftNode_Propose_Handler(srv interface{}, ctx context.Context, dec func(in
 	return interceptor(ctx, in, info, handler)
 }
 
+func _RaftNode_ReadIndex_Handler(srv interface{}, ctx context.Context, dec func(interface{}) error, interceptor grpc.UnaryServerInterceptor) (interface{}, error) {
+	in := new(ReadIndexRequest)
+	if err := dec(in); err != nil {
+		return nil, err
+	}
+	if interceptor == nil {
+		return srv.(RaftNodeServer).ReadIndex(ctx, in)
+	}
+	info := &grpc.UnaryServerInfo{
+		Server:     srv,
+		FullMethod: RaftNode_ReadIndex_FullMethodName,
+	}
+	handler := func(ctx context.Context, req interface{}) (interface{}, error) {
+		return srv.(RaftNodeServer).ReadIndex(ctx, req.(*ReadIndexRequest))
+	}
+	return interceptor(ctx, in, info, handler)
+}
+
+func _RaftNode_Leadership_Handler(srv interface{}, ctx context.Context, dec func(interface{}) error, interceptor grpc.UnaryServerInterceptor) (interface{}, error) {
+	in := new(LeadershipRequest)
+	if err := dec(in); err != nil {
+		return nil, err
+	}
+	if interceptor == nil {
+		return srv.(RaftNodeServer).Leadership(ctx, in)
+	}
+	info := &grpc.UnaryServerInfo{
+		Server:     srv,
+		FullMethod: RaftNode_Leadership_FullMethodName,
+	}
+	handler := func(ctx context.Context, req interface{}) (interface{}, error) {
+		return srv.(RaftNodeServer).Leadership(ctx, req.(*LeadershipRequest))
+	}
+	return interceptor(ctx, in, info, handler)
+}
+
 // RaftNode_ServiceDesc is the grpc.ServiceDesc for RaftNode service.
 // It's only intended for direct use with grpc.RegisterService,
 // and not to be introspected or modified (even as a copy)
@@ -115,13 +193,25 @@ var RaftNode_ServiceDesc = grpc.ServiceDesc{
 			MethodName: "Propose",
 			Handler:    _RaftNode_Propose_Handler,
 		},
+		{
+			MethodName: "ReadIndex",
+			Handler:    _RaftNode_ReadIndex_Handler,
+		},
+		{
+			MethodName: "Leadership",
+			Handler:    _RaftNode_Leadership_Handler,
+		},
 	},
 	Streams:  []grpc.StreamDesc{},
 	Metadata: "consensus.proto",
 }
 
 const (
-	StateMachine_Apply_FullMethodName = "/consensus.StateMachine/Apply"
+	StateMachine_Apply_FullMethodName        = "/consensus.StateMachine/Apply"
+	StateMachine_ApplyBatch_FullMethodName   = "/consensus.StateMachine/ApplyBatch"
+	StateMachine_Snapshot_FullMethodName     = "/consensus.StateMachine/Snapshot"
+	StateMachine_Restore_FullMethodName      = "/consensus.StateMachine/Restore"
+	StateMachine_AppliedIndex_FullMethodName = "/consensus.StateMachine/AppliedIndex"
 )
 
 // StateMachineClient is the client API for StateMachine service.
@@ -129,6 +219,18 @@ const (
 // For semantics around ctx use and closing/ending streaming RPCs, please refer to https://pkg.go.dev/google.golang.org/grpc/?tab=doc#ClientConn.NewStream.
 type StateMachineClient interface {
 	Apply(ctx context.Context, in *Command, opts ...grpc.CallOption) (*ApplyResponse, error)
+	// Apply committed entries a batch at a time, in log order, over one
+	// long-lived stream: each CommandBatch is answered by one
+	// ApplyBatchResponse before the next is sent.
+	ApplyBatch(ctx context.Context, opts ...grpc.CallOption) (grpc.BidiStreamingClient[CommandBatch, ApplyBatchResponse], error)
+	// Stream a point-in-time copy of the store. The first chunk is empty
+	// and is sent once the point in time has been fixed.
+	Snapshot(ctx context.Context, in *SnapshotRequest, opts ...grpc.CallOption) (grpc.ServerStreamingClient[SnapshotChunk], error)
+	// Replace the store's contents with a snapshot stream.
+	Restore(ctx context.Context, opts ...grpc.CallOption) (grpc.ClientStreamingClient[SnapshotChunk, RestoreResponse], error)
+	// The position of the last entry the store holds, so a restarted
+	// sidecar can skip the entries already applied.
+	AppliedIndex(ctx context.Context, in *AppliedIndexRequest, opts ...grpc.CallOption) (*AppliedIndexResponse, error)
 }
 
 type stateMachineClient struct {
@@ -149,11 +251,78 @@ func (c *stateMachineClient) Apply(ctx context.Context, in *Command, opts ...grp
 	return out, nil
 }
 
+func (c *stateMachineClient) ApplyBatch(ctx context.Context, opts ...grpc.CallOption) (grpc.BidiStreamingClient[CommandBatch, ApplyBatchResponse], error) {
+	cOpts := append([]grpc.CallOption{grpc.StaticMethod()}, opts...)
+	stream, err := c.cc.NewStream(ctx, &StateMachine_ServiceDesc.Streams[0], StateMachine_ApplyBatch_FullMethodName, cOpts...)
+	if err != nil {
+		return nil, err
+	}
+	x := &grpc.GenericClientStream[CommandBatch, ApplyBatchResponse]{ClientStream: stream}
+	return x, nil
+}
+
+// This type alias is provided for backwards compatibility with existing code that references the prior non-generic stream type by name.
+type StateMachine_ApplyBatchClient = grpc.BidiStreamingClient[CommandBatch, ApplyBatchResponse]
+
+func (c *stateMachineClient) Snapshot(ctx context.Context, in *SnapshotRequest, opts ...grpc.CallOption) (grpc.ServerStreamingClient[SnapshotChunk], error) {
+	cOpts := append([]grpc.CallOption{grpc.StaticMethod()}, opts...)
+	stream, err := c.cc.NewStream(ctx, &StateMachine_ServiceDesc.Streams[1], StateMachine_Snapshot_FullMethodName, cOpts...)
+	if err != nil {
+		return nil, err
+	}
+	x := &grpc.GenericClientStream[SnapshotRequest, SnapshotChunk]{ClientStream: stream}
+	if err := x.ClientStream.SendMsg(in); err != nil {
+		return nil, err
+	}
+	if err := x.ClientStream.CloseSend(); err != nil {
+		return nil, err
+	}
+	return x, nil
+}
+
+// This type alias is provided for backwards compatibility with existing code that references the prior non-generic stream type by name.
+type StateMachine_SnapshotClient = grpc.ServerStreamingClient[SnapshotChunk]
+
+func (c *stateMachineClient) Restore(ctx context.Context, opts ...grpc.CallOption) (grpc.ClientStreamingClient[SnapshotChunk, RestoreResponse], error) {
+	cOpts := append([]grpc.CallOption{grpc.StaticMethod()}, opts...)
+	stream, err := c.cc.NewStream(ctx, &StateMachine_ServiceDesc.Streams[2], StateMachine_Restore_FullMethodName, cOpts...)
+	if err != nil {
+		return nil, err
+	}
+	x := &grpc.GenericClientStream[SnapshotChunk, RestoreResponse]{ClientStream: stream}
+	return x, nil
+}
+
+// This type alias is provided for backwards compatibility with existing code that references the prior non-generic stream type by name.
+type StateMachine_RestoreClient = grpc.ClientStreamingClient[SnapshotChunk, RestoreResponse]
+
+func (c *stateMachineClient) AppliedIndex(ctx context.Context, in *AppliedIndexRequest, opts ...grpc.CallOption) (*AppliedIndexResponse, error) {
+	cOpts := append([]grpc.CallOption{grpc.StaticMethod()}, opts...)
+	out := new(AppliedIndexResponse)
+	err := c.cc.Invoke(ctx, StateMachine_AppliedIndex_FullMethodName, in, out, cOpts...)
+	if err != nil {
+		return nil, err
+	}
+	return out, nil
+}
+
 // StateMachineServer is the server API for StateMachine service.
 // All implementations must embed UnimplementedStateMachineServer
 // for forward compatibility.
 type StateMachineServer interface {
 	Apply(context.Context, *Command) (*ApplyResponse, error)
+	// Apply committed entries a batch at a time, in log order, over one
+	// long-lived stream: each CommandBatch is answered by one
+	// ApplyBatchResponse before the next is sent.
+	ApplyBatch(grpc.BidiStreamingServer[CommandBatch, ApplyBatchResponse]) error
+	// Stream a point-in-time copy of the store. The first chunk is empty
+	// and is sent once the point in time has been fixed.
+	Snapshot(*SnapshotRequest, grpc.ServerStreamingServer[SnapshotChunk]) error
+	// Replace the store's contents with a snapshot stream.
+	Restore(grpc.ClientStreamingServer[SnapshotChunk, RestoreResponse]) error
+	// The position of the last entry the store holds, so a restarted
+	// sidecar can skip the entries already applied.
+	AppliedIndex(context.Context, *AppliedIndexRequest) (*AppliedIndexResponse, error)
 	mustEmbedUnimplementedStateMachineServer()
 }
 
@@ -167,6 +336,18 @@ type UnimplementedStateMachineServer struct{}
 func (UnimplementedStateMachineServer) Apply(context.Context, *Command) (*ApplyResponse, error) {
 	return nil, status.Error(codes.Unimplemented, "method Apply not implemented")
 }
+func (UnimplementedStateMachineServer) ApplyBatch(grpc.BidiStreamingServer[CommandBatch, ApplyBatchResponse]) error {
+	return status.Error(codes.Unimplemented, "method ApplyBatch not implemented")
+}
+func (UnimplementedStateMachineServer) Snapshot(*SnapshotRequest, grpc.ServerStreamingServer[SnapshotChunk]) error {
+	return status.Error(codes.Unimplemented, "method Snapshot not implemented")
+}
+func (UnimplementedStateMachineServer) Restore(grpc.ClientStreamingServer[SnapshotChunk, RestoreResponse]) error {
+	return status.Error(codes.Unimplemented, "method Restore not implemented")
+}
+func (UnimplementedStateMachineServer) AppliedIndex(context.Context, *AppliedIndexRequest) (*AppliedIndexResponse, error) {
+	return nil, status.Error(codes.Unimplemented, "method AppliedIndex not implemented")
+}
 func (UnimplementedStateMachineServer) mustEmbedUnimplementedStateMachineServer() {}
 func (UnimplementedStateMachineServer) testEmbeddedByValue()                      {}
 
@@ -206,6 +387,49 @@ func _StateMachine_Apply_Handler(srv interface{}, ctx context.Context, dec func(
 	return interceptor(ctx, in, info, handler)
 }
 
+func _StateMachine_ApplyBatch_Handler(srv interface{}, stream grpc.ServerStream) error {
+	return srv.(StateMachineServer).ApplyBatch(&grpc.GenericServerStream[CommandBatch, ApplyBatchResponse]{ServerStream: stream})
+}
+
+// This type alias is provided for backwards compatibility with existing code that references the prior non-generic stream type by name.
+type StateMachine_ApplyBatchServer = grpc.BidiStreamingServer[CommandBatch, ApplyBatchResponse]
+
+func _StateMachine_Snapshot_Handler(srv interface{}, stream grpc.ServerStream) error {
+	m := new(SnapshotRequest)
+	if err := stream.RecvMsg(m); err != nil {
+		return err
+	}
+	return srv.(StateMachineServer).Snapshot(m, &grpc.GenericServerStream[SnapshotRequest, SnapshotChunk]{ServerStream: stream})
+}
+
+// This type alias is provided for backwards compatibility with existing code that references the prior non-generic stream type by name.
+type StateMachine_SnapshotServer = grpc.ServerStreamingServer[SnapshotChunk]
+
+func _StateMachine_Restore_Handler(srv interface{}, stream grpc.ServerStream) error {
+	return srv.(StateMachineServer).Restore(&grpc.GenericServerStream[SnapshotChunk, RestoreResponse]{ServerStream: stream})
+}
+
+// This type alias is provided for backwards compatibility with existing code that references the prior non-generic stream type by name.
+type StateMachine_RestoreServer = grpc.ClientStreamingServer[SnapshotChunk, RestoreResponse]
+
+func _StateMachine_AppliedIndex_Handler(srv interface{}, ctx context.Context, dec func(interface{}) error, interceptor grpc.UnaryServerInterceptor) (interface{}, error) {
+	in := new(AppliedIndexRequest)
+	if err := dec(in); err != nil {
+		return nil, err
+	}
+	if interceptor == nil {
+		return srv.(StateMachineServer).AppliedIndex(ctx, in)
+	}
+	info := &grpc.UnaryServerInfo{
+		Server:     srv,
+		FullMethod: StateMachine_AppliedIndex_FullMethodName,
+	}
+	handler := func(ctx context.Context, req interface{}) (interface{}, error) {
+		return srv.(StateMachineServer).AppliedIndex(ctx, req.(*AppliedIndexRequest))
+	}
+	return interceptor(ctx, in, info, handler)
+}
+
 // StateMachine_ServiceDesc is the grpc.ServiceDesc for StateMachine service.
 // It's only intended for direct use with grpc.RegisterService,
 // and not to be introspected or modified (even as a copy)
@@ -217,7 +441,28 @@ var StateMachine_ServiceDesc = grpc.ServiceDesc{
 			MethodName: "Apply",
 			Handler:    _StateMachine_Apply_Handler,
 		},
+		{
+			MethodName: "AppliedIndex",
+			Handler:    _StateMachine_AppliedIndex_Handler,
+		},
+	},
+	Streams: []grpc.StreamDesc{
+		{
+			StreamName:    "ApplyBatch",
+			Handler:       _StateMachine_ApplyBatch_Handler,
+			ServerStreams: true,
+			ClientStreams: true,
+		},
+		{
+			StreamName:    "Snapshot",
+			Handler:       _StateMachine_Snapshot_Handler,
+			ServerStreams: true,
+		},
+		{
+			StreamName:    "Restore",
+			Handler:       _StateMachine_Restore_Handler,
+			ClientStreams: true,
+		},
 	},
-	Streams:  []grpc.StreamDesc{},
 	Metadata: "consensus.proto",
 }